@@ -0,0 +1,87 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <benchmark/benchmark.h>
+#include <CamEncoder/av_file_io.h>
+#include <CamEncoder/av_error.h>
+#include <fmt/format.h>
+#include <cstdio>
+#include <vector>
+
+constexpr auto benchmark_filename = "benchmark_file_io.bin";
+
+/*!
+ * Write the amount of bytes a lossless recording would produce, in packet sized chunks.
+ */
+static void write_packets(AVIOContext *context, const std::vector<uint8_t> &packet, int64_t total_size)
+{
+    for (int64_t written = 0; written < total_size; written += packet.size())
+        avio_write(context, packet.data(), static_cast<int>(packet.size()));
+    avio_flush(context);
+}
+
+static void file_io_default_avio(benchmark::State &state)
+{
+    const std::vector<uint8_t> packet(static_cast<size_t>(state.range(0)), 0x5a);
+    const auto total_size = state.range(1) * 1024 * 1024;
+
+    for (auto _ : state)
+    {
+        AVIOContext *context = nullptr;
+        if (int ret = avio_open(&context, benchmark_filename, AVIO_FLAG_WRITE); ret < 0)
+            throw std::runtime_error(fmt::format("unable to open output: {}", av_error_to_string(ret)));
+
+        write_packets(context, packet, total_size);
+        avio_closep(&context);
+    }
+
+    state.SetBytesProcessed(state.iterations() * total_size);
+    std::remove(benchmark_filename);
+}
+
+static void file_io_large_buffer(benchmark::State &state, bool direct_io)
+{
+    const std::vector<uint8_t> packet(static_cast<size_t>(state.range(0)), 0x5a);
+    const auto total_size = state.range(1) * 1024 * 1024;
+
+    av_file_io_config config;
+    config.direct_io = direct_io;
+
+    for (auto _ : state)
+    {
+        av_file_io file_io(benchmark_filename, config);
+        write_packets(file_io.get_context(), packet, total_size);
+        if (int ret = file_io.close(); ret < 0)
+            throw std::runtime_error(fmt::format("unable to write output: {}", av_error_to_string(ret)));
+    }
+
+    state.SetBytesProcessed(state.iterations() * total_size);
+    std::remove(benchmark_filename);
+}
+
+static void file_io_arguments(benchmark::internal::Benchmark *benchmark)
+{
+    // packet size in bytes, file size in MiB; roughly a cscd and a ffv1 1080p frame.
+    benchmark->Args({256 * 1024, 512});
+    benchmark->Args({2 * 1024 * 1024, 1024});
+    benchmark->Unit(benchmark::kMillisecond);
+    benchmark->UseRealTime();
+}
+
+BENCHMARK(file_io_default_avio)->Apply(file_io_arguments);
+BENCHMARK_CAPTURE(file_io_large_buffer, cached, false)->Apply(file_io_arguments);
+BENCHMARK_CAPTURE(file_io_large_buffer, direct, true)->Apply(file_io_arguments);
@@ -0,0 +1,73 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <benchmark/benchmark.h>
+#include <CamEncoder/av_video.h>
+#include "benchmark_utilities.h"
+
+/*!
+ * Encode a synthetic desktop with one of the lossless codecs. Reports the raw frame throughput
+ * (bytes_per_second, items_per_second is frames per second) and the average compressed frame size.
+ */
+static void encode_lossless(benchmark::State &state, video::codec codec)
+{
+    const auto width = static_cast<int>(state.range(0));
+    const auto height = static_cast<int>(state.range(1));
+
+    synthetic_screen screen(width, height);
+
+    av_video_codec config;
+    config.pixel_format = AV_PIX_FMT_BGRA;
+
+    av_dict avargs;
+    av_video video(config, create_benchmark_video_config(codec, width, height, 60));
+    video.open(nullptr, avargs);
+
+    timestamp_t timestamp = 0;
+    int64_t compressed_size = 0;
+    for (auto _ : state)
+    {
+        screen.next_frame();
+        video.push_encode_frame(timestamp, screen.data(), screen.width(), screen.height(),
+            screen.stride());
+        compressed_size += pull_encoded_bytes(video);
+        timestamp += 16;
+    }
+
+    // flush so frame threaded encoders also account for their queued frames.
+    video.push_encode_frame(0, nullptr, 0, 0, 0);
+    compressed_size += pull_encoded_bytes(video);
+
+    const auto frames = static_cast<int64_t>(state.iterations());
+    state.SetItemsProcessed(frames);
+    state.SetBytesProcessed(frames * static_cast<int64_t>(screen.frame_size()));
+    state.counters["frame_kb"] = static_cast<double>(compressed_size) / frames / 1024.0;
+    state.counters["ratio"] = static_cast<double>(frames * screen.frame_size()) / compressed_size;
+}
+
+static void lossless_resolutions(benchmark::internal::Benchmark *benchmark)
+{
+    benchmark->Args({1280, 720});
+    benchmark->Args({1920, 1080});
+    benchmark->Args({3840, 2160});
+    benchmark->Unit(benchmark::kMillisecond);
+    benchmark->UseRealTime();
+}
+
+BENCHMARK_CAPTURE(encode_lossless, cscd, video::codec::camstudio)->Apply(lossless_resolutions);
+BENCHMARK_CAPTURE(encode_lossless, ffv1, video::codec::ffv1)->Apply(lossless_resolutions);
+BENCHMARK_CAPTURE(encode_lossless, utvideo, video::codec::utvideo)->Apply(lossless_resolutions);
@@ -0,0 +1,144 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <CamEncoder/av_video.h>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+/*!
+ * A bgra frame that somewhat looks like a desktop: a flat background, a couple of 'windows' with
+ * lines of 'text' and a block that moves every frame so the encoder always has some work to do.
+ */
+class synthetic_screen
+{
+public:
+    synthetic_screen(const int width, const int height)
+        : width_(width)
+        , height_(height)
+        , stride_(width * 4)
+        , data_(static_cast<size_t>(stride_) * height)
+    {
+        _fill_rect(0, 0, width_, height_, 0xff3a6ea5);
+
+        for (int window = 0; window < 3; ++window)
+        {
+            const auto left = width_ / 8 + window * width_ / 5;
+            const auto top = height_ / 8 + window * height_ / 6;
+            const auto right = left + width_ / 2;
+            const auto bottom = top + height_ / 2;
+            _fill_rect(left, top, right, bottom, 0xffffffff);
+            _fill_rect(left, top, right, top + 24, 0xff1f1f1f);
+
+            // every line is a row of 'glyphs' of a slightly different length.
+            for (int y = top + 32; y + 12 < bottom; y += 16)
+                for (int x = left + 8; x + 8 < right; x += 8 + ((x * 7 + y) % 5))
+                    _fill_rect(x, y, x + 6, y + 10, 0xff000000);
+        }
+    }
+
+    void next_frame()
+    {
+        const auto size = 64;
+        const auto x = (frame_number_ * 8) % (width_ - size);
+        const auto y = (frame_number_ * 4) % (height_ - size);
+        _fill_rect(x, y, x + size, y + size, 0xff000000 | (frame_number_ * 2654435761u));
+        ++frame_number_;
+    }
+
+    auto data() noexcept -> unsigned char *
+    {
+        return data_.data();
+    }
+
+    auto width() const noexcept -> int
+    {
+        return width_;
+    }
+
+    auto height() const noexcept -> int
+    {
+        return height_;
+    }
+
+    auto stride() const noexcept -> int
+    {
+        return stride_;
+    }
+
+    auto frame_size() const noexcept -> size_t
+    {
+        return data_.size();
+    }
+
+private:
+    void _fill_rect(int left, int top, int right, int bottom, uint32_t bgra)
+    {
+        for (int y = top; y < bottom; ++y)
+        {
+            auto *row = reinterpret_cast<uint32_t *>(data_.data() + static_cast<size_t>(y) * stride_);
+            for (int x = left; x < right; ++x)
+                row[x] = bgra;
+        }
+    }
+
+    int width_;
+    int height_;
+    int stride_;
+    std::vector<unsigned char> data_;
+    unsigned int frame_number_{0};
+};
+
+inline av_video_meta create_benchmark_video_config(video::codec codec, const int width,
+                                                   const int height, const int fps)
+{
+    av_video_meta meta;
+    meta.codec = codec;
+    meta.container = video::container::mkv;
+    meta.quality = 25;
+    meta.bpp = 32;
+    meta.width = width;
+    meta.height = height;
+    meta.fps = {fps, 1};
+    meta.preset = video::preset::ultrafast;
+    return meta;
+}
+
+/*!
+ * Drain the encoder and return the amount of compressed bytes it produced.
+ */
+inline auto pull_encoded_bytes(av_video &video) -> int64_t
+{
+    AVPacket pkt = {};
+    av_init_packet(&pkt);
+
+    int64_t size = 0;
+    for (bool valid_packet = true; valid_packet;)
+    {
+        if (!video.pull_encoded_packet(&pkt, &valid_packet))
+            throw std::runtime_error("pull encoded packet failed");
+
+        if (!valid_packet)
+            break;
+
+        size += pkt.size;
+        av_packet_unref(&pkt);
+    }
+    return size;
+}
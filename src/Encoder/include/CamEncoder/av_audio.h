@@ -17,7 +17,87 @@
 
 #pragma once
 
-class av_audio
+#include "av_config.h"
+#include "av_icodec.h"
+#include "av_dict.h"
+#include "av_ffmpeg.h"
+#include "av_sample_ring.h"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+struct av_audio_stats
 {
+    int64_t samples_pushed{0};
+    // samples that did not fit in the ring, they are replaced by silence to stay in sync.
+    int64_t samples_dropped{0};
+    int64_t samples_encoded{0};
+
+    // the largest difference between the capture timestamp of a block of samples and the timestamp
+    // the sample count gives it, in microseconds. This is the a/v sync error of the audio track.
+    int64_t max_sync_error{0};
+};
+
+class av_audio : public av_icodec
+{
+public:
+    av_audio(const av_audio_codec &config, const av_audio_meta &meta);
+    ~av_audio() override;
+
+    void open(AVStream *stream, av_dict &dict) override;
+
+    /*!
+     * Queue captured samples, timestamp is the capture time of the first sample on the clock of
+     * the video frames. This is lock free, so it can be called from an audio capture callback.
+     * Returns the amount of samples that fit in the ring.
+     */
+    auto push_samples(timestamp_t timestamp, const uint8_t *data, int sample_count) noexcept -> int;
+
+    /*!
+     * Resample the queued samples and encode all complete codec frames. When flush is set the
+     * last partial frame is encoded as well and the encoder is flushed.
+     */
+    void encode_pending(bool flush);
+
+    bool pull_encoded_packet(AVPacket *pkt, bool *valid_packet) override;
+
+    auto get_codec() const noexcept -> audio::codec;
+    AVCodecContext *get_codec_context() const noexcept override;
+    AVRational get_time_base() const noexcept override;
+    auto get_stats() const noexcept -> av_audio_stats;
+
+private:
+    void _resample(const uint8_t *data, int sample_count);
+    void _insert_silence(int sample_count);
+    void _ensure_resample_capacity(int sample_count);
+    void _encode_frame(AVFrame *frame);
+
+    audio::codec codec_type_;
+    av_audio_codec input_;
+
+    AVCodec *codec_{ nullptr };
+    AVCodecContext *context_{ nullptr };
+    SwrContext *swr_context_{ nullptr };
+    AVAudioFifo *fifo_{ nullptr };
+    AVFrame *frame_{ nullptr };
+    AVFrame *resample_frame_{ nullptr };
+    int frame_size_{ 0 };
+    av_dict av_opts_{};
+
+    // producer side, written from the capture callback.
+    av_sample_ring ring_;
+    std::atomic<int64_t> first_timestamp_{ -1 };
+    std::atomic<int64_t> samples_pushed_{ 0 };
+    std::atomic<int64_t> samples_dropped_{ 0 };
+    std::atomic<int64_t> max_sync_error_{ 0 };
 
-};
\ No newline at end of file
+    // consumer side.
+    std::vector<uint8_t> input_buffer_;
+    int64_t silence_inserted_{ 0 };
+    int64_t start_pts_{ AV_NOPTS_VALUE };
+    int64_t samples_encoded_{ 0 };
+    bool flushed_{ false };
+    std::deque<AVPacket *> packets_;
+};
@@ -0,0 +1,129 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "av_config.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*!
+ * Receives a block of interleaved samples, timestamp is the capture time of the first sample in
+ * microseconds since the epoch passed to av_audio_source::start.
+ */
+using av_audio_callback = std::function<void(timestamp_t timestamp, const uint8_t *data,
+    int sample_count)>;
+
+/*!
+ * A source of audio samples, the callback is called from a thread owned by the source.
+ */
+class av_audio_source
+{
+public:
+    virtual ~av_audio_source() = default;
+
+    virtual auto get_format() const noexcept -> av_audio_codec = 0;
+    virtual void start(std::chrono::steady_clock::time_point epoch, av_audio_callback callback) = 0;
+    virtual void stop() = 0;
+};
+
+/*!
+ * Delivers a block of samples every period, like an audio capture device does. Derived classes
+ * only generate the samples, and must call stop in their destructor.
+ */
+class av_paced_audio_source : public av_audio_source
+{
+public:
+    explicit av_paced_audio_source(av_audio_codec format,
+        std::chrono::milliseconds period = std::chrono::milliseconds(10));
+    ~av_paced_audio_source() override;
+
+    auto get_format() const noexcept -> av_audio_codec override;
+    void start(std::chrono::steady_clock::time_point epoch, av_audio_callback callback) override;
+    void stop() override;
+
+protected:
+    /*!
+     * Fill data with the next sample_count samples, return false when the source has ended.
+     */
+    virtual bool fill(uint8_t *data, int sample_count) = 0;
+
+private:
+    void _run(std::chrono::steady_clock::time_point epoch, av_audio_callback callback);
+
+    av_audio_codec format_;
+    std::chrono::milliseconds period_;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
+
+/*!
+ * A sine tone, used to test the audio track without a capture device.
+ */
+class av_sine_source : public av_paced_audio_source
+{
+public:
+    explicit av_sine_source(av_audio_codec format, double frequency = 440.0,
+        double amplitude = 0.25);
+    ~av_sine_source() override;
+
+protected:
+    bool fill(uint8_t *data, int sample_count) override;
+
+private:
+    double phase_{0.0};
+    double phase_step_;
+    double amplitude_;
+};
+
+struct av_wav_data
+{
+    av_audio_codec format;
+    std::vector<uint8_t> samples;
+};
+
+/*!
+ * Read a 16 bit pcm or 32 bit float wav file.
+ */
+auto load_wav_file(const std::string &filename) -> av_wav_data;
+
+/*!
+ * Plays a wav file, see load_wav_file for the supported formats.
+ */
+class av_wav_source : public av_paced_audio_source
+{
+public:
+    explicit av_wav_source(const std::string &filename, bool loop = false);
+    ~av_wav_source() override;
+
+protected:
+    bool fill(uint8_t *data, int sample_count) override;
+
+private:
+    av_wav_source(av_wav_data data, bool loop);
+
+    std::vector<uint8_t> samples_;
+    size_t frame_size_;
+    size_t position_{0};
+    bool loop_;
+};
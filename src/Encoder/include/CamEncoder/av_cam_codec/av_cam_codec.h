@@ -18,6 +18,7 @@
 #pragma once
 
 #include "CamEncoder/av_ffmpeg.h"
+#include "CamEncoder/av_pixel_format.h"
 
 struct CamStudioContext
 {
@@ -33,6 +34,9 @@ struct CamStudioContext
     AVFrame *previouse_frame;
     AVFrame *delta_frame;
 
+    /* frame delta kernel for the pixel format, selected at init */
+    pixel_format::delta_kernel delta;
+
     unsigned int comp_size;
     unsigned char *comp_buf;
 
@@ -46,9 +50,9 @@ struct CamStudioContext
 };
 
 /* init video encoder */
-int __cdecl cam_codec_init(AVCodecContext *avctx);
-int __cdecl cam_codec_encode_picture(AVCodecContext *avctx, AVPacket *pkt, const AVFrame *frame, int *got_packet);
-int __cdecl cam_codec_encode_end(AVCodecContext *avctx);
+int cam_codec_init(AVCodecContext *avctx);
+int cam_codec_encode_picture(AVCodecContext *avctx, AVPacket *pkt, const AVFrame *frame, int *got_packet);
+int cam_codec_encode_end(AVCodecContext *avctx);
 
 #define OFFSET(x) offsetof(CamStudioContext, x)
 static const AVOption cam_codec_options[] = {
@@ -0,0 +1,106 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "av_config.h"
+#include "av_dict.h"
+#include "av_ffmpeg.h"
+#include <vector>
+
+/*!
+ * The amount of frames an encoder holds on to before it produces a packet.
+ */
+enum class av_codec_latency
+{
+    none, // every frame results in a packet (intra/delta coders like cscd)
+    low,  // a small fixed delay, a.e. x264 with zerolatency
+    high  // lookahead and/or b-frames
+};
+
+using av_codec_find_encoder = AVCodec *(*)();
+
+/*!
+ * Map the user configuration onto the codec context and the codec private options.
+ */
+using av_codec_option_mapper = void (*)(const av_video_meta &meta, AVCodecContext *context,
+    av_dict &options);
+
+struct av_codec_descriptor
+{
+    video::codec codec{video::codec::x264};
+    av_video_codec_type codec_type{av_video_codec_type::none};
+    const char *name{""};
+
+    av_codec_find_encoder find_encoder{nullptr};
+
+    // the pixel formats the encoder accepts, in order of preference.
+    std::vector<AVPixelFormat> pixel_formats{};
+
+    // the FF_THREAD_* types the encoder can use, 0 for single threaded encoders or encoders that
+    // manage their own threads.
+    int thread_type{0};
+    av_codec_latency latency{av_codec_latency::high};
+
+    // the containers that are able to store the encoded stream.
+    std::vector<video::container> containers{};
+
+    // the encoder wants a tightly packed frame (linesize == width * bytes per pixel).
+    bool packed_frame{false};
+    // the encoder wants its frame data bottom up (like a windows DIB).
+    bool bottom_up{false};
+
+    av_codec_option_mapper apply_options{nullptr};
+};
+
+/*!
+ * The result of matching a capture pixel format with the pixel formats an encoder accepts.
+ */
+struct av_pixel_format_negotiation
+{
+    AVPixelFormat input_pixel_format{AV_PIX_FMT_NONE};
+    AVPixelFormat output_pixel_format{AV_PIX_FMT_NONE};
+
+    // FF_LOSS_* flags of the conversion, 0 means lossless.
+    int loss{0};
+
+    // when false the frame only needs to be copied (and maybe flipped) into the encoder frame.
+    bool conversion_required{true};
+};
+
+auto negotiate_pixel_format(const av_codec_descriptor &descriptor, AVPixelFormat input_pixel_format)
+    -> av_pixel_format_negotiation;
+
+class av_codec_registry
+{
+public:
+    static auto get() -> av_codec_registry &;
+
+    /*!
+     * Register a codec, when a descriptor for the same video::codec already exists it is replaced.
+     */
+    void register_codec(av_codec_descriptor descriptor);
+
+    auto find(video::codec codec) const -> const av_codec_descriptor &;
+    bool supports_container(video::codec codec, video::container container) const;
+    auto get_codecs() const noexcept -> const std::vector<av_codec_descriptor> &;
+
+private:
+    av_codec_registry();
+
+    std::vector<av_codec_descriptor> codecs_;
+};
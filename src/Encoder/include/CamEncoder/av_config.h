@@ -22,13 +22,21 @@
 #include <string_view>
 #include <string>
 #include <array>
+#include <cstdint>
+
+// timestamps are in microseconds, so high refresh (120/144 fps) captures do not collide.
+using timestamp_t = uint64_t;
+constexpr AVRational timestamp_time_base = {1, 1000000};
 
 namespace video
 {
     enum class codec
     {
         x264,
-        camstudio
+        camstudio,
+        ffv1,
+        utvideo,
+        av1
     };
 
     enum class container
@@ -173,6 +181,15 @@ namespace video
     };
 } // namespace video
 
+namespace audio
+{
+    enum class codec
+    {
+        aac,
+        opus
+    };
+} // namespace audio
+
 struct frame_rate
 {
     int num;
@@ -195,9 +212,39 @@ struct av_video_meta
     std::optional<video::tune> tune;
     std::optional<video::profile> profile; // for example h264
     std::optional<video::codec_level> level;
+
+    // live streaming: no frame delay, sliced threads and no b-frames, the keyframes stay so a
+    // client can join at any gop. Only applies to x264.
+    bool low_latency{ false };
+};
+
+enum class av_video_codec_type
+{
+    none,
+    h264,
+    cscd, // cam codec encoder
+    ffv1,
+    utvideo,
+    av1
 };
 
 struct av_video_codec
 {
     AVPixelFormat pixel_format = AV_PIX_FMT_BGR24;
-};
\ No newline at end of file
+};
+
+struct av_audio_meta
+{
+    audio::codec codec{ audio::codec::aac };
+    int sample_rate{ 48000 };
+    int channels{ 2 };
+    std::optional<double> bitrate; // in kbit/s
+};
+
+// the format of the samples the audio source delivers, always interleaved.
+struct av_audio_codec
+{
+    AVSampleFormat sample_format = AV_SAMPLE_FMT_S16;
+    int sample_rate = 48000;
+    int channels = 2;
+};
@@ -0,0 +1,142 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "av_ffmpeg.h"
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct av_file_io_config
+{
+    // the size of each of the two write buffers, a multiple of the direct io alignment.
+    size_t buffer_size{4 * 1024 * 1024};
+
+    // the file is grown in extents that start at this size and double with every extension, up to
+    // the max extent size.
+    int64_t preallocate_extent{64 * 1024 * 1024};
+    int64_t max_preallocate_extent{1024 * 1024 * 1024};
+
+    // bypass the os file cache for the full (aligned) buffers. Partial buffers and the header
+    // updates after a seek always go through the file cache.
+    bool direct_io{false};
+};
+
+struct av_file_io_stats
+{
+    int64_t bytes_written{0};
+    uint64_t write_count{0};
+    uint64_t direct_write_count{0};
+    uint64_t preallocate_count{0};
+    int64_t preallocated_size{0};
+    // the error of the preallocation that failed, the rest of the file is not preallocated.
+    int preallocate_error{0};
+
+    // the time the muxer waited for the previous buffer to be written.
+    std::chrono::microseconds wait_time{0};
+};
+
+namespace detail
+{
+class native_file;
+}
+
+/*!
+ * An AVIOContext that writes to a file through two large aligned buffers. While one buffer is
+ * filled by the muxer, the other one is written by a background thread. The file is preallocated
+ * ahead of the writes, and truncated to the real size on close.
+ */
+class av_file_io
+{
+public:
+    av_file_io(const std::string &filename, av_file_io_config config);
+    ~av_file_io();
+
+    av_file_io(const av_file_io &) = delete;
+    av_file_io &operator=(const av_file_io &) = delete;
+
+    auto get_context() const noexcept -> AVIOContext *;
+
+    /*!
+     * Flush the AVIOContext and the write buffers, truncate the file to its real size and close it.
+     * Returns the first error that occurred while writing the file.
+     */
+    int close();
+
+    auto get_stats() const -> av_file_io_stats;
+
+    // the required alignment of the buffers and the file offsets for direct io.
+    static constexpr size_t alignment = 4096;
+
+private:
+    struct aligned_delete
+    {
+        void operator()(uint8_t *p) const noexcept;
+    };
+    using aligned_buffer = std::unique_ptr<uint8_t[], aligned_delete>;
+
+    static int _write_packet(void *opaque, uint8_t *buf, int buf_size);
+    static int64_t _seek(void *opaque, int64_t offset, int whence);
+
+    int _write(const uint8_t *data, int size);
+    int64_t _seek(int64_t offset, int whence);
+
+    // hand the current buffer to the writer thread and continue with the other one.
+    int _submit_buffer();
+    // wait until the writer thread is idle, returns the error of the last write.
+    int _wait_for_writer();
+    void _run();
+    int _write_buffer(const uint8_t *data, size_t size, int64_t offset);
+
+    av_file_io_config config_;
+    std::unique_ptr<detail::native_file> file_;
+    AVIOContext *context_{nullptr};
+
+    std::array<aligned_buffer, 2> buffers_;
+    int active_buffer_{0};
+    size_t buffer_fill_{0};
+    // the file offset of the first byte in the active buffer.
+    int64_t buffer_offset_{0};
+
+    // the logical position of the muxer, and the size of the file.
+    int64_t position_{0};
+    int64_t size_{0};
+
+    int64_t allocated_size_{0};
+    int64_t next_extent_{0};
+    bool closed_{false};
+
+    mutable std::mutex lock_;
+    std::condition_variable job_queued_;
+    std::condition_variable job_done_;
+    const uint8_t *job_data_{nullptr};
+    size_t job_size_{0};
+    int64_t job_offset_{0};
+    bool job_pending_{false};
+    bool stopping_{false};
+    int error_{0};
+    av_file_io_stats stats_{};
+
+    std::thread thread_;
+};
@@ -20,10 +20,20 @@
 #include "av_config.h"
 #include "av_audio.h"
 #include "av_video.h"
+#include "av_packet_writer.h"
+#include "av_file_io.h"
+#include "av_pipe_io.h"
+#include "av_segmenter.h"
+#include "av_replay_buffer.h"
+#include "av_tee_sink.h"
 
 #include <memory>
 #include <string>
 #include <array>
+#include <atomic>
+#include <future>
+#include <optional>
+#include <vector>
 
 enum class av_track_type
 {
@@ -36,14 +46,18 @@ enum class av_muxer_type
     none,
     mp4,
     mkv,
-    avi
+    avi,
+    mpegts,
+    nut
 };
 
-constexpr std::array<const char*, 4> av_muxer_type_names = {
+constexpr std::array<const char*, 6> av_muxer_type_names = {
     "invalid",
     "mp4",
     "matroska",
-    "avi"
+    "avi",
+    "mpegts",
+    "nut"
 };
 
 // a wrapper around a single output AVStream
@@ -56,56 +70,166 @@ struct av_track
     int sample_count;
 };
 
+// a frame for one of the video tracks, see av_muxer::encode_frames.
+struct av_video_frame
+{
+    unsigned char *data{nullptr};
+    int width{0};
+    int height{0};
+    int stride{0};
+};
+
 struct av_metadata
 {
     std::string encoding_tool;
 };
 
+struct av_muxer_config
+{
+    av_packet_writer_config writer{};
+
+    // write the output file through av_file_io instead of the default avio file protocol.
+    bool use_file_io{true};
+    av_file_io_config file_io{};
+
+    // mp4: write a fragment per keyframe instead of one moov at the end. Closing the file no
+    // longer depends on the recording length and a truncated file is still playable, but some
+    // players seek slower in a fragmented file or don't support it, so it is opt in.
+    bool fragmented_mp4{false};
+
+    // mkv: reserve space for the cues (the seek index) after the header, so they don't have to be
+    // appended when the file is closed. Every keyframe takes about 16 bytes of cues, so all intra
+    // codecs (ffv1, utvideo, cscd) and long recordings need a lot. When the cues don't fit the file
+    // has no cues at all. 0 disables the reservation.
+    int64_t mkv_reserve_index_space{0};
+
+    // split the recording into segments, instead of writing a single file.
+    std::optional<av_segment_config> segment{};
+
+    // keep the last part of the recording in memory instead of writing a file, see save_replay.
+    std::optional<av_replay_config> replay{};
+
+    // write the container to this file descriptor instead of a file, a.e. av_pipe_io::stdout_fd.
+    // Only the streamable containers (mkv, mpegts and nut) can be written to a pipe.
+    std::optional<int> output_fd{};
+
+    // live streaming, the filename is a udp:// or tcp:// url (a.e. mpegts to a local player).
+    // Packets are written as soon as they are encoded, without the interleaving queue of the
+    // muxer, and the output is flushed after every packet. Use with av_video_meta::low_latency.
+    bool live{false};
+
+    // extra outputs that receive the same encoded packets, a.e. a named pipe for a live consumer.
+    std::vector<av_tee_sink_config> tee{};
+};
+
 class av_muxer
 {
 public:
-    av_muxer(std::string filename, const av_muxer_type muxer_type, av_metadata metadata);
+    av_muxer(std::string filename, const av_muxer_type muxer_type, av_metadata metadata,
+        av_muxer_config config = {});
     ~av_muxer();
 
     // open the muxer so its ready to encode stuff.
     void open();
     void flush();
 
-    // Add a video codec as track/stream.
-    void add_stream(std::unique_ptr<av_video> video_codec);
+    /*!
+     * Flush the encoders and wait until the writers wrote all the queued packets, after this the
+     * writer and tee stats are final and no more frames can be encoded. The destructor finishes as
+     * well.
+     */
+    void finish();
+
+    // Add a video codec as track/stream, returns the index of the video track.
+    int add_stream(std::unique_ptr<av_video> video_codec);
+
+    // Add an audio codec as track/stream, its samples are pushed with av_audio::push_samples.
+    void add_stream(std::unique_ptr<av_audio> audio_codec);
 
     // this sends a video frame to the video encoder and sends any pending results to the muxer.
     void encode_frame(timestamp_t timestamp, unsigned char *data, int width, int height, int stride);
 
-    /* audio output */
-    AVFrame *alloc_audio_frame(enum AVSampleFormat sample_fmt, uint64_t channel_layout,
-        int sample_rate, int nb_samples);
+    // encode a frame for every video track (a.e. one per monitor) with the same timestamp. The
+    // tracks are encoded in parallel, a track without a frame in frames is skipped.
+    void encode_frames(timestamp_t timestamp, const std::vector<av_video_frame> &frames);
 
-    void open_audio(AVFormatContext *format_context, AVCodec *codec, av_track *track,
-        AVDictionary *opt_arg);
+    // a frame pipeline converts frames on its own thread with convert_frame, into frames allocated
+    // with alloc_video_frame, and then encodes them with encode_converted_frames.
+    auto alloc_video_frame(size_t track) const -> AVFrame *;
+    void convert_frame(size_t track, const av_video_frame &frame, timestamp_t timestamp,
+        AVFrame *converted) const;
+    void encode_converted_frames(const std::vector<AVFrame *> &frames);
 
-    /*
-     * encode one audio frame and send it to the muxer
-     * return 1 when encoding is finished, 0 otherwise
-     */
-    int write_audio_frame(av_track *ost, AVFrame *frame);
+    // drain the encoder of a video track and reconfigure it with meta, see av_video::reconfigure.
+    // This has to be called from the thread that encodes the frames.
+    void reconfigure_video(size_t track, const av_video_meta &meta);
+
+    // the number of frames that where dropped because their timestamp collided with the previous
+    // frame in the stream time base.
+    auto get_skipped_frame_count() const noexcept -> int;
+
+    // the statistics of the packet writer thread, only valid after open.
+    auto get_writer_stats() const -> av_packet_writer_stats;
 
-    void close_stream(AVFormatContext *format_context, av_track *ost);
+    // the segments that are completed so far, only in segment mode.
+    auto get_segments() const -> std::vector<av_segment_info>;
+
+    // write the retained part of the recording to a file, only in replay mode.
+    auto save_replay(std::string filename) -> std::future<void>;
+
+    // the statistics of the replay buffer, only valid after open in replay mode.
+    auto get_replay_stats() const -> av_replay_stats;
+
+    // the statistics of the extra outputs, in the order of av_muxer_config::tee.
+    auto get_tee_stats() const -> std::vector<av_tee_sink_stats>;
+
+    // the statistics of the output file, only valid after open when file io is used.
+    auto get_file_io_stats() const -> av_file_io_stats;
+
+    // the statistics of the audio track, empty when there is no audio track.
+    auto get_audio_stats() const -> av_audio_stats;
 
 private:
+    void apply_format_options(av_dict &avargs) const;
     int write_frame(const AVRational &time_base, AVStream *st, AVPacket *pkt);
+    void write_audio_packets(bool flush);
+    bool encode_video(size_t index, timestamp_t timestamp, const av_video_frame &frame);
+    bool encode_video(size_t index, AVFrame *frame);
+    bool _accept_timestamp(size_t index, timestamp_t timestamp);
+    void write_video_packets(size_t index);
+
+    struct video_stream
+    {
+        std::unique_ptr<av_video> codec;
+        av_track track;
+        int64_t last_stream_timestamp{AV_NOPTS_VALUE};
+        int64_t last_dts{AV_NOPTS_VALUE};
+    };
+
+    // runs the encoders of the video tracks after the first one on their own thread.
+    class video_encode_workers;
 private:
     AVFormatContext *format_context_{ nullptr };
     AVOutputFormat *output_format_{ nullptr };
-    std::unique_ptr<av_video> video_codec_{};
-    //std::unique_ptr<av_audio> audio_codec_;
-    av_track video_track{};
+    av_muxer_type muxer_type_{ av_muxer_type::none };
+    std::vector<video_stream> video_streams_{};
+    std::unique_ptr<video_encode_workers> video_workers_{};
+    std::unique_ptr<av_audio> audio_codec_{};
     av_track audio_track{};
     std::string filename_{};
     av_metadata metadata_{};
     AVRational time_base_{1, 0};
-
-    // Commented, because we do not handle audio yet.
-    //int have_audio{0};
-    //int encode_audio{0};
+    std::atomic<int> skipped_frame_count_{0};
+
+    av_muxer_config config_{};
+
+    // packets are written to the output on a separate thread, so a disk stall doesn't stall the
+    // capture.
+    std::unique_ptr<av_packet_writer> writer_{};
+    bool finished_{false};
+    std::unique_ptr<av_file_io> file_io_{};
+    std::unique_ptr<av_pipe_io> pipe_io_{};
+    std::unique_ptr<av_segmenter> segmenter_{};
+    std::unique_ptr<av_replay_buffer> replay_{};
+    std::vector<std::unique_ptr<av_tee_sink>> tee_sinks_{};
 };
@@ -0,0 +1,118 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "av_config.h"
+#include <array>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+
+enum class av_governor_step
+{
+    preset, // a faster encoder preset (x264 only)
+    scale,  // encode at a smaller size (x264 only)
+    fps     // capture less frames per second
+};
+
+struct av_governor_config
+{
+    // the order in which the governor gives up quality when the recording can't keep up, it steps
+    // back up in the reverse order.
+    std::vector<av_governor_step> order{av_governor_step::preset, av_governor_step::scale,
+        av_governor_step::fps};
+
+    // the amount of presets the governor may go faster than the configured one.
+    int max_preset_steps{3};
+    std::vector<double> scales{0.75, 0.5};
+    std::vector<double> fps_factors{0.75, 0.5};
+
+    // a window is overloaded when the busiest stage needs more than this part of the frame time,
+    // and has headroom when it needs less than this part.
+    double overload_load{0.9};
+    double headroom_load{0.5};
+
+    std::chrono::milliseconds window{2000};
+    // the amount of windows in a row with headroom, before stepping back up.
+    int recover_windows{3};
+};
+
+// how far every step is taken, 0 is the configured value.
+struct av_governor_level
+{
+    int preset{0};
+    int scale{0};
+    int fps{0};
+};
+
+struct av_governor_event
+{
+    std::chrono::microseconds timestamp{0};
+    av_governor_step step{av_governor_step::preset};
+    bool step_down{true};
+    double load{0.0};
+    av_governor_level level{};
+    std::string description;
+};
+
+/*!
+ * Watches the load of the recording, and picks a faster encoder preset, a smaller size or a lower
+ * frame rate when it is not able to keep up. It only decides, applying the level is up to the
+ * caller (see get_video_meta and get_fps).
+ */
+class av_overload_governor
+{
+public:
+    av_overload_governor(const av_governor_config &config, const av_video_meta &meta, int fps);
+
+    /*!
+     * Add the load of a frame: the time the busiest pipeline stage needed for it, compared to the
+     * frame time. overrun marks frames that were dropped, missed their deadline or found the queues
+     * full. Returns an event when the level changed.
+     */
+    auto add_frame(std::chrono::microseconds timestamp, std::chrono::microseconds busiest_stage_time,
+        std::chrono::microseconds frame_time, bool overrun) -> std::optional<av_governor_event>;
+
+    auto get_level() const noexcept -> const av_governor_level &;
+
+    // the video configuration and frame rate for the current level.
+    auto get_video_meta() const -> av_video_meta;
+    // apply the current level onto the configuration of another track.
+    auto get_video_meta(const av_video_meta &meta) const -> av_video_meta;
+    auto get_fps() const noexcept -> int;
+
+private:
+    auto _change(av_governor_step step, bool step_down, double load) -> av_governor_event;
+    auto _level(av_governor_step step) noexcept -> int &;
+    auto _max_level(av_governor_step step) const noexcept -> int;
+    auto _describe(av_governor_step step) const -> std::string;
+
+    av_governor_config config_;
+    av_video_meta meta_;
+    int fps_;
+    av_governor_level level_{};
+
+    std::chrono::microseconds busy_time_{0};
+    std::chrono::microseconds frame_time_{0};
+    int overrun_count_{0};
+    int recover_count_{0};
+    // the window after a change is not judged, it holds the cost of the change itself.
+    bool settling_{false};
+    std::chrono::microseconds timestamp_{0};
+};
@@ -0,0 +1,120 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "av_ffmpeg.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ * What to do with a new packet when the writer queue is full.
+ */
+enum class av_packet_queue_policy
+{
+    // wait for the writer, this stalls the capture thread for as long as the disk stalls.
+    block,
+    // drop non-key packets up to the next key packet, key packets still block.
+    drop_non_key,
+    // keep queueing past the queue size, memory grows for as long as the disk stalls.
+    spill
+};
+
+struct av_packet_writer_config
+{
+    av_packet_queue_policy policy{av_packet_queue_policy::block};
+    size_t queue_size{120};
+};
+
+struct av_packet_writer_stats
+{
+    uint64_t packets_written{0};
+    uint64_t packets_dropped{0};
+    // packets that were queued while the queue was full.
+    uint64_t packets_spilled{0};
+
+    size_t queue_depth{0};
+    size_t max_queue_depth{0};
+
+    // the amount of times, and the total time, the producer had to wait for the writer.
+    uint64_t stall_count{0};
+    std::chrono::microseconds stall_time{0};
+
+    // the slowest single write.
+    std::chrono::microseconds max_write_time{0};
+};
+
+/*!
+ * Writes packets on a dedicated thread, so slow storage does not delay the thread that produces
+ * the packets. The packets are written in the order they were pushed.
+ */
+class av_packet_writer
+{
+public:
+    // the write function takes ownership of the packet data, like av_interleaved_write_frame.
+    using write_function = std::function<int(AVPacket *pkt)>;
+
+    av_packet_writer(write_function write, av_packet_writer_config config);
+    ~av_packet_writer();
+
+    av_packet_writer(const av_packet_writer &) = delete;
+    av_packet_writer &operator=(const av_packet_writer &) = delete;
+
+    /*!
+     * Queue a packet for writing. The packet is moved into the queue when it is refcounted, and
+     * copied otherwise. Throws when a previous write failed.
+     */
+    void push(AVPacket *pkt);
+
+    /*!
+     * Write all the queued packets and stop the writer thread.
+     */
+    void stop();
+
+    auto get_stats() const -> av_packet_writer_stats;
+
+    // the error of the first failed write, 0 when all writes succeeded.
+    auto get_error() const -> int;
+
+private:
+    void _run();
+    bool _should_drop(const AVPacket *pkt);
+    bool _is_dropping(const AVPacket *pkt) const;
+
+    write_function write_;
+    av_packet_writer_config config_;
+
+    mutable std::mutex lock_;
+    std::condition_variable packet_queued_;
+    std::condition_variable packet_written_;
+    std::deque<AVPacket *> queue_;
+
+    bool stopping_{false};
+    // per stream index, the stream drops its packets up to its next key packet.
+    std::vector<bool> dropping_;
+    int error_{0};
+    av_packet_writer_stats stats_{};
+
+    std::thread thread_;
+};
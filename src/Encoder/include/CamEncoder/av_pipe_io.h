@@ -0,0 +1,67 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "av_ffmpeg.h"
+
+#include <cstdint>
+
+struct av_pipe_io_stats
+{
+    int64_t bytes_written{0};
+    uint64_t write_count{0};
+};
+
+/*!
+ * An AVIOContext that writes to a file descriptor that can not seek, a.e. stdout or a pipe. The
+ * muxer writing to it has to be able to produce a streamable container.
+ *
+ * A write to a pipe without a reader fails with EPIPE. The SIGPIPE it raises is blocked and
+ * consumed on the writing thread, so the signal disposition of the process is left alone.
+ */
+class av_pipe_io
+{
+public:
+    // the file descriptor is not owned, it stays open after close.
+    explicit av_pipe_io(int fd);
+    ~av_pipe_io();
+
+    av_pipe_io(const av_pipe_io &) = delete;
+    av_pipe_io &operator=(const av_pipe_io &) = delete;
+
+    auto get_context() const noexcept -> AVIOContext *;
+
+    /*!
+     * Flush the AVIOContext, returns the first error that occurred while writing.
+     */
+    int close();
+
+    auto get_stats() const noexcept -> av_pipe_io_stats;
+
+    // the file descriptor of stdout.
+    static constexpr int stdout_fd = 1;
+
+private:
+    static int _write_packet(void *opaque, uint8_t *buf, int buf_size);
+
+    int fd_;
+    AVIOContext *context_{nullptr};
+    bool closed_{false};
+    int error_{0};
+    av_pipe_io_stats stats_{};
+};
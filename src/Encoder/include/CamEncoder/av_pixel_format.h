@@ -0,0 +1,337 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "av_ffmpeg.h"
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+/*!
+ * Compile time knowledge about the pixel formats we capture and encode, and the frame kernels
+ * (convert, pack and delta) that are build on top of it. The kernels are instantiated per
+ * (source, destination) pair, so the format dispatch happens once when a recording starts instead
+ * of once per row or pixel.
+ */
+namespace pixel_format
+{
+
+enum class channel_order
+{
+    none,
+    bgr,
+    rgb,
+    gbr,
+    yuv
+};
+
+/*!
+ * \note the default traits mark a format as unknown. The kernels only support packed 8 bit per
+ * channel formats, everything else is left to swscale.
+ */
+template <AVPixelFormat Format>
+struct traits
+{
+    static constexpr bool known = false;
+    static constexpr bool planar = false;
+    static constexpr bool packed_8bit = false;
+    static constexpr int bytes_per_pixel = 0;
+    static constexpr int bits_per_pixel = 0;
+    static constexpr channel_order order = channel_order::none;
+    static constexpr bool has_alpha = false;
+
+    // a format that is stored in a single plane can be flipped for free with a negative stride.
+    static constexpr bool flip_by_stride = false;
+};
+
+template <int BytesPerPixel, channel_order Order, int R, int G, int B, int A>
+struct packed_traits
+{
+    static constexpr bool known = true;
+    static constexpr bool planar = false;
+    static constexpr bool packed_8bit = true;
+    static constexpr int bytes_per_pixel = BytesPerPixel;
+    static constexpr int bits_per_pixel = BytesPerPixel * 8;
+    static constexpr channel_order order = Order;
+    static constexpr bool has_alpha = A >= 0;
+    static constexpr bool flip_by_stride = true;
+
+    // byte offsets of the channels within a pixel, -1 when not available.
+    static constexpr int r = R;
+    static constexpr int g = G;
+    static constexpr int b = B;
+    static constexpr int a = A;
+};
+
+template <channel_order Order, bool Alpha = false>
+struct planar_traits
+{
+    static constexpr bool known = true;
+    static constexpr bool planar = true;
+    static constexpr bool packed_8bit = false;
+    static constexpr int bytes_per_pixel = 0;
+    static constexpr int bits_per_pixel = 0;
+    static constexpr channel_order order = Order;
+    static constexpr bool has_alpha = Alpha;
+    static constexpr bool flip_by_stride = false;
+};
+
+template <> struct traits<AV_PIX_FMT_BGR24> : packed_traits<3, channel_order::bgr, 2, 1, 0, -1> {};
+template <> struct traits<AV_PIX_FMT_RGB24> : packed_traits<3, channel_order::rgb, 0, 1, 2, -1> {};
+template <> struct traits<AV_PIX_FMT_BGRA> : packed_traits<4, channel_order::bgr, 2, 1, 0, 3> {};
+template <> struct traits<AV_PIX_FMT_RGBA> : packed_traits<4, channel_order::rgb, 0, 1, 2, 3> {};
+template <> struct traits<AV_PIX_FMT_BGR0> : packed_traits<4, channel_order::bgr, 2, 1, 0, -1> {};
+template <> struct traits<AV_PIX_FMT_RGB0> : packed_traits<4, channel_order::rgb, 0, 1, 2, -1> {};
+
+template <>
+struct traits<AV_PIX_FMT_RGB555LE>
+{
+    static constexpr bool known = true;
+    static constexpr bool planar = false;
+    static constexpr bool packed_8bit = false;
+    static constexpr int bytes_per_pixel = 2;
+    static constexpr int bits_per_pixel = 16;
+    static constexpr channel_order order = channel_order::rgb;
+    static constexpr bool has_alpha = false;
+    static constexpr bool flip_by_stride = true;
+};
+
+template <> struct traits<AV_PIX_FMT_YUV420P> : planar_traits<channel_order::yuv> {};
+template <> struct traits<AV_PIX_FMT_YUV422P> : planar_traits<channel_order::yuv> {};
+template <> struct traits<AV_PIX_FMT_YUV444P> : planar_traits<channel_order::yuv> {};
+template <> struct traits<AV_PIX_FMT_GBRP> : planar_traits<channel_order::gbr> {};
+template <> struct traits<AV_PIX_FMT_GBRAP> : planar_traits<channel_order::gbr, true> {};
+
+template <AVPixelFormat... Formats>
+struct format_list
+{
+};
+
+// all the formats we have traits for, only the packed ones get kernels.
+using known_formats = format_list<
+    AV_PIX_FMT_BGR24, AV_PIX_FMT_RGB24, AV_PIX_FMT_BGRA, AV_PIX_FMT_RGBA, AV_PIX_FMT_BGR0,
+    AV_PIX_FMT_RGB0, AV_PIX_FMT_RGB555LE, AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P,
+    AV_PIX_FMT_YUV444P, AV_PIX_FMT_GBRP, AV_PIX_FMT_GBRAP>;
+
+using kernel_formats = format_list<
+    AV_PIX_FMT_BGR24, AV_PIX_FMT_RGB24, AV_PIX_FMT_BGRA, AV_PIX_FMT_RGBA, AV_PIX_FMT_BGR0,
+    AV_PIX_FMT_RGB0>;
+
+/*!
+ * The runtime view of the traits, for the places that only know the format at runtime.
+ */
+struct info
+{
+    bool known{false};
+    bool planar{false};
+    bool packed_8bit{false};
+    int bytes_per_pixel{0};
+    int bits_per_pixel{0};
+    channel_order order{channel_order::none};
+    bool has_alpha{false};
+    bool flip_by_stride{false};
+};
+
+template <AVPixelFormat Format>
+constexpr auto make_info() noexcept -> info
+{
+    using t = traits<Format>;
+    return {t::known, t::planar, t::packed_8bit, t::bytes_per_pixel, t::bits_per_pixel, t::order,
+            t::has_alpha, t::flip_by_stride};
+}
+
+template <AVPixelFormat... Formats>
+constexpr auto get_info(AVPixelFormat format, format_list<Formats...>) noexcept -> info
+{
+    info result{};
+    // fold over the list, only the matching format assigns.
+    ((format == Formats ? (result = make_info<Formats>(), true) : false) || ...);
+    return result;
+}
+
+constexpr auto get_info(AVPixelFormat format) noexcept -> info
+{
+    return get_info(format, known_formats{});
+}
+
+/* kernels */
+
+using frame_kernel = void (*)(const uint8_t *src, int src_stride, uint8_t *dst, int dst_stride,
+    int width, int height);
+
+template <AVPixelFormat Src, AVPixelFormat Dst>
+constexpr bool is_same_layout() noexcept
+{
+    using s = traits<Src>;
+    using d = traits<Dst>;
+    return s::bytes_per_pixel == d::bytes_per_pixel && s::r == d::r && s::g == d::g && s::b == d::b;
+}
+
+/*!
+ * Convert or pack (when the layouts match) a packed frame into a packed frame. When Flip is set the
+ * source is read bottom up.
+ */
+template <AVPixelFormat Src, AVPixelFormat Dst, bool Flip>
+void convert_frame(const uint8_t *src, int src_stride, uint8_t *dst, int dst_stride, int width,
+    int height)
+{
+    using s = traits<Src>;
+    using d = traits<Dst>;
+    static_assert(s::packed_8bit && d::packed_8bit, "only packed 8 bit formats have kernels");
+
+    if constexpr (Flip)
+    {
+        src += static_cast<ptrdiff_t>(height - 1) * src_stride;
+        src_stride = -src_stride;
+    }
+
+    if constexpr (is_same_layout<Src, Dst>())
+    {
+        const auto row_size = static_cast<size_t>(width) * d::bytes_per_pixel;
+        for (int y = 0; y < height; ++y)
+        {
+            std::memcpy(dst, src, row_size);
+            src += src_stride;
+            dst += dst_stride;
+        }
+    }
+    else
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            const uint8_t *src_pixel = src;
+            uint8_t *dst_pixel = dst;
+            for (int x = 0; x < width; ++x)
+            {
+                dst_pixel[d::r] = src_pixel[s::r];
+                dst_pixel[d::g] = src_pixel[s::g];
+                dst_pixel[d::b] = src_pixel[s::b];
+
+                if constexpr (d::has_alpha && s::has_alpha)
+                    dst_pixel[d::a] = src_pixel[s::a];
+                else if constexpr (d::has_alpha)
+                    dst_pixel[d::a] = 0xff;
+                else if constexpr (d::bytes_per_pixel == 4)
+                    dst_pixel[3] = 0; // a constant padding byte compresses to nothing.
+
+                src_pixel += s::bytes_per_pixel;
+                dst_pixel += d::bytes_per_pixel;
+            }
+            src += src_stride;
+            dst += dst_stride;
+        }
+    }
+}
+
+namespace detail
+{
+template <AVPixelFormat Src, bool Flip, AVPixelFormat... Formats>
+constexpr auto select_dst(AVPixelFormat dst, format_list<Formats...>) noexcept -> frame_kernel
+{
+    frame_kernel result = nullptr;
+    ((dst == Formats ? (result = &convert_frame<Src, Formats, Flip>, true) : false) || ...);
+    return result;
+}
+
+template <bool Flip, AVPixelFormat... Formats>
+constexpr auto select_src(AVPixelFormat src, AVPixelFormat dst, format_list<Formats...>) noexcept
+    -> frame_kernel
+{
+    frame_kernel result = nullptr;
+    ((src == Formats ? (result = select_dst<Formats, Flip>(dst, kernel_formats{}), true) : false)
+        || ...);
+    return result;
+}
+} // namespace detail
+
+/*!
+ * Select the kernel for a (source, destination) pair. Returns nullptr when there is no kernel for
+ * the pair, the caller should fall back to swscale.
+ */
+inline auto select_convert_kernel(AVPixelFormat src, AVPixelFormat dst, bool flip) noexcept
+    -> frame_kernel
+{
+    if (flip)
+        return detail::select_src<true>(src, dst, kernel_formats{});
+    return detail::select_src<false>(src, dst, kernel_formats{});
+}
+
+/*!
+ * The cscd delta: dst = current - previous per byte, and previous becomes current. The bulk is
+ * done 8 bytes at a time with a carry-less (SWAR) byte subtraction.
+ */
+inline void delta_bytes(const uint8_t *current, uint8_t *previous, uint8_t *delta, size_t size) noexcept
+{
+    constexpr uint64_t high_bits = 0x8080808080808080ull;
+
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t a;
+        uint64_t b;
+        std::memcpy(&a, current + i, sizeof(a));
+        std::memcpy(&b, previous + i, sizeof(b));
+
+        const uint64_t diff = ((a | high_bits) - (b & ~high_bits)) ^ ((a ^ ~b) & high_bits);
+
+        std::memcpy(delta + i, &diff, sizeof(diff));
+        std::memcpy(previous + i, &a, sizeof(a));
+    }
+
+    for (; i < size; ++i)
+    {
+        delta[i] = static_cast<uint8_t>(current[i] - previous[i]);
+        previous[i] = current[i];
+    }
+}
+
+using delta_kernel = void (*)(const uint8_t *current, uint8_t *previous, uint8_t *delta,
+    int line_size, int height);
+
+/*!
+ * Delta a frame against the previous frame, line_size is the size of a row in bytes including
+ * the row padding.
+ */
+template <AVPixelFormat Format>
+void delta_frame(const uint8_t *current, uint8_t *previous, uint8_t *delta, int line_size,
+    int height)
+{
+    static_assert(traits<Format>::known && !traits<Format>::planar,
+        "delta frames are only supported for packed formats");
+
+    delta_bytes(current, previous, delta, static_cast<size_t>(line_size) * height);
+}
+
+namespace detail
+{
+template <AVPixelFormat... Formats>
+constexpr auto select_delta(AVPixelFormat format, format_list<Formats...>) noexcept -> delta_kernel
+{
+    delta_kernel result = nullptr;
+    ((format == Formats ? (result = &delta_frame<Formats>, true) : false) || ...);
+    return result;
+}
+} // namespace detail
+
+inline auto select_delta_kernel(AVPixelFormat format) noexcept -> delta_kernel
+{
+    return detail::select_delta(format,
+        format_list<AV_PIX_FMT_RGB555LE, AV_PIX_FMT_BGR24, AV_PIX_FMT_BGR0>{});
+}
+
+} // namespace pixel_format
@@ -0,0 +1,118 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "av_dict.h"
+#include "av_ffmpeg.h"
+#include "av_file_io.h"
+
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct av_replay_config
+{
+    // the amount of seconds that is retained, rounded up to the next keyframe.
+    double duration{120.0};
+
+    // the memory the retained packets may use, the oldest gop is dropped when it is exceeded.
+    size_t memory_limit{512 * 1024 * 1024};
+};
+
+struct av_replay_stats
+{
+    // the retained window, it always starts at a keyframe.
+    double duration{0.0};
+    size_t memory{0};
+    size_t packet_count{0};
+    size_t keyframe_count{0};
+
+    // packets dropped from the front of the window.
+    uint64_t packets_pruned{0};
+    uint64_t saves{0};
+};
+
+/*!
+ * Keeps the last part of a recording as encoded packets in memory, so it can be saved after the
+ * fact. Nothing is written to disk until save is called, and saving does not re-encode.
+ */
+class av_replay_buffer
+{
+public:
+    /*!
+     * The packets pushed have the time base of these streams, stream_index selects the stream. The
+     * window is pruned on the keyframes of key_stream_index (the video stream).
+     */
+    av_replay_buffer(const char *format_name, av_replay_config config,
+        std::vector<const AVStream *> streams, int key_stream_index, av_dict format_options,
+        av_dict metadata, bool use_file_io, av_file_io_config file_io_config);
+    ~av_replay_buffer();
+
+    av_replay_buffer(const av_replay_buffer &) = delete;
+    av_replay_buffer &operator=(const av_replay_buffer &) = delete;
+
+    /*!
+     * Retain a packet. Takes ownership of the packet data, like av_interleaved_write_frame.
+     */
+    int push(AVPacket *pkt);
+
+    /*!
+     * Write the retained window to a file. The window is copied by reference, and written on a
+     * separate thread, so the packets keep coming in while saving.
+     */
+    auto save(std::string filename) -> std::future<void>;
+
+    auto get_stats() const -> av_replay_stats;
+
+private:
+    struct keyframe
+    {
+        uint64_t sequence;
+        double time;
+    };
+
+    void _prune();
+    void _drop_front(uint64_t sequence);
+    void _write(const std::string &filename, std::vector<AVPacket *> packets) const;
+
+    const char *format_name_;
+    av_replay_config config_;
+    std::vector<const AVStream *> streams_;
+    int key_stream_index_;
+    av_dict format_options_;
+    av_dict metadata_;
+    bool use_file_io_;
+    av_file_io_config file_io_config_;
+
+    mutable std::mutex lock_;
+    std::deque<AVPacket *> packets_;
+    // the sequence number of the first packet in packets_.
+    uint64_t first_sequence_{0};
+    std::deque<keyframe> keyframes_;
+    double last_time_{0.0};
+    size_t memory_{0};
+    uint64_t packets_pruned_{0};
+    uint64_t saves_{0};
+
+    std::mutex save_lock_;
+    std::vector<std::thread> save_threads_;
+};
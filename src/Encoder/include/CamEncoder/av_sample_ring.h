@@ -0,0 +1,123 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+/*!
+ * A lock free single producer, single consumer ring of audio sample frames. The producer is the
+ * audio capture callback, which must never block, the consumer is the encoder. All sizes are in
+ * sample frames (one sample for every channel).
+ */
+class av_sample_ring
+{
+public:
+    av_sample_ring(size_t capacity, size_t frame_size)
+        : capacity_(round_up_pow2(capacity))
+        , frame_size_(frame_size)
+        , data_(std::make_unique<uint8_t[]>(capacity_ * frame_size))
+    {
+    }
+
+    av_sample_ring(const av_sample_ring &) = delete;
+    av_sample_ring &operator=(const av_sample_ring &) = delete;
+
+    /*!
+     * Producer: copy up to count frames into the ring, returns the amount of frames that fit.
+     */
+    auto write(const uint8_t *data, size_t count) noexcept -> size_t
+    {
+        const auto head = head_.load(std::memory_order_relaxed);
+        const auto tail = tail_.load(std::memory_order_acquire);
+
+        count = std::min(count, capacity_ - (head - tail));
+        _copy_in(head, data, count);
+
+        head_.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    /*!
+     * Consumer: copy up to count frames out of the ring, returns the amount of frames read.
+     */
+    auto read(uint8_t *data, size_t count) noexcept -> size_t
+    {
+        const auto tail = tail_.load(std::memory_order_relaxed);
+        const auto head = head_.load(std::memory_order_acquire);
+
+        count = std::min(count, head - tail);
+        _copy_out(tail, data, count);
+
+        tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // the amount of frames the consumer is able to read, only exact on the consumer thread.
+    auto size() const noexcept -> size_t
+    {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    auto capacity() const noexcept -> size_t
+    {
+        return capacity_;
+    }
+
+    auto frame_size() const noexcept -> size_t
+    {
+        return frame_size_;
+    }
+
+private:
+    static constexpr auto round_up_pow2(size_t value) noexcept -> size_t
+    {
+        size_t result = 1;
+        while (result < value)
+            result <<= 1;
+        return result;
+    }
+
+    void _copy_in(size_t position, const uint8_t *data, size_t count) noexcept
+    {
+        const auto index = position & (capacity_ - 1);
+        const auto first = std::min(count, capacity_ - index);
+        std::memcpy(data_.get() + index * frame_size_, data, first * frame_size_);
+        std::memcpy(data_.get(), data + first * frame_size_, (count - first) * frame_size_);
+    }
+
+    void _copy_out(size_t position, uint8_t *data, size_t count) const noexcept
+    {
+        const auto index = position & (capacity_ - 1);
+        const auto first = std::min(count, capacity_ - index);
+        std::memcpy(data, data_.get() + index * frame_size_, first * frame_size_);
+        std::memcpy(data + first * frame_size_, data_.get(), (count - first) * frame_size_);
+    }
+
+    const size_t capacity_;
+    const size_t frame_size_;
+    std::unique_ptr<uint8_t[]> data_;
+
+    // the positions only ever grow, the index in the ring is the position modulo the capacity.
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
@@ -0,0 +1,133 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "av_dict.h"
+#include "av_ffmpeg.h"
+#include "av_file_io.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class av_playlist_type
+{
+    none,
+    hls,
+    dash
+};
+
+struct av_segment_config
+{
+    // start a new segment at the first keyframe after this many seconds, 0 disables the limit.
+    double duration{0.0};
+
+    // start a new segment at the first keyframe after this many bytes, 0 disables the limit.
+    int64_t size{0};
+
+    // maintain a playlist next to the segments, only available for (fragmented) mp4. With a
+    // playlist the segments are the fragments of one continuous mp4, see av_segmenter.
+    av_playlist_type playlist{av_playlist_type::none};
+};
+
+struct av_segment_info
+{
+    std::string filename;
+    int64_t size{0};
+    // the size of the ftyp and moov boxes at the start of the segment, with a playlist only the
+    // first segment has them.
+    int64_t init_size{0};
+    double start_time{0.0};
+    double duration{0.0};
+};
+
+/*!
+ * Writes packets into a sequence of files, a new file is started at a keyframe once the current
+ * one reaches the configured duration or size. The packets are not re-encoded and keep their
+ * timestamps, so the segments can be played back to back.
+ *
+ * Without a playlist every segment is a file that plays on its own. With a playlist one fragmented
+ * mp4 muxer writes all segments, at every rotation the fragment is finished and the muxer
+ * continues in the next file. The segments then share the initialization section at the start of
+ * the first segment, and the fragment sequence numbers and decode times continue across them.
+ *
+ * Segments are opened and closed from the thread that calls write, which for av_muxer is the
+ * packet writer thread.
+ */
+class av_segmenter
+{
+public:
+    av_segmenter(std::string filename, const char *format_name, av_segment_config config,
+        const AVStream *stream, av_dict format_options, av_dict metadata, bool use_file_io,
+        av_file_io_config file_io_config);
+    ~av_segmenter();
+
+    av_segmenter(const av_segmenter &) = delete;
+    av_segmenter &operator=(const av_segmenter &) = delete;
+
+    /*!
+     * Write a packet with timestamps in the time base of the stream passed to the constructor.
+     * Takes ownership of the packet data, like av_interleaved_write_frame.
+     */
+    int write(AVPacket *pkt);
+
+    /*!
+     * Finish the current segment and the playlist.
+     */
+    void close();
+
+    auto get_segments() const -> std::vector<av_segment_info>;
+    auto get_playlist_filename() const -> std::string;
+
+    // the filename of segment index, a.e. recording.mp4 -> recording_00003.mp4.
+    static auto make_segment_filename(const std::string &filename, int index) -> std::string;
+
+private:
+    struct segment_file;
+
+    void _open_segment(int64_t start_pts);
+    int _close_segment(int64_t end_pts);
+    void _open_context();
+    void _init_context();
+    int _close_context();
+    bool _should_rotate(const AVPacket *pkt) const;
+    void _write_playlist(bool finished) const;
+    void _write_hls_playlist(std::string &playlist, bool finished) const;
+    void _write_dash_playlist(std::string &playlist, bool finished) const;
+
+    std::string filename_;
+    const char *format_name_;
+    av_segment_config config_;
+    const AVStream *stream_;
+    av_dict format_options_;
+    av_dict metadata_;
+    bool use_file_io_;
+    av_file_io_config file_io_config_;
+
+    // all segments are written by a single muxer, only the output file changes.
+    bool continuous_{false};
+    AVFormatContext *context_{nullptr};
+    std::unique_ptr<segment_file> file_;
+    int64_t last_pts_{AV_NOPTS_VALUE};
+    int64_t last_duration_{0};
+    bool closed_{false};
+
+    mutable std::mutex lock_;
+    std::vector<av_segment_info> segments_;
+};
@@ -0,0 +1,140 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+/*!
+ * A lock free single producer, single consumer queue, to hand items (a.e. frame buffers) from one
+ * pipeline stage to the next. Pushing and popping never take a lock, only a consumer that found the
+ * queue empty parks on a condition variable until the producer pushes or closes the queue.
+ */
+template <typename T>
+class av_spsc_queue
+{
+public:
+    explicit av_spsc_queue(size_t capacity)
+        : capacity_(round_up_pow2(capacity))
+        , items_(std::make_unique<T[]>(capacity_))
+    {
+    }
+
+    av_spsc_queue(const av_spsc_queue &) = delete;
+    av_spsc_queue &operator=(const av_spsc_queue &) = delete;
+
+    /*!
+     * Producer: returns false when the queue is full.
+     */
+    bool try_push(T item)
+    {
+        const auto head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) == capacity_)
+            return false;
+
+        items_[head & (capacity_ - 1)] = std::move(item);
+        head_.store(head + 1, std::memory_order_seq_cst);
+
+        if (consumer_waiting_.load(std::memory_order_seq_cst))
+        {
+            std::lock_guard<std::mutex> lock(wait_lock_);
+            wakeup_.notify_one();
+        }
+        return true;
+    }
+
+    /*!
+     * Consumer: returns false when the queue is empty.
+     */
+    bool try_pop(T &item)
+    {
+        const auto tail = tail_.load(std::memory_order_relaxed);
+        if (head_.load(std::memory_order_acquire) == tail)
+            return false;
+
+        item = std::move(items_[tail & (capacity_ - 1)]);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*!
+     * Consumer: wait for an item, returns false when the queue is closed and empty.
+     */
+    bool pop(T &item)
+    {
+        if (try_pop(item))
+            return true;
+
+        std::unique_lock<std::mutex> lock(wait_lock_);
+        consumer_waiting_.store(true, std::memory_order_seq_cst);
+        wakeup_.wait(lock, [this]() {
+            return head_.load(std::memory_order_seq_cst) != tail_.load(std::memory_order_relaxed)
+                || closed_.load(std::memory_order_seq_cst);
+        });
+        consumer_waiting_.store(false, std::memory_order_relaxed);
+        lock.unlock();
+
+        return try_pop(item);
+    }
+
+    /*!
+     * Producer: no more items will be pushed, pop returns false once the queue is drained.
+     */
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(wait_lock_);
+        closed_.store(true, std::memory_order_seq_cst);
+        wakeup_.notify_one();
+    }
+
+    // the amount of queued items, only exact on the consumer thread.
+    auto size() const noexcept -> size_t
+    {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    auto capacity() const noexcept -> size_t
+    {
+        return capacity_;
+    }
+
+private:
+    static constexpr auto round_up_pow2(size_t value) noexcept -> size_t
+    {
+        size_t result = 1;
+        while (result < value)
+            result <<= 1;
+        return result;
+    }
+
+    const size_t capacity_;
+    std::unique_ptr<T[]> items_;
+
+    // the positions only ever grow, the index in the queue is the position modulo the capacity.
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+
+    std::atomic<bool> consumer_waiting_{false};
+    std::atomic<bool> closed_{false};
+    std::mutex wait_lock_;
+    std::condition_variable wakeup_;
+};
@@ -0,0 +1,112 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "av_dict.h"
+#include "av_ffmpeg.h"
+#include "av_packet_writer.h"
+#include "av_pipe_io.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct av_tee_sink_config
+{
+    // a filename or an ffmpeg url, a.e. a named pipe or "pipe:1".
+    std::string filename;
+
+    // the ffmpeg name of the container, a.e. "matroska", "mpegts" or "nut".
+    std::string format{"matroska"};
+
+    // a sink never stalls the recording on non-key packets, it drops them instead.
+    av_packet_writer_config writer{av_packet_queue_policy::drop_non_key, 120};
+};
+
+struct av_tee_sink_stats
+{
+    std::string filename;
+
+    // the sink stopped after an error, the other outputs keep going.
+    bool failed{false};
+    int error{0};
+    // packets that were not queued for writing, because the sink failed.
+    uint64_t packets_lost{0};
+
+    av_packet_writer_stats writer{};
+};
+
+/*!
+ * An extra output of av_muxer, it receives the same encoded packets as the main output. Every
+ * sink has its own output context and writer thread, so a slow or failing sink does not affect the
+ * main output or the other sinks.
+ *
+ * The output is opened by the writer thread before it writes the first packet, so a slow url does
+ * not stall the recording. A fifo without a reader fails the sink, instead of waiting for one, and
+ * so does a reader that goes away. A url that is written by ffmpeg itself, a.e. "pipe:1", can
+ * still raise SIGPIPE, the application decides whether to ignore that.
+ */
+class av_tee_sink
+{
+public:
+    /*!
+     * Create the sink with a copy of the given streams, which have to be opened already. A failure
+     * to open the sink is not fatal, the sink is marked as failed instead.
+     */
+    av_tee_sink(av_tee_sink_config config, const std::vector<const AVStream *> &streams,
+        av_dict metadata);
+    ~av_tee_sink();
+
+    av_tee_sink(const av_tee_sink &) = delete;
+    av_tee_sink &operator=(const av_tee_sink &) = delete;
+
+    /*!
+     * Queue a reference to the packet, pkt is not modified. time_base is the time base of the
+     * packet timestamps, pkt->stream_index the index in the streams passed to the constructor.
+     */
+    void push(const AVPacket *pkt, AVRational time_base);
+
+    /*!
+     * Write the queued packets and the trailer, and close the output.
+     */
+    void close();
+
+    auto get_stats() const -> av_tee_sink_stats;
+
+private:
+    void _create(const std::vector<const AVStream *> &streams, av_dict metadata);
+    int _open();
+    int _open_fifo();
+    void _fail(int error, const char *what);
+
+    av_tee_sink_config config_;
+    AVFormatContext *context_{nullptr};
+    std::unique_ptr<av_packet_writer> writer_{};
+    // the time base of the queued packets per stream, writing the header can change the output one.
+    std::vector<AVRational> queue_time_bases_;
+    // only used by the writer thread, until it is stopped.
+    bool header_written_{false};
+    int fifo_fd_{-1};
+    // writes to the fifo, instead of the avio pipe protocol.
+    std::unique_ptr<av_pipe_io> pipe_io_{};
+    std::atomic<bool> failed_{false};
+    std::atomic<int> error_{0};
+    std::atomic<uint64_t> packets_lost_{0};
+};
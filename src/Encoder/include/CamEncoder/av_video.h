@@ -18,21 +18,14 @@
 #pragma once
 
 #include "av_config.h"
+#include "av_codec_registry.h"
 #include "av_icodec.h"
+#include "av_pixel_format.h"
 #include "av_dict.h"
 #include "av_ffmpeg.h"
 #include <stdexcept>
 #include <cstdint>
 
-using timestamp_t = uint64_t;
-
-enum class av_video_codec_type
-{
-    none,
-    h264,
-    cscd, // cam codec encoder
-};
-
 enum class av_video_colorspace
 {
     BT709,  /* limited */
@@ -49,27 +42,63 @@ public:
 
     void push_encode_frame(timestamp_t timestamp, unsigned char *data, int width, int height, int stride);
 
+    // allocate a frame in the pixel format and size of the encoder, to convert frames into.
+    auto alloc_frame() const -> AVFrame *;
+
+    // convert a captured frame into frame, this can run on another thread than push_frame.
+    void convert_frame(timestamp_t timestamp, unsigned char *data, int width, int height, int stride,
+        AVFrame *frame) const;
+
+    // send a converted frame to the encoder, nullptr flushes the encoder.
+    void push_frame(AVFrame *frame);
+
+    /*!
+     * Replace the encoder with one for meta (a.e. a faster preset or a smaller size) without
+     * restarting the stream. The encoder has to be flushed and drained first. The frames keep the
+     * size the video was created with, and are resized for the encoder. Only h264 supports this.
+     */
+    void reconfigure(const av_video_meta &meta);
+
     // this function will return false, if it was unable to read a encoded packet.
     bool pull_encoded_packet(AVPacket *pkt, bool *valid_packet) override;
 
     av_video_codec_type get_codec_type() const noexcept;
+    auto get_codec_descriptor() const noexcept -> const av_codec_descriptor &;
+    auto get_pixel_format_negotiation() const noexcept -> const av_pixel_format_negotiation &;
     AVCodecContext *get_codec_context() const noexcept override;
     AVRational get_time_base() const noexcept override;
 
 private:
     // create a video frame scaler/converter so we can convert our rgb24 to a.e. yuv420.
     SwsContext *create_software_scaler(AVPixelFormat src_pixel_format, int src_width, int src_height,
-                                       AVPixelFormat dst_pixel_format, int dst_width, int dst_height);
+                                       AVPixelFormat dst_pixel_format, int dst_width, int dst_height,
+                                       int flags = SWS_BICUBIC);
+
+    void _create_context(const av_video_meta &meta);
+    void _open_context();
+    auto _resize_frame(AVFrame *frame) -> AVFrame *;
 
 private:
+    av_codec_descriptor descriptor_;
+    av_pixel_format_negotiation pixel_format_negotiation_{};
+
     AVCodec *codec_{ nullptr };
     AVCodecContext *context_{ nullptr };
     AVFrame *frame_{ nullptr };
 
+    // the size of the frames pushed into the encoder, the encoder size differs after reconfigure.
+    int frame_width_{ 0 };
+    int frame_height_{ 0 };
+    SwsContext *resize_context_{ nullptr };
+    AVFrame *resized_frame_{ nullptr };
+
     AVPixelFormat input_pixel_format_{ AV_PIX_FMT_NONE };
     AVPixelFormat output_pixel_format_{ AV_PIX_FMT_NONE };
     SwsContext *sws_context_{ nullptr };
 
+    // converts packed input into packed encoder input, without going through swscale.
+    pixel_format::frame_kernel convert_kernel_{ nullptr };
+
     av_video_codec_type codec_type_{ av_video_codec_type::none };
     av_dict av_opts_{};
 };
@@ -14,4 +14,336 @@
  * You should have received a copy of the GNU General Public License
  * along with this program. If not, see <https://www.gnu.org/licenses/>.
  */
+
 #include "CamEncoder/av_audio.h"
+#include "CamEncoder/av_error.h"
+#include "av_log.h"
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+
+// the ring holds 2 seconds of input, the encoder drains it at least once every video frame.
+constexpr int ring_seconds = 2;
+// the amount of samples that are resampled at once.
+constexpr int resample_block_size = 4096;
+
+static AVCodec *find_audio_encoder(audio::codec codec)
+{
+    switch (codec)
+    {
+    case audio::codec::aac:
+        return avcodec_find_encoder(AV_CODEC_ID_AAC);
+    case audio::codec::opus:
+        // prefer libopus, the native opus encoder is experimental.
+        if (auto encoder = avcodec_find_encoder_by_name("libopus"); encoder != nullptr)
+            return encoder;
+        return avcodec_find_encoder(AV_CODEC_ID_OPUS);
+    }
+    return nullptr;
+}
+
+static int select_sample_rate(const AVCodec *codec, int sample_rate)
+{
+    if (codec->supported_samplerates == nullptr)
+        return sample_rate;
+
+    int best = 0;
+    for (auto rate = codec->supported_samplerates; *rate != 0; ++rate)
+    {
+        if (*rate == sample_rate)
+            return sample_rate;
+        // otherwise the closest rate.
+        if (best == 0 || std::abs(*rate - sample_rate) < std::abs(best - sample_rate))
+            best = *rate;
+    }
+    return best;
+}
+
+av_audio::av_audio(const av_audio_codec &config, const av_audio_meta &meta)
+    : codec_type_(meta.codec)
+    , input_(config)
+    , ring_(static_cast<size_t>(config.sample_rate) * ring_seconds,
+        static_cast<size_t>(av_get_bytes_per_sample(config.sample_format)) * config.channels)
+    , input_buffer_(static_cast<size_t>(resample_block_size) * ring_.frame_size())
+{
+    if (av_sample_fmt_is_planar(config.sample_format))
+        throw std::runtime_error("av_audio: the input samples must be interleaved");
+
+    codec_ = find_audio_encoder(meta.codec);
+    if (codec_ == nullptr)
+        throw std::runtime_error("av_audio: unable to find audio encoder");
+
+    context_ = avcodec_alloc_context3(codec_);
+    if (context_ == nullptr)
+        throw std::runtime_error("av_audio: unable to allocate audio encoder context");
+
+    context_->sample_fmt = codec_->sample_fmts ? codec_->sample_fmts[0] : AV_SAMPLE_FMT_FLTP;
+    context_->sample_rate = select_sample_rate(codec_, meta.sample_rate);
+    context_->channels = meta.channels;
+    context_->channel_layout = av_get_default_channel_layout(meta.channels);
+    context_->time_base = {1, context_->sample_rate};
+    const auto default_bitrate = meta.codec == audio::codec::opus ? 96.0 : 128.0;
+    context_->bit_rate = static_cast<int64_t>(1000.0 * meta.bitrate.value_or(default_bitrate));
+    context_->strict_std_compliance = FF_COMPLIANCE_EXPERIMENTAL;
+    context_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    swr_context_ = swr_alloc_set_opts(nullptr,
+        context_->channel_layout, context_->sample_fmt, context_->sample_rate,
+        av_get_default_channel_layout(config.channels), config.sample_format, config.sample_rate,
+        0, nullptr);
+    if (swr_context_ == nullptr)
+        throw std::runtime_error("av_audio: unable to allocate resampler");
+
+    if (int ret = swr_init(swr_context_); ret < 0)
+        throw std::runtime_error(fmt::format("av_audio: unable to initialize resampler: {}",
+            av_error_to_string(ret)));
+
+    _log("av_audio: {} {}Hz {} -> {}Hz {}\n", codec_->name, config.sample_rate,
+        av_get_sample_fmt_name(config.sample_format), context_->sample_rate,
+        av_get_sample_fmt_name(context_->sample_fmt));
+}
+
+av_audio::~av_audio()
+{
+    for (auto pkt : packets_)
+        av_packet_free(&pkt);
+
+    av_frame_free(&frame_);
+    av_frame_free(&resample_frame_);
+    if (fifo_ != nullptr)
+        av_audio_fifo_free(fifo_);
+    swr_free(&swr_context_);
+    avcodec_free_context(&context_);
+}
+
+void av_audio::open(AVStream *stream, av_dict &dict)
+{
+    dict = av_opts_;
+    auto av_opts = av_opts_;
+
+    if (int ret = avcodec_open2(context_, codec_, av_opts); ret < 0)
+        throw std::runtime_error(fmt::format("av_audio: unable to open audio encoder: {}",
+            av_error_to_string(ret)));
+
+    // encoders with a variable frame size take any amount of samples.
+    frame_size_ = context_->frame_size;
+    if (frame_size_ == 0 || (codec_->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE))
+        frame_size_ = 1024;
+
+    frame_ = av_frame_alloc();
+    if (frame_ == nullptr)
+        throw std::runtime_error("av_audio: unable to allocate audio frame");
+
+    frame_->format = context_->sample_fmt;
+    frame_->channel_layout = context_->channel_layout;
+    frame_->sample_rate = context_->sample_rate;
+    frame_->nb_samples = frame_size_;
+    if (int ret = av_frame_get_buffer(frame_, 0); ret < 0)
+        throw std::runtime_error("av_audio: unable to allocate audio frame data");
+
+    fifo_ = av_audio_fifo_alloc(context_->sample_fmt, context_->channels, frame_size_ * 4);
+    if (fifo_ == nullptr)
+        throw std::runtime_error("av_audio: unable to allocate audio fifo");
+
+    if (stream != nullptr)
+    {
+        if (int ret = avcodec_parameters_from_context(stream->codecpar, context_); ret < 0)
+            throw std::runtime_error(fmt::format("av_audio: failed to copy avcodec parameters: {}",
+                av_error_to_string(ret)));
+    }
+}
+
+auto av_audio::push_samples(timestamp_t timestamp, const uint8_t *data, int sample_count) noexcept
+    -> int
+{
+    const auto pushed = samples_pushed_.load(std::memory_order_relaxed);
+
+    auto first_timestamp = first_timestamp_.load(std::memory_order_relaxed);
+    if (first_timestamp < 0)
+    {
+        first_timestamp = static_cast<int64_t>(timestamp);
+        first_timestamp_.store(first_timestamp, std::memory_order_relaxed);
+    }
+
+    // the timestamp the encoder will give these samples, based on the samples before them.
+    const auto expected = first_timestamp + av_rescale(pushed, 1000000, input_.sample_rate);
+    const auto sync_error = std::abs(static_cast<int64_t>(timestamp) - expected);
+    if (sync_error > max_sync_error_.load(std::memory_order_relaxed))
+        max_sync_error_.store(sync_error, std::memory_order_relaxed);
+
+    // publishing the samples also publishes the first timestamp.
+    const auto written = static_cast<int>(ring_.write(data, static_cast<size_t>(sample_count)));
+
+    samples_pushed_.store(pushed + sample_count, std::memory_order_relaxed);
+    if (written < sample_count)
+        samples_dropped_.fetch_add(sample_count - written, std::memory_order_relaxed);
+
+    return written;
+}
+
+void av_audio::encode_pending(bool flush)
+{
+    if (flushed_)
+        return;
+
+    for (;;)
+    {
+        const auto count = ring_.read(input_buffer_.data(), resample_block_size);
+        if (count == 0)
+            break;
+        _resample(input_buffer_.data(), static_cast<int>(count));
+    }
+
+    // keep the samples after a ring overflow at their original time.
+    if (const auto dropped = samples_dropped_.load(std::memory_order_relaxed); dropped > silence_inserted_)
+    {
+        _log("av_audio: {} samples dropped, inserting silence\n", dropped - silence_inserted_);
+        _insert_silence(static_cast<int>(av_rescale(dropped - silence_inserted_, context_->sample_rate,
+            input_.sample_rate)));
+        silence_inserted_ = dropped;
+    }
+
+    if (flush)
+        _resample(nullptr, 0);
+
+    while (av_audio_fifo_size(fifo_) >= frame_size_ || (flush && av_audio_fifo_size(fifo_) > 0))
+    {
+        if (av_frame_make_writable(frame_) < 0)
+            throw std::runtime_error("av_audio: unable to make audio frame writable");
+
+        const auto sample_count = std::min(av_audio_fifo_size(fifo_), frame_size_);
+        av_audio_fifo_read(fifo_, reinterpret_cast<void **>(frame_->data), sample_count);
+        frame_->nb_samples = sample_count;
+        _encode_frame(frame_);
+    }
+
+    if (flush)
+    {
+        _encode_frame(nullptr);
+        flushed_ = true;
+    }
+}
+
+bool av_audio::pull_encoded_packet(AVPacket *pkt, bool *valid_packet)
+{
+    *valid_packet = !packets_.empty();
+    if (!*valid_packet)
+        return true;
+
+    auto queued = packets_.front();
+    packets_.pop_front();
+
+    av_packet_move_ref(pkt, queued);
+    av_packet_free(&queued);
+    return true;
+}
+
+auto av_audio::get_codec() const noexcept -> audio::codec
+{
+    return codec_type_;
+}
+
+AVCodecContext *av_audio::get_codec_context() const noexcept
+{
+    return context_;
+}
+
+AVRational av_audio::get_time_base() const noexcept
+{
+    return context_->time_base;
+}
+
+auto av_audio::get_stats() const noexcept -> av_audio_stats
+{
+    av_audio_stats stats;
+    stats.samples_pushed = samples_pushed_.load(std::memory_order_relaxed);
+    stats.samples_dropped = samples_dropped_.load(std::memory_order_relaxed);
+    stats.samples_encoded = samples_encoded_;
+    stats.max_sync_error = max_sync_error_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void av_audio::_resample(const uint8_t *data, int sample_count)
+{
+    _ensure_resample_capacity(swr_get_out_samples(swr_context_, sample_count));
+
+    const uint8_t *input[1] = {data};
+    const auto converted = swr_convert(swr_context_, resample_frame_->data,
+        resample_frame_->nb_samples, data ? input : nullptr, sample_count);
+    if (converted < 0)
+        throw std::runtime_error(fmt::format("av_audio: resampling failed: {}",
+            av_error_to_string(converted)));
+
+    if (converted > 0)
+        av_audio_fifo_write(fifo_, reinterpret_cast<void **>(resample_frame_->data), converted);
+}
+
+void av_audio::_insert_silence(int sample_count)
+{
+    while (sample_count > 0)
+    {
+        const auto count = std::min(sample_count, resample_block_size);
+        _ensure_resample_capacity(count);
+        av_samples_set_silence(resample_frame_->data, 0, count, context_->channels,
+            context_->sample_fmt);
+        av_audio_fifo_write(fifo_, reinterpret_cast<void **>(resample_frame_->data), count);
+        sample_count -= count;
+    }
+}
+
+void av_audio::_ensure_resample_capacity(int sample_count)
+{
+    if (resample_frame_ != nullptr && resample_frame_->nb_samples >= sample_count)
+        return;
+
+    av_frame_free(&resample_frame_);
+    resample_frame_ = av_frame_alloc();
+    if (resample_frame_ == nullptr)
+        throw std::runtime_error("av_audio: unable to allocate resample frame");
+
+    resample_frame_->format = context_->sample_fmt;
+    resample_frame_->channel_layout = context_->channel_layout;
+    resample_frame_->sample_rate = context_->sample_rate;
+    resample_frame_->nb_samples = std::max(sample_count, resample_block_size);
+    if (av_frame_get_buffer(resample_frame_, 0) < 0)
+        throw std::runtime_error("av_audio: unable to allocate resample frame data");
+}
+
+void av_audio::_encode_frame(AVFrame *frame)
+{
+    if (frame != nullptr)
+    {
+        // the first sample is at the capture time of the first pushed samples.
+        if (start_pts_ == AV_NOPTS_VALUE)
+            start_pts_ = av_rescale_q(first_timestamp_.load(std::memory_order_relaxed),
+                timestamp_time_base, context_->time_base);
+
+        frame->pts = start_pts_ + samples_encoded_;
+        samples_encoded_ += frame->nb_samples;
+    }
+
+    if (int ret = avcodec_send_frame(context_, frame); ret < 0)
+        throw std::runtime_error(fmt::format("send audio frame to encoder failed: {}",
+            av_error_to_string(ret)));
+
+    // the encoder only holds a single packet, so collect them right away.
+    for (;;)
+    {
+        AVPacket *pkt = av_packet_alloc();
+        if (pkt == nullptr)
+            throw std::runtime_error("av_audio: unable to allocate packet");
+
+        const auto ret = avcodec_receive_packet(context_, pkt);
+        if (ret < 0)
+        {
+            av_packet_free(&pkt);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+                break;
+            throw std::runtime_error(fmt::format("receive audio packet failed: {}",
+                av_error_to_string(ret)));
+        }
+        packets_.push_back(pkt);
+    }
+}
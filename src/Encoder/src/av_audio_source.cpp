@@ -0,0 +1,246 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "CamEncoder/av_audio_source.h"
+#include "CamEncoder/av_ffmpeg.h"
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+constexpr double pi = 3.14159265358979323846;
+
+av_paced_audio_source::av_paced_audio_source(av_audio_codec format, std::chrono::milliseconds period)
+    : format_(format)
+    , period_(period)
+{
+}
+
+av_paced_audio_source::~av_paced_audio_source()
+{
+    stop();
+}
+
+auto av_paced_audio_source::get_format() const noexcept -> av_audio_codec
+{
+    return format_;
+}
+
+void av_paced_audio_source::start(std::chrono::steady_clock::time_point epoch,
+    av_audio_callback callback)
+{
+    stop();
+    running_ = true;
+    thread_ = std::thread(&av_paced_audio_source::_run, this, epoch, std::move(callback));
+}
+
+void av_paced_audio_source::stop()
+{
+    running_ = false;
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void av_paced_audio_source::_run(std::chrono::steady_clock::time_point epoch,
+    av_audio_callback callback)
+{
+    using namespace std::chrono;
+
+    const auto frame_size = av_get_bytes_per_sample(format_.sample_format) * format_.channels;
+    std::vector<uint8_t> block;
+
+    const auto start = steady_clock::now();
+    int64_t samples_delivered = 0;
+
+    for (int64_t period = 1; running_; ++period)
+    {
+        // the amount of samples is based on the schedule, so rounding never drifts.
+        const auto next = start + period * period_;
+        const auto sample_count = static_cast<int>(
+            duration_cast<microseconds>(next - start).count() * format_.sample_rate / 1000000 -
+            samples_delivered);
+
+        block.resize(static_cast<size_t>(sample_count) * frame_size);
+        const auto more = fill(block.data(), sample_count);
+
+        std::this_thread::sleep_until(next);
+
+        // the block was captured during the last period, like the timestamps of a capture device.
+        const auto now = steady_clock::now();
+        const auto timestamp = duration_cast<microseconds>(now - epoch - period_).count();
+        callback(static_cast<timestamp_t>(std::max<int64_t>(timestamp, 0)), block.data(),
+            sample_count);
+
+        samples_delivered += sample_count;
+        if (!more)
+            break;
+    }
+}
+
+av_sine_source::av_sine_source(av_audio_codec format, double frequency, double amplitude)
+    : av_paced_audio_source(format)
+    , phase_step_(2.0 * pi * frequency / format.sample_rate)
+    , amplitude_(amplitude)
+{
+    if (format.sample_format != AV_SAMPLE_FMT_S16 && format.sample_format != AV_SAMPLE_FMT_FLT)
+        throw std::runtime_error("av_sine_source: only s16 and flt samples are supported");
+}
+
+av_sine_source::~av_sine_source()
+{
+    stop();
+}
+
+bool av_sine_source::fill(uint8_t *data, int sample_count)
+{
+    const auto format = get_format();
+    auto s16 = reinterpret_cast<int16_t *>(data);
+    auto flt = reinterpret_cast<float *>(data);
+
+    for (int i = 0; i < sample_count; ++i)
+    {
+        const auto value = amplitude_ * std::sin(phase_);
+        phase_ = std::fmod(phase_ + phase_step_, 2.0 * pi);
+
+        for (int channel = 0; channel < format.channels; ++channel)
+        {
+            if (format.sample_format == AV_SAMPLE_FMT_S16)
+                *s16++ = static_cast<int16_t>(value * 32767.0);
+            else
+                *flt++ = static_cast<float>(value);
+        }
+    }
+    return true;
+}
+
+template <typename T>
+static auto read_le(const uint8_t *data) -> T
+{
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+auto load_wav_file(const std::string &filename) -> av_wav_data
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+        throw std::runtime_error(fmt::format("av_wav_source: unable to open '{}'", filename));
+
+    const std::vector<uint8_t> content{std::istreambuf_iterator<char>(file),
+        std::istreambuf_iterator<char>()};
+
+    if (content.size() < 12 || std::memcmp(content.data(), "RIFF", 4) != 0 ||
+        std::memcmp(content.data() + 8, "WAVE", 4) != 0)
+        throw std::runtime_error(fmt::format("av_wav_source: '{}' is not a wav file", filename));
+
+    av_wav_data result;
+    bool have_format = false;
+
+    for (size_t offset = 12; offset + 8 <= content.size();)
+    {
+        const auto chunk = content.data() + offset;
+        const auto chunk_size = std::min<size_t>(read_le<uint32_t>(chunk + 4),
+            content.size() - offset - 8);
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16)
+        {
+            auto tag = read_le<uint16_t>(chunk + 8);
+            const auto channels = read_le<uint16_t>(chunk + 10);
+            const auto sample_rate = read_le<uint32_t>(chunk + 12);
+            const auto bits = read_le<uint16_t>(chunk + 22);
+
+            // WAVE_FORMAT_EXTENSIBLE, the real format is in the first 2 bytes of the sub format.
+            if (tag == 0xfffe && chunk_size >= 40)
+                tag = read_le<uint16_t>(chunk + 32);
+
+            if (tag == 1 && bits == 16)
+                result.format.sample_format = AV_SAMPLE_FMT_S16;
+            else if (tag == 3 && bits == 32)
+                result.format.sample_format = AV_SAMPLE_FMT_FLT;
+            else
+                throw std::runtime_error(fmt::format(
+                    "av_wav_source: unsupported wav format {} with {} bits", tag, bits));
+
+            result.format.channels = channels;
+            result.format.sample_rate = static_cast<int>(sample_rate);
+            have_format = true;
+        }
+        else if (std::memcmp(chunk, "data", 4) == 0)
+        {
+            result.samples.assign(chunk + 8, chunk + 8 + chunk_size);
+        }
+
+        // chunks are word aligned.
+        offset += 8 + chunk_size + (chunk_size & 1);
+    }
+
+    if (!have_format || result.format.channels == 0)
+        throw std::runtime_error(fmt::format("av_wav_source: '{}' has no format", filename));
+
+    return result;
+}
+
+av_wav_source::av_wav_source(const std::string &filename, bool loop)
+    : av_wav_source(load_wav_file(filename), loop)
+{
+}
+
+av_wav_source::av_wav_source(av_wav_data data, bool loop)
+    : av_paced_audio_source(data.format)
+    , samples_(std::move(data.samples))
+    , frame_size_(static_cast<size_t>(av_get_bytes_per_sample(data.format.sample_format)) *
+        data.format.channels)
+    , loop_(loop)
+{
+    // drop a trailing partial sample.
+    samples_.resize(samples_.size() - samples_.size() % frame_size_);
+}
+
+av_wav_source::~av_wav_source()
+{
+    stop();
+}
+
+bool av_wav_source::fill(uint8_t *data, int sample_count)
+{
+    auto remaining = static_cast<size_t>(sample_count) * frame_size_;
+    while (remaining > 0)
+    {
+        if (position_ == samples_.size())
+        {
+            if (!loop_ || samples_.empty())
+            {
+                // pad the last block with silence.
+                std::memset(data, 0, remaining);
+                return false;
+            }
+            position_ = 0;
+        }
+
+        const auto count = std::min(remaining, samples_.size() - position_);
+        std::memcpy(data, samples_.data() + position_, count);
+        position_ += count;
+        data += count;
+        remaining -= count;
+    }
+    return loop_ || position_ < samples_.size();
+}
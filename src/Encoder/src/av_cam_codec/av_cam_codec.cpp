@@ -16,6 +16,7 @@
  */
 
 #include "CamEncoder/av_cam_codec/av_cam_codec.h"
+#include "CamEncoder/av_pixel_format.h"
 #include <minilzo/minilzo.h>
 #include <zlib.h>
 
@@ -57,31 +58,31 @@ int ff_alloc_packet2(AVCodecContext *avctx, AVPacket *avpkt, int64_t size, int64
     }
 }
 
-int __cdecl cam_codec_init(AVCodecContext *avctx)
+int cam_codec_init(AVCodecContext *avctx)
 {
+    // bgr or rgb are transparently encoded.
     switch(avctx->pix_fmt)
     {
-    case AV_PIX_FMT_RGB555LE:
-        avctx->bits_per_coded_sample = 16;
-        break;
-    case AV_PIX_FMT_BGR24:
-        [[fallthrough]];
     case AV_PIX_FMT_RGB24:
-        avctx->bits_per_coded_sample = 24;
         avctx->pix_fmt = AV_PIX_FMT_BGR24;
         break;
-    case AV_PIX_FMT_BGR0:
-        [[fallthrough]];
     case AV_PIX_FMT_RGB0:
-        avctx->bits_per_coded_sample = 32;
         avctx->pix_fmt = AV_PIX_FMT_BGR0;
         break;
     default:
+        break;
+    }
+
+    const auto delta = pixel_format::select_delta_kernel(avctx->pix_fmt);
+    if (delta == nullptr)
+    {
         av_log(avctx, AV_LOG_ERROR, "CamStudio codec error: invalid pixel format %i\n", avctx->pix_fmt);
         return AVERROR_INVALIDDATA;
     }
+    avctx->bits_per_coded_sample = pixel_format::get_info(avctx->pix_fmt).bits_per_pixel;
 
     CamStudioContext *c = (CamStudioContext *)avctx->priv_data;
+    c->delta = delta;
     c->bpp = avctx->bits_per_coded_sample;
     c->linelen = avctx->width * avctx->bits_per_coded_sample / 8;
     c->height = avctx->height;
@@ -180,7 +181,7 @@ int gzip_compress(const Bytef * src, uLong src_len, Bytef *dst, uLongf *dst_len,
 #define CSCD_NON_KEYFRAME_BIT 0
 #define CSCD_KEYFRAME_BIT 1
 
-int __cdecl cam_codec_encode_picture(AVCodecContext *avctx, AVPacket *pkt, const AVFrame *frame, int *got_packet)
+int cam_codec_encode_picture(AVCodecContext *avctx, AVPacket *pkt, const AVFrame *frame, int *got_packet)
 {
     CamStudioContext *c = (CamStudioContext *)avctx->priv_data;
 
@@ -255,19 +256,8 @@ int __cdecl cam_codec_encode_picture(AVCodecContext *avctx, AVPacket *pkt, const
     else
     {
         /* for now only support interleaved (planar needs a bit of extra work) */
-        unsigned char *diffinputptr = c->delta_frame->data[0];
-        unsigned char *inputptr = frame->data[0];
-        unsigned char *prevFrameptr = c->previouse_frame->data[0];
-
-        for (unsigned long i = 0; i != in_len; ++i)
-        {
-            *diffinputptr = *inputptr - *prevFrameptr;
-            *prevFrameptr = *inputptr;
-
-            prevFrameptr++;
-            inputptr++;
-            diffinputptr++;
-        }
+        c->delta(frame->data[0], c->previouse_frame->data[0], c->delta_frame->data[0],
+            c->frame_size / c->height, c->height);
 
         if (c->algorithm == 0)
         {
@@ -305,7 +295,7 @@ int __cdecl cam_codec_encode_picture(AVCodecContext *avctx, AVPacket *pkt, const
     return 0;
 }
 
-int __cdecl cam_codec_encode_end(AVCodecContext *avctx)
+int cam_codec_encode_end(AVCodecContext *avctx)
 {
     CamStudioContext *c = (CamStudioContext *)avctx->priv_data;
     av_freep(&c->comp_buf);
@@ -0,0 +1,450 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "CamEncoder/av_codec_registry.h"
+#include "CamEncoder/av_cam_codec/av_cam_codec.h"
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <utility>
+#include <stdexcept>
+#include <cassert>
+
+/*!
+ * calculate a approximate gob size.
+ *
+ * \note Currently generate a gop that is equal to fps. The practical problem I faced it that you
+ * record a 5 second video having a gop of 250 is simply not good enough.
+ * This used to be gop = ((num/den) + 0.5) * 10.
+ */
+int calculate_gop_size(const av_video_meta &meta)
+{
+    double gob_size = ((static_cast<double>(meta.fps.num) / meta.fps.den) + 0.5);
+    return static_cast<int>(gob_size);
+}
+
+void apply_preset(av_dict &av_opts, std::optional<video::preset> preset)
+{
+    const auto preset_idx = static_cast<int>(preset.value_or(video::preset::medium));
+    const auto preset_name = video::preset_names.at(preset_idx);
+    av_opts["preset"] = preset_name;
+}
+
+void apply_tune(av_dict &av_opts, std::optional<video::tune> preset)
+{
+    if (!preset)
+        return;
+
+    const auto tune_idx = static_cast<int>(preset.value());
+    const auto tune_name = video::tune_names.at(tune_idx);
+    av_opts["tune"] = tune_name;
+}
+
+void apply_profile(av_dict &av_opts, std::optional<video::profile> profile)
+{
+    if (!profile)
+        return;
+
+    const auto profile_idx = static_cast<int>(profile.value());
+    const auto profile_name = video::profile_names.at(profile_idx);
+    av_opts["profile"] = profile_name;
+}
+
+void apply_level(AVCodecContext *condext, std::optional<video::codec_level> level)
+{
+    if (!level)
+        return;
+
+    const auto level_idx = static_cast<int>(level.value());
+    const auto level_value = video::codec_level_values.at(level_idx);
+    condext->level = level_value;
+}
+
+void apply_container_options(av_dict &av_opts, video::container container)
+{
+    switch (container)
+    {
+    case video::container::mp4:
+    {
+        av_opts["brand"] = "mp42";
+
+        /*
+         * disable_chpl: Disable Nero chapter markers (chpl atom)
+         */
+        av_opts["movflags"] = "disable_chpl";
+    } break;
+    }
+}
+
+/* x264 */
+
+AVCodec *x264_find_encoder()
+{
+    return avcodec_find_encoder(AV_CODEC_ID_H264);
+}
+
+void x264_apply_options(const av_video_meta &meta, AVCodecContext *context, av_dict &av_opts)
+{
+    // calculate a approximate gob size.
+    context->gop_size = calculate_gop_size(meta);
+
+    // either quality of bitrate must be set.
+    assert(!!meta.quality || !!meta.bitrate);
+
+    apply_preset(av_opts, meta.preset);
+    apply_tune(av_opts, meta.tune);
+    apply_profile(av_opts, meta.profile);
+    apply_level(context, meta.level);
+    apply_container_options(av_opts, meta.container);
+
+    if (meta.low_latency)
+    {
+        // zerolatency already drops the lookahead and frame threading, spell out the rest. x264
+        // combines tunes, so a film or animation tune is kept. there is no intra refresh, the
+        // drop_non_key writers and late joining live clients need the periodic keyframes.
+        if (meta.tune && meta.tune != video::tune::zerolatency)
+            av_opts["tune"] = fmt::format("{},zerolatency",
+                video::tune_names.at(static_cast<int>(meta.tune.value())));
+        else
+            av_opts["tune"] = "zerolatency";
+        context->max_b_frames = 0;
+        context->thread_type = FF_THREAD_SLICE;
+    }
+
+    /*!
+     * set variable framerate.
+     * \see https://superuser.com/questions/908295/ffmpeg-libx264-how-to-specify-a-variable-frame-rate-but-with-a-maximum
+     */
+    //av_opts["vsync"] = "vfr";
+
+    // Now set the things in context that we don't want to allow
+    // the user to override.
+    if (meta.bitrate)
+    {
+        // Average bitrate
+        context->bit_rate = static_cast<int64_t>(1000.0 * meta.bitrate.value());
+
+        // ffmpeg's mpeg2 encoder requires that the bit_rate_tolerance be >= bitrate * fps
+        //context->bit_rate_tolerance = static_cast<int>(context->bit_rate * av_q2d(fps) + 1);
+    }
+    else
+    {
+        /* Constant quantizer */
+        context->flags |= AV_CODEC_FLAG_QSCALE;
+
+        /* global_quality only seem to apply to mpeg 1, 2 and 4 */
+        //context->global_quality =
+        //      static_cast<int>(FF_QP2LAMBDA * meta.quality.value() + 0.5);
+
+        // x264 requires this.
+        av_opts["crf"] = static_cast<int64_t>(meta.quality.value());
+    }
+}
+
+/* camstudio */
+
+AVCodec *cscd_find_encoder()
+{
+    return &cam_codec_encoder;
+}
+
+void cscd_apply_options(const av_video_meta &meta, AVCodecContext * /*context*/, av_dict &av_opts)
+{
+    av_opts["algorithm"] = 1; // select lzo compressor
+    av_opts["gzip_level"] = 9; // gzip compresion level is not used.
+    av_opts["autokeyframe"] = 1; // enable keyframe insertion every x frames.
+    av_opts["autokeyframe_rate"] = calculate_gop_size(meta) * 10;
+}
+
+/* ffv1 */
+
+AVCodec *ffv1_find_encoder()
+{
+    return avcodec_find_encoder(AV_CODEC_ID_FFV1);
+}
+
+void ffv1_apply_options(const av_video_meta &meta, AVCodecContext *context, av_dict &av_opts)
+{
+    // version 3 is required for slices, which is what allows ffv1 to encode multi threaded.
+    context->level = 3;
+    context->slices = 16;
+    context->gop_size = calculate_gop_size(meta);
+
+    av_opts["coder"] = "range_def"; // range coder with the default state transition table.
+    av_opts["context"] = 0; // small context model, larger ones cost a lot of speed.
+    av_opts["slicecrc"] = 1; // allows a decoder to recover from a truncated recording.
+}
+
+/* utvideo */
+
+AVCodec *utvideo_find_encoder()
+{
+    return avcodec_find_encoder(AV_CODEC_ID_UTVIDEO);
+}
+
+void utvideo_apply_options(const av_video_meta & /*meta*/, AVCodecContext * /*context*/, av_dict &av_opts)
+{
+    // left prediction is the fastest, median costs a lot of speed for a few percent in size.
+    av_opts["pred"] = "left";
+}
+
+/* svt-av1 */
+
+AVCodec *av1_find_encoder()
+{
+    return avcodec_find_encoder_by_name("libsvtav1");
+}
+
+/*!
+ * Map our (x264 style) preset onto a svt-av1 preset. Svt-av1 presets run from 0 (slowest) to 12
+ * (fastest, realtime), its default is 10.
+ */
+int av1_preset(std::optional<video::preset> preset)
+{
+    constexpr std::array<int, 9> svt_presets = {
+        12, // ultrafast
+        11, // superfast
+        10, // veryfast
+        9,  // faster
+        8,  // fast
+        7,  // medium
+        6,  // slow
+        4,  // slower
+        2,  // veryslow
+    };
+
+    const auto preset_idx = static_cast<int>(preset.value_or(video::preset::medium));
+    return svt_presets.at(preset_idx);
+}
+
+void av1_apply_options(const av_video_meta &meta, AVCodecContext *context, av_dict &av_opts)
+{
+    context->gop_size = calculate_gop_size(meta);
+
+    // either quality of bitrate must be set.
+    assert(!!meta.quality || !!meta.bitrate);
+
+    av_opts["preset"] = av1_preset(meta.preset);
+
+    /*
+     * scm: screen content mode, enables the palette and intra block copy tools. These make text
+     * and ui heavy recordings a lot smaller. The svtav1-params and crf options exist since
+     * ffmpeg 5.1 (libavcodec 59.37.100), older versions only know a constant qp.
+     */
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(59, 37, 100)
+    av_opts["svtav1-params"] = "scm=1";
+#endif
+
+    apply_container_options(av_opts, meta.container);
+
+    if (meta.bitrate)
+    {
+        context->bit_rate = static_cast<int64_t>(1000.0 * meta.bitrate.value());
+    }
+    else
+    {
+        // our quality scale is the x264 crf scale (0-51), svt-av1 uses 0-63.
+        const auto crf = static_cast<int64_t>(meta.quality.value() * 63.0 / 51.0 + 0.5);
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(59, 37, 100)
+        av_opts["crf"] = std::min<int64_t>(crf, 63);
+#else
+        av_opts["rc"] = 0; // constant qp
+        av_opts["qp"] = std::min<int64_t>(crf, 63);
+#endif
+    }
+}
+
+/*!
+ * Pixel formats that only differ in the meaning of the 4th byte. Converting between these is a
+ * plain copy.
+ */
+bool is_layout_compatible(AVPixelFormat lhs, AVPixelFormat rhs)
+{
+    if (lhs == rhs)
+        return true;
+
+    constexpr std::pair<AVPixelFormat, AVPixelFormat> compatible_formats[] = {
+        {AV_PIX_FMT_BGRA, AV_PIX_FMT_BGR0},
+        {AV_PIX_FMT_RGBA, AV_PIX_FMT_RGB0},
+        {AV_PIX_FMT_ARGB, AV_PIX_FMT_0RGB},
+        {AV_PIX_FMT_ABGR, AV_PIX_FMT_0BGR},
+    };
+
+    for (const auto &[a, b] : compatible_formats)
+    {
+        if ((lhs == a && rhs == b) || (lhs == b && rhs == a))
+            return true;
+    }
+    return false;
+}
+
+auto negotiate_pixel_format(const av_codec_descriptor &descriptor, AVPixelFormat input_pixel_format)
+    -> av_pixel_format_negotiation
+{
+    if (descriptor.pixel_formats.empty())
+        throw std::runtime_error(fmt::format("av_codec_registry: codec '{}' has no pixel formats",
+            descriptor.name));
+
+    av_pixel_format_negotiation result;
+    result.input_pixel_format = input_pixel_format;
+
+    // first see if the encoder can consume our input as is.
+    for (const auto pixel_format : descriptor.pixel_formats)
+    {
+        if (!is_layout_compatible(pixel_format, input_pixel_format))
+            continue;
+
+        result.output_pixel_format = pixel_format;
+        result.loss = 0;
+        result.conversion_required = false;
+        return result;
+    }
+
+    // let ffmpeg pick the format that loses the least information. the captured frames are opaque,
+    // so a format with an alpha plane would only encode a plane that never changes.
+    std::vector<AVPixelFormat> pixel_formats;
+    std::copy_if(descriptor.pixel_formats.begin(), descriptor.pixel_formats.end(),
+        std::back_inserter(pixel_formats), [](AVPixelFormat pixel_format) {
+            const auto pixel_format_descriptor = av_pix_fmt_desc_get(pixel_format);
+            return pixel_format_descriptor == nullptr
+                || !(pixel_format_descriptor->flags & AV_PIX_FMT_FLAG_ALPHA);
+        });
+    if (pixel_formats.empty())
+        pixel_formats = descriptor.pixel_formats;
+    pixel_formats.push_back(AV_PIX_FMT_NONE);
+
+    int loss = 0;
+    result.output_pixel_format = avcodec_find_best_pix_fmt_of_list(pixel_formats.data(),
+        input_pixel_format, 0, &loss);
+
+    if (result.output_pixel_format == AV_PIX_FMT_NONE)
+        result.output_pixel_format = descriptor.pixel_formats.front();
+
+    result.loss = loss;
+    result.conversion_required = true;
+    return result;
+}
+
+av_codec_registry::av_codec_registry()
+{
+    av_codec_descriptor x264;
+    x264.codec = video::codec::x264;
+    x264.codec_type = av_video_codec_type::h264;
+    x264.name = "h264";
+    x264.find_encoder = x264_find_encoder;
+    x264.pixel_formats = {AV_PIX_FMT_YUV420P};
+    x264.containers = {video::container::avi, video::container::mp4, video::container::mkv};
+    x264.thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    x264.latency = av_codec_latency::high;
+    x264.apply_options = x264_apply_options;
+    register_codec(std::move(x264));
+
+    av_codec_descriptor cscd;
+    cscd.codec = video::codec::camstudio;
+    cscd.codec_type = av_video_codec_type::cscd;
+    cscd.name = "cscd";
+    cscd.find_encoder = cscd_find_encoder;
+    cscd.pixel_formats = {AV_PIX_FMT_BGR24, AV_PIX_FMT_BGR0, AV_PIX_FMT_RGB555LE};
+    cscd.containers = {video::container::avi, video::container::mkv};
+    cscd.thread_type = 0;
+    cscd.latency = av_codec_latency::none;
+    cscd.packed_frame = true;
+    cscd.bottom_up = true;
+    cscd.apply_options = cscd_apply_options;
+    register_codec(std::move(cscd));
+
+    av_codec_descriptor ffv1;
+    ffv1.codec = video::codec::ffv1;
+    ffv1.codec_type = av_video_codec_type::ffv1;
+    ffv1.name = "ffv1";
+    ffv1.find_encoder = ffv1_find_encoder;
+    ffv1.pixel_formats = {AV_PIX_FMT_BGR0, AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUV420P};
+    ffv1.containers = {video::container::avi, video::container::mkv};
+    ffv1.thread_type = FF_THREAD_SLICE;
+    ffv1.latency = av_codec_latency::none;
+    ffv1.apply_options = ffv1_apply_options;
+    register_codec(std::move(ffv1));
+
+    av_codec_descriptor utvideo;
+    utvideo.codec = video::codec::utvideo;
+    utvideo.codec_type = av_video_codec_type::utvideo;
+    utvideo.name = "utvideo";
+    utvideo.find_encoder = utvideo_find_encoder;
+    utvideo.pixel_formats = {AV_PIX_FMT_GBRP, AV_PIX_FMT_GBRAP, AV_PIX_FMT_YUV444P,
+        AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV420P};
+    utvideo.containers = {video::container::avi, video::container::mkv};
+    utvideo.thread_type = FF_THREAD_FRAME;
+    utvideo.latency = av_codec_latency::low;
+    utvideo.apply_options = utvideo_apply_options;
+    register_codec(std::move(utvideo));
+
+    av_codec_descriptor av1;
+    av1.codec = video::codec::av1;
+    av1.codec_type = av_video_codec_type::av1;
+    av1.name = "av1";
+    av1.find_encoder = av1_find_encoder;
+    av1.pixel_formats = {AV_PIX_FMT_YUV420P};
+    av1.containers = {video::container::mp4, video::container::mkv};
+    av1.thread_type = 0; // svt-av1 manages its own threads.
+    av1.latency = av_codec_latency::high;
+    av1.apply_options = av1_apply_options;
+    register_codec(std::move(av1));
+}
+
+auto av_codec_registry::get() -> av_codec_registry &
+{
+    static av_codec_registry registry;
+    return registry;
+}
+
+void av_codec_registry::register_codec(av_codec_descriptor descriptor)
+{
+    assert(descriptor.find_encoder != nullptr);
+    assert(descriptor.apply_options != nullptr);
+
+    const auto itr = std::find_if(codecs_.begin(), codecs_.end(),
+        [codec = descriptor.codec](const auto &entry) { return entry.codec == codec; });
+
+    if (itr != codecs_.end())
+        *itr = std::move(descriptor);
+    else
+        codecs_.emplace_back(std::move(descriptor));
+}
+
+auto av_codec_registry::find(video::codec codec) const -> const av_codec_descriptor &
+{
+    const auto itr = std::find_if(codecs_.begin(), codecs_.end(),
+        [codec](const auto &entry) { return entry.codec == codec; });
+
+    if (itr == codecs_.end())
+        throw std::runtime_error("av_codec_registry: unsupported encoder");
+
+    return *itr;
+}
+
+bool av_codec_registry::supports_container(video::codec codec, video::container container) const
+{
+    const auto &containers = find(codec).containers;
+    return std::find(containers.begin(), containers.end(), container) != containers.end();
+}
+
+auto av_codec_registry::get_codecs() const noexcept -> const std::vector<av_codec_descriptor> &
+{
+    return codecs_;
+}
@@ -0,0 +1,511 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "CamEncoder/av_file_io.h"
+#include "CamEncoder/av_error.h"
+#include "av_log.h"
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+// the size of the AVIOContext buffer, the muxer writes in chunks of at most this size.
+constexpr int avio_buffer_size = 256 * 1024;
+
+namespace detail
+{
+
+/*!
+ * The os file, with an optional second handle that bypasses the file cache.
+ */
+class native_file
+{
+public:
+    native_file(const std::string &filename, bool direct_io);
+    ~native_file();
+
+    native_file(const native_file &) = delete;
+    native_file &operator=(const native_file &) = delete;
+
+    bool has_direct_io() const noexcept;
+
+    int write(const uint8_t *data, size_t size, int64_t offset, bool direct);
+
+    // reserve disk space up to size, without changing the file size where the os allows it.
+    int preallocate(int64_t size);
+
+    int truncate(int64_t size);
+    void close();
+
+private:
+#if defined(_WIN32)
+    HANDLE file_{INVALID_HANDLE_VALUE};
+    HANDLE direct_file_{INVALID_HANDLE_VALUE};
+#else
+    int file_{-1};
+    int direct_file_{-1};
+#endif
+};
+
+#if defined(_WIN32)
+
+static auto utf8_to_wide(const std::string &str) -> std::wstring
+{
+    const auto size = MultiByteToWideChar(CP_UTF8, 0, str.c_str(), -1, nullptr, 0);
+    std::wstring result(size, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, str.c_str(), -1, result.data(), size);
+    result.resize(size - 1);
+    return result;
+}
+
+native_file::native_file(const std::string &filename, bool direct_io)
+{
+    const auto wide_filename = utf8_to_wide(filename);
+    file_ = CreateFileW(wide_filename.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE)
+        throw std::runtime_error(fmt::format("av_file_io: unable to open '{}': {}", filename,
+            GetLastError()));
+
+    if (direct_io)
+    {
+        direct_file_ = CreateFileW(wide_filename.c_str(), GENERIC_WRITE,
+            FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+            FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH, nullptr);
+        if (direct_file_ == INVALID_HANDLE_VALUE)
+            _log("av_file_io: direct io is not available for '{}'\n", filename);
+    }
+}
+
+native_file::~native_file()
+{
+    close();
+}
+
+bool native_file::has_direct_io() const noexcept
+{
+    return direct_file_ != INVALID_HANDLE_VALUE;
+}
+
+int native_file::write(const uint8_t *data, size_t size, int64_t offset, bool direct)
+{
+    const auto handle = direct ? direct_file_ : file_;
+    while (size > 0)
+    {
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(offset & 0xffffffff);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+        const auto chunk = static_cast<DWORD>(std::min<size_t>(size, 0x40000000));
+        DWORD written = 0;
+        if (!WriteFile(handle, data, chunk, &written, &overlapped) || written == 0)
+            return AVERROR(EIO);
+
+        data += written;
+        size -= written;
+        offset += written;
+    }
+    return 0;
+}
+
+int native_file::preallocate(int64_t size)
+{
+    FILE_ALLOCATION_INFO info = {};
+    info.AllocationSize.QuadPart = size;
+    if (!SetFileInformationByHandle(file_, FileAllocationInfo, &info, sizeof(info)))
+        return AVERROR(ENOSPC);
+    return 0;
+}
+
+int native_file::truncate(int64_t size)
+{
+    FILE_END_OF_FILE_INFO info = {};
+    info.EndOfFile.QuadPart = size;
+    if (!SetFileInformationByHandle(file_, FileEndOfFileInfo, &info, sizeof(info)))
+        return AVERROR(EIO);
+    return 0;
+}
+
+void native_file::close()
+{
+    if (direct_file_ != INVALID_HANDLE_VALUE)
+        CloseHandle(direct_file_);
+    if (file_ != INVALID_HANDLE_VALUE)
+        CloseHandle(file_);
+
+    direct_file_ = INVALID_HANDLE_VALUE;
+    file_ = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+native_file::native_file(const std::string &filename, bool direct_io)
+{
+    file_ = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file_ < 0)
+        throw std::runtime_error(fmt::format("av_file_io: unable to open '{}': {}", filename,
+            std::strerror(errno)));
+
+#if defined(O_DIRECT)
+    if (direct_io)
+    {
+        // not every file system supports O_DIRECT (a.e. tmpfs), in that case we just use the cache.
+        direct_file_ = ::open(filename.c_str(), O_WRONLY | O_DIRECT | O_CLOEXEC);
+        if (direct_file_ < 0)
+            _log("av_file_io: direct io is not available for '{}': {}\n", filename,
+                std::strerror(errno));
+    }
+#else
+    (void)direct_io;
+#endif
+}
+
+native_file::~native_file()
+{
+    close();
+}
+
+bool native_file::has_direct_io() const noexcept
+{
+    return direct_file_ >= 0;
+}
+
+int native_file::write(const uint8_t *data, size_t size, int64_t offset, bool direct)
+{
+    const auto fd = direct ? direct_file_ : file_;
+    while (size > 0)
+    {
+        const auto written = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return AVERROR(errno);
+        }
+
+        data += written;
+        size -= static_cast<size_t>(written);
+        offset += written;
+    }
+    return 0;
+}
+
+int native_file::preallocate(int64_t size)
+{
+#if defined(__linux__)
+    // keep the file size, so a file that is not closed properly doesn't end in zeros.
+    if (::fallocate(file_, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size)) != 0)
+        return AVERROR(errno);
+    return 0;
+#else
+    if (const auto ret = ::posix_fallocate(file_, 0, static_cast<off_t>(size)); ret != 0)
+        return AVERROR(ret);
+    return 0;
+#endif
+}
+
+int native_file::truncate(int64_t size)
+{
+    if (::ftruncate(file_, static_cast<off_t>(size)) != 0)
+        return AVERROR(errno);
+    return 0;
+}
+
+void native_file::close()
+{
+    if (direct_file_ >= 0)
+        ::close(direct_file_);
+    if (file_ >= 0)
+        ::close(file_);
+
+    direct_file_ = -1;
+    file_ = -1;
+}
+
+#endif
+
+} // namespace detail
+
+void av_file_io::aligned_delete::operator()(uint8_t *p) const noexcept
+{
+    ::operator delete[](p, std::align_val_t{alignment});
+}
+
+av_file_io::av_file_io(const std::string &filename, av_file_io_config config)
+    : config_(config)
+    , file_(std::make_unique<detail::native_file>(filename, config.direct_io))
+{
+    // direct io needs whole blocks.
+    config_.buffer_size = std::max<size_t>(
+        (config_.buffer_size + alignment - 1) / alignment * alignment, alignment);
+    next_extent_ = config_.preallocate_extent;
+
+    for (auto &buffer : buffers_)
+        buffer = aligned_buffer(static_cast<uint8_t *>(
+            ::operator new[](config_.buffer_size, std::align_val_t{alignment})));
+
+    auto avio_buffer = static_cast<unsigned char *>(av_malloc(avio_buffer_size));
+    if (avio_buffer == nullptr)
+        throw std::runtime_error("av_file_io: unable to allocate avio buffer");
+
+    context_ = avio_alloc_context(avio_buffer, avio_buffer_size, 1, this, nullptr,
+        &av_file_io::_write_packet, &av_file_io::_seek);
+    if (context_ == nullptr)
+    {
+        av_free(avio_buffer);
+        throw std::runtime_error("av_file_io: unable to allocate avio context");
+    }
+
+    thread_ = std::thread([this]() { _run(); });
+}
+
+av_file_io::~av_file_io()
+{
+    close();
+
+    if (context_ != nullptr)
+    {
+        av_freep(&context_->buffer);
+        avio_context_free(&context_);
+    }
+}
+
+auto av_file_io::get_context() const noexcept -> AVIOContext *
+{
+    return context_;
+}
+
+int av_file_io::close()
+{
+    if (closed_)
+        return error_;
+    closed_ = true;
+
+    avio_flush(context_);
+
+    auto ret = _submit_buffer();
+    if (const auto wait_ret = _wait_for_writer(); ret == 0)
+        ret = wait_ret;
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        stopping_ = true;
+    }
+    job_queued_.notify_one();
+    thread_.join();
+
+    // drop the preallocated space we didn't use.
+    if (const auto truncate_ret = file_->truncate(size_); ret == 0)
+        ret = truncate_ret;
+
+    file_->close();
+
+    if (ret < 0)
+        _log("av_file_io: closing file failed: {}\n", av_error_to_string(ret));
+    return ret;
+}
+
+auto av_file_io::get_stats() const -> av_file_io_stats
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return stats_;
+}
+
+int av_file_io::_write_packet(void *opaque, uint8_t *buf, int buf_size)
+{
+    return static_cast<av_file_io *>(opaque)->_write(buf, buf_size);
+}
+
+int64_t av_file_io::_seek(void *opaque, int64_t offset, int whence)
+{
+    return static_cast<av_file_io *>(opaque)->_seek(offset, whence);
+}
+
+int av_file_io::_write(const uint8_t *data, int size)
+{
+    // the muxer seeked, a.e. to update a header, continue in a new buffer at the new position.
+    if (position_ != buffer_offset_ + static_cast<int64_t>(buffer_fill_))
+    {
+        if (const auto ret = _submit_buffer(); ret < 0)
+            return ret;
+        buffer_offset_ = position_;
+    }
+
+    auto remaining = static_cast<size_t>(size);
+    while (remaining > 0)
+    {
+        const auto chunk = std::min(remaining, config_.buffer_size - buffer_fill_);
+        std::memcpy(buffers_[active_buffer_].get() + buffer_fill_, data, chunk);
+
+        data += chunk;
+        remaining -= chunk;
+        buffer_fill_ += chunk;
+        position_ += chunk;
+        size_ = std::max(size_, position_);
+
+        if (buffer_fill_ == config_.buffer_size)
+        {
+            if (const auto ret = _submit_buffer(); ret < 0)
+                return ret;
+        }
+    }
+    return size;
+}
+
+int64_t av_file_io::_seek(int64_t offset, int whence)
+{
+    int64_t position = 0;
+    switch (whence & ~AVSEEK_FORCE)
+    {
+    case AVSEEK_SIZE:
+        return size_;
+    case SEEK_SET:
+        position = offset;
+        break;
+    case SEEK_CUR:
+        position = position_ + offset;
+        break;
+    case SEEK_END:
+        position = size_ + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+
+    if (position < 0)
+        return AVERROR(EINVAL);
+
+    // the actual repositioning happens on the next write.
+    position_ = position;
+    return position_;
+}
+
+int av_file_io::_submit_buffer()
+{
+    if (buffer_fill_ == 0)
+        return 0;
+
+    if (const auto ret = _wait_for_writer(); ret < 0)
+        return ret;
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        job_data_ = buffers_[active_buffer_].get();
+        job_size_ = buffer_fill_;
+        job_offset_ = buffer_offset_;
+        job_pending_ = true;
+    }
+    job_queued_.notify_one();
+
+    active_buffer_ ^= 1;
+    buffer_offset_ += static_cast<int64_t>(buffer_fill_);
+    buffer_fill_ = 0;
+    return 0;
+}
+
+int av_file_io::_wait_for_writer()
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    if (job_pending_)
+    {
+        const auto wait_start = std::chrono::steady_clock::now();
+        job_done_.wait(lock, [this]() { return !job_pending_; });
+        stats_.wait_time += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - wait_start);
+    }
+    return error_;
+}
+
+void av_file_io::_run()
+{
+    for (;;)
+    {
+        const uint8_t *data = nullptr;
+        size_t size = 0;
+        int64_t offset = 0;
+        {
+            std::unique_lock<std::mutex> lock(lock_);
+            job_queued_.wait(lock, [this]() { return job_pending_ || stopping_; });
+            if (!job_pending_)
+                return;
+
+            data = job_data_;
+            size = job_size_;
+            offset = job_offset_;
+        }
+
+        const auto ret = _write_buffer(data, size, offset);
+
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            if (ret < 0 && error_ == 0)
+                error_ = ret;
+            job_pending_ = false;
+        }
+        job_done_.notify_one();
+    }
+}
+
+int av_file_io::_write_buffer(const uint8_t *data, size_t size, int64_t offset)
+{
+    const auto end = offset + static_cast<int64_t>(size);
+    while (next_extent_ > 0 && end > allocated_size_)
+    {
+        const auto new_allocated_size = allocated_size_ + next_extent_;
+        if (const auto ret = file_->preallocate(new_allocated_size); ret < 0)
+        {
+            // not supported or the disk is full, the write itself will tell which one.
+            _log("av_file_io: preallocation failed, continuing without: {}\n",
+                av_error_to_string(ret));
+            next_extent_ = 0;
+
+            std::lock_guard<std::mutex> lock(lock_);
+            stats_.preallocate_error = ret;
+            break;
+        }
+
+        allocated_size_ = new_allocated_size;
+        next_extent_ = std::min(next_extent_ * 2, config_.max_preallocate_extent);
+
+        std::lock_guard<std::mutex> lock(lock_);
+        ++stats_.preallocate_count;
+        stats_.preallocated_size = allocated_size_;
+    }
+
+    const auto direct = file_->has_direct_io() && size % alignment == 0 &&
+        offset % static_cast<int64_t>(alignment) == 0;
+
+    if (const auto ret = file_->write(data, size, offset, direct); ret < 0)
+        return ret;
+
+    std::lock_guard<std::mutex> lock(lock_);
+    stats_.bytes_written += static_cast<int64_t>(size);
+    ++stats_.write_count;
+    if (direct)
+        ++stats_.direct_write_count;
+    return 0;
+}
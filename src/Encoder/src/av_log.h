@@ -2,12 +2,14 @@
 
 #include <fmt/printf.h>
 #include <fmt/ostream.h>
+#include <cstdio>
 
+// logs to stderr, stdout can be the output of a recording (pipe:1).
 template <typename... Args>
 static void _log(fmt::string_view format_str, const Args &... args)
 {
 #ifdef _DEBUG
-    fmt::vprint(format_str, fmt::make_format_args(args...));
+    fmt::vprint(stderr, format_str, fmt::make_format_args(args...));
 #endif
 }
 
@@ -22,6 +22,111 @@
 
 #include <fmt/format.h>
 #include <fmt/time.h>
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+class av_muxer::video_encode_workers
+{
+public:
+    // a thread for every track after the first, the first track is encoded by the caller.
+    explicit video_encode_workers(size_t track_count)
+    {
+        for (size_t index = 1; index < track_count; ++index)
+            threads_.emplace_back([this, index]() { _run(index); });
+    }
+
+    ~video_encode_workers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            stopping_ = true;
+        }
+        job_ready_.notify_all();
+
+        for (auto &thread : threads_)
+            thread.join();
+    }
+
+    // run job for every track index, and wait for all of them. Rethrows the first error.
+    void run(const std::function<void(size_t)> &job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            job_ = &job;
+            pending_ = threads_.size();
+            error_ = nullptr;
+            ++generation_;
+        }
+        job_ready_.notify_all();
+
+        std::exception_ptr error;
+        try
+        {
+            job(0);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        std::unique_lock<std::mutex> lock(lock_);
+        job_done_.wait(lock, [this]() { return pending_ == 0; });
+        job_ = nullptr;
+
+        if (error == nullptr)
+            error = error_;
+        if (error != nullptr)
+            std::rethrow_exception(error);
+    }
+
+private:
+    void _run(size_t index)
+    {
+        uint64_t generation = 0;
+        for (;;)
+        {
+            const std::function<void(size_t)> *job = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(lock_);
+                job_ready_.wait(lock, [&]() { return stopping_ || generation_ != generation; });
+                if (stopping_)
+                    return;
+                generation = generation_;
+                job = job_;
+            }
+
+            std::exception_ptr error;
+            try
+            {
+                (*job)(index);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(lock_);
+            if (error != nullptr && error_ == nullptr)
+                error_ = error;
+            if (--pending_ == 0)
+                job_done_.notify_one();
+        }
+    }
+
+    std::mutex lock_;
+    std::condition_variable job_ready_;
+    std::condition_variable job_done_;
+    const std::function<void(size_t)> *job_{nullptr};
+    uint64_t generation_{0};
+    size_t pending_{0};
+    std::exception_ptr error_{};
+    bool stopping_{false};
+    std::vector<std::thread> threads_;
+};
 
 void av_log_packet(const AVFormatContext *fmt_ctx, const AVPacket *pkt)
 {
@@ -34,9 +139,12 @@ void av_log_packet(const AVFormatContext *fmt_ctx, const AVPacket *pkt)
                pkt->stream_index);
 }
 
-av_muxer::av_muxer(std::string filename, const av_muxer_type muxer_type, av_metadata metadata)
-    : filename_(std::move(filename))
+av_muxer::av_muxer(std::string filename, const av_muxer_type muxer_type, av_metadata metadata,
+    av_muxer_config config)
+    : muxer_type_(muxer_type)
+    , filename_(std::move(filename))
     , metadata_(std::move(metadata))
+    , config_(config)
 {
     const auto muxer_type_name = av_muxer_type_names.at(static_cast<int>(muxer_type));
 
@@ -51,6 +159,37 @@ av_muxer::av_muxer(std::string filename, const av_muxer_type muxer_type, av_meta
             fmt::format("av_muxer: unable to create avformat output context: {}",
                 av_error_to_string(ret)));
 
+    if (config_.segment && config_.segment->playlist != av_playlist_type::none)
+    {
+        if (muxer_type != av_muxer_type::mp4)
+            throw std::runtime_error("av_muxer: segment playlists are only supported for mp4");
+
+        /* the playlists address the fragments of the segments. */
+        config_.fragmented_mp4 = true;
+    }
+
+    if (config_.segment && config_.replay)
+        throw std::runtime_error("av_muxer: segment and replay mode can not be combined");
+
+    if (config_.output_fd)
+    {
+        if (muxer_type != av_muxer_type::mkv && muxer_type != av_muxer_type::mpegts &&
+            muxer_type != av_muxer_type::nut)
+            throw std::runtime_error(fmt::format("av_muxer: '{}' can not be written to a pipe",
+                av_muxer_type_names.at(static_cast<int>(muxer_type))));
+
+        if (config_.segment || config_.replay)
+            throw std::runtime_error("av_muxer: pipe output can not be combined with segment or replay mode");
+    }
+
+    if (config_.live)
+    {
+        if (config_.segment || config_.replay || config_.output_fd)
+            throw std::runtime_error("av_muxer: live streaming can not be combined with segment, replay or pipe output");
+
+        avformat_network_init();
+    }
+
     switch(muxer_type)
     {
     case av_muxer_type::none:
@@ -59,12 +198,17 @@ av_muxer::av_muxer(std::string filename, const av_muxer_type muxer_type, av_meta
         );
         break;
     case av_muxer_type::mp4:
+        [[fallthrough]];
+    case av_muxer_type::mpegts:
+        [[fallthrough]];
+    case av_muxer_type::nut:
         time_base_.num = 1;
         time_base_.den = 90000;
         break;
     case av_muxer_type::avi:
         [[fallthrough]];
     case av_muxer_type::mkv:
+        // the matroska muxer always stores its timestamps in ms.
         time_base_.num = 1;
         time_base_.den = 1000;
         break;
@@ -73,287 +217,603 @@ av_muxer::av_muxer(std::string filename, const av_muxer_type muxer_type, av_meta
 
 av_muxer::~av_muxer()
 {
-    flush();
+    // all the queued packets need to be written before the trailer. the destructor can't throw, a
+    // failure only loses the end of the recording.
+    try
+    {
+        finish();
+    }
+    catch (const std::exception &e)
+    {
+        _log("av_muxer: finishing the recording failed: {}\n", e.what());
+    }
+
+    /* the extra outputs have their own output contexts and writers. */
+    tee_sinks_.clear();
 
     /* Write the trailer, if any. The trailer must be written before you
      * close the CodecContexts open when you wrote the header; otherwise
      * av_write_trailer() may try to use memory that was freed on
      * av_codec_close(). */
-    int ret = av_write_trailer(format_context_);
-    assert(ret == 0);
-
-    //if (have_audio)
-    //    close_stream(format_context_, &audio_track);
+    if (segmenter_)
+    {
+        /* the segments have their own output contexts. */
+        segmenter_->close();
+    }
+    else if (replay_)
+    {
+        /* nothing was written, wait for the saves that are still running. */
+        replay_.reset();
+    }
+    else if (writer_)
+    {
+        /* the file is still closed, without its index it is only missing the seek information.
+         * without a writer open() did not get to write the header, so there is no trailer. */
+        if (const auto ret = av_write_trailer(format_context_); ret < 0)
+            _log("av_muxer: writing the trailer failed: {}\n", av_error_to_string(ret));
+    }
 
     /* Close each codec. */
-    video_codec_.reset();
+    video_workers_.reset();
+    video_streams_.clear();
+    audio_codec_.reset();
 
-    if (!(output_format_->flags & AVFMT_NOFILE))
+    if (file_io_)
+    {
+        /* Close the output file, the context is owned by file_io_. */
+        avio_flush(format_context_->pb);
+        file_io_->close();
+        const auto stats = file_io_->get_stats();
+        _log("av_muxer: wrote {} bytes in {} writes ({} direct), preallocated {} bytes, waited {}us\n",
+             stats.bytes_written, stats.write_count, stats.direct_write_count,
+             stats.preallocated_size, stats.wait_time.count());
+        format_context_->pb = nullptr;
+        file_io_.reset();
+    }
+    else if (pipe_io_)
+    {
+        /* Flush the pipe, the file descriptor is not ours to close. */
+        pipe_io_->close();
+        const auto stats = pipe_io_->get_stats();
+        _log("av_muxer: wrote {} bytes to the pipe in {} writes\n", stats.bytes_written,
+             stats.write_count);
+        format_context_->pb = nullptr;
+        pipe_io_.reset();
+    }
+    else if (!(output_format_->flags & AVFMT_NOFILE))
+    {
         /* Close the output file. */
         avio_closep(&format_context_->pb);
-
-    if (format_context_->url != nullptr)
-    {
-        free(format_context_->url);
-        format_context_->url = nullptr;
     }
-    /* free the stream */
+
+    /* free the stream, this also frees the url. */
     avformat_free_context(format_context_);
+
+    if (config_.live)
+        avformat_network_deinit();
 }
 
 void av_muxer::open()
 {
+    if (video_streams_.empty())
+        throw std::runtime_error("av_muxer: at least one video track is required");
+
+    /* the segmenter only copies a single stream into its segments. */
+    if (config_.segment && video_streams_.size() > 1)
+        throw std::runtime_error("av_muxer: multiple video tracks are not supported in segment mode");
+
+    /* the format options come from the first video codec. */
     av_dict avargs;
-    video_codec_->open(video_track.stream, avargs);
+    for (size_t i = 0; i < video_streams_.size(); ++i)
+    {
+        av_dict track_args;
+        video_streams_[i].codec->open(video_streams_[i].track.stream, i == 0 ? avargs : track_args);
+    }
 
-    // if (output_format_->audio_codec != AV_CODEC_ID_NONE)
-    //{
-    //    add_stream(&audio_st, format_context_, &audio_codec, output_format_->audio_codec);
-    //    have_audio = 1;
-    //    encode_audio = 1;
-    //}
+    if (video_streams_.size() > 1)
+        video_workers_ = std::make_unique<video_encode_workers>(video_streams_.size());
 
+    if (audio_codec_)
+    {
+        /* the segmenter only copies a single stream into its segments. */
+        if (config_.segment)
+            throw std::runtime_error("av_muxer: an audio track is not supported in segment mode");
 
-    /* Now that all the parameters are set, we can open the audio and
-    * video codecs and allocate the necessary encode buffers. */
+        av_dict audio_args;
+        audio_codec_->open(audio_track.stream, audio_args);
 
-    //if (have_audio)
-    //    open_audio(format_context_, audio_codec, &audio_st, opt);
+        /* opus in mp4 is still marked experimental by the mp4 muxer. */
+        if (muxer_type_ == av_muxer_type::mp4 && audio_codec_->get_codec() == audio::codec::opus)
+            avargs["strict"] = "experimental";
+    }
+
+    apply_format_options(avargs);
 
     av_dump_format(format_context_, 0, filename_.c_str(), 1);
 
+    std::time_t t = std::time(nullptr);
+    auto metadata = make_av_dict({
+        {"encoding_tool", metadata_.encoding_tool},
+        {"creation_time", fmt::format("{:%Y-%m-%dT%H:%M:%S}Z", *std::localtime(&t))}
+    });
+
+    /* the extra outputs receive the packets of every mode. */
+    if (!config_.tee.empty())
+    {
+        std::vector<const AVStream *> streams(format_context_->nb_streams);
+        for (unsigned int i = 0; i < format_context_->nb_streams; ++i)
+            streams[i] = format_context_->streams[i];
+
+        for (const auto &sink_config : config_.tee)
+            tee_sinks_.push_back(std::make_unique<av_tee_sink>(sink_config, streams, metadata));
+    }
+
+    /* in segment mode the segmenter opens the output files from the writer thread. */
+    if (config_.segment)
+    {
+        segmenter_ = std::make_unique<av_segmenter>(filename_,
+            av_muxer_type_names.at(static_cast<int>(muxer_type_)), *config_.segment,
+            video_streams_.front().track.stream, avargs, metadata, config_.use_file_io, config_.file_io);
+
+        writer_ = std::make_unique<av_packet_writer>([this](AVPacket *pkt) {
+            return segmenter_->write(pkt);
+        }, config_.writer);
+        return;
+    }
+
+    /* in replay mode the packets are only retained in memory, until they are saved. */
+    if (config_.replay)
+    {
+        std::vector<const AVStream *> streams(format_context_->nb_streams);
+        for (unsigned int i = 0; i < format_context_->nb_streams; ++i)
+            streams[i] = format_context_->streams[i];
+
+        replay_ = std::make_unique<av_replay_buffer>(
+            av_muxer_type_names.at(static_cast<int>(muxer_type_)), *config_.replay,
+            std::move(streams), video_streams_.front().track.stream->index, avargs, metadata, config_.use_file_io,
+            config_.file_io);
+
+        writer_ = std::make_unique<av_packet_writer>([this](AVPacket *pkt) {
+            return replay_->push(pkt);
+        }, config_.writer);
+        return;
+    }
+
     /* open the output file, if needed */
     if (!(output_format_->flags & AVFMT_NOFILE))
     {
-        format_context_->url = ::_strdup(filename_.c_str());
-        if (int ret = avio_open(&format_context_->pb, filename_.c_str(), AVIO_FLAG_WRITE); ret < 0)
+        format_context_->url = av_strdup(filename_.c_str());
+        if (config_.output_fd)
+        {
+            pipe_io_ = std::make_unique<av_pipe_io>(*config_.output_fd);
+            format_context_->pb = pipe_io_->get_context();
+            format_context_->flags |= AVFMT_FLAG_CUSTOM_IO;
+        }
+        else if (config_.live)
+        {
+            /* keep every udp datagram a whole number of ts packets (7 * 188 bytes). */
+            av_dict io_options;
+            if (filename_.rfind("udp://", 0) == 0)
+                io_options["pkt_size"] = 1316;
+
+            if (int ret = avio_open2(&format_context_->pb, filename_.c_str(), AVIO_FLAG_WRITE,
+                nullptr, io_options); ret < 0)
+                throw std::runtime_error(fmt::format("Could not open '{}': {}", filename_,
+                    av_error_to_string(ret)));
+        }
+        else if (config_.use_file_io)
+        {
+            file_io_ = std::make_unique<av_file_io>(filename_, config_.file_io);
+            format_context_->pb = file_io_->get_context();
+            format_context_->flags |= AVFMT_FLAG_CUSTOM_IO;
+        }
+        else if (int ret = avio_open(&format_context_->pb, filename_.c_str(), AVIO_FLAG_WRITE); ret < 0)
+        {
             throw std::runtime_error(fmt::format("Could not open '{}': {}", filename_,
                 av_error_to_string(ret)));
+        }
     }
 
-    std::time_t t = std::time(nullptr);
-    auto metadata = make_av_dict({
-        {"encoding_tool", metadata_.encoding_tool},
-        {"creation_time", fmt::format("{:%Y-%m-%dT%H:%M:%S}Z", *std::localtime(&t))}
-    });
-
     format_context_->metadata = metadata.release();
 
+    if (config_.live)
+    {
+        format_context_->flags |= AVFMT_FLAG_FLUSH_PACKETS;
+        format_context_->flush_packets = 1;
+        format_context_->max_interleave_delta = 0;
+    }
+
     /* Write the stream header, if any. */
     if (int ret = avformat_write_header(format_context_, avargs); ret < 0)
         throw std::runtime_error(fmt::format("Error occurred when opening output file: {}",
             av_error_to_string(ret)));
+
+    if (config_.live)
+    {
+        /* the packets already arrive in encode order, waiting for the other streams to interleave
+         * them only adds latency. */
+        writer_ = std::make_unique<av_packet_writer>([this](AVPacket *pkt) {
+            return av_write_frame(format_context_, pkt);
+        }, config_.writer);
+        return;
+    }
+
+    writer_ = std::make_unique<av_packet_writer>([this](AVPacket *pkt) {
+        return av_interleaved_write_frame(format_context_, pkt);
+    }, config_.writer);
+}
+
+void av_muxer::apply_format_options(av_dict &avargs) const
+{
+    switch (muxer_type_)
+    {
+    case av_muxer_type::mp4:
+        if (config_.fragmented_mp4)
+        {
+            /* the codec might already have set some movflags, a.e. disable_chpl. */
+            std::string movflags = "frag_keyframe+empty_moov+default_base_moof";
+            if (const auto entry = av_dict_get(*static_cast<AVDictionary **>(avargs), "movflags", nullptr, 0); entry != nullptr)
+                movflags = fmt::format("{}+{}", entry->value, movflags);
+            avargs["movflags"] = movflags;
+        }
+        break;
+    case av_muxer_type::mkv:
+        /* a pipe can't seek back to the reserved space. */
+        if (config_.mkv_reserve_index_space > 0 && !config_.output_fd)
+            avargs["reserve_index_space"] = config_.mkv_reserve_index_space;
+        break;
+    default:
+        break;
+    }
 }
 
 void av_muxer::flush()
 {
-    encode_frame(0, nullptr, 0, 0, 0);
+    for (size_t i = 0; i < video_streams_.size(); ++i)
+    {
+        video_streams_[i].codec->push_encode_frame(0, nullptr, 0, 0, 0);
+        write_video_packets(i);
+    }
+
+    if (audio_codec_)
+        write_audio_packets(true);
 }
 
-void av_muxer::encode_frame(timestamp_t timestamp, unsigned char *data, int width, int height, int stride)
+void av_muxer::finish()
 {
-    video_codec_->push_encode_frame(timestamp, data, width, height, stride);
+    /* the encoders can only be flushed once. */
+    if (finished_)
+        return;
+    finished_ = true;
+
+    /* without a writer open() did not succeed, the encoders have nothing to flush. */
+    std::exception_ptr error;
+    if (writer_)
+    {
+        try
+        {
+            flush();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
 
-    AVPacket pkt = {};
-    av_init_packet(&pkt);
+        writer_->stop();
+        const auto stats = writer_->get_stats();
+        _log("av_muxer: wrote {} packets, dropped {}, spilled {}, max queue depth {}, stalled {} times "
+             "for {}us, slowest write {}us\n", stats.packets_written, stats.packets_dropped,
+             stats.packets_spilled, stats.max_queue_depth, stats.stall_count,
+             stats.stall_time.count(), stats.max_write_time.count());
+    }
 
-    const auto time_base = video_codec_->get_time_base();
+    /* the extra outputs drain their own writers, so their stats are final as well. */
+    for (auto &sink : tee_sinks_)
+        sink->close();
 
-    for(bool valid_packet = true; valid_packet;)
+    if (error != nullptr)
+        std::rethrow_exception(error);
+}
+
+void av_muxer::encode_frame(timestamp_t timestamp, unsigned char *data, int width, int height, int stride)
+{
+    if (data == nullptr)
     {
-        if (!video_codec_->pull_encoded_packet(&pkt, &valid_packet))
-            throw std::runtime_error("pull encoded packet failed");
+        flush();
+        return;
+    }
 
-        if (!valid_packet)
-            break;
+    if (!encode_video(0, timestamp, {data, width, height, stride}))
+        return;
 
-        write_frame(time_base, video_track.stream, &pkt);
-        av_packet_unref(&pkt);
-    }
+    write_video_packets(0);
+
+    /* encode the audio captured since the previous frame, the muxer interleaves both tracks. */
+    if (audio_codec_)
+        write_audio_packets(false);
 }
 
-void av_muxer::add_stream(std::unique_ptr<av_video> video_codec)
+void av_muxer::encode_frames(timestamp_t timestamp, const std::vector<av_video_frame> &frames)
 {
-    video_codec_ = std::move(video_codec);
-    const auto codec_context = video_codec_->get_codec_context();
+    const auto count = std::min(frames.size(), video_streams_.size());
+    std::vector<char> encoded(count, 0);
 
-    av_track track = {};
-    track.type = av_track_type::video;
-    track.stream = avformat_new_stream(format_context_, codec_context->codec);
-    if (!track.stream)
-        throw std::runtime_error("Could not allocate stream");
+    if (video_workers_)
+    {
+        video_workers_->run([&](size_t index) {
+            if (index < count)
+                encoded[index] = encode_video(index, timestamp, frames[index]);
+        });
+    }
+    else if (count > 0)
+    {
+        encoded[0] = encode_video(0, timestamp, frames[0]);
+    }
 
-    track.stream->id = format_context_->nb_streams - 1;
-    track.stream->time_base = time_base_;
+    /* the packets are written from this thread in track order, the muxer interleaves them by
+     * their timestamps. */
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (encoded[i])
+            write_video_packets(i);
+    }
 
-    /* Some formats want stream headers to be separate. */
-    if (format_context_->oformat->flags & AVFMT_GLOBALHEADER)
-        codec_context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    if (audio_codec_)
+        write_audio_packets(false);
+}
 
-    video_track = track;
+auto av_muxer::alloc_video_frame(size_t track) const -> AVFrame *
+{
+    return video_streams_.at(track).codec->alloc_frame();
 }
 
-AVFrame *av_muxer::alloc_audio_frame(enum AVSampleFormat sample_fmt, uint64_t channel_layout, int sample_rate,
-                                     int nb_samples)
+void av_muxer::convert_frame(size_t track, const av_video_frame &frame, timestamp_t timestamp,
+    AVFrame *converted) const
 {
-    AVFrame *frame = av_frame_alloc();
-    if (frame == nullptr)
+    video_streams_.at(track).codec->convert_frame(timestamp, frame.data, frame.width, frame.height,
+        frame.stride, converted);
+}
+
+void av_muxer::encode_converted_frames(const std::vector<AVFrame *> &frames)
+{
+    const auto count = std::min(frames.size(), video_streams_.size());
+    std::vector<char> encoded(count, 0);
+
+    if (video_workers_)
     {
-        _log("Error allocating an audio frame\n");
-        exit(1);
+        video_workers_->run([&](size_t index) {
+            if (index < count)
+                encoded[index] = encode_video(index, frames[index]);
+        });
+    }
+    else if (count > 0)
+    {
+        encoded[0] = encode_video(0, frames[0]);
     }
 
-    frame->format = sample_fmt;
-    frame->channel_layout = channel_layout;
-    frame->sample_rate = sample_rate;
-    frame->nb_samples = nb_samples;
-
-    if (nb_samples)
+    for (size_t i = 0; i < count; ++i)
     {
-        if (int ret = av_frame_get_buffer(frame, 0); ret < 0)
-        {
-            _log("Error allocating an audio buffer\n");
-            exit(1);
-        }
+        if (encoded[i])
+            write_video_packets(i);
     }
 
-    return frame;
+    if (audio_codec_)
+        write_audio_packets(false);
 }
 
-void av_muxer::open_audio(AVFormatContext *format_context, AVCodec *codec, av_track *track, AVDictionary *opt_arg)
+void av_muxer::reconfigure_video(size_t track, const av_video_meta &meta)
 {
-    AVCodecContext *c;
-    int nb_samples;
-    int ret;
-    AVDictionary *opt = nullptr;
-
-    c = track->codec_context;
-
-    /* open it */
-    av_dict_copy(&opt, opt_arg, 0);
-    ret = avcodec_open2(c, codec, &opt);
-    av_dict_free(&opt);
-    if (ret < 0)
-    {
-        _log("Could not open audio codec: {}\n", av_error_to_string(ret));
-        exit(1);
-    }
-
-    /* init signal generator */
-    // track->t = 0;
-    // track->tincr = 2 * M_PI * 110.0 / c->sample_rate;
-    /* increment frequency by 110 Hz per second */
-    // track->tincr2 = 2 * M_PI * 110.0 / c->sample_rate / c->sample_rate;
-
-    if (c->codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE)
-        nb_samples = 10000;
-    else
-        nb_samples = c->frame_size;
-
-    // track->frame = alloc_audio_frame(c->sample_fmt, c->channel_layout, c->sample_rate, nb_samples);
-    // track->tmp_frame = alloc_audio_frame(AV_SAMPLE_FMT_S16, c->channel_layout, c->sample_rate, nb_samples);
-
-    /* copy the stream parameters to the muxer */
-    ret = avcodec_parameters_from_context(track->stream->codecpar, c);
-    if (ret < 0)
-    {
-        _log("Could not copy the stream parameters\n");
-        exit(1);
-    }
-
-    /* create resampler context */
-    // track->swr_ctx = swr_alloc();
-    // if (!track->swr_ctx) {
-    //    _log("Could not allocate resampler context\n");
-    //    exit(1);
-    //}
-
-    /* set options */
-    // av_opt_set_int(track->swr_ctx, "in_channel_count", c->channels, 0);
-    // av_opt_set_int(track->swr_ctx, "in_sample_rate", c->sample_rate, 0);
-    // av_opt_set_sample_fmt(track->swr_ctx, "in_sample_fmt", AV_SAMPLE_FMT_S16, 0);
-    // av_opt_set_int(track->swr_ctx, "out_channel_count", c->channels, 0);
-    // av_opt_set_int(track->swr_ctx, "out_sample_rate", c->sample_rate, 0);
-    // av_opt_set_sample_fmt(track->swr_ctx, "out_sample_fmt", c->sample_fmt, 0);
-
-    /* initialize the resampling context */
-    // if ((ret = swr_init(track->swr_ctx)) < 0) {
-    //    _log("Failed to initialize the resampling context\n");
-    //    exit(1);
-    //}
+    auto &video = video_streams_.at(track);
+    video.codec->push_frame(nullptr);
+    write_video_packets(track);
+    video.codec->reconfigure(meta);
 }
 
-int av_muxer::write_audio_frame(av_track *track, AVFrame *frame)
+bool av_muxer::encode_video(size_t index, timestamp_t timestamp, const av_video_frame &frame)
 {
-    assert(false && !"muxing audio frames is not implemented yet");
+    if (frame.data == nullptr || !_accept_timestamp(index, timestamp))
+        return false;
 
-    AVCodecContext *c = nullptr;
-    AVPacket pkt = {}; // data and size must be 0;
-
-    int ret = 0;
-    int got_packet = 0;
-    int dst_nb_samples = 0;
+    video_streams_[index].codec->push_encode_frame(timestamp, frame.data, frame.width, frame.height,
+        frame.stride);
+    return true;
+}
 
-    av_init_packet(&pkt);
-    c = track->codec_context;
+bool av_muxer::encode_video(size_t index, AVFrame *frame)
+{
+    if (frame == nullptr || !_accept_timestamp(index, static_cast<timestamp_t>(frame->pts)))
+        return false;
 
-    if (frame)
-    {
-        /* convert samples from native format to destination codec format, using the resampler */
-        /* compute destination number of samples */
-        // dst_nb_samples = av_rescale_rnd(swr_get_delay(track->swr_ctx, c->sample_rate) + frame->nb_samples,
-        // c->sample_rate, c->sample_rate, AV_ROUND_UP);
-        av_assert0(dst_nb_samples == frame->nb_samples);
+    video_streams_[index].codec->push_frame(frame);
+    return true;
+}
 
-        /* when we pass a frame to the encoder, it may keep a reference to it
-         * internally;
-         * make sure we do not overwrite it here
-         */
-        // ret = av_frame_make_writable(track->frame);
-        //if (ret < 0)
-            //exit(1);
+bool av_muxer::_accept_timestamp(size_t index, timestamp_t timestamp)
+{
+    auto &video = video_streams_[index];
 
-        /* convert to destination format */
-        // ret = swr_convert(track->swr_ctx,
-        //    track->frame->data, dst_nb_samples,
-        //    (const uint8_t **)frame->data, frame->nb_samples);
-        // if (ret < 0) {
-        //    _log("Error while converting\n");
-        //    exit(1);
-        //}
-        // frame = track->frame;
-        //
-        // frame->pts = av_rescale_q(track->samples_count, { 1, c->sample_rate }, c->time_base);
-        // track->samples_count += dst_nb_samples;
-    }
+    /* frames closer together than the stream time base can represent (a.e. 1ms for mkv) would
+     * end up with the same timestamp in the container, which the muxer rejects. */
+    const auto stream_timestamp = av_rescale_q(static_cast<int64_t>(timestamp),
+        video.codec->get_time_base(), video.track.stream->time_base);
 
-    ret = avcodec_encode_audio2(c, &pkt, frame, &got_packet);
-    if (ret < 0)
+    if (video.last_stream_timestamp != AV_NOPTS_VALUE && stream_timestamp <= video.last_stream_timestamp)
     {
-        _log("Error encoding audio frame: {}\n", av_error_to_string(ret));
-        exit(1);
+        _log("av_muxer: skipping frame, timestamp {} collides with the previous frame\n",
+            timestamp);
+        ++skipped_frame_count_;
+        return false;
     }
+    video.last_stream_timestamp = stream_timestamp;
+    return true;
+}
+
+void av_muxer::write_video_packets(size_t index)
+{
+    auto &video = video_streams_[index];
+
+    AVPacket pkt = {};
+    av_init_packet(&pkt);
 
-    if (got_packet)
+    const auto time_base = video.codec->get_time_base();
+
+    for(bool valid_packet = true; valid_packet;)
     {
-        ret = write_frame(c->time_base, track->stream, &pkt);
-        if (ret < 0)
+        if (!video.codec->pull_encoded_packet(&pkt, &valid_packet))
+            throw std::runtime_error("pull encoded packet failed");
+
+        if (!valid_packet)
+            break;
+
+        /* after a reconfigure the new encoder starts its decode timestamps before the last packets
+         * of the old one, keep them increasing in the stream time base. */
+        if (pkt.dts != AV_NOPTS_VALUE)
         {
-            _log("Error while writing audio frame: {}\n", av_error_to_string(ret));
-            exit(1);
+            const auto min_step = av_rescale_q_rnd(1, video.track.stream->time_base, time_base,
+                AV_ROUND_UP);
+            if (video.last_dts != AV_NOPTS_VALUE && pkt.dts < video.last_dts + min_step)
+            {
+                pkt.dts = video.last_dts + min_step;
+
+                /* a frame can not be presented before it is decoded, so it is shown a bit later. */
+                if (pkt.pts != AV_NOPTS_VALUE && pkt.pts < pkt.dts)
+                    pkt.pts = pkt.dts;
+            }
+            video.last_dts = pkt.dts;
         }
+
+        write_frame(time_base, video.track.stream, &pkt);
+        av_packet_unref(&pkt);
+    }
+}
+
+void av_muxer::write_audio_packets(bool flush)
+{
+    audio_codec_->encode_pending(flush);
+
+    AVPacket pkt = {};
+    av_init_packet(&pkt);
+
+    const auto time_base = audio_codec_->get_time_base();
+
+    for (bool valid_packet = true; valid_packet;)
+    {
+        if (!audio_codec_->pull_encoded_packet(&pkt, &valid_packet))
+            throw std::runtime_error("pull encoded audio packet failed");
+
+        if (!valid_packet)
+            break;
+
+        write_frame(time_base, audio_track.stream, &pkt);
+        av_packet_unref(&pkt);
     }
+}
 
-    return (frame || got_packet) ? 0 : 1;
+auto av_muxer::get_skipped_frame_count() const noexcept -> int
+{
+    return skipped_frame_count_;
 }
 
-void av_muxer::close_stream(AVFormatContext *format_context, av_track *ost)
+auto av_muxer::get_writer_stats() const -> av_packet_writer_stats
 {
-    avcodec_free_context(&ost->codec_context);
+    if (!writer_)
+        return {};
+    return writer_->get_stats();
+}
+
+auto av_muxer::get_segments() const -> std::vector<av_segment_info>
+{
+    if (!segmenter_)
+        return {};
+    return segmenter_->get_segments();
+}
+
+auto av_muxer::get_audio_stats() const -> av_audio_stats
+{
+    if (!audio_codec_)
+        return {};
+    return audio_codec_->get_stats();
+}
+
+auto av_muxer::save_replay(std::string filename) -> std::future<void>
+{
+    if (!replay_)
+        throw std::runtime_error("av_muxer: save replay is only available in replay mode");
+    return replay_->save(std::move(filename));
+}
+
+auto av_muxer::get_replay_stats() const -> av_replay_stats
+{
+    if (!replay_)
+        return {};
+    return replay_->get_stats();
+}
+
+auto av_muxer::get_tee_stats() const -> std::vector<av_tee_sink_stats>
+{
+    std::vector<av_tee_sink_stats> stats;
+    for (const auto &sink : tee_sinks_)
+        stats.push_back(sink->get_stats());
+    return stats;
+}
+
+auto av_muxer::get_file_io_stats() const -> av_file_io_stats
+{
+    if (!file_io_)
+        return {};
+    return file_io_->get_stats();
+}
+
+int av_muxer::add_stream(std::unique_ptr<av_video> video_codec)
+{
+    const auto codec_context = video_codec->get_codec_context();
+
+    av_track track = {};
+    track.type = av_track_type::video;
+    track.stream = avformat_new_stream(format_context_, codec_context->codec);
+    if (!track.stream)
+        throw std::runtime_error("Could not allocate stream");
+
+    track.stream->id = format_context_->nb_streams - 1;
+    track.stream->time_base = time_base_;
+    track.codec_context = codec_context;
+
+    /* Some formats want stream headers to be separate. */
+    if (format_context_->oformat->flags & AVFMT_GLOBALHEADER)
+        codec_context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    video_streams_.push_back({std::move(video_codec), track});
+    return static_cast<int>(video_streams_.size()) - 1;
+}
+
+void av_muxer::add_stream(std::unique_ptr<av_audio> audio_codec)
+{
+    audio_codec_ = std::move(audio_codec);
+    const auto codec_context = audio_codec_->get_codec_context();
+
+    av_track track = {};
+    track.type = av_track_type::audio;
+    track.stream = avformat_new_stream(format_context_, codec_context->codec);
+    if (!track.stream)
+        throw std::runtime_error("Could not allocate stream");
+
+    track.stream->id = format_context_->nb_streams - 1;
+    track.stream->time_base = audio_codec_->get_time_base();
+    track.codec_context = codec_context;
+
+    audio_track = track;
 }
 
 int av_muxer::write_frame(const AVRational &time_base, AVStream *stream, AVPacket *pkt)
 {
+    if (!writer_)
+        throw std::runtime_error("av_muxer: unable to write a frame, the muxer is not opened");
+
+    /* every extra output rescales to its own stream time base. */
+    pkt->stream_index = stream->index;
+    for (auto &sink : tee_sinks_)
+        sink->push(pkt, time_base);
+
     /* rescale output packet timestamp values from codec to stream timebase */
     av_packet_rescale_ts(pkt, time_base, stream->time_base);
     pkt->stream_index = stream->index;
@@ -361,8 +821,7 @@ int av_muxer::write_frame(const AVRational &time_base, AVStream *stream, AVPacke
     /* Log packet info */
     //av_log_packet(format_context_, pkt);
 
-    /* Write the compressed frame to the media file. */
-    const auto ret = av_interleaved_write_frame(format_context_, pkt);
-    assert(ret == 0);
-    return ret;
+    /* Queue the compressed frame for the writer thread, which writes it to the media file. */
+    writer_->push(pkt);
+    return 0;
 }
@@ -0,0 +1,193 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "CamEncoder/av_overload_governor.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <stdexcept>
+
+av_overload_governor::av_overload_governor(const av_governor_config &config,
+    const av_video_meta &meta, int fps)
+    : config_(config)
+    , meta_(meta)
+    , fps_(fps)
+{
+    if (config_.overload_load <= config_.headroom_load)
+        throw std::runtime_error("av_overload_governor: the overload load must be above the headroom load");
+}
+
+auto av_overload_governor::add_frame(std::chrono::microseconds timestamp,
+    std::chrono::microseconds busiest_stage_time, std::chrono::microseconds frame_time,
+    bool overrun) -> std::optional<av_governor_event>
+{
+    timestamp_ = timestamp;
+    busy_time_ += busiest_stage_time;
+    frame_time_ += frame_time;
+    if (overrun)
+        ++overrun_count_;
+
+    /* the window is measured in frame time, so it does not depend on the timestamps being regular. */
+    if (frame_time_ < config_.window || frame_time_.count() == 0)
+        return {};
+
+    const auto load = static_cast<double>(busy_time_.count()) / frame_time_.count();
+    const auto overloaded = load > config_.overload_load || overrun_count_ > 0;
+    const auto headroom = load < config_.headroom_load && overrun_count_ == 0;
+
+    busy_time_ = std::chrono::microseconds(0);
+    frame_time_ = std::chrono::microseconds(0);
+    overrun_count_ = 0;
+
+    if (settling_)
+    {
+        settling_ = false;
+        return {};
+    }
+
+    if (overloaded)
+    {
+        recover_count_ = 0;
+        for (const auto step : config_.order)
+        {
+            if (_level(step) < _max_level(step))
+                return _change(step, true, load);
+        }
+        return {};
+    }
+
+    if (!headroom)
+    {
+        recover_count_ = 0;
+        return {};
+    }
+
+    if (++recover_count_ < config_.recover_windows)
+        return {};
+
+    recover_count_ = 0;
+    for (auto step = config_.order.rbegin(); step != config_.order.rend(); ++step)
+    {
+        if (_level(*step) > 0)
+            return _change(*step, false, load);
+    }
+    return {};
+}
+
+auto av_overload_governor::get_level() const noexcept -> const av_governor_level &
+{
+    return level_;
+}
+
+auto av_overload_governor::get_video_meta() const -> av_video_meta
+{
+    return get_video_meta(meta_);
+}
+
+auto av_overload_governor::get_video_meta(const av_video_meta &meta) const -> av_video_meta
+{
+    auto result = meta;
+
+    if (level_.preset > 0)
+    {
+        const auto preset = static_cast<int>(meta.preset.value_or(video::preset::medium));
+        result.preset = static_cast<video::preset>(std::max(preset - level_.preset, 0));
+    }
+
+    if (level_.scale > 0)
+    {
+        /* yuv 420 needs an even size. */
+        const auto scale = config_.scales.at(level_.scale - 1);
+        result.width = std::max(static_cast<int>(meta.width * scale) & ~1, 2);
+        result.height = std::max(static_cast<int>(meta.height * scale) & ~1, 2);
+    }
+
+    result.fps = {get_fps(), 1};
+    return result;
+}
+
+auto av_overload_governor::get_fps() const noexcept -> int
+{
+    if (level_.fps == 0)
+        return fps_;
+
+    return std::max(static_cast<int>(fps_ * config_.fps_factors[level_.fps - 1]), 1);
+}
+
+auto av_overload_governor::_change(av_governor_step step, bool step_down, double load)
+    -> av_governor_event
+{
+    const auto before = _describe(step);
+    _level(step) += step_down ? 1 : -1;
+    settling_ = true;
+
+    av_governor_event event;
+    event.timestamp = timestamp_;
+    event.step = step;
+    event.step_down = step_down;
+    event.load = load;
+    event.level = level_;
+    event.description = fmt::format("{} {} -> {} (load {:.2f})", step_down ? "overloaded" : "headroom",
+        before, _describe(step), load);
+    return event;
+}
+
+auto av_overload_governor::_level(av_governor_step step) noexcept -> int &
+{
+    switch (step)
+    {
+    case av_governor_step::preset: return level_.preset;
+    case av_governor_step::scale: return level_.scale;
+    case av_governor_step::fps: break;
+    }
+    return level_.fps;
+}
+
+auto av_overload_governor::_max_level(av_governor_step step) const noexcept -> int
+{
+    switch (step)
+    {
+    case av_governor_step::preset:
+        /* only x264 can change its preset and size without restarting the stream. */
+        if (meta_.codec != video::codec::x264)
+            return 0;
+        return std::min(config_.max_preset_steps,
+            static_cast<int>(meta_.preset.value_or(video::preset::medium)));
+    case av_governor_step::scale:
+        if (meta_.codec != video::codec::x264)
+            return 0;
+        return static_cast<int>(config_.scales.size());
+    case av_governor_step::fps:
+        break;
+    }
+    return static_cast<int>(config_.fps_factors.size());
+}
+
+auto av_overload_governor::_describe(av_governor_step step) const -> std::string
+{
+    const auto meta = get_video_meta();
+    switch (step)
+    {
+    case av_governor_step::preset:
+        return fmt::format("preset {}",
+            video::preset_names.at(static_cast<int>(meta.preset.value_or(video::preset::medium))));
+    case av_governor_step::scale:
+        return fmt::format("size {}x{}", meta.width, meta.height);
+    case av_governor_step::fps:
+        break;
+    }
+    return fmt::format("{} fps", get_fps());
+}
@@ -0,0 +1,199 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "CamEncoder/av_packet_writer.h"
+#include "CamEncoder/av_error.h"
+#include "av_log.h"
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <stdexcept>
+
+av_packet_writer::av_packet_writer(write_function write, av_packet_writer_config config)
+    : write_(std::move(write))
+    , config_(config)
+{
+    if (config_.queue_size == 0)
+        throw std::runtime_error("av_packet_writer: queue size must be at least 1");
+
+    thread_ = std::thread([this]() { _run(); });
+}
+
+av_packet_writer::~av_packet_writer()
+{
+    stop();
+}
+
+void av_packet_writer::push(AVPacket *pkt)
+{
+    std::unique_lock<std::mutex> lock(lock_);
+
+    if (error_ != 0)
+        throw std::runtime_error(fmt::format("av_packet_writer: writing packet failed: {}",
+            av_error_to_string(error_)));
+
+    if (stopping_)
+        throw std::runtime_error("av_packet_writer: unable to queue packet, writer is stopped");
+
+    if (queue_.size() >= config_.queue_size)
+    {
+        if (_should_drop(pkt))
+        {
+            ++stats_.packets_dropped;
+            return;
+        }
+
+        if (config_.policy == av_packet_queue_policy::spill)
+        {
+            ++stats_.packets_spilled;
+        }
+        else
+        {
+            const auto stall_start = std::chrono::steady_clock::now();
+            packet_written_.wait(lock, [this]() {
+                return queue_.size() < config_.queue_size || error_ != 0;
+            });
+            ++stats_.stall_count;
+            stats_.stall_time += std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - stall_start);
+
+            if (error_ != 0)
+                throw std::runtime_error(fmt::format("av_packet_writer: writing packet failed: {}",
+                    av_error_to_string(error_)));
+        }
+    }
+    else if (_is_dropping(pkt) && _should_drop(pkt))
+    {
+        // a packet that depends on a dropped packet is not decodable either.
+        ++stats_.packets_dropped;
+        return;
+    }
+
+    AVPacket *queued = av_packet_alloc();
+    if (queued == nullptr)
+        throw std::runtime_error("av_packet_writer: unable to allocate packet");
+
+    if (pkt->buf != nullptr)
+    {
+        av_packet_move_ref(queued, pkt);
+    }
+    else if (int ret = av_packet_ref(queued, pkt); ret < 0)
+    {
+        av_packet_free(&queued);
+        throw std::runtime_error(fmt::format("av_packet_writer: unable to reference packet: {}",
+            av_error_to_string(ret)));
+    }
+
+    queue_.push_back(queued);
+    stats_.max_queue_depth = std::max(stats_.max_queue_depth, queue_.size());
+    packet_queued_.notify_one();
+}
+
+void av_packet_writer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        stopping_ = true;
+    }
+    packet_queued_.notify_one();
+
+    if (thread_.joinable())
+        thread_.join();
+}
+
+auto av_packet_writer::get_stats() const -> av_packet_writer_stats
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    auto stats = stats_;
+    stats.queue_depth = queue_.size();
+    return stats;
+}
+
+auto av_packet_writer::get_error() const -> int
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return error_;
+}
+
+void av_packet_writer::_run()
+{
+    for (;;)
+    {
+        AVPacket *pkt = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(lock_);
+            packet_queued_.wait(lock, [this]() { return !queue_.empty() || stopping_; });
+
+            if (queue_.empty())
+                return;
+
+            pkt = queue_.front();
+            queue_.pop_front();
+        }
+        // wake the producer as soon as there is room, not after the (possibly slow) write.
+        packet_written_.notify_one();
+
+        // after a failed write we only drain the queue.
+        int ret = 0;
+        auto write_time = std::chrono::microseconds(0);
+        if (get_error() == 0)
+        {
+            const auto write_start = std::chrono::steady_clock::now();
+            ret = write_(pkt);
+            write_time = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - write_start);
+        }
+        av_packet_free(&pkt);
+
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            if (ret < 0)
+            {
+                _log("av_packet_writer: writing packet failed: {}\n", av_error_to_string(ret));
+                if (error_ == 0)
+                    error_ = ret;
+            }
+            else if (error_ == 0)
+            {
+                ++stats_.packets_written;
+                stats_.max_write_time = std::max(stats_.max_write_time, write_time);
+            }
+        }
+        // a producer blocked on a full queue needs to see the error.
+        if (ret < 0)
+            packet_written_.notify_all();
+    }
+}
+
+bool av_packet_writer::_should_drop(const AVPacket *pkt)
+{
+    if (config_.policy != av_packet_queue_policy::drop_non_key)
+        return false;
+
+    // every packet of the stream up to its next key packet references the dropped one.
+    const auto index = static_cast<size_t>(pkt->stream_index);
+    if (dropping_.size() <= index)
+        dropping_.resize(index + 1, false);
+    dropping_[index] = (pkt->flags & AV_PKT_FLAG_KEY) == 0;
+    return dropping_[index];
+}
+
+bool av_packet_writer::_is_dropping(const AVPacket *pkt) const
+{
+    const auto index = static_cast<size_t>(pkt->stream_index);
+    return index < dropping_.size() && dropping_[index];
+}
@@ -0,0 +1,165 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "CamEncoder/av_pipe_io.h"
+#include "CamEncoder/av_error.h"
+#include "av_log.h"
+
+#include <cerrno>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <csignal>
+#include <ctime>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+// a small buffer, so a live consumer gets the data without much delay.
+constexpr int avio_buffer_size = 32 * 1024;
+
+#if !defined(_WIN32)
+/*!
+ * Write to a pipe without terminating the process when its reader went away. SIGPIPE is blocked on
+ * this thread for the write, and the one the write raised is consumed before it is unblocked.
+ */
+static auto write_without_sigpipe(int fd, const uint8_t *buf, size_t size) -> ssize_t
+{
+    sigset_t sigpipe;
+    sigemptyset(&sigpipe);
+    sigaddset(&sigpipe, SIGPIPE);
+
+    // a SIGPIPE that was already pending is not ours to consume.
+    sigset_t pending;
+    sigpending(&pending);
+    const bool was_pending = sigismember(&pending, SIGPIPE) == 1;
+
+    sigset_t old_mask;
+    pthread_sigmask(SIG_BLOCK, &sigpipe, &old_mask);
+
+    const auto ret = ::write(fd, buf, size);
+    const auto error = errno;
+
+    if (ret < 0 && error == EPIPE && !was_pending)
+    {
+        const timespec no_wait = {0, 0};
+        while (sigtimedwait(&sigpipe, nullptr, &no_wait) == -1 && errno == EINTR)
+            ;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old_mask, nullptr);
+    errno = error;
+    return ret;
+}
+#endif
+
+av_pipe_io::av_pipe_io(int fd)
+    : fd_(fd)
+{
+#if defined(_WIN32)
+    // stdout is opened in text mode, which would translate every \n in the stream.
+    if (_setmode(fd_, _O_BINARY) == -1)
+        throw std::runtime_error("av_pipe_io: invalid file descriptor");
+#endif
+
+    auto avio_buffer = static_cast<unsigned char *>(av_malloc(avio_buffer_size));
+    if (avio_buffer == nullptr)
+        throw std::runtime_error("av_pipe_io: unable to allocate avio buffer");
+
+    context_ = avio_alloc_context(avio_buffer, avio_buffer_size, 1, this, nullptr,
+        &av_pipe_io::_write_packet, nullptr);
+    if (context_ == nullptr)
+    {
+        av_free(avio_buffer);
+        throw std::runtime_error("av_pipe_io: unable to allocate avio context");
+    }
+
+    // without a seek callback the muxers write their streamable variant.
+    context_->seekable = 0;
+}
+
+av_pipe_io::~av_pipe_io()
+{
+    close();
+
+    if (context_ != nullptr)
+    {
+        av_freep(&context_->buffer);
+        avio_context_free(&context_);
+    }
+}
+
+auto av_pipe_io::get_context() const noexcept -> AVIOContext *
+{
+    return context_;
+}
+
+int av_pipe_io::close()
+{
+    if (closed_)
+        return error_;
+    closed_ = true;
+
+    avio_flush(context_);
+
+    if (error_ < 0)
+        _log("av_pipe_io: writing failed: {}\n", av_error_to_string(error_));
+    return error_;
+}
+
+auto av_pipe_io::get_stats() const noexcept -> av_pipe_io_stats
+{
+    return stats_;
+}
+
+int av_pipe_io::_write_packet(void *opaque, uint8_t *buf, int buf_size)
+{
+    auto self = static_cast<av_pipe_io *>(opaque);
+    if (self->error_ < 0)
+        return self->error_;
+
+    // a pipe accepts partial writes, when its reader is slower than the recording.
+    for (int written = 0; written < buf_size;)
+    {
+#if defined(_WIN32)
+        const auto ret = _write(self->fd_, buf + written, buf_size - written);
+        if (ret < 0)
+        {
+            self->error_ = AVERROR(errno);
+            return self->error_;
+        }
+#else
+        const auto ret = write_without_sigpipe(self->fd_, buf + written,
+            static_cast<size_t>(buf_size - written));
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            self->error_ = AVERROR(errno);
+            return self->error_;
+        }
+#endif
+        written += static_cast<int>(ret);
+        ++self->stats_.write_count;
+    }
+
+    self->stats_.bytes_written += buf_size;
+    return buf_size;
+}
@@ -0,0 +1,299 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "CamEncoder/av_replay_buffer.h"
+#include "CamEncoder/av_error.h"
+#include "av_log.h"
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+av_replay_buffer::av_replay_buffer(const char *format_name, av_replay_config config,
+    std::vector<const AVStream *> streams, int key_stream_index, av_dict format_options,
+    av_dict metadata, bool use_file_io, av_file_io_config file_io_config)
+    : format_name_(format_name)
+    , config_(config)
+    , streams_(std::move(streams))
+    , key_stream_index_(key_stream_index)
+    , format_options_(format_options)
+    , metadata_(metadata)
+    , use_file_io_(use_file_io)
+    , file_io_config_(file_io_config)
+{
+    if (config_.duration <= 0.0)
+        throw std::runtime_error("av_replay_buffer: the replay duration must be positive");
+}
+
+av_replay_buffer::~av_replay_buffer()
+{
+    std::lock_guard<std::mutex> lock(save_lock_);
+    for (auto &thread : save_threads_)
+        thread.join();
+
+    for (auto pkt : packets_)
+        av_packet_free(&pkt);
+}
+
+int av_replay_buffer::push(AVPacket *pkt)
+{
+    auto retained = av_packet_alloc();
+    if (retained == nullptr)
+        return AVERROR(ENOMEM);
+
+    // makes the packet data reference counted when it is not yet.
+    if (const auto ret = av_packet_ref(retained, pkt); ret < 0)
+    {
+        av_packet_free(&retained);
+        return ret;
+    }
+    av_packet_unref(pkt);
+
+    std::lock_guard<std::mutex> lock(lock_);
+
+    if (retained->stream_index == key_stream_index_)
+    {
+        const auto time = retained->pts * av_q2d(streams_[key_stream_index_]->time_base);
+        if (retained->flags & AV_PKT_FLAG_KEY)
+            keyframes_.push_back({first_sequence_ + packets_.size(), time});
+        last_time_ = std::max(last_time_, time);
+    }
+
+    memory_ += retained->size;
+    packets_.push_back(retained);
+
+    _prune();
+    return 0;
+}
+
+auto av_replay_buffer::save(std::string filename) -> std::future<void>
+{
+    std::vector<AVPacket *> packets;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (keyframes_.empty())
+            throw std::runtime_error("av_replay_buffer: there is nothing to save yet");
+
+        // the window starts at the first keyframe, only references to the packet data are copied.
+        const auto first = static_cast<size_t>(keyframes_.front().sequence - first_sequence_);
+        packets.reserve(packets_.size() - first);
+        for (auto i = first; i < packets_.size(); ++i)
+        {
+            auto pkt = av_packet_clone(packets_[i]);
+            if (pkt == nullptr)
+            {
+                for (auto cloned : packets)
+                    av_packet_free(&cloned);
+                throw std::runtime_error("av_replay_buffer: unable to reference the packets");
+            }
+            packets.push_back(pkt);
+        }
+        ++saves_;
+    }
+
+    auto promise = std::make_shared<std::promise<void>>();
+    auto result = promise->get_future();
+
+    std::lock_guard<std::mutex> lock(save_lock_);
+    save_threads_.emplace_back([this, promise, filename = std::move(filename),
+        packets = std::move(packets)]() mutable {
+        try
+        {
+            _write(filename, std::move(packets));
+            promise->set_value();
+        }
+        catch (...)
+        {
+            promise->set_exception(std::current_exception());
+        }
+    });
+    return result;
+}
+
+auto av_replay_buffer::get_stats() const -> av_replay_stats
+{
+    std::lock_guard<std::mutex> lock(lock_);
+
+    av_replay_stats stats;
+    if (!keyframes_.empty())
+        stats.duration = last_time_ - keyframes_.front().time;
+    stats.memory = memory_;
+    stats.packet_count = packets_.size();
+    stats.keyframe_count = keyframes_.size();
+    stats.packets_pruned = packets_pruned_;
+    stats.saves = saves_;
+    return stats;
+}
+
+void av_replay_buffer::_prune()
+{
+    // drop the oldest gop for as long as the rest still covers the duration, or uses too much
+    // memory. The window always starts at a keyframe, so it is decodable on its own.
+    while (keyframes_.size() >= 2)
+    {
+        const auto without_front = last_time_ - keyframes_[1].time;
+        if (without_front < config_.duration && memory_ <= config_.memory_limit)
+            break;
+
+        // drop the packets right away, so the memory check of the next gop sees the freed memory.
+        _drop_front(keyframes_[1].sequence);
+        keyframes_.pop_front();
+    }
+
+    // packets in front of the first keyframe (a.e. audio) are never saved.
+    if (!keyframes_.empty())
+        _drop_front(keyframes_.front().sequence);
+}
+
+void av_replay_buffer::_drop_front(uint64_t sequence)
+{
+    while (first_sequence_ < sequence)
+    {
+        auto pkt = packets_.front();
+        memory_ -= pkt->size;
+        av_packet_free(&pkt);
+        packets_.pop_front();
+        ++first_sequence_;
+        ++packets_pruned_;
+    }
+}
+
+void av_replay_buffer::_write(const std::string &filename, std::vector<AVPacket *> packets) const
+{
+    // frees the packets that are not written, also when writing fails.
+    auto free_packets = [&packets](size_t from) {
+        for (auto i = from; i < packets.size(); ++i)
+            av_packet_free(&packets[i]);
+    };
+
+    AVFormatContext *context = nullptr;
+    if (const auto ret = avformat_alloc_output_context2(&context, nullptr, format_name_,
+        filename.c_str()); ret < 0)
+    {
+        free_packets(0);
+        throw std::runtime_error(fmt::format("av_replay_buffer: unable to create output context: {}",
+            av_error_to_string(ret)));
+    }
+
+    std::unique_ptr<av_file_io> file_io;
+    size_t written = 0;
+
+    try
+    {
+        for (const auto stream : streams_)
+        {
+            AVStream *output_stream = avformat_new_stream(context, nullptr);
+            if (output_stream == nullptr)
+                throw std::runtime_error("av_replay_buffer: unable to allocate stream");
+
+            if (const auto ret = avcodec_parameters_copy(output_stream->codecpar, stream->codecpar); ret < 0)
+                throw std::runtime_error(fmt::format("av_replay_buffer: unable to copy codec parameters: {}",
+                    av_error_to_string(ret)));
+            output_stream->time_base = stream->time_base;
+        }
+
+        if (use_file_io_)
+        {
+            file_io = std::make_unique<av_file_io>(filename, file_io_config_);
+            context->pb = file_io->get_context();
+            context->flags |= AVFMT_FLAG_CUSTOM_IO;
+        }
+        else if (const auto ret = avio_open(&context->pb, filename.c_str(), AVIO_FLAG_WRITE); ret < 0)
+        {
+            throw std::runtime_error(fmt::format("av_replay_buffer: unable to open '{}': {}",
+                filename, av_error_to_string(ret)));
+        }
+
+        av_dict metadata = metadata_;
+        context->metadata = metadata.release();
+
+        av_dict options = format_options_;
+        if (const auto ret = avformat_write_header(context, options); ret < 0)
+            throw std::runtime_error(fmt::format("av_replay_buffer: unable to write header: {}",
+                av_error_to_string(ret)));
+
+        // the saved file starts at 0.
+        int64_t start = std::numeric_limits<int64_t>::max();
+        for (const auto pkt : packets)
+        {
+            const auto dts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+            start = std::min(start, av_rescale_q(dts, streams_[pkt->stream_index]->time_base,
+                AV_TIME_BASE_Q));
+        }
+
+        for (; written < packets.size(); ++written)
+        {
+            auto pkt = packets[written];
+            const auto time_base = streams_[pkt->stream_index]->time_base;
+            const auto offset = av_rescale_q(start, AV_TIME_BASE_Q, time_base);
+            if (pkt->pts != AV_NOPTS_VALUE)
+                pkt->pts -= offset;
+            if (pkt->dts != AV_NOPTS_VALUE)
+                pkt->dts -= offset;
+
+            av_packet_rescale_ts(pkt, time_base, context->streams[pkt->stream_index]->time_base);
+
+            const auto ret = av_interleaved_write_frame(context, pkt);
+            av_packet_free(&packets[written]);
+            if (ret < 0)
+            {
+                ++written;
+                throw std::runtime_error(fmt::format("av_replay_buffer: unable to write packet: {}",
+                    av_error_to_string(ret)));
+            }
+        }
+
+        if (const auto ret = av_write_trailer(context); ret < 0)
+            throw std::runtime_error(fmt::format("av_replay_buffer: unable to write trailer: {}",
+                av_error_to_string(ret)));
+    }
+    catch (...)
+    {
+        free_packets(written);
+        if (file_io)
+        {
+            file_io->close();
+            context->pb = nullptr;
+        }
+        else
+        {
+            avio_closep(&context->pb);
+        }
+        avformat_free_context(context);
+        throw;
+    }
+
+    int ret = 0;
+    if (file_io)
+    {
+        ret = file_io->close();
+        context->pb = nullptr;
+    }
+    else
+    {
+        avio_closep(&context->pb);
+    }
+    avformat_free_context(context);
+
+    if (ret < 0)
+        throw std::runtime_error(fmt::format("av_replay_buffer: unable to close '{}': {}",
+            filename, av_error_to_string(ret)));
+
+    _log("av_replay_buffer: saved {} packets to '{}'\n", packets.size(), filename);
+}
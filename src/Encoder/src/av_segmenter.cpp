@@ -0,0 +1,518 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "CamEncoder/av_segmenter.h"
+#include "CamEncoder/av_error.h"
+#include "av_log.h"
+
+#include <fmt/format.h>
+#include <fmt/time.h>
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+struct av_segmenter::segment_file
+{
+    ~segment_file()
+    {
+        close();
+    }
+
+    int close()
+    {
+        if (pb == nullptr)
+            return 0;
+
+        int ret = 0;
+        avio_flush(pb);
+        if (file_io)
+        {
+            ret = file_io->close();
+            pb = nullptr;
+        }
+        else
+        {
+            avio_closep(&pb);
+        }
+        return ret;
+    }
+
+    AVIOContext *pb{nullptr};
+    std::unique_ptr<av_file_io> file_io{};
+    av_segment_info info{};
+    int64_t start_pts{0};
+};
+
+av_segmenter::av_segmenter(std::string filename, const char *format_name, av_segment_config config,
+    const AVStream *stream, av_dict format_options, av_dict metadata, bool use_file_io,
+    av_file_io_config file_io_config)
+    : filename_(std::move(filename))
+    , format_name_(format_name)
+    , config_(config)
+    , stream_(stream)
+    , format_options_(format_options)
+    , metadata_(metadata)
+    , use_file_io_(use_file_io)
+    , file_io_config_(file_io_config)
+    , continuous_(config.playlist != av_playlist_type::none)
+{
+    if (config_.duration <= 0.0 && config_.size <= 0)
+        throw std::runtime_error("av_segmenter: either a segment duration or size is required");
+}
+
+av_segmenter::~av_segmenter()
+{
+    close();
+
+    // only when opening a segment failed, otherwise close released the context.
+    if (context_ != nullptr)
+    {
+        context_->pb = nullptr;
+        avformat_free_context(context_);
+    }
+}
+
+auto av_segmenter::make_segment_filename(const std::string &filename, int index) -> std::string
+{
+    const auto path = std::filesystem::u8path(filename);
+    auto segment_path = path;
+    segment_path.replace_filename(fmt::format("{}_{:05}{}", path.stem().u8string(), index,
+        path.extension().u8string()));
+    return segment_path.u8string();
+}
+
+int av_segmenter::write(AVPacket *pkt)
+{
+    if (closed_)
+        return AVERROR(EINVAL);
+
+    try
+    {
+        if (file_ == nullptr)
+        {
+            _open_segment(pkt->pts);
+        }
+        else if (_should_rotate(pkt))
+        {
+            if (const auto ret = _close_segment(pkt->pts); ret < 0)
+                return ret;
+            _open_segment(pkt->pts);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        _log("av_segmenter: {}\n", e.what());
+        file_.reset();
+        if (context_ != nullptr)
+            context_->pb = nullptr;
+        return AVERROR(EIO);
+    }
+
+    last_duration_ = pkt->duration;
+    if (last_pts_ != AV_NOPTS_VALUE && pkt->pts > last_pts_ && last_duration_ == 0)
+        last_duration_ = pkt->pts - last_pts_;
+    last_pts_ = pkt->pts;
+
+    auto stream = context_->streams[0];
+    av_packet_rescale_ts(pkt, stream_->time_base, stream->time_base);
+    pkt->stream_index = stream->index;
+    return av_interleaved_write_frame(context_, pkt);
+}
+
+void av_segmenter::close()
+{
+    if (closed_)
+        return;
+    closed_ = true;
+
+    if (file_ != nullptr)
+        _close_segment(last_pts_ + last_duration_);
+
+    if (config_.playlist != av_playlist_type::none)
+        _write_playlist(true);
+}
+
+auto av_segmenter::get_segments() const -> std::vector<av_segment_info>
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return segments_;
+}
+
+auto av_segmenter::get_playlist_filename() const -> std::string
+{
+    auto path = std::filesystem::u8path(filename_);
+    switch (config_.playlist)
+    {
+    case av_playlist_type::hls:
+        path.replace_extension(".m3u8");
+        break;
+    case av_playlist_type::dash:
+        path.replace_extension(".mpd");
+        break;
+    default:
+        return {};
+    }
+    return path.u8string();
+}
+
+bool av_segmenter::_should_rotate(const AVPacket *pkt) const
+{
+    // only a keyframe can start a segment that plays on its own.
+    if ((pkt->flags & AV_PKT_FLAG_KEY) == 0)
+        return false;
+
+    if (config_.duration > 0.0)
+    {
+        const auto elapsed = (pkt->pts - file_->start_pts) * av_q2d(stream_->time_base);
+        if (elapsed >= config_.duration)
+            return true;
+    }
+
+    if (config_.size > 0 && avio_tell(file_->pb) >= config_.size)
+        return true;
+
+    return false;
+}
+
+void av_segmenter::_open_segment(int64_t start_pts)
+{
+    auto file = std::make_unique<segment_file>();
+    file->start_pts = start_pts;
+    file->info.filename = make_segment_filename(filename_, static_cast<int>(segments_.size()));
+    file->info.start_time = start_pts * av_q2d(stream_->time_base);
+
+    if (use_file_io_)
+    {
+        file->file_io = std::make_unique<av_file_io>(file->info.filename, file_io_config_);
+        file->pb = file->file_io->get_context();
+    }
+    else if (const auto ret = avio_open(&file->pb, file->info.filename.c_str(), AVIO_FLAG_WRITE); ret < 0)
+    {
+        throw std::runtime_error(fmt::format("unable to open '{}': {}", file->info.filename,
+            av_error_to_string(ret)));
+    }
+
+    file_ = std::move(file);
+
+    /* a continuous muxer only writes its header into the first segment. */
+    if (context_ != nullptr)
+    {
+        context_->pb = file_->pb;
+    }
+    else
+    {
+        _open_context();
+
+        // with an empty moov the header is the initialization section of the segment.
+        avio_flush(file_->pb);
+        file_->info.init_size = avio_tell(file_->pb);
+    }
+
+    _log("av_segmenter: started segment '{}'\n", file_->info.filename);
+}
+
+int av_segmenter::_close_segment(int64_t end_pts)
+{
+    int ret = 0;
+    if (continuous_)
+    {
+        /* finish the fragment, so the segment ends with a complete moof/mdat pair. The interleaving
+         * queue is flushed first, so all packets of the segment are part of the fragment. */
+        ret = av_interleaved_write_frame(context_, nullptr);
+        if (const auto flush_ret = av_write_frame(context_, nullptr); ret >= 0)
+            ret = flush_ret;
+        if (ret < 0)
+            _log("av_segmenter: unable to finish segment fragment: {}\n", av_error_to_string(ret));
+        ret = 0;
+    }
+    else
+    {
+        ret = _close_context();
+    }
+
+    avio_flush(file_->pb);
+    file_->info.size = avio_tell(file_->pb);
+    file_->info.duration = (end_pts - file_->start_pts) * av_q2d(stream_->time_base);
+
+    /* the trailer of a continuous muxer only holds the fragment index, it is not part of the media
+     * of the last segment. */
+    if (continuous_ && closed_)
+        ret = _close_context();
+
+    if (const auto close_ret = file_->close(); ret == 0)
+        ret = close_ret;
+
+    if (context_ != nullptr)
+        context_->pb = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        segments_.push_back(file_->info);
+    }
+    file_.reset();
+
+    if (config_.playlist != av_playlist_type::none && !closed_)
+        _write_playlist(false);
+
+    return ret;
+}
+
+void av_segmenter::_open_context()
+{
+    if (const auto ret = avformat_alloc_output_context2(&context_, nullptr, format_name_,
+        file_->info.filename.c_str()); ret < 0)
+        throw std::runtime_error(fmt::format("unable to create segment output context: {}",
+            av_error_to_string(ret)));
+
+    try
+    {
+        _init_context();
+    }
+    catch (...)
+    {
+        // a context without a header can not be continued by the next segment.
+        context_->pb = nullptr;
+        avformat_free_context(context_);
+        context_ = nullptr;
+        throw;
+    }
+}
+
+void av_segmenter::_init_context()
+{
+    AVStream *stream = avformat_new_stream(context_, nullptr);
+    if (stream == nullptr)
+        throw std::runtime_error("unable to allocate segment stream");
+
+    if (const auto ret = avcodec_parameters_copy(stream->codecpar, stream_->codecpar); ret < 0)
+        throw std::runtime_error(fmt::format("unable to copy segment codec parameters: {}",
+            av_error_to_string(ret)));
+    stream->time_base = stream_->time_base;
+
+    context_->pb = file_->pb;
+    context_->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+    av_dict metadata = metadata_;
+    context_->metadata = metadata.release();
+
+    av_dict options = format_options_;
+    if (const auto ret = avformat_write_header(context_, options); ret < 0)
+        throw std::runtime_error(fmt::format("unable to write segment header: {}",
+            av_error_to_string(ret)));
+}
+
+int av_segmenter::_close_context()
+{
+    const auto ret = av_write_trailer(context_);
+    if (ret < 0)
+        _log("av_segmenter: unable to write segment trailer: {}\n", av_error_to_string(ret));
+
+    // the file is closed by its segment_file.
+    context_->pb = nullptr;
+    avformat_free_context(context_);
+    context_ = nullptr;
+    return ret;
+}
+
+void av_segmenter::_write_playlist(bool finished) const
+{
+    std::string playlist;
+    switch (config_.playlist)
+    {
+    case av_playlist_type::hls:
+        _write_hls_playlist(playlist, finished);
+        break;
+    case av_playlist_type::dash:
+        _write_dash_playlist(playlist, finished);
+        break;
+    default:
+        return;
+    }
+
+    // replace the playlist in one go, so a reader never sees a partial playlist.
+    const auto playlist_filename = std::filesystem::u8path(get_playlist_filename());
+    auto temp_filename = playlist_filename;
+    temp_filename += ".tmp";
+    {
+        std::ofstream file(temp_filename, std::ios::binary | std::ios::trunc);
+        file << playlist;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_filename, playlist_filename, error);
+    if (error)
+        _log("av_segmenter: unable to update playlist: {}\n", error.message());
+}
+
+/*!
+ * The segments are the fragments of one continuous mp4. The ftyp/moov at the start of the first
+ * segment is the initialization section, the media of each segment is addressed with a byte range.
+ */
+void av_segmenter::_write_hls_playlist(std::string &playlist, bool finished) const
+{
+    const auto segments = get_segments();
+
+    double target_duration = 1.0;
+    for (const auto &segment : segments)
+        target_duration = std::max(target_duration, segment.duration);
+
+    playlist += "#EXTM3U\n";
+    playlist += "#EXT-X-VERSION:7\n";
+    playlist += fmt::format("#EXT-X-TARGETDURATION:{}\n", static_cast<int>(std::ceil(target_duration)));
+    playlist += "#EXT-X-MEDIA-SEQUENCE:0\n";
+    playlist += "#EXT-X-PLAYLIST-TYPE:EVENT\n";
+    playlist += "#EXT-X-INDEPENDENT-SEGMENTS\n";
+
+    if (!segments.empty())
+    {
+        const auto &first = segments.front();
+        playlist += fmt::format("#EXT-X-MAP:URI=\"{}\",BYTERANGE=\"{}@0\"\n",
+            std::filesystem::u8path(first.filename).filename().u8string(), first.init_size);
+    }
+
+    for (const auto &segment : segments)
+    {
+        playlist += fmt::format("#EXTINF:{:.6f},\n", segment.duration);
+        playlist += fmt::format("#EXT-X-BYTERANGE:{}@{}\n", segment.size - segment.init_size,
+            segment.init_size);
+        playlist += std::filesystem::u8path(segment.filename).filename().u8string();
+        playlist += "\n";
+    }
+
+    if (finished)
+        playlist += "#EXT-X-ENDLIST\n";
+}
+
+/*!
+ * The codecs attribute of the dash representation (RFC 6381), players pick their decoder with it.
+ * The h264 profile, constraint flags and level come from the sps in the extradata, which is an
+ * avcC record or annex b.
+ */
+static auto get_dash_codecs(const AVCodecParameters *codecpar) -> std::string
+{
+    const auto extradata = codecpar->extradata;
+    const auto size = codecpar->extradata_size;
+    switch (codecpar->codec_id)
+    {
+    case AV_CODEC_ID_H264:
+    {
+        if (size >= 4 && extradata[0] == 1)
+            return fmt::format("avc1.{:02x}{:02x}{:02x}", extradata[1], extradata[2], extradata[3]);
+
+        for (int i = 0; i + 6 < size; ++i)
+        {
+            if (extradata[i] == 0 && extradata[i + 1] == 0 && extradata[i + 2] == 1
+                && (extradata[i + 3] & 0x1f) == 7)
+                return fmt::format("avc1.{:02x}{:02x}{:02x}", extradata[i + 4], extradata[i + 5],
+                    extradata[i + 6]);
+        }
+
+        const auto constraint = (codecpar->profile & FF_PROFILE_H264_CONSTRAINED) ? 0x40 : 0;
+        return fmt::format("avc1.{:02x}{:02x}{:02x}", codecpar->profile & 0xff, constraint,
+            std::max(codecpar->level, 0));
+    }
+    case AV_CODEC_ID_AV1:
+    {
+        // the av1C record: profile and level in the second byte, tier and bit depth in the third.
+        if (size < 4)
+            return "av01";
+
+        const auto profile = extradata[1] >> 5;
+        const auto level = extradata[1] & 0x1f;
+        const auto tier = (extradata[2] & 0x80) ? 'H' : 'M';
+        const auto bit_depth = (extradata[2] & 0x40) ? ((extradata[2] & 0x20) ? 12 : 10) : 8;
+        return fmt::format("av01.{}.{:02}{}.{:02}", profile, level, tier, bit_depth);
+    }
+    default:
+        return avcodec_get_name(codecpar->codec_id);
+    }
+}
+
+void av_segmenter::_write_dash_playlist(std::string &playlist, bool finished) const
+{
+    const auto segments = get_segments();
+
+    double total_duration = 0.0;
+    double max_duration = 1.0;
+    for (const auto &segment : segments)
+    {
+        total_duration += segment.duration;
+        max_duration = std::max(max_duration, segment.duration);
+    }
+
+    const auto t = std::time(nullptr);
+    const auto now = fmt::format("{:%Y-%m-%dT%H:%M:%S}Z", *std::gmtime(&t));
+    const auto codecpar = stream_->codecpar;
+
+    playlist += "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+    if (finished)
+    {
+        playlist += fmt::format("<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" "
+            "profiles=\"urn:mpeg:dash:profile:isoff-main:2011\" type=\"static\" "
+            "mediaPresentationDuration=\"PT{:.3f}S\" minBufferTime=\"PT{:.3f}S\">\n",
+            total_duration, max_duration);
+    }
+    else
+    {
+        playlist += fmt::format("<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" "
+            "profiles=\"urn:mpeg:dash:profile:isoff-main:2011\" type=\"dynamic\" "
+            "availabilityStartTime=\"{}\" publishTime=\"{}\" minimumUpdatePeriod=\"PT{:.3f}S\" "
+            "minBufferTime=\"PT{:.3f}S\">\n", now, now, max_duration, max_duration);
+    }
+
+    playlist += "  <Period id=\"0\" start=\"PT0S\">\n";
+    playlist += "    <AdaptationSet contentType=\"video\" mimeType=\"video/mp4\" segmentAlignment=\"true\">\n";
+    playlist += fmt::format("      <Representation id=\"0\" codecs=\"{}\" width=\"{}\" height=\"{}\" "
+        "bandwidth=\"{}\">\n", get_dash_codecs(codecpar), codecpar->width, codecpar->height,
+        std::max<int64_t>(codecpar->bit_rate, 1));
+
+    if (!segments.empty())
+    {
+        const auto timescale = stream_->time_base.den;
+        playlist += fmt::format("        <SegmentList timescale=\"{}\">\n", timescale);
+
+        const auto &first = segments.front();
+        playlist += fmt::format("          <Initialization sourceURL=\"{}\" range=\"0-{}\"/>\n",
+            std::filesystem::u8path(first.filename).filename().u8string(), first.init_size - 1);
+
+        // the segments differ in length, as they can only start at a keyframe.
+        playlist += "          <SegmentTimeline>\n";
+        for (const auto &segment : segments)
+        {
+            playlist += fmt::format("            <S t=\"{}\" d=\"{}\"/>\n",
+                std::llround((segment.start_time - first.start_time) * timescale),
+                std::llround(segment.duration * timescale));
+        }
+        playlist += "          </SegmentTimeline>\n";
+
+        for (const auto &segment : segments)
+        {
+            playlist += fmt::format("          <SegmentURL media=\"{}\" mediaRange=\"{}-{}\"/>\n",
+                std::filesystem::u8path(segment.filename).filename().u8string(), segment.init_size,
+                segment.size - 1);
+        }
+        playlist += "        </SegmentList>\n";
+    }
+
+    playlist += "      </Representation>\n";
+    playlist += "    </AdaptationSet>\n";
+    playlist += "  </Period>\n";
+    playlist += "</MPD>\n";
+}
@@ -0,0 +1,238 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "CamEncoder/av_tee_sink.h"
+#include "CamEncoder/av_error.h"
+#include "av_log.h"
+
+#include <fmt/format.h>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+av_tee_sink::av_tee_sink(av_tee_sink_config config, const std::vector<const AVStream *> &streams,
+    av_dict metadata)
+    : config_(std::move(config))
+{
+    try
+    {
+        _create(streams, metadata);
+    }
+    catch (const std::exception &e)
+    {
+        _log("av_tee_sink: {}\n", e.what());
+        _fail(AVERROR(EIO), "unable to create");
+    }
+}
+
+av_tee_sink::~av_tee_sink()
+{
+    close();
+}
+
+void av_tee_sink::push(const AVPacket *pkt, AVRational time_base)
+{
+    if (failed_ || writer_ == nullptr)
+    {
+        ++packets_lost_;
+        return;
+    }
+
+    AVPacket queued = {};
+    av_init_packet(&queued);
+    if (const auto ret = av_packet_ref(&queued, pkt); ret < 0)
+    {
+        _fail(ret, "unable to reference packet");
+        return;
+    }
+
+    // the header can still change the stream time base, the writer rescales once it is written.
+    av_packet_rescale_ts(&queued, time_base, queue_time_bases_[pkt->stream_index]);
+
+    try
+    {
+        writer_->push(&queued);
+    }
+    catch (const std::exception &e)
+    {
+        _log("av_tee_sink: {}\n", e.what());
+        if (!failed_)
+            _fail(writer_->get_error(), "write failed");
+        ++packets_lost_;
+    }
+    av_packet_unref(&queued);
+}
+
+void av_tee_sink::close()
+{
+    if (context_ == nullptr)
+        return;
+
+    if (writer_)
+    {
+        writer_->stop();
+        if (!failed_ && writer_->get_error() != 0)
+            _fail(writer_->get_error(), "write failed");
+    }
+
+    if (header_written_)
+    {
+        if (const auto ret = av_write_trailer(context_); ret < 0 && !failed_)
+            _fail(ret, "unable to write trailer");
+    }
+
+    if (pipe_io_)
+    {
+        pipe_io_->close();
+        context_->pb = nullptr;
+        pipe_io_.reset();
+    }
+    else if (!(context_->oformat->flags & AVFMT_NOFILE))
+    {
+        avio_closep(&context_->pb);
+    }
+
+#if !defined(_WIN32)
+    // av_pipe_io does not close the file descriptor it writes to.
+    if (fifo_fd_ >= 0)
+        ::close(fifo_fd_);
+    fifo_fd_ = -1;
+#endif
+
+    avformat_free_context(context_);
+    context_ = nullptr;
+}
+
+auto av_tee_sink::get_stats() const -> av_tee_sink_stats
+{
+    av_tee_sink_stats stats;
+    stats.filename = config_.filename;
+    stats.failed = failed_;
+    stats.error = error_;
+    stats.packets_lost = packets_lost_;
+    if (writer_)
+        stats.writer = writer_->get_stats();
+    return stats;
+}
+
+void av_tee_sink::_create(const std::vector<const AVStream *> &streams, av_dict metadata)
+{
+    if (const auto ret = avformat_alloc_output_context2(&context_, nullptr, config_.format.c_str(),
+        config_.filename.c_str()); ret < 0)
+        throw std::runtime_error(fmt::format("unable to create output context for '{}': {}",
+            config_.filename, av_error_to_string(ret)));
+
+    for (const auto stream : streams)
+    {
+        AVStream *output_stream = avformat_new_stream(context_, nullptr);
+        if (output_stream == nullptr)
+            throw std::runtime_error("unable to allocate stream");
+
+        if (const auto ret = avcodec_parameters_copy(output_stream->codecpar, stream->codecpar); ret < 0)
+            throw std::runtime_error(fmt::format("unable to copy codec parameters: {}",
+                av_error_to_string(ret)));
+        output_stream->time_base = stream->time_base;
+        queue_time_bases_.push_back(stream->time_base);
+    }
+
+    context_->metadata = metadata.release();
+
+    // opening the output can block, so the writer thread does that before the first write.
+    writer_ = std::make_unique<av_packet_writer>([this](AVPacket *pkt) {
+        if (!header_written_)
+        {
+            if (const auto ret = _open(); ret < 0)
+                return ret;
+        }
+        av_packet_rescale_ts(pkt, queue_time_bases_[pkt->stream_index],
+            context_->streams[pkt->stream_index]->time_base);
+        return av_interleaved_write_frame(context_, pkt);
+    }, config_.writer);
+}
+
+int av_tee_sink::_open()
+{
+    if (!(context_->oformat->flags & AVFMT_NOFILE))
+    {
+        int ret = _open_fifo();
+        if (ret == 0 && context_->pb == nullptr)
+            ret = avio_open(&context_->pb, config_.filename.c_str(), AVIO_FLAG_WRITE);
+        if (ret < 0)
+        {
+            _fail(ret, "unable to open");
+            return ret;
+        }
+    }
+
+    if (const auto ret = avformat_write_header(context_, nullptr); ret < 0)
+    {
+        _fail(ret, "unable to write header to");
+        return ret;
+    }
+    header_written_ = true;
+
+    _log("av_tee_sink: opened '{}' ({})\n", config_.filename, config_.format);
+    return 0;
+}
+
+/*!
+ * Opening a fifo for writing waits for a reader, possibly forever. So a fifo is opened without
+ * blocking, which fails when there is no reader, and the muxer writes to the opened descriptor.
+ * A reader that goes away fails the sink with EPIPE, av_pipe_io keeps the SIGPIPE of that write
+ * from terminating the process.
+ */
+int av_tee_sink::_open_fifo()
+{
+#if !defined(_WIN32)
+    struct stat status = {};
+    if (stat(config_.filename.c_str(), &status) != 0 || !S_ISFIFO(status.st_mode))
+        return 0;
+
+    fifo_fd_ = ::open(config_.filename.c_str(), O_WRONLY | O_NONBLOCK);
+    if (fifo_fd_ < 0)
+        return AVERROR(errno);
+
+    // only the open should not block, the writes wait for the reader like they do for a file.
+    fcntl(fifo_fd_, F_SETFL, fcntl(fifo_fd_, F_GETFL) & ~O_NONBLOCK);
+    try
+    {
+        pipe_io_ = std::make_unique<av_pipe_io>(fifo_fd_);
+    }
+    catch (const std::exception &e)
+    {
+        _log("av_tee_sink: {}\n", e.what());
+        return AVERROR(ENOMEM);
+    }
+    context_->pb = pipe_io_->get_context();
+    context_->flags |= AVFMT_FLAG_CUSTOM_IO;
+    return 0;
+#else
+    return 0;
+#endif
+}
+
+void av_tee_sink::_fail(int error, const char *what)
+{
+    failed_ = true;
+    error_ = error;
+    _log("av_tee_sink: {} '{}': {}\n", what, config_.filename, av_error_to_string(error));
+}
@@ -18,7 +18,6 @@
 #include "CamEncoder/av_video.h"
 #include "CamEncoder/av_dict.h"
 #include "CamEncoder/av_error.h"
-#include "CamEncoder/av_cam_codec/av_cam_codec.h"
 
 #include "av_log.h"
 
@@ -39,56 +38,6 @@ AVRational truncate_fps(AVRational fps)
     return fps;
 }
 
-/*!
- * calculate a approximate gob size.
- *
- * \note Currently generate a gop that is equal to fps. The practical problem I faced it that you
- * record a 5 second video having a gop of 250 is simply not good enough.
- * This used to be gop = ((num/den) + 0.5) * 10.
- */
-int calculate_gop_size(const av_video_meta &meta)
-{
-    double gob_size = ((static_cast<double>(meta.fps.num) / meta.fps.den) + 0.5);
-    return static_cast<int>(gob_size);
-}
-
-void apply_preset(av_dict &av_opts, std::optional<video::preset> preset)
-{
-    const auto preset_idx = static_cast<int>(preset.value_or(video::preset::medium));
-    const auto preset_name = video::preset_names.at(preset_idx);
-    av_opts["preset"] = preset_name;
-}
-
-void apply_tune(av_dict &av_opts, std::optional<video::tune> preset)
-{
-    if (!preset)
-        return;
-
-    const auto tune_idx = static_cast<int>(preset.value());
-    const auto tune_name = video::tune_names.at(tune_idx);
-    av_opts["tune"] = tune_name;
-}
-
-void apply_profile(av_dict &av_opts, std::optional<video::profile> profile)
-{
-    if (!profile)
-        return;
-
-    const auto profile_idx = static_cast<int>(profile.value());
-    const auto profile_name = video::profile_names.at(profile_idx);
-    av_opts["profile"] = profile_name;
-}
-
-void apply_level(AVCodecContext *condext, std::optional<video::codec_level> level)
-{
-    if (!level)
-        return;
-
-    const auto level_idx = static_cast<int>(level.value());
-    const auto level_value = video::codec_level_values.at(level_idx);
-    condext->level = level_value;
-}
-
 void dump_context(AVCodecContext *context)
 {
     AVCodecParameters * params = avcodec_parameters_alloc();
@@ -111,7 +60,7 @@ void dump_context(AVCodecContext *context)
     params = nullptr;
 }
 
-AVFrame *create_video_frame(AVPixelFormat pix_fmt, int width, int height, bool camstudio_codec)
+AVFrame *create_video_frame(AVPixelFormat pix_fmt, int width, int height, bool packed_frame)
 {
     AVFrame *video_frame = av_frame_alloc();
     if (!video_frame)
@@ -122,8 +71,8 @@ AVFrame *create_video_frame(AVPixelFormat pix_fmt, int width, int height, bool c
     video_frame->height = height;
 
     int align = 0;
-    /* special case the cam studio codec, it needs to have a  tightly packed video frame */
-    if (camstudio_codec)
+    /* special case codecs like cscd, they need to have a tightly packed video frame */
+    if (packed_frame)
         align = 1;
 
     /* allocate the buffers for the frame data */
@@ -162,6 +111,7 @@ void my_av_log_callback(void *avcl, int level, const char *fmt, va_list vl)
 
 
 av_video::av_video(const av_video_codec &config, const av_video_meta &meta)
+    : descriptor_(av_codec_registry::get().find(meta.codec))
 {
     //av_log_set_level(AV_LOG_DEBUG);
     //av_log_set_callback(my_av_log_callback);
@@ -169,27 +119,51 @@ av_video::av_video(const av_video_codec &config, const av_video_meta &meta)
     // truncate_framerate is not used, as its commonly used to handle mpeg2/4 framerate limitations.
     //bool truncate_framerate = false;
 
-    switch (meta.codec)
+    codec_type_ = descriptor_.codec_type;
+    codec_ = descriptor_.find_encoder();
+    if (codec_ == nullptr)
+        throw std::runtime_error("av_video: unable to find video encoder");
+
+    if (!av_codec_registry::get().supports_container(meta.codec, meta.container))
+        throw std::runtime_error(fmt::format("av_video: {} can not be stored in the selected container",
+            descriptor_.name));
+
+    pixel_format_negotiation_ = negotiate_pixel_format(descriptor_, config.pixel_format);
+    input_pixel_format_ = pixel_format_negotiation_.input_pixel_format;
+    output_pixel_format_ = pixel_format_negotiation_.output_pixel_format;
+
+    _log("av_video: {} input {} -> {} (conversion: {}, loss: {})\n", descriptor_.name,
+        input_pixel_format_, output_pixel_format_, pixel_format_negotiation_.conversion_required,
+        pixel_format_negotiation_.loss);
+
+    _create_context(meta);
+
+    frame_width_ = meta.width;
+    frame_height_ = meta.height;
+
+    frame_ = create_video_frame(context_->pix_fmt, context_->width, context_->height,
+        descriptor_.packed_frame);
+
+    if (!pixel_format::get_info(output_pixel_format_).known)
+        throw std::runtime_error("av_video: invalid encoder input format");
+
+    // packed to packed conversions (and flips) are done by our own kernels, the kernel is selected
+    // once here so we don't have to dispatch on the pixel format for every frame.
+    convert_kernel_ = pixel_format::select_convert_kernel(input_pixel_format_, output_pixel_format_,
+        descriptor_.bottom_up);
+
+    // when the encoder accepts our input format, we only need to copy the frame.
+    if (pixel_format_negotiation_.conversion_required && convert_kernel_ == nullptr)
     {
-    case video::codec::camstudio:
-        codec_type_ = av_video_codec_type::cscd;
-        input_pixel_format_ = config.pixel_format;
-        output_pixel_format_ = AV_PIX_FMT_BGR24;
-        codec_ = &cam_codec_encoder;
-        break;
-    case video::codec::x264:
-        codec_type_ = av_video_codec_type::h264;
-        input_pixel_format_ = config.pixel_format;
-        output_pixel_format_ = AV_PIX_FMT_YUV420P;
-        codec_ = avcodec_find_encoder(AV_CODEC_ID_H264);
-        if (codec_ == nullptr)
-            throw std::runtime_error("av_video: unable to find video encoder");
-        break;
-    default:
-        throw std::runtime_error("av_video: unsupported encoder");
-        break;
+        sws_context_ = create_software_scaler(
+            input_pixel_format_, context_->width, context_->height,
+            output_pixel_format_, context_->width, context_->height
+        );
     }
+}
 
+void av_video::_create_context(const av_video_meta &meta)
+{
     context_ = avcodec_alloc_context3(codec_);
 
     auto fps = AVRational{ meta.fps.num, meta.fps.den };
@@ -207,72 +181,23 @@ av_video::av_video(const av_video_codec &config, const av_video_meta &meta)
         }
     }
 
-    // always force variable framerate with ms timestamps.
-    context_->time_base = { 1, 1000 };
-
-    if (codec_type_ != av_video_codec_type::cscd)
-    {
-        // calculate a approximate gob size.
-        context_->gop_size = calculate_gop_size(meta);
+    // always force variable framerate with us timestamps.
+    context_->time_base = timestamp_time_base;
 
-        // either quality of bitrate must be set.
-        assert(!!meta.quality || !!meta.bitrate);
+    // the time base does not tell the encoder anything about the frame rate, so rate control
+    // needs to know the nominal frame rate.
+    context_->framerate = fps;
 
-        apply_preset(av_opts_, meta.preset);
-        apply_tune(av_opts_, meta.tune);
-        apply_profile(av_opts_, meta.profile);
-        apply_level(context_, meta.level);
-
-        switch(meta.container)
-        {
-        case video::container::mp4:
-        {
-            av_opts_["brand"] = "mp42";
-
-            /*
-             * disable_chpl: Disable Nero chapter markers (chpl atom)
-             */
-            av_opts_["movflags"] = "disable_chpl";
-        } break;
-        }
-
-        /*!
-         * set variable framerate.
-         * \see https://superuser.com/questions/908295/ffmpeg-libx264-how-to-specify-a-variable-frame-rate-but-with-a-maximum
-         */
-        //av_opts_["vsync"] = "vfr";
-
-        // Now set the things in context that we don't want to allow
-        // the user to override.
-        if (meta.bitrate)
-        {
-            // Average bitrate
-            context_->bit_rate = static_cast<int64_t>(1000.0 * meta.bitrate.value());
-
-            // ffmpeg's mpeg2 encoder requires that the bit_rate_tolerance be >= bitrate * fps
-            //context_->bit_rate_tolerance = static_cast<int>(context_->bit_rate * av_q2d(fps) + 1);
-        }
-        else
-        {
-            /* Constant quantizer */
-            context_->flags |= AV_CODEC_FLAG_QSCALE;
-
-            /* global_quality only seem to apply to mpeg 1, 2 and 4 */
-            //context_->global_quality =
-            //      static_cast<int>(FF_QP2LAMBDA * meta.quality.value() + 0.5);
-
-            // x264 requires this.
-            av_opts_["crf"] = static_cast<int64_t>(meta.quality.value());
-        }
-    }
-    else
+    // let the encoder decide on the thread count, when it is able to use threads.
+    if (descriptor_.thread_type != 0)
     {
-        av_opts_["algorithm"] = 1; // select lzo compressor
-        av_opts_["gzip_level"] = 9; // gzip compresion level is not used.
-        av_opts_["autokeyframe"] = 1; // enable keyframe insertion every x frames.
-        av_opts_["autokeyframe_rate"] = calculate_gop_size(meta) * 10;
+        context_->thread_count = 0;
+        context_->thread_type = descriptor_.thread_type;
     }
 
+    av_opts_.clear();
+    descriptor_.apply_options(meta, context_, av_opts_);
+
     context_->width = meta.width;
     context_->height = meta.height;
     context_->pix_fmt = output_pixel_format_;
@@ -286,20 +211,15 @@ av_video::av_video(const av_video_codec &config, const av_video_meta &meta)
     //    context->flags |= AV_CODEC_FLAG_GRAY;
 
     context_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
-
-    frame_ = create_video_frame(context_->pix_fmt, context_->width, context_->height,
-        codec_type_ == av_video_codec_type::cscd);
-
-    sws_context_ = create_software_scaler(
-        input_pixel_format_, context_->width, context_->height,
-        output_pixel_format_, context_->width, context_->height
-    );
 }
 
 av_video::~av_video()
 {
     avcodec_free_context(&context_);
     av_frame_free(&frame_);
+    av_frame_free(&resized_frame_);
+    sws_freeContext(sws_context_);
+    sws_freeContext(resize_context_);
 }
 
 void av_video::open(AVStream *stream, av_dict &dict)
@@ -309,22 +229,7 @@ void av_video::open(AVStream *stream, av_dict &dict)
      * entries if it encounters them.
      */
     dict = av_opts_;
-    auto av_opts = av_opts_;
-
-    if (int ret = avcodec_open2(context_, codec_, av_opts); ret < 0)
-        throw std::runtime_error(fmt::format("av_video: unable to open video encoder: {}",
-            av_error_to_string(ret)));
-
-    /* avcodec_open populates the opts dictionary with the things it didn't recognize. */
-    if (!av_opts.empty())
-    {
-        AVDictionaryEntry *t = nullptr;
-        for (int i = 0; i < av_opts.size(); ++i)
-        {
-            t = av_opts.at("", t, AV_DICT_IGNORE_SUFFIX);
-            _log("av_video: unknown avcodec option: {}\n", t->key);
-        }
-    }
+    _open_context();
 
     if (stream != nullptr)
     {
@@ -339,84 +244,126 @@ void av_video::open(AVStream *stream, av_dict &dict)
 void av_video::push_encode_frame(timestamp_t timestamp, unsigned char *data, int width, int height, int stride)
 {
     // also handle encoder flush
-    AVFrame *encode_frame = nullptr;
-    if (data != nullptr)
+    if (data == nullptr)
     {
-        /* when we pass a frame to the encoder, it may keep a reference to it
-         * internally; make sure we do not overwrite it here
-         */
-        if (av_frame_make_writable(frame_) < 0)
-            throw std::runtime_error("Unable to make temp video frame writable");
-
-        const auto src_data = data;
-        const auto src_width = width;
-        const auto src_height = height;
-
-        const auto dst_width = context_->width;
-        const auto dst_height = context_->height;
-        const auto dst_pixel_format = context_->pix_fmt;
-
-        /* \todo fix hard coded src ptr and stride. */
-        uint8_t *src[3] = {const_cast<uint8_t *>(src_data), nullptr, nullptr};
-        int src_stride[3] = {stride, 0, 0};
-
-        /* special case camstudio codec, because it wants its data upside down. */
-        if (codec_type_ == av_video_codec_type::cscd)
-        {
-            src[0] = src[0] + (dst_height * src_stride[0]) - src_stride[0];
-            src_stride[0] = src_stride[0] * -1;
-        }
+        push_frame(nullptr);
+        return;
+    }
 
-        int dst_stride[3] = {0, 0, 0};
+    convert_frame(timestamp, data, width, height, stride, frame_);
+    push_frame(frame_);
+}
 
-        switch(output_pixel_format_)
-        {
-        case AV_PIX_FMT_RGB555LE:
-        case AV_PIX_FMT_BGR24:
-        case AV_PIX_FMT_BGR0:
-        case AV_PIX_FMT_YUV420P:
-        case AV_PIX_FMT_YUV444P:
-            dst_stride[0] = frame_->linesize[0];
-            dst_stride[1] = frame_->linesize[1];
-            dst_stride[2] = frame_->linesize[2];
-            break;
-
-        default:
-            throw std::runtime_error("av_video: invalid encoder input format");
-            break;
-        }
+auto av_video::alloc_frame() const -> AVFrame *
+{
+    return create_video_frame(output_pixel_format_, frame_width_, frame_height_,
+        descriptor_.packed_frame);
+}
+
+void av_video::convert_frame(timestamp_t timestamp, unsigned char *data, int width, int height,
+    int stride, AVFrame *frame) const
+{
+    /* when we pass a frame to the encoder, it may keep a reference to it
+     * internally; make sure we do not overwrite it here
+     */
+    if (av_frame_make_writable(frame) < 0)
+        throw std::runtime_error("Unable to make temp video frame writable");
 
-        //if (output_pixel_format_ != AV_PIX_FMT_YUV420P)
+    const auto src_data = data;
+    const auto src_width = width;
+    const auto src_height = height;
+
+    const auto dst_height = frame->height;
+
+    /* \todo fix hard coded src ptr and stride. */
+    uint8_t *src[4] = {const_cast<uint8_t *>(src_data), nullptr, nullptr, nullptr};
+    int src_stride[4] = {stride, 0, 0, 0};
+
+    if (convert_kernel_ != nullptr)
+    {
+        convert_kernel_(src_data, stride, frame->data[0], frame->linesize[0], src_width,
+            src_height);
+    }
+    else
+    {
+        /* special case codecs like cscd, because they want their data upside down. */
+        if (descriptor_.bottom_up)
         {
-            if (int ret = sws_scale(sws_context_, src, src_stride, 0, src_height, frame_->data, dst_stride); ret < 0)
-                throw std::runtime_error(fmt::format("av_video: sws scale failed: {}", av_error_to_string(ret)));
+            src[0] = src[0] + (dst_height * src_stride[0]) - src_stride[0];
+            src_stride[0] = src_stride[0] * -1;
         }
-#if 0
-        else if (input_pixel_format_ == AV_PIX_FMT_BGRA)
+
+        if (!pixel_format_negotiation_.conversion_required)
         {
-            yuvconvert::bgra_to_420(frame_->data, dst_stride, src, src_width, src_height, src_stride,
-                yuvconvert::simd_mode::ssse3);
+            av_image_copy(frame->data, frame->linesize, const_cast<const uint8_t **>(src),
+                src_stride, output_pixel_format_, src_width, src_height);
         }
         else
         {
-            yuvconvert::bgr_to_420(frame_->data, dst_stride, src, src_width, src_height, src_stride,
-                yuvconvert::simd_mode::ssse3);
+            if (int ret = sws_scale(sws_context_, src, src_stride, 0, src_height, frame->data,
+                frame->linesize); ret < 0)
+                throw std::runtime_error(fmt::format("av_video: sws scale failed: {}",
+                    av_error_to_string(ret)));
         }
-#endif
-
-        frame_->pts = timestamp;
-        encode_frame = frame_;
+    }
+#if 0
+    else if (input_pixel_format_ == AV_PIX_FMT_BGRA)
+    {
+        yuvconvert::bgra_to_420(frame->data, dst_stride, src, src_width, src_height, src_stride,
+            yuvconvert::simd_mode::ssse3);
     }
     else
     {
-        _log("flush encoder\n");
+        yuvconvert::bgr_to_420(frame->data, dst_stride, src, src_width, src_height, src_stride,
+            yuvconvert::simd_mode::ssse3);
     }
+#endif
+
+    frame->pts = timestamp;
+}
 
-    if (int ret = avcodec_send_frame(context_, encode_frame); ret < 0)
+void av_video::push_frame(AVFrame *frame)
+{
+    if (frame == nullptr)
+        _log("flush encoder\n");
+    else if (frame->width != context_->width || frame->height != context_->height)
+        frame = _resize_frame(frame);
+
+    if (int ret = avcodec_send_frame(context_, frame); ret < 0)
         throw std::runtime_error(fmt::format("send video frame to encoder failed: {}",
             av_error_to_string(ret)));
 }
 
+void av_video::reconfigure(const av_video_meta &meta)
+{
+    if (codec_type_ != av_video_codec_type::h264)
+        throw std::runtime_error(fmt::format("av_video: {} can not be reconfigured while recording",
+            descriptor_.name));
+
+    avcodec_free_context(&context_);
+    _create_context(meta);
+
+    /* the stream header holds the parameter sets of the first encoder, so this encoder has to
+     * repeat its own in front of every keyframe. */
+    context_->flags &= ~AV_CODEC_FLAG_GLOBAL_HEADER;
+    _open_context();
+
+    av_frame_free(&resized_frame_);
+    sws_freeContext(resize_context_);
+    resize_context_ = nullptr;
+
+    /* the frames are still converted at the capture size, they are resized to the new size. */
+    if (context_->width != frame_width_ || context_->height != frame_height_)
+    {
+        resize_context_ = create_software_scaler(output_pixel_format_, frame_width_, frame_height_,
+            output_pixel_format_, context_->width, context_->height, SWS_FAST_BILINEAR);
+        resized_frame_ = create_video_frame(context_->pix_fmt, context_->width, context_->height,
+            descriptor_.packed_frame);
+    }
+
+    _log("av_video: reconfigured to {}x{}\n", context_->width, context_->height);
+}
+
 bool av_video::pull_encoded_packet(AVPacket *pkt, bool *valid_packet)
 {
     pkt->data = nullptr;
@@ -441,6 +388,16 @@ av_video_codec_type av_video::get_codec_type() const noexcept
     return codec_type_;
 }
 
+auto av_video::get_codec_descriptor() const noexcept -> const av_codec_descriptor &
+{
+    return descriptor_;
+}
+
+auto av_video::get_pixel_format_negotiation() const noexcept -> const av_pixel_format_negotiation &
+{
+    return pixel_format_negotiation_;
+}
+
 AVCodecContext *av_video::get_codec_context() const noexcept
 {
     return context_;
@@ -452,15 +409,57 @@ AVRational av_video::get_time_base() const noexcept
 }
 
 SwsContext *av_video::create_software_scaler(AVPixelFormat src_pixel_format, int src_width, int src_height,
-                                             AVPixelFormat dst_pixel_format, int dst_width, int dst_height)
+                                             AVPixelFormat dst_pixel_format, int dst_width, int dst_height,
+                                             int flags)
 {
     SwsContext *software_scaler_context = sws_getContext(
         src_width, src_height, src_pixel_format,
         dst_width, dst_height, dst_pixel_format,
-        SWS_BICUBIC, nullptr, nullptr, nullptr);
+        flags, nullptr, nullptr, nullptr);
 
     if (!software_scaler_context)
         throw std::runtime_error("Could not initialize the conversion context");
 
     return software_scaler_context;
 }
+
+void av_video::_open_context()
+{
+    /*!
+     * create a copy of our settings dict as avcodec_open2 clears it and fills it with the invalid
+     * entries if it encounters them.
+     */
+    auto av_opts = av_opts_;
+
+    if (int ret = avcodec_open2(context_, codec_, av_opts); ret < 0)
+        throw std::runtime_error(fmt::format("av_video: unable to open video encoder: {}",
+            av_error_to_string(ret)));
+
+    /* avcodec_open populates the opts dictionary with the things it didn't recognize. */
+    if (!av_opts.empty())
+    {
+        AVDictionaryEntry *t = nullptr;
+        for (int i = 0; i < av_opts.size(); ++i)
+        {
+            t = av_opts.at("", t, AV_DICT_IGNORE_SUFFIX);
+            _log("av_video: unknown avcodec option: {}\n", t->key);
+        }
+    }
+}
+
+auto av_video::_resize_frame(AVFrame *frame) -> AVFrame *
+{
+    if (resize_context_ == nullptr)
+        throw std::runtime_error("av_video: frame size does not match the encoder");
+
+    if (av_frame_make_writable(resized_frame_) < 0)
+        throw std::runtime_error("Unable to make resized video frame writable");
+
+    if (int ret = sws_scale(resize_context_, frame->data, frame->linesize, 0, frame->height,
+        resized_frame_->data, resized_frame_->linesize); ret < 0)
+        throw std::runtime_error(fmt::format("av_video: resizing the frame failed: {}",
+            av_error_to_string(ret)));
+
+    resized_frame_->pts = frame->pts;
+    return resized_frame_;
+}
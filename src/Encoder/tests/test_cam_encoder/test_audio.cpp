@@ -0,0 +1,228 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <CamEncoder/av_muxer.h>
+#include <CamEncoder/av_audio_source.h>
+#include <CamEncoder/av_sample_ring.h>
+#include "test_utilities.h"
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+TEST(test_audio, test_sample_ring_threaded)
+{
+    constexpr uint32_t sample_count = 1000000;
+    av_sample_ring ring(1000, sizeof(uint32_t));
+    EXPECT_EQ(ring.capacity(), 1024u);
+
+    std::thread producer([&ring]() {
+        uint32_t block[100];
+        for (uint32_t value = 0; value < sample_count;)
+        {
+            const auto count = std::min<uint32_t>(100, sample_count - value);
+            for (uint32_t i = 0; i < count; ++i)
+                block[i] = value + i;
+
+            value += static_cast<uint32_t>(ring.write(reinterpret_cast<uint8_t *>(block), count));
+        }
+    });
+
+    // the samples arrive complete and in order, while the positions wrap around the ring.
+    uint32_t expected = 0;
+    uint32_t block[64];
+    while (expected < sample_count)
+    {
+        const auto count = ring.read(reinterpret_cast<uint8_t *>(block), 64);
+        for (size_t i = 0; i < count; ++i)
+            ASSERT_EQ(block[i], expected++);
+    }
+
+    producer.join();
+    EXPECT_EQ(ring.size(), 0u);
+}
+
+TEST(test_audio, test_sample_ring_full)
+{
+    av_sample_ring ring(16, 2);
+    std::vector<uint8_t> data(64, 0);
+    EXPECT_EQ(ring.write(data.data(), 32), 16u);
+    EXPECT_EQ(ring.write(data.data(), 1), 0u);
+    EXPECT_EQ(ring.read(data.data(), 4), 4u);
+    EXPECT_EQ(ring.write(data.data(), 8), 4u);
+}
+
+TEST(test_audio, test_encode_aac)
+{
+    av_audio_codec config;
+    av_audio_meta meta;
+    av_audio audio(config, meta);
+
+    av_dict avargs;
+    audio.open(nullptr, avargs);
+
+    // 1 second of a 440Hz tone, pushed in 10ms blocks.
+    std::vector<int16_t> block(480 * 2);
+    for (int i = 0; i < 100; ++i)
+    {
+        for (size_t j = 0; j < block.size(); j += 2)
+        {
+            const auto t = (i * 480 + j / 2) / 48000.0;
+            block[j] = block[j + 1] = static_cast<int16_t>(8000.0 * std::sin(2.0 * 3.14159265 * 440.0 * t));
+        }
+        EXPECT_EQ(audio.push_samples(i * 10000, reinterpret_cast<uint8_t *>(block.data()), 480), 480);
+    }
+
+    audio.encode_pending(true);
+
+    AVPacket pkt = {};
+    av_init_packet(&pkt);
+    int packet_count = 0;
+    for (bool valid_packet = true; valid_packet;)
+    {
+        ASSERT_TRUE(audio.pull_encoded_packet(&pkt, &valid_packet));
+        if (!valid_packet)
+            break;
+
+        ++packet_count;
+        av_packet_unref(&pkt);
+    }
+
+    // 48000 samples in frames of 1024, plus the encoder delay.
+    EXPECT_GE(packet_count, 47);
+
+    const auto stats = audio.get_stats();
+    EXPECT_EQ(stats.samples_pushed, 48000);
+    EXPECT_EQ(stats.samples_dropped, 0);
+    EXPECT_EQ(stats.samples_encoded, 48000);
+    EXPECT_EQ(stats.max_sync_error, 0);
+}
+
+struct stream_range
+{
+    double start{0.0};
+    double end{0.0};
+    int packet_count{0};
+};
+
+// read back the time range of every stream in a file.
+auto read_stream_ranges(const std::string &filename) -> std::vector<stream_range>
+{
+    AVFormatContext *format_context = nullptr;
+    if (avformat_open_input(&format_context, filename.c_str(), nullptr, nullptr) < 0)
+        throw std::runtime_error("unable to open the recorded file");
+
+    std::vector<stream_range> ranges(format_context->nb_streams);
+
+    AVPacket pkt = {};
+    av_init_packet(&pkt);
+    while (av_read_frame(format_context, &pkt) >= 0)
+    {
+        const auto time_base = av_q2d(format_context->streams[pkt.stream_index]->time_base);
+        auto &range = ranges[pkt.stream_index];
+        if (range.packet_count++ == 0)
+            range.start = pkt.pts * time_base;
+        range.end = std::max(range.end, (pkt.pts + pkt.duration) * time_base);
+        av_packet_unref(&pkt);
+    }
+
+    avformat_close_input(&format_context);
+    return ranges;
+}
+
+void test_av_sync(av_muxer_type muxer_type, audio::codec codec, const std::string &filename)
+{
+    const auto config = create_video_config(video::codec::x264, 64, 64, 25);
+
+    av_audio_codec audio_config;
+    av_audio_meta audio_meta;
+    audio_meta.codec = codec;
+
+#ifdef _WIN32
+    timeBeginPeriod(1);
+#endif
+    {
+        av_metadata metadata{"test"};
+        av_muxer muxer(filename, muxer_type, metadata);
+        muxer.add_stream(create_video_codec(config, AV_PIX_FMT_BGR24));
+
+        auto audio = std::make_unique<av_audio>(audio_config, audio_meta);
+        auto audio_codec = audio.get();
+        muxer.add_stream(std::move(audio));
+        muxer.open();
+
+        // video and audio share the same clock, like the recorder does.
+        const auto start = std::chrono::steady_clock::now();
+        av_sine_source source(audio_config);
+        source.start(start, [audio_codec](timestamp_t timestamp, const uint8_t *data, int sample_count) {
+            audio_codec->push_samples(timestamp, data, sample_count);
+        });
+
+        auto frame = create_bmpinfo(config.width, config.height, AV_PIX_FMT_BGR24);
+        auto deadline = start;
+        for (int i = 0; i < 75; ++i)
+        {
+            const auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
+
+            fill_bmpinfo(frame, i, AV_PIX_FMT_BGR24);
+            muxer.encode_frame(static_cast<timestamp_t>(timestamp),
+                reinterpret_cast<unsigned char *>(frame->bmiColors), config.width, config.height,
+                config.width * 3);
+
+            deadline += std::chrono::milliseconds(40);
+            std::this_thread::sleep_until(deadline);
+        }
+        source.stop();
+        free(frame);
+
+        const auto stats = muxer.get_audio_stats();
+        EXPECT_EQ(stats.samples_dropped, 0);
+        EXPECT_LT(stats.max_sync_error, 20000);
+    }
+#ifdef _WIN32
+    timeEndPeriod(1);
+#endif
+
+    const auto ranges = read_stream_ranges(filename);
+    ASSERT_EQ(ranges.size(), 2u);
+
+    const auto &video_range = ranges[0];
+    const auto &audio_range = ranges[1];
+    EXPECT_EQ(video_range.packet_count, 75);
+    EXPECT_GT(audio_range.packet_count, 0);
+
+    // both tracks start at the start of the recording, and the audio covers the whole video.
+    EXPECT_NEAR(audio_range.start, video_range.start, 0.05);
+    EXPECT_NEAR(audio_range.end, video_range.end, 0.1);
+}
+
+TEST(test_audio, test_av_sync_aac_mkv)
+{
+    test_av_sync(av_muxer_type::mkv, audio::codec::aac, "test_av_sync_aac.mkv");
+}
+
+TEST(test_audio, test_av_sync_aac_mp4)
+{
+    test_av_sync(av_muxer_type::mp4, audio::codec::aac, "test_av_sync_aac.mp4");
+}
+
+TEST(test_audio, test_av_sync_opus_mkv)
+{
+    test_av_sync(av_muxer_type::mkv, audio::codec::opus, "test_av_sync_opus.mkv");
+}
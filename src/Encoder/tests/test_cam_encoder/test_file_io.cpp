@@ -0,0 +1,97 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <CamEncoder/av_file_io.h>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+static auto read_file(const char *filename) -> std::vector<uint8_t>
+{
+    std::ifstream file(filename, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+static auto test_file_io(bool direct_io) -> av_file_io_stats
+{
+    const auto filename = "test_file_io.bin";
+
+    av_file_io_config config;
+    config.buffer_size = 64 * 1024;
+    config.preallocate_extent = 128 * 1024;
+    config.direct_io = direct_io;
+
+    std::vector<uint8_t> expected;
+    av_file_io_stats stats;
+    {
+        av_file_io file_io(filename, config);
+        auto context = file_io.get_context();
+
+        for (int i = 0; i < 1000; ++i)
+        {
+            const std::vector<uint8_t> packet(1 + (i * 7919) % 1500, static_cast<uint8_t>(i));
+            avio_write(context, packet.data(), static_cast<int>(packet.size()));
+            expected.insert(expected.end(), packet.begin(), packet.end());
+
+            // update a 'header' like the muxers do.
+            if (i % 100 == 99)
+            {
+                const auto position = avio_tell(context);
+                avio_seek(context, 16, SEEK_SET);
+                avio_wb32(context, i);
+                avio_seek(context, position, SEEK_SET);
+
+                expected[16] = 0;
+                expected[17] = 0;
+                expected[18] = static_cast<uint8_t>(i >> 8);
+                expected[19] = static_cast<uint8_t>(i);
+            }
+        }
+
+        EXPECT_EQ(file_io.close(), 0);
+
+        stats = file_io.get_stats();
+        EXPECT_GE(stats.bytes_written, static_cast<int64_t>(expected.size()));
+    }
+
+    // the preallocated space past the end is truncated.
+    EXPECT_EQ(read_file(filename), expected);
+    std::remove(filename);
+    return stats;
+}
+
+TEST(test_file_io, test_write_and_seek)
+{
+    test_file_io(false);
+}
+
+TEST(test_file_io, test_write_and_seek_direct_io)
+{
+    test_file_io(true);
+}
+
+TEST(test_file_io, test_preallocate)
+{
+    const auto stats = test_file_io(false);
+    if (stats.preallocate_error != 0)
+        GTEST_SKIP() << "the file system does not support preallocation";
+
+    EXPECT_GE(stats.preallocate_count, 1u);
+    EXPECT_GE(stats.preallocated_size, 128 * 1024);
+}
@@ -0,0 +1,224 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+// winsock2 has to be included before windows.h.
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <CamEncoder/av_muxer.h>
+#include "test_utilities.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+using latency_clock = std::chrono::steady_clock;
+
+/*!
+ * Receives an mpegts stream on the loopback interface, and records when the first byte of every
+ * video frame (a pes packet with a pts) arrives.
+ */
+class loopback_receiver
+{
+public:
+    loopback_receiver(bool tcp, int port)
+        : tcp_(tcp)
+    {
+        WSADATA wsa_data;
+        WSAStartup(MAKEWORD(2, 2), &wsa_data);
+
+        socket_ = socket(AF_INET, tcp ? SOCK_STREAM : SOCK_DGRAM, tcp ? IPPROTO_TCP : IPPROTO_UDP);
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<u_short>(port));
+        inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+        bind(socket_, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+
+        if (tcp_)
+            listen(socket_, 1);
+
+        thread_ = std::thread([this]() { _run(); });
+    }
+
+    ~loopback_receiver()
+    {
+        stop();
+        WSACleanup();
+    }
+
+    void stop()
+    {
+        if (!thread_.joinable())
+            return;
+
+        closesocket(socket_);
+        if (connection_ != INVALID_SOCKET)
+            closesocket(connection_);
+        thread_.join();
+    }
+
+    // the arrival time of every frame by its pts, only valid after stop.
+    std::map<int64_t, latency_clock::time_point> arrivals;
+
+private:
+    void _run()
+    {
+        auto source = socket_;
+        if (tcp_)
+        {
+            connection_ = accept(socket_, nullptr, nullptr);
+            if (connection_ == INVALID_SOCKET)
+                return;
+            source = connection_;
+        }
+
+        std::vector<uint8_t> stream;
+        char buffer[64 * 1024];
+        for (int size; (size = recv(source, buffer, sizeof(buffer), 0)) > 0;)
+        {
+            const auto now = latency_clock::now();
+            stream.insert(stream.end(), buffer, buffer + size);
+
+            size_t offset = 0;
+            for (; offset + 188 <= stream.size(); offset += 188)
+                _parse_ts_packet(stream.data() + offset, now);
+            stream.erase(stream.begin(), stream.begin() + offset);
+        }
+    }
+
+    void _parse_ts_packet(const uint8_t *packet, latency_clock::time_point now)
+    {
+        const bool payload_unit_start = (packet[1] & 0x40) != 0;
+        const auto adaptation_field = (packet[3] >> 4) & 0x3;
+        if (packet[0] != 0x47 || !payload_unit_start || (adaptation_field & 0x1) == 0)
+            return;
+
+        auto payload = packet + 4;
+        if (adaptation_field & 0x2)
+            payload += 1 + payload[0];
+
+        // a video pes header with a pts.
+        if (payload + 14 > packet + 188 || payload[0] != 0 || payload[1] != 0 || payload[2] != 1 ||
+            (payload[3] & 0xf0) != 0xe0 || (payload[7] & 0x80) == 0)
+            return;
+
+        const auto pts = (static_cast<int64_t>(payload[9] & 0x0e) << 29) |
+            (static_cast<int64_t>(payload[10]) << 22) | (static_cast<int64_t>(payload[11] & 0xfe) << 14) |
+            (static_cast<int64_t>(payload[12]) << 7) | (static_cast<int64_t>(payload[13]) >> 1);
+        arrivals.emplace(pts, now);
+    }
+
+    bool tcp_;
+    SOCKET socket_{INVALID_SOCKET};
+    SOCKET connection_{INVALID_SOCKET};
+    std::thread thread_;
+};
+
+/*!
+ * Stream 5 seconds of 25 fps video over the loopback interface, and measure the time between
+ * handing a frame to the muxer and its arrival at the receiver.
+ */
+auto measure_live_latency(const std::string &protocol, int port) -> std::vector<double>
+{
+    auto config = create_video_config(video::codec::x264, 320, 240, 25);
+    config.low_latency = true;
+
+    constexpr int frame_count = 125;
+    std::vector<latency_clock::time_point> send_times(frame_count);
+
+    loopback_receiver receiver(protocol == "tcp", port);
+    {
+        av_muxer_config muxer_config;
+        muxer_config.live = true;
+        muxer_config.use_file_io = false;
+
+        av_metadata metadata{"test"};
+        av_muxer muxer(fmt::format("{}://127.0.0.1:{}", protocol, port), av_muxer_type::mpegts,
+            metadata, muxer_config);
+        muxer.add_stream(create_video_codec(config, AV_PIX_FMT_BGR24));
+        muxer.open();
+
+        auto frame = create_bmpinfo(config.width, config.height, AV_PIX_FMT_BGR24);
+        auto deadline = latency_clock::now();
+        for (int i = 0; i < frame_count; ++i)
+        {
+            fill_bmpinfo(frame, i, AV_PIX_FMT_BGR24);
+
+            send_times[i] = latency_clock::now();
+            muxer.encode_frame(static_cast<timestamp_t>(i) * 40000,
+                reinterpret_cast<unsigned char *>(frame->bmiColors), config.width, config.height,
+                config.width * 3);
+
+            deadline += std::chrono::milliseconds(40);
+            std::this_thread::sleep_until(deadline);
+        }
+        free(frame);
+    }
+
+    // give the receiver the last datagrams.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    receiver.stop();
+    const auto &arrivals = receiver.arrivals;
+
+    std::vector<double> latencies;
+    if (arrivals.empty())
+        return latencies;
+
+    // the pts of the frames are 40ms (3600 ticks) apart, from the first pts on.
+    const auto first_pts = arrivals.begin()->first;
+    for (const auto &[pts, arrival] : arrivals)
+    {
+        const auto index = static_cast<size_t>((pts - first_pts + 1800) / 3600);
+        if (index >= send_times.size())
+            continue;
+        latencies.push_back(std::chrono::duration<double, std::milli>(arrival - send_times[index]).count());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    return latencies;
+}
+
+void test_live_latency(const std::string &protocol, int port)
+{
+    const auto latencies = measure_live_latency(protocol, port);
+
+    // every frame arrives, the encoder does not hold any frames back.
+    ASSERT_GE(latencies.size(), 120u);
+
+    const auto median = latencies[latencies.size() / 2];
+    const auto p95 = latencies[latencies.size() * 95 / 100];
+    ::testing::Test::RecordProperty("median_latency_ms", static_cast<int>(median));
+    ::testing::Test::RecordProperty("p95_latency_ms", static_cast<int>(p95));
+    ::testing::Test::RecordProperty("max_latency_ms", static_cast<int>(latencies.back()));
+
+    // well within a single frame time.
+    EXPECT_LT(median, 40.0);
+}
+
+TEST(test_live_stream, test_udp_latency)
+{
+    test_live_latency("udp", 23456);
+}
+
+TEST(test_live_stream, test_tcp_latency)
+{
+    test_live_latency("tcp", 23457);
+}
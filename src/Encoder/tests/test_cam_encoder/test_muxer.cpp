@@ -21,35 +21,17 @@
 #include <thread>
 #include <chrono>
 #include <memory>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <utility>
+#include <fcntl.h>
+#include <io.h>
 
 constexpr auto test_width = 128;
 constexpr auto test_height = 128;
 
-av_video_meta create_video_config(video::codec codec, const int width,
-                                  const int height, const int fps)
-{
-    av_video_meta meta;
-    meta.codec = codec;
-    meta.quality = 25;
-    meta.bpp = 24;
-    meta.width = width;
-    meta.height = height;
-    meta.fps = {fps, 1};
-    meta.preset = video::preset::ultrafast;  // configure 'almost' realtime video encoding
-    meta.profile = video::profile::baseline; // lets try 264 baseline
-    //meta.profile = video::profile::high; // lets try 264 baseline
-    meta.tune = video::tune::zerolatency;
-    return meta;
-}
-
-std::unique_ptr<av_video> create_video_codec(const av_video_meta &meta, AVPixelFormat pixel_format)
-{
-    av_video_codec video_codec_config;
-    video_codec_config.pixel_format = pixel_format;
-
-    return std::make_unique<av_video>(video_codec_config, meta);
-}
-
 void test_muxer(const int width, const int height, const int fps, av_muxer_type muxer_type,
     video::codec codec, AVPixelFormat pixel_format = AV_PIX_FMT_BGRA)
 {
@@ -65,6 +47,15 @@ void test_muxer(const int width, const int height, const int fps, av_muxer_type
     case video::codec::camstudio:
         filename += "cscd";
         break;
+    case video::codec::ffv1:
+        filename += "ffv1";
+        break;
+    case video::codec::utvideo:
+        filename += "utvideo";
+        break;
+    case video::codec::av1:
+        filename += "av1";
+        break;
     }
 
     switch(muxer_type)
@@ -78,6 +69,12 @@ void test_muxer(const int width, const int height, const int fps, av_muxer_type
     case av_muxer_type::avi:
         filename += ".avi";
         break;
+    case av_muxer_type::mpegts:
+        filename += ".ts";
+        break;
+    case av_muxer_type::nut:
+        filename += ".nut";
+        break;
     }
 
     av_metadata metadata{"test"};
@@ -91,7 +88,7 @@ void test_muxer(const int width, const int height, const int fps, av_muxer_type
     for (int i = 0; i < 100; ++i)
     {
         DWORD ts = GetTickCount() - timestamp;
-        muxer.encode_frame(ts, reinterpret_cast<unsigned char *>(frame->bmiColors), config.width,
+        muxer.encode_frame(static_cast<timestamp_t>(ts) * 1000, reinterpret_cast<unsigned char *>(frame->bmiColors), config.width,
             config.height, config.width * 3);
         fill_bmpinfo(frame, ts / fps, pixel_format);
         double dt = (1.0 / (double)fps) * 1000.0;
@@ -121,3 +118,616 @@ TEST(test_muxer, test_create_mkv_cam_codec_muxer)
     test_muxer(test_width, test_height, 25, av_muxer_type::mkv, video::codec::camstudio, AV_PIX_FMT_BGRA);
     //test_muxer(test_width, test_height, 25, av_muxer_type::mkv, AV_CODEC_ID_CSCD, AV_PIX_FMT_BGR0);
 }
+
+TEST(test_muxer, test_create_mkv_lossless_muxer)
+{
+    test_muxer(test_width, test_height, 25, av_muxer_type::mkv, video::codec::ffv1, AV_PIX_FMT_BGRA);
+    test_muxer(test_width, test_height, 25, av_muxer_type::avi, video::codec::ffv1, AV_PIX_FMT_BGR24);
+
+    test_muxer(test_width, test_height, 25, av_muxer_type::mkv, video::codec::utvideo, AV_PIX_FMT_BGRA);
+    test_muxer(test_width, test_height, 25, av_muxer_type::avi, video::codec::utvideo, AV_PIX_FMT_BGR24);
+}
+
+TEST(test_muxer, test_create_av1_muxer)
+{
+    // av1 is optional, ffmpeg might be build without libsvtav1.
+    if (avcodec_find_encoder_by_name("libsvtav1") == nullptr)
+        GTEST_SKIP() << "ffmpeg is build without libsvtav1";
+
+    test_muxer(test_width, test_height, 25, av_muxer_type::mkv, video::codec::av1);
+    test_muxer(test_width, test_height, 25, av_muxer_type::mp4, video::codec::av1);
+}
+
+// encode 2 seconds at a high refresh rate, with the timestamps a perfectly paced capture has. the
+// capture pacing itself is tested with a fake clock in the cam_frame_pacer tests.
+void test_high_refresh_pacing(const int fps, av_muxer_type muxer_type, const std::string &filename)
+{
+    const auto frame_count = fps * 2;
+    const auto config = create_video_config(video::codec::x264, 64, 64, fps);
+    {
+        av_metadata metadata{"test"};
+        av_muxer muxer(filename, muxer_type, metadata);
+        muxer.add_stream(create_video_codec(config, AV_PIX_FMT_BGR24));
+        muxer.open();
+
+        auto frame = create_bmpinfo(config.width, config.height, AV_PIX_FMT_BGR24);
+        for (int i = 0; i < frame_count; ++i)
+        {
+            fill_bmpinfo(frame, i, AV_PIX_FMT_BGR24);
+            muxer.encode_frame(static_cast<timestamp_t>(i) * 1000000 / fps,
+                reinterpret_cast<unsigned char *>(frame->bmiColors), config.width, config.height,
+                config.width * 3);
+        }
+
+        // a frame time below a millisecond tick no longer collides with the previous frame.
+        EXPECT_EQ(muxer.get_skipped_frame_count(), 0);
+        free(frame);
+    }
+
+    const auto stream = read_stream_timestamps(filename);
+    ASSERT_EQ(stream.pts.size(), static_cast<size_t>(frame_count));
+
+    // every frame must have its own timestamp.
+    for (size_t i = 1; i < stream.pts.size(); ++i)
+        EXPECT_GT(stream.pts[i], stream.pts[i - 1]);
+
+    // the container rounds to its own time base, a millisecond for mkv.
+    const auto duration = (stream.pts.back() - stream.pts.front()) * av_q2d(stream.time_base);
+    EXPECT_NEAR(duration, static_cast<double>(frame_count - 1) / fps, 0.001);
+}
+
+TEST(test_muxer, test_high_refresh_pacing_120)
+{
+    test_high_refresh_pacing(120, av_muxer_type::mkv, "test_pacing_120.mkv");
+    test_high_refresh_pacing(120, av_muxer_type::mp4, "test_pacing_120.mp4");
+}
+
+TEST(test_muxer, test_high_refresh_pacing_144)
+{
+    test_high_refresh_pacing(144, av_muxer_type::mkv, "test_pacing_144.mkv");
+    test_high_refresh_pacing(144, av_muxer_type::mp4, "test_pacing_144.mp4");
+}
+
+// record a short file, and copy the first part of it like a recording that was interrupted.
+void test_truncated_recording(av_muxer_type muxer_type, const std::string &filename)
+{
+    const auto config = create_video_config(video::codec::x264, 64, 64, 25);
+    {
+        av_muxer_config muxer_config;
+        muxer_config.fragmented_mp4 = true;
+
+        av_metadata metadata{"test"};
+        av_muxer muxer(filename, muxer_type, metadata, muxer_config);
+        muxer.add_stream(create_video_codec(config, AV_PIX_FMT_BGR24));
+        muxer.open();
+
+        auto frame = create_bmpinfo(config.width, config.height, AV_PIX_FMT_BGR24);
+        for (int i = 0; i < 250; ++i)
+        {
+            fill_bmpinfo(frame, i, AV_PIX_FMT_BGR24);
+            muxer.encode_frame(static_cast<timestamp_t>(i) * 40000,
+                reinterpret_cast<unsigned char *>(frame->bmiColors), config.width, config.height,
+                config.width * 3);
+        }
+        free(frame);
+    }
+
+    const auto complete = read_stream_timestamps(filename);
+    ASSERT_EQ(complete.pts.size(), 250u);
+
+    std::ifstream file(filename, std::ios::binary);
+    std::vector<char> data{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    file.close();
+
+    const auto truncated_filename = "truncated_" + filename;
+    std::ofstream truncated(truncated_filename, std::ios::binary);
+    truncated.write(data.data(), data.size() * 2 / 3);
+    truncated.close();
+
+    // everything up to the last complete fragment/cluster is still readable.
+    const auto partial = read_stream_timestamps(truncated_filename);
+    EXPECT_GT(partial.pts.size(), 0u);
+    EXPECT_LT(partial.pts.size(), complete.pts.size());
+}
+
+TEST(test_muxer, test_truncated_fragmented_mp4)
+{
+    test_truncated_recording(av_muxer_type::mp4, "test_fragmented.mp4");
+}
+
+TEST(test_muxer, test_truncated_mkv)
+{
+    test_truncated_recording(av_muxer_type::mkv, "test_truncated.mkv");
+}
+
+// record 10 seconds in segments, and return the segment files on disk.
+auto record_segmented(av_muxer_type muxer_type, const std::string &filename,
+    av_segment_config segment_config) -> std::vector<std::string>
+{
+    const auto config = create_video_config(video::codec::x264, 64, 64, 25);
+    {
+        av_muxer_config muxer_config;
+        muxer_config.segment = segment_config;
+
+        av_metadata metadata{"test"};
+        av_muxer muxer(filename, muxer_type, metadata, muxer_config);
+        muxer.add_stream(create_video_codec(config, AV_PIX_FMT_BGR24));
+        muxer.open();
+
+        auto frame = create_bmpinfo(config.width, config.height, AV_PIX_FMT_BGR24);
+        for (int i = 0; i < 250; ++i)
+        {
+            fill_bmpinfo(frame, i, AV_PIX_FMT_BGR24);
+            muxer.encode_frame(static_cast<timestamp_t>(i) * 40000,
+                reinterpret_cast<unsigned char *>(frame->bmiColors), config.width, config.height,
+                config.width * 3);
+        }
+        free(frame);
+    }
+
+    std::vector<std::string> segments;
+    for (int i = 0;; ++i)
+    {
+        auto segment_filename = av_segmenter::make_segment_filename(filename, i);
+        if (!std::ifstream(segment_filename).good())
+            break;
+        segments.push_back(std::move(segment_filename));
+    }
+    return segments;
+}
+
+// the segments of a playlist are only playable behind the initialization section of the first one,
+// so read them back as a single file.
+stream_timestamps read_joined_segments(const std::vector<std::string> &segments,
+    const std::string &joined_filename)
+{
+    {
+        std::ofstream joined(joined_filename, std::ios::binary | std::ios::trunc);
+        for (const auto &segment : segments)
+            joined << std::ifstream(segment, std::ios::binary).rdbuf();
+    }
+    return read_stream_timestamps(joined_filename);
+}
+
+auto read_text_file(const std::string &filename) -> std::string
+{
+    std::ifstream file(filename, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+// all values of attribute in the lines starting with tag, a.e. the durations of #EXTINF:.
+auto find_values(const std::string &text, const std::string &tag) -> std::vector<std::string>
+{
+    std::vector<std::string> values;
+    for (auto pos = text.find(tag); pos != std::string::npos; pos = text.find(tag, pos + 1))
+    {
+        const auto begin = pos + tag.size();
+        const auto end = text.find_first_of(",\"\r\n", begin);
+        values.push_back(text.substr(begin, end - begin));
+    }
+    return values;
+}
+
+TEST(test_muxer, test_segment_by_duration)
+{
+    av_segment_config segment_config;
+    segment_config.duration = 2.0;
+    const auto segments = record_segmented(av_muxer_type::mkv, "test_segment_duration.mkv",
+        segment_config);
+
+    // the gop is 1 second, so every segment is exactly 2 seconds.
+    ASSERT_EQ(segments.size(), 5u);
+
+    size_t frame_count = 0;
+    int64_t previous_pts = -1;
+    for (const auto &segment_filename : segments)
+    {
+        // without a playlist every segment plays on its own.
+        const auto segment = read_stream_timestamps(segment_filename);
+        EXPECT_EQ(segment.pts.size(), 50u);
+        frame_count += segment.pts.size();
+
+        // the segments continue where the previous one stopped.
+        EXPECT_GT(segment.pts.front(), previous_pts);
+        previous_pts = segment.pts.back();
+    }
+    EXPECT_EQ(frame_count, 250u);
+}
+
+TEST(test_muxer, test_segment_by_size_with_playlist)
+{
+    av_segment_config segment_config;
+    segment_config.size = 16 * 1024;
+    segment_config.playlist = av_playlist_type::hls;
+    const auto segments = record_segmented(av_muxer_type::mp4, "test_segment_size.mp4",
+        segment_config);
+
+    ASSERT_GT(segments.size(), 1u);
+
+    // the fragments continue across the segments.
+    const auto stream = read_joined_segments(segments, "test_segment_size_joined.mp4");
+    ASSERT_EQ(stream.pts.size(), 250u);
+    for (size_t i = 1; i < stream.pts.size(); ++i)
+        EXPECT_GT(stream.pts[i], stream.pts[i - 1]);
+
+    const auto playlist = read_text_file("test_segment_size.m3u8");
+    EXPECT_EQ(find_values(playlist, "#EXT-X-MEDIA-SEQUENCE:"), std::vector<std::string>{"0"});
+    EXPECT_NE(playlist.find("#EXT-X-ENDLIST"), std::string::npos);
+
+    // one initialization section for all segments.
+    EXPECT_EQ(find_values(playlist, "#EXT-X-MAP:URI=\""),
+        std::vector<std::string>{"test_segment_size_00000.mp4"});
+    const auto init_range = find_values(playlist, "BYTERANGE=\"");
+    ASSERT_EQ(init_range.size(), 1u);
+    EXPECT_GT(std::stoll(init_range.front()), 0);
+    EXPECT_EQ(init_range.front().substr(init_range.front().find('@')), "@0");
+
+    // every segment is listed with its own duration, together they cover the recording.
+    const auto durations = find_values(playlist, "#EXTINF:");
+    ASSERT_EQ(durations.size(), segments.size());
+    double total_duration = 0.0;
+    for (const auto &duration : durations)
+    {
+        EXPECT_GT(std::stod(duration), 0.0);
+        total_duration += std::stod(duration);
+    }
+    EXPECT_NEAR(total_duration, 10.0, 0.001);
+    EXPECT_EQ(find_values(playlist, "#EXT-X-BYTERANGE:").size(), segments.size());
+}
+
+TEST(test_muxer, test_segment_by_duration_with_dash_playlist)
+{
+    av_segment_config segment_config;
+    segment_config.duration = 2.0;
+    segment_config.playlist = av_playlist_type::dash;
+    const auto segments = record_segmented(av_muxer_type::mp4, "test_segment_dash.mp4",
+        segment_config);
+
+    ASSERT_EQ(segments.size(), 5u);
+    const auto stream = read_joined_segments(segments, "test_segment_dash_joined.mp4");
+    EXPECT_EQ(stream.pts.size(), 250u);
+
+    const auto playlist = read_text_file("test_segment_dash.mpd");
+    EXPECT_NE(playlist.find("type=\"static\""), std::string::npos);
+    EXPECT_NE(playlist.find("<Initialization sourceURL=\"test_segment_dash_00000.mp4\" range=\"0-"),
+        std::string::npos);
+    EXPECT_NE(playlist.find("mimeType=\"video/mp4\""), std::string::npos);
+
+    // a baseline h264 stream, avc1 with the profile, constraint flags and level in hex.
+    const auto codecs = find_values(playlist, "codecs=\"");
+    ASSERT_EQ(codecs.size(), 1u);
+    EXPECT_EQ(codecs[0].size(), 11u);
+    EXPECT_EQ(codecs[0].rfind("avc1.42", 0), 0u);
+
+    // the timeline has the real duration of every segment, and has no gaps.
+    const auto timescale = std::stoll(find_values(playlist, "<SegmentList timescale=\"").at(0));
+    const auto starts = find_values(playlist, "<S t=\"");
+    const auto durations = find_values(playlist, " d=\"");
+    ASSERT_EQ(starts.size(), segments.size());
+    ASSERT_EQ(durations.size(), segments.size());
+
+    int64_t next_start = 0;
+    for (size_t i = 0; i < durations.size(); ++i)
+    {
+        EXPECT_EQ(std::stoll(starts[i]), next_start);
+        EXPECT_EQ(std::stoll(durations[i]), 2 * timescale);
+        next_start += std::stoll(durations[i]);
+    }
+    EXPECT_EQ(find_values(playlist, "<SegmentURL media=\"").size(), segments.size());
+}
+
+TEST(test_muxer, test_segment_playlist_requires_mp4)
+{
+    av_muxer_config muxer_config;
+    muxer_config.segment = av_segment_config{2.0, 0, av_playlist_type::dash};
+
+    av_metadata metadata{"test"};
+    EXPECT_THROW(av_muxer("test_segment.mkv", av_muxer_type::mkv, metadata, muxer_config),
+        std::runtime_error);
+}
+
+// record 10 seconds in replay mode, and save the retained window.
+auto record_replay(const std::string &filename, av_replay_config replay_config)
+    -> std::pair<av_replay_stats, stream_timestamps>
+{
+    const auto config = create_video_config(video::codec::x264, 64, 64, 25);
+
+    av_replay_stats stats;
+    {
+        av_muxer_config muxer_config;
+        muxer_config.replay = replay_config;
+
+        av_metadata metadata{"test"};
+        av_muxer muxer("test_replay.mkv", av_muxer_type::mkv, metadata, muxer_config);
+        muxer.add_stream(create_video_codec(config, AV_PIX_FMT_BGR24));
+        muxer.open();
+
+        auto frame = create_bmpinfo(config.width, config.height, AV_PIX_FMT_BGR24);
+        for (int i = 0; i < 250; ++i)
+        {
+            fill_bmpinfo(frame, i, AV_PIX_FMT_BGR24);
+            muxer.encode_frame(static_cast<timestamp_t>(i) * 40000,
+                reinterpret_cast<unsigned char *>(frame->bmiColors), config.width, config.height,
+                config.width * 3);
+        }
+        free(frame);
+
+        // nothing is written until the replay is saved.
+        EXPECT_FALSE(std::ifstream("test_replay.mkv").good());
+
+        while (muxer.get_writer_stats().packets_written < 250)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        stats = muxer.get_replay_stats();
+        muxer.save_replay(filename).get();
+    }
+    return {stats, read_stream_timestamps(filename)};
+}
+
+TEST(test_muxer, test_replay_duration)
+{
+    av_replay_config replay_config;
+    replay_config.duration = 3.0;
+    const auto [stats, saved] = record_replay("test_replay_duration.mkv", replay_config);
+
+    // the gop is 1 second, the window starts at the keyframe that still covers 3 seconds.
+    EXPECT_EQ(stats.keyframe_count, 4u);
+    EXPECT_EQ(stats.packet_count, 100u);
+    EXPECT_EQ(saved.pts.size(), 100u);
+
+    // the saved file starts at 0.
+    EXPECT_EQ(saved.pts.front(), 0);
+}
+
+TEST(test_muxer, test_replay_memory_limit)
+{
+    av_replay_config replay_config;
+    replay_config.memory_limit = 1;
+    const auto [stats, saved] = record_replay("test_replay_memory.mkv", replay_config);
+
+    // only the last gop remains, it can not be pruned without losing its keyframe.
+    EXPECT_EQ(stats.keyframe_count, 1u);
+    EXPECT_EQ(stats.packet_count, 25u);
+    EXPECT_EQ(saved.pts.size(), 25u);
+}
+
+// record to a pipe, and store what comes out of the other end in a file.
+void test_pipe_output(av_muxer_type muxer_type, const std::string &filename)
+{
+    const auto config = create_video_config(video::codec::x264, 64, 64, 25);
+
+    int fds[2];
+    ASSERT_EQ(_pipe(fds, 64 * 1024, _O_BINARY), 0);
+
+    std::vector<char> received;
+    std::thread reader([&received, read_fd = fds[0]]() {
+        char buffer[4096];
+        for (int size; (size = _read(read_fd, buffer, sizeof(buffer))) > 0;)
+            received.insert(received.end(), buffer, buffer + size);
+    });
+
+    {
+        av_muxer_config muxer_config;
+        muxer_config.output_fd = fds[1];
+
+        av_metadata metadata{"test"};
+        av_muxer muxer("pipe", muxer_type, metadata, muxer_config);
+        muxer.add_stream(create_video_codec(config, AV_PIX_FMT_BGR24));
+        muxer.open();
+
+        auto frame = create_bmpinfo(config.width, config.height, AV_PIX_FMT_BGR24);
+        for (int i = 0; i < 50; ++i)
+        {
+            fill_bmpinfo(frame, i, AV_PIX_FMT_BGR24);
+            muxer.encode_frame(static_cast<timestamp_t>(i) * 40000,
+                reinterpret_cast<unsigned char *>(frame->bmiColors), config.width, config.height,
+                config.width * 3);
+        }
+        free(frame);
+    }
+
+    // the muxer leaves the file descriptor open, closing it ends the stream.
+    _close(fds[1]);
+    reader.join();
+    _close(fds[0]);
+
+    std::ofstream file(filename, std::ios::binary);
+    file.write(received.data(), received.size());
+    file.close();
+
+    const auto stream = read_stream_timestamps(filename);
+    EXPECT_EQ(stream.pts.size(), 50u);
+}
+
+TEST(test_muxer, test_pipe_output)
+{
+    test_pipe_output(av_muxer_type::mkv, "test_pipe.mkv");
+    test_pipe_output(av_muxer_type::mpegts, "test_pipe.ts");
+    test_pipe_output(av_muxer_type::nut, "test_pipe.nut");
+}
+
+TEST(test_muxer, test_pipe_output_requires_streamable_container)
+{
+    av_muxer_config muxer_config;
+    muxer_config.output_fd = av_pipe_io::stdout_fd;
+
+    av_metadata metadata{"test"};
+    EXPECT_THROW(av_muxer("pipe", av_muxer_type::mp4, metadata, muxer_config), std::runtime_error);
+}
+
+TEST(test_muxer, test_destroy_without_open)
+{
+    const auto config = create_video_config(video::codec::x264, 64, 64, 25);
+    av_metadata metadata{"test"};
+
+    // nothing was opened, so there is nothing to flush and no trailer to write.
+    {
+        av_muxer muxer("test_not_opened.mkv", av_muxer_type::mkv, metadata);
+        muxer.add_stream(create_video_codec(config, AV_PIX_FMT_BGR24));
+    }
+
+    // the output can't be opened, destroying the muxer afterwards does not throw.
+    {
+        av_muxer muxer("does_not_exist/test_open_failed.mkv", av_muxer_type::mkv, metadata);
+        muxer.add_stream(create_video_codec(config, AV_PIX_FMT_BGR24));
+        EXPECT_THROW(muxer.open(), std::runtime_error);
+    }
+}
+
+// record a frame and a crop of it as two video tracks, like a recording with a track per monitor.
+TEST(test_muxer, test_multiple_video_tracks)
+{
+    const auto config = create_video_config(video::codec::x264, 64, 64, 25);
+    const auto crop_config = create_video_config(video::codec::x264, 32, 32, 25);
+    const auto filename = std::string("test_multiple_tracks.mkv");
+    {
+        av_metadata metadata{"test"};
+        av_muxer muxer(filename, av_muxer_type::mkv, metadata);
+        EXPECT_EQ(muxer.add_stream(create_video_codec(config, AV_PIX_FMT_BGR24)), 0);
+        EXPECT_EQ(muxer.add_stream(create_video_codec(crop_config, AV_PIX_FMT_BGR24)), 1);
+        muxer.open();
+
+        const auto stride = config.width * 3;
+        auto frame = create_bmpinfo(config.width, config.height, AV_PIX_FMT_BGR24);
+        auto data = reinterpret_cast<unsigned char *>(frame->bmiColors);
+        for (int i = 0; i < 100; ++i)
+        {
+            fill_bmpinfo(frame, i, AV_PIX_FMT_BGR24);
+            const std::vector<av_video_frame> frames = {
+                {data, config.width, config.height, stride},
+                {data + 16 * stride + 16 * 3, crop_config.width, crop_config.height, stride}
+            };
+            muxer.encode_frames(static_cast<timestamp_t>(i) * 40000, frames);
+        }
+        free(frame);
+    }
+
+    AVFormatContext *format_context = nullptr;
+    ASSERT_GE(avformat_open_input(&format_context, filename.c_str(), nullptr, nullptr), 0);
+    ASSERT_GE(avformat_find_stream_info(format_context, nullptr), 0);
+    ASSERT_EQ(format_context->nb_streams, 2u);
+    EXPECT_EQ(format_context->streams[0]->codecpar->width, 64);
+    EXPECT_EQ(format_context->streams[1]->codecpar->width, 32);
+
+    std::array<int, 2> packet_count = {};
+    AVPacket pkt = {};
+    av_init_packet(&pkt);
+    while (av_read_frame(format_context, &pkt) >= 0)
+    {
+        ++packet_count[pkt.stream_index];
+        av_packet_unref(&pkt);
+    }
+    avformat_close_input(&format_context);
+
+    EXPECT_EQ(packet_count[0], 100);
+    EXPECT_EQ(packet_count[1], 100);
+}
+
+// frames one stream tick apart, with b-frames the new encoder starts its decode timestamps before
+// the last packets of the old one, and clamping them leaves no room below the presentation time.
+TEST(test_muxer, test_reconfigure_video_keeps_dts_increasing)
+{
+    auto config = create_video_config(video::codec::x264, 64, 64, 1000);
+    config.preset = video::preset::medium;
+    config.tune = std::nullopt;
+
+    const auto filename = std::string("test_reconfigure_dts.mkv");
+    {
+        av_metadata metadata{"test"};
+        av_muxer muxer(filename, av_muxer_type::mkv, metadata);
+        muxer.add_stream(create_video_codec(config, AV_PIX_FMT_BGR24));
+        muxer.open();
+
+        auto frame = create_bmpinfo(config.width, config.height, AV_PIX_FMT_BGR24);
+        for (int i = 0; i < 100; ++i)
+        {
+            if (i == 50)
+                muxer.reconfigure_video(0, config);
+
+            // 1ms apart, a single tick of the mkv time base.
+            fill_bmpinfo(frame, i, AV_PIX_FMT_BGR24);
+            muxer.encode_frame(static_cast<timestamp_t>(i) * 1000,
+                reinterpret_cast<unsigned char *>(frame->bmiColors), config.width, config.height,
+                config.width * 3);
+        }
+        free(frame);
+
+        // the container rejects a packet of which the dts does not increase, or is after its pts.
+        muxer.finish();
+        EXPECT_EQ(muxer.get_skipped_frame_count(), 0);
+        EXPECT_EQ(muxer.get_writer_stats().packets_written, 100u);
+    }
+
+    EXPECT_EQ(read_stream_timestamps(filename).pts.size(), 100u);
+}
+
+// switch the encoder to a faster preset and a smaller size halfway, without restarting the file.
+TEST(test_muxer, test_reconfigure_video)
+{
+    const auto config = create_video_config(video::codec::x264, 64, 64, 25);
+    const auto filename = std::string("test_reconfigure.mkv");
+    {
+        av_metadata metadata{"test"};
+        av_muxer muxer(filename, av_muxer_type::mkv, metadata);
+        muxer.add_stream(create_video_codec(config, AV_PIX_FMT_BGR24));
+        muxer.open();
+
+        auto frame = create_bmpinfo(config.width, config.height, AV_PIX_FMT_BGR24);
+        for (int i = 0; i < 100; ++i)
+        {
+            if (i == 50)
+            {
+                auto reconfigured = config;
+                reconfigured.preset = video::preset::ultrafast;
+                reconfigured.width = 32;
+                reconfigured.height = 32;
+                muxer.reconfigure_video(0, reconfigured);
+            }
+
+            fill_bmpinfo(frame, i, AV_PIX_FMT_BGR24);
+            muxer.encode_frame(static_cast<timestamp_t>(i) * 40000,
+                reinterpret_cast<unsigned char *>(frame->bmiColors), config.width, config.height,
+                config.width * 3);
+        }
+        free(frame);
+    }
+
+    // every frame decodes, at the size of the encoder that produced it.
+    AVFormatContext *format_context = nullptr;
+    ASSERT_GE(avformat_open_input(&format_context, filename.c_str(), nullptr, nullptr), 0);
+    ASSERT_GE(avformat_find_stream_info(format_context, nullptr), 0);
+
+    const auto codecpar = format_context->streams[0]->codecpar;
+    auto decoder = avcodec_alloc_context3(avcodec_find_decoder(codecpar->codec_id));
+    ASSERT_GE(avcodec_parameters_to_context(decoder, codecpar), 0);
+    ASSERT_GE(avcodec_open2(decoder, decoder->codec, nullptr), 0);
+
+    std::vector<int> widths;
+    AVFrame *decoded = av_frame_alloc();
+    const auto receive_frames = [&]() {
+        while (avcodec_receive_frame(decoder, decoded) == 0)
+        {
+            widths.push_back(decoded->width);
+            av_frame_unref(decoded);
+        }
+    };
+
+    AVPacket pkt = {};
+    av_init_packet(&pkt);
+    while (av_read_frame(format_context, &pkt) >= 0)
+    {
+        EXPECT_GE(avcodec_send_packet(decoder, &pkt), 0);
+        av_packet_unref(&pkt);
+        receive_frames();
+    }
+    avcodec_send_packet(decoder, nullptr);
+    receive_frames();
+
+    av_frame_free(&decoded);
+    avcodec_free_context(&decoder);
+    avformat_close_input(&format_context);
+
+    ASSERT_EQ(widths.size(), 100u);
+    EXPECT_EQ(widths.front(), 64);
+    EXPECT_EQ(widths.back(), 32);
+}
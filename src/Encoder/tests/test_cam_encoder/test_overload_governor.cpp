@@ -0,0 +1,162 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <CamEncoder/av_overload_governor.h>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+auto create_meta() -> av_video_meta
+{
+    av_video_meta meta;
+    meta.width = 1920;
+    meta.height = 1080;
+    meta.fps = {60, 1};
+    meta.codec = video::codec::x264;
+    meta.preset = video::preset::veryfast;
+    meta.quality = 23;
+    return meta;
+}
+
+// feed a window worth of 60 fps frames with the given load, returns the last event.
+auto run_window(av_overload_governor &governor, std::chrono::microseconds &timestamp, double load,
+    bool overrun = false) -> std::optional<av_governor_event>
+{
+    const auto frame_time = std::chrono::microseconds(1000000 / governor.get_fps());
+    const auto busy_time = std::chrono::microseconds(static_cast<int64_t>(frame_time.count() * load));
+
+    std::optional<av_governor_event> result;
+    for (auto end = timestamp + 1s; timestamp < end; timestamp += frame_time)
+    {
+        if (auto event = governor.add_frame(timestamp, busy_time, frame_time, overrun))
+            result = event;
+    }
+    return result;
+}
+
+} // namespace
+
+TEST(test_overload_governor, test_steps_down_in_order)
+{
+    av_governor_config config;
+    config.window = 1s;
+    config.max_preset_steps = 3;
+
+    av_overload_governor governor(config, create_meta(), 60);
+    auto timestamp = 0us;
+
+    // veryfast can only go two presets faster.
+    for (const auto preset : {video::preset::superfast, video::preset::ultrafast})
+    {
+        const auto event = run_window(governor, timestamp, 1.5);
+        ASSERT_TRUE(event);
+        EXPECT_EQ(event->step, av_governor_step::preset);
+        EXPECT_TRUE(event->step_down);
+        EXPECT_EQ(governor.get_video_meta().preset, preset);
+
+        // the window after a change is not judged.
+        EXPECT_FALSE(run_window(governor, timestamp, 1.5));
+    }
+
+    for (const auto width : {1440, 960})
+    {
+        const auto event = run_window(governor, timestamp, 1.5);
+        ASSERT_TRUE(event);
+        EXPECT_EQ(event->step, av_governor_step::scale);
+        EXPECT_EQ(governor.get_video_meta().width, width);
+        run_window(governor, timestamp, 1.5);
+    }
+
+    for (const auto fps : {45, 30})
+    {
+        const auto event = run_window(governor, timestamp, 1.5);
+        ASSERT_TRUE(event);
+        EXPECT_EQ(event->step, av_governor_step::fps);
+        EXPECT_EQ(governor.get_fps(), fps);
+        EXPECT_EQ(governor.get_video_meta().fps.num, fps);
+        run_window(governor, timestamp, 1.5);
+    }
+
+    // nothing left to give up.
+    EXPECT_FALSE(run_window(governor, timestamp, 1.5));
+    EXPECT_EQ(governor.get_level().preset, 2);
+    EXPECT_EQ(governor.get_level().scale, 2);
+    EXPECT_EQ(governor.get_level().fps, 2);
+}
+
+TEST(test_overload_governor, test_overrun_steps_down)
+{
+    av_governor_config config;
+    config.window = 1s;
+
+    av_overload_governor governor(config, create_meta(), 60);
+    auto timestamp = 0us;
+
+    // a low average load, but frames were dropped.
+    const auto event = run_window(governor, timestamp, 0.3, true);
+    ASSERT_TRUE(event);
+    EXPECT_EQ(event->step, av_governor_step::preset);
+}
+
+TEST(test_overload_governor, test_steps_up_after_headroom)
+{
+    av_governor_config config;
+    config.window = 1s;
+    config.recover_windows = 3;
+
+    av_overload_governor governor(config, create_meta(), 60);
+    auto timestamp = 0us;
+
+    ASSERT_TRUE(run_window(governor, timestamp, 1.5));
+    run_window(governor, timestamp, 0.7);
+    ASSERT_TRUE(run_window(governor, timestamp, 1.5));
+    run_window(governor, timestamp, 0.7);
+    EXPECT_EQ(governor.get_level().preset, 2);
+
+    // a load between headroom and overload keeps the level.
+    EXPECT_FALSE(run_window(governor, timestamp, 0.7));
+    EXPECT_FALSE(run_window(governor, timestamp, 0.7));
+
+    // three windows with headroom step back up, the last step down first.
+    EXPECT_FALSE(run_window(governor, timestamp, 0.2));
+    EXPECT_FALSE(run_window(governor, timestamp, 0.2));
+    const auto event = run_window(governor, timestamp, 0.2);
+    ASSERT_TRUE(event);
+    EXPECT_FALSE(event->step_down);
+    EXPECT_EQ(event->step, av_governor_step::preset);
+    EXPECT_EQ(governor.get_level().preset, 1);
+    EXPECT_EQ(governor.get_video_meta().preset, video::preset::superfast);
+}
+
+TEST(test_overload_governor, test_only_fps_for_other_codecs)
+{
+    av_governor_config config;
+    config.window = 1s;
+
+    auto meta = create_meta();
+    meta.codec = video::codec::ffv1;
+    av_overload_governor governor(config, meta, 60);
+    auto timestamp = 0us;
+
+    const auto event = run_window(governor, timestamp, 1.5);
+    ASSERT_TRUE(event);
+    EXPECT_EQ(event->step, av_governor_step::fps);
+    EXPECT_EQ(governor.get_video_meta().width, 1920);
+}
@@ -0,0 +1,204 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <CamEncoder/av_packet_writer.h>
+#include <algorithm>
+#include <future>
+#include <vector>
+
+/*!
+ * A packet writer output that stalls until it is released, like a disk that hangs.
+ */
+class stalled_output
+{
+public:
+    stalled_output()
+        : release_future_(release_.get_future().share())
+    {
+    }
+
+    auto write_function() -> av_packet_writer::write_function
+    {
+        return [this](AVPacket *pkt) {
+            release_future_.wait();
+            written_.push_back(pkt->pts);
+            av_packet_unref(pkt);
+            return 0;
+        };
+    }
+
+    void release()
+    {
+        release_.set_value();
+    }
+
+    auto written() const -> const std::vector<int64_t> &
+    {
+        return written_;
+    }
+
+private:
+    std::promise<void> release_;
+    std::shared_future<void> release_future_;
+    std::vector<int64_t> written_;
+};
+
+static void push_test_packet(av_packet_writer &writer, int64_t pts, bool key, int stream_index = 0)
+{
+    AVPacket *pkt = av_packet_alloc();
+    av_new_packet(pkt, 64);
+    pkt->stream_index = stream_index;
+    pkt->pts = pts;
+    pkt->dts = pts;
+    if (key)
+        pkt->flags |= AV_PKT_FLAG_KEY;
+    writer.push(pkt);
+    av_packet_free(&pkt);
+}
+
+TEST(test_packet_writer, test_writes_in_order)
+{
+    stalled_output output;
+    output.release();
+
+    av_packet_writer writer(output.write_function(), {av_packet_queue_policy::block, 4});
+    for (int i = 0; i < 100; ++i)
+        push_test_packet(writer, i, i % 10 == 0);
+    writer.stop();
+
+    const auto &written = output.written();
+    ASSERT_EQ(written.size(), 100u);
+    for (int i = 0; i < 100; ++i)
+        EXPECT_EQ(written[i], i);
+
+    const auto stats = writer.get_stats();
+    EXPECT_EQ(stats.packets_written, 100u);
+    EXPECT_EQ(stats.packets_dropped, 0u);
+    EXPECT_EQ(stats.queue_depth, 0u);
+    EXPECT_LE(stats.max_queue_depth, 4u);
+}
+
+TEST(test_packet_writer, test_drop_non_key_when_stalled)
+{
+    stalled_output output;
+    av_packet_writer writer(output.write_function(), {av_packet_queue_policy::drop_non_key, 4});
+
+    // the writer takes the first packet and stalls on it, the queue fills with the next 4.
+    for (int i = 0; i < 5; ++i)
+        push_test_packet(writer, i, i == 0);
+
+    // everything up to the next key packet is dropped, even when the queue has room again.
+    push_test_packet(writer, 5, false);
+    output.release();
+    push_test_packet(writer, 6, false);
+    push_test_packet(writer, 7, true);
+    push_test_packet(writer, 8, false);
+    writer.stop();
+
+    const auto stats = writer.get_stats();
+    EXPECT_GE(stats.packets_dropped, 2u);
+    EXPECT_EQ(stats.packets_written + stats.packets_dropped, 9u);
+
+    // the packets that made it to the output never reference a dropped packet.
+    const auto &written = output.written();
+    ASSERT_FALSE(written.empty());
+    EXPECT_EQ(written.front(), 0);
+    EXPECT_EQ(std::count(written.begin(), written.end(), 5), 0);
+    EXPECT_EQ(std::count(written.begin(), written.end(), 6), 0);
+    EXPECT_EQ(std::count(written.begin(), written.end(), 7), 1);
+}
+
+TEST(test_packet_writer, test_drop_non_key_per_stream)
+{
+    stalled_output output;
+    av_packet_writer writer(output.write_function(), {av_packet_queue_policy::drop_non_key, 4});
+
+    for (int i = 0; i < 5; ++i)
+        push_test_packet(writer, i, i == 0);
+    push_test_packet(writer, 5, false);
+    output.release();
+
+    // a key packet of another stream does not end the drop of the video stream.
+    push_test_packet(writer, 100, true, 1);
+    push_test_packet(writer, 6, false);
+    push_test_packet(writer, 7, true);
+    push_test_packet(writer, 8, false);
+    writer.stop();
+
+    const auto &written = output.written();
+    EXPECT_EQ(std::count(written.begin(), written.end(), 5), 0);
+    EXPECT_EQ(std::count(written.begin(), written.end(), 6), 0);
+    EXPECT_EQ(std::count(written.begin(), written.end(), 100), 1);
+    EXPECT_EQ(std::count(written.begin(), written.end(), 7), 1);
+    EXPECT_EQ(std::count(written.begin(), written.end(), 8), 1);
+}
+
+TEST(test_packet_writer, test_spill_when_stalled)
+{
+    stalled_output output;
+    av_packet_writer writer(output.write_function(), {av_packet_queue_policy::spill, 4});
+
+    for (int i = 0; i < 20; ++i)
+        push_test_packet(writer, i, i == 0);
+
+    auto stats = writer.get_stats();
+    EXPECT_GT(stats.max_queue_depth, 4u);
+    EXPECT_GT(stats.packets_spilled, 0u);
+    EXPECT_EQ(stats.stall_count, 0u);
+
+    output.release();
+    writer.stop();
+
+    stats = writer.get_stats();
+    EXPECT_EQ(stats.packets_written, 20u);
+    EXPECT_EQ(stats.packets_dropped, 0u);
+}
+
+TEST(test_packet_writer, test_block_reports_stall)
+{
+    stalled_output output;
+    av_packet_writer writer(output.write_function(), {av_packet_queue_policy::block, 2});
+
+    auto release = std::async(std::launch::async, [&output]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        output.release();
+    });
+
+    for (int i = 0; i < 10; ++i)
+        push_test_packet(writer, i, i == 0);
+    writer.stop();
+
+    const auto stats = writer.get_stats();
+    EXPECT_EQ(stats.packets_written, 10u);
+    EXPECT_GE(stats.stall_count, 1u);
+    EXPECT_GT(stats.stall_time.count(), 0);
+}
+
+TEST(test_packet_writer, test_write_error_is_reported)
+{
+    av_packet_writer writer([](AVPacket *pkt) {
+        av_packet_unref(pkt);
+        return AVERROR(EIO);
+    }, {av_packet_queue_policy::block, 1});
+
+    push_test_packet(writer, 0, true);
+    writer.stop();
+
+    EXPECT_EQ(writer.get_error(), AVERROR(EIO));
+    EXPECT_THROW(push_test_packet(writer, 1, false), std::runtime_error);
+}
@@ -0,0 +1,100 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <CamEncoder/av_pixel_format.h>
+#include <vector>
+
+static_assert(pixel_format::get_info(AV_PIX_FMT_BGR24).bytes_per_pixel == 3);
+static_assert(pixel_format::get_info(AV_PIX_FMT_BGR0).bytes_per_pixel == 4);
+static_assert(pixel_format::get_info(AV_PIX_FMT_RGB555LE).bits_per_pixel == 16);
+static_assert(pixel_format::get_info(AV_PIX_FMT_YUV420P).planar);
+static_assert(!pixel_format::get_info(AV_PIX_FMT_NV12).known);
+
+static auto create_test_frame(int width, int height, int bytes_per_pixel) -> std::vector<uint8_t>
+{
+    std::vector<uint8_t> frame(static_cast<size_t>(width) * height * bytes_per_pixel);
+    for (size_t i = 0; i < frame.size(); ++i)
+        frame[i] = static_cast<uint8_t>(i * 31 + (i >> 8));
+    return frame;
+}
+
+TEST(test_pixel_format, test_convert_bgra_to_bgr24_flipped)
+{
+    const int width = 7;
+    const int height = 5;
+    const auto src = create_test_frame(width, height, 4);
+    std::vector<uint8_t> dst(width * height * 3);
+
+    const auto kernel = pixel_format::select_convert_kernel(AV_PIX_FMT_BGRA, AV_PIX_FMT_BGR24, true);
+    ASSERT_NE(kernel, nullptr);
+    kernel(src.data(), width * 4, dst.data(), width * 3, width, height);
+
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            for (int c = 0; c < 3; ++c)
+                ASSERT_EQ(dst[(y * width + x) * 3 + c], src[((height - 1 - y) * width + x) * 4 + c]);
+}
+
+TEST(test_pixel_format, test_convert_bgr24_to_rgba)
+{
+    const int width = 9;
+    const int height = 3;
+    const auto src = create_test_frame(width, height, 3);
+    std::vector<uint8_t> dst(width * height * 4);
+
+    const auto kernel = pixel_format::select_convert_kernel(AV_PIX_FMT_BGR24, AV_PIX_FMT_RGBA, false);
+    ASSERT_NE(kernel, nullptr);
+    kernel(src.data(), width * 3, dst.data(), width * 4, width, height);
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        ASSERT_EQ(dst[i * 4 + 0], src[i * 3 + 2]);
+        ASSERT_EQ(dst[i * 4 + 1], src[i * 3 + 1]);
+        ASSERT_EQ(dst[i * 4 + 2], src[i * 3 + 0]);
+        ASSERT_EQ(dst[i * 4 + 3], 0xff);
+    }
+}
+
+TEST(test_pixel_format, test_no_kernel_for_planar_formats)
+{
+    EXPECT_EQ(pixel_format::select_convert_kernel(AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV420P, false), nullptr);
+    EXPECT_EQ(pixel_format::select_delta_kernel(AV_PIX_FMT_YUV420P), nullptr);
+}
+
+TEST(test_pixel_format, test_delta_frame)
+{
+    // an odd size so both the 8 byte and the byte loop are used.
+    const int line_size = 13 * 3;
+    const int height = 3;
+    const auto current = create_test_frame(13, height, 3);
+    auto previous = create_test_frame(13, height, 3);
+    for (auto &value : previous)
+        value = static_cast<uint8_t>(value * 7 + 3);
+    const auto original_previous = previous;
+    std::vector<uint8_t> delta(current.size());
+
+    const auto kernel = pixel_format::select_delta_kernel(AV_PIX_FMT_BGR24);
+    ASSERT_NE(kernel, nullptr);
+    kernel(current.data(), previous.data(), delta.data(), line_size, height);
+
+    for (size_t i = 0; i < current.size(); ++i)
+    {
+        ASSERT_EQ(delta[i], static_cast<uint8_t>(current[i] - original_previous[i]));
+        ASSERT_EQ(previous[i], current[i]);
+    }
+}
@@ -0,0 +1,74 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <CamEncoder/av_replay_buffer.h>
+
+// push 10 gops of 25 packets of 1000 bytes, at 25 fps.
+static auto push_gops(av_replay_config config) -> av_replay_stats
+{
+    AVFormatContext *context = avformat_alloc_context();
+    AVStream *stream = avformat_new_stream(context, nullptr);
+    stream->time_base = {1, 25};
+
+    av_replay_stats stats;
+    {
+        av_replay_buffer buffer("matroska", config, {stream}, 0, {}, {}, false, {});
+        for (int i = 0; i < 250; ++i)
+        {
+            AVPacket *pkt = av_packet_alloc();
+            av_new_packet(pkt, 1000);
+            pkt->pts = pkt->dts = i;
+            pkt->duration = 1;
+            if (i % 25 == 0)
+                pkt->flags |= AV_PKT_FLAG_KEY;
+
+            EXPECT_EQ(buffer.push(pkt), 0);
+            av_packet_free(&pkt);
+        }
+        stats = buffer.get_stats();
+    }
+
+    avformat_free_context(context);
+    return stats;
+}
+
+TEST(test_replay_buffer, test_memory_limit_keeps_several_gops)
+{
+    av_replay_config config;
+    config.duration = 100.0;
+    config.memory_limit = 3 * 25 * 1000 + 500;
+    const auto stats = push_gops(config);
+
+    // only the gops that do not fit are dropped, not every gop but the last.
+    EXPECT_EQ(stats.keyframe_count, 3u);
+    EXPECT_EQ(stats.packet_count, 75u);
+    EXPECT_EQ(stats.memory, 75000u);
+    EXPECT_EQ(stats.packets_pruned, 175u);
+}
+
+TEST(test_replay_buffer, test_duration_keeps_covering_gops)
+{
+    av_replay_config config;
+    config.duration = 2.5;
+    const auto stats = push_gops(config);
+
+    // the gop is 1 second, the window starts at the keyframe that still covers 2.5 seconds.
+    EXPECT_EQ(stats.keyframe_count, 3u);
+    EXPECT_EQ(stats.packet_count, 75u);
+    EXPECT_NEAR(stats.duration, 2.96, 0.001);
+}
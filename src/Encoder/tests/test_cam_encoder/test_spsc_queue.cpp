@@ -0,0 +1,135 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <CamEncoder/av_muxer.h>
+#include <CamEncoder/av_spsc_queue.h>
+#include "test_utilities.h"
+#include <thread>
+#include <vector>
+
+TEST(test_spsc_queue, test_threaded_order)
+{
+    constexpr int item_count = 1000000;
+    av_spsc_queue<int> queue(5);
+    EXPECT_EQ(queue.capacity(), 8u);
+
+    std::thread producer([&queue]() {
+        for (int value = 0; value < item_count;)
+        {
+            if (queue.try_push(value))
+                ++value;
+            else
+                std::this_thread::yield();
+        }
+        queue.close();
+    });
+
+    // the items arrive complete and in order, the consumer parks whenever the queue runs empty.
+    int expected = 0;
+    for (int value = 0; queue.pop(value);)
+        ASSERT_EQ(value, expected++);
+
+    producer.join();
+    EXPECT_EQ(expected, item_count);
+}
+
+TEST(test_spsc_queue, test_full_and_closed)
+{
+    av_spsc_queue<int> queue(2);
+    EXPECT_TRUE(queue.try_push(1));
+    EXPECT_TRUE(queue.try_push(2));
+    EXPECT_FALSE(queue.try_push(3));
+    EXPECT_EQ(queue.size(), 2u);
+
+    // a closed queue still hands out what is left.
+    queue.close();
+    int value = 0;
+    EXPECT_TRUE(queue.pop(value));
+    EXPECT_EQ(value, 1);
+    EXPECT_TRUE(queue.pop(value));
+    EXPECT_EQ(value, 2);
+    EXPECT_FALSE(queue.pop(value));
+}
+
+// convert frames on one thread and encode them on another, like the capture pipeline does.
+TEST(test_spsc_queue, test_convert_encode_pipeline)
+{
+    const auto config = create_video_config(video::codec::x264, 64, 64, 25);
+    const auto filename = std::string("test_pipeline.mkv");
+    constexpr int frame_count = 100;
+    constexpr size_t pool_size = 3;
+    {
+        av_metadata metadata{"test"};
+        av_muxer muxer(filename, av_muxer_type::mkv, metadata);
+        muxer.add_stream(create_video_codec(config, AV_PIX_FMT_BGR24));
+        muxer.open();
+
+        std::vector<AVFrame *> pool;
+        av_spsc_queue<AVFrame *> free_queue(pool_size);
+        av_spsc_queue<AVFrame *> encode_queue(pool_size);
+        for (size_t i = 0; i < pool_size; ++i)
+        {
+            pool.push_back(muxer.alloc_video_frame(0));
+            free_queue.try_push(pool.back());
+        }
+
+        std::thread encoder([&]() {
+            for (AVFrame *frame = nullptr; encode_queue.pop(frame);)
+            {
+                muxer.encode_converted_frames({frame});
+                free_queue.try_push(frame);
+            }
+        });
+
+        auto frame = create_bmpinfo(config.width, config.height, AV_PIX_FMT_BGR24);
+        for (int i = 0; i < frame_count; ++i)
+        {
+            AVFrame *converted = nullptr;
+            while (!free_queue.try_pop(converted))
+                std::this_thread::yield();
+
+            fill_bmpinfo(frame, i, AV_PIX_FMT_BGR24);
+            muxer.convert_frame(0, {reinterpret_cast<unsigned char *>(frame->bmiColors),
+                config.width, config.height, config.width * 3}, static_cast<timestamp_t>(i) * 40000,
+                converted);
+            encode_queue.try_push(converted);
+        }
+        free(frame);
+
+        encode_queue.close();
+        encoder.join();
+
+        for (auto &pool_frame : pool)
+            av_frame_free(&pool_frame);
+    }
+
+    AVFormatContext *format_context = nullptr;
+    ASSERT_GE(avformat_open_input(&format_context, filename.c_str(), nullptr, nullptr), 0);
+
+    int packet_count = 0;
+    AVPacket pkt = {};
+    av_init_packet(&pkt);
+    while (av_read_frame(format_context, &pkt) >= 0)
+    {
+        ++packet_count;
+        av_packet_unref(&pkt);
+    }
+    avformat_close_input(&format_context);
+
+    EXPECT_EQ(packet_count, frame_count);
+}
@@ -0,0 +1,152 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <CamEncoder/av_muxer.h>
+#include "test_utilities.h"
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <csignal>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// record frame_count frames of noise at 25fps, with the extra outputs of muxer_config.
+static auto record_with_tee(const std::string &filename, av_muxer_type muxer_type,
+    const av_muxer_config &muxer_config, int frame_count, int size = 64)
+    -> std::vector<av_tee_sink_stats>
+{
+    const auto config = create_video_config(video::codec::x264, size, size, 25);
+
+    av_metadata metadata{"test"};
+    av_muxer muxer(filename.c_str(), muxer_type, metadata, muxer_config);
+    muxer.add_stream(create_video_codec(config, AV_PIX_FMT_BGR24));
+    muxer.open();
+
+    std::minstd_rand random;
+    std::vector<unsigned char> frame(config.width * config.height * 3);
+    for (int i = 0; i < frame_count; ++i)
+    {
+        std::generate(frame.begin(), frame.end(), [&]() { return static_cast<unsigned char>(random()); });
+        muxer.encode_frame(static_cast<timestamp_t>(i) * 40000, frame.data(), config.width,
+            config.height, config.width * 3);
+    }
+
+    // the sinks open on their writer thread, a failure shows once the writers are done.
+    muxer.finish();
+    return muxer.get_tee_stats();
+}
+
+TEST(test_tee_sink, test_tee_output)
+{
+    av_muxer_config muxer_config;
+    muxer_config.tee.push_back({"test_tee_copy.mkv", "matroska"});
+    muxer_config.tee.push_back({"test_tee_copy.ts", "mpegts"});
+    // a sink that can't be opened does not affect the other outputs.
+    muxer_config.tee.push_back({"does_not_exist/test_tee.mkv", "matroska"});
+
+    const auto stats = record_with_tee("test_tee.mp4", av_muxer_type::mp4, muxer_config, 100);
+
+    ASSERT_EQ(stats.size(), 3u);
+    EXPECT_FALSE(stats[0].failed);
+    EXPECT_FALSE(stats[1].failed);
+    EXPECT_TRUE(stats[2].failed);
+    EXPECT_EQ(stats[0].packets_lost, 0u);
+    EXPECT_EQ(stats[2].writer.packets_written, 0u);
+
+    const auto main_output = read_stream_timestamps("test_tee.mp4");
+    const auto mkv_copy = read_stream_timestamps("test_tee_copy.mkv");
+    const auto ts_copy = read_stream_timestamps("test_tee_copy.ts");
+    ASSERT_EQ(main_output.pts.size(), 100u);
+    ASSERT_EQ(mkv_copy.pts.size(), 100u);
+    ASSERT_EQ(ts_copy.pts.size(), 100u);
+
+    // each output has its own time base, but every packet has the same timing, also the ones
+    // queued before the sink wrote its header and picked its time base.
+    const auto seconds = [](const stream_timestamps &stream, size_t i) {
+        return (stream.pts[i] - stream.pts.front()) * av_q2d(stream.time_base);
+    };
+    for (size_t i = 0; i < 100; ++i)
+    {
+        EXPECT_NEAR(seconds(main_output, i), i * 0.04, 0.002);
+        EXPECT_NEAR(seconds(mkv_copy, i), i * 0.04, 0.002);
+        EXPECT_NEAR(seconds(ts_copy, i), i * 0.04, 0.002);
+    }
+}
+
+#if !defined(_WIN32)
+TEST(test_tee_sink, test_tee_fifo_without_reader)
+{
+    const auto fifo_filename = "test_tee_fifo";
+    ::unlink(fifo_filename);
+    ASSERT_EQ(::mkfifo(fifo_filename, 0600), 0);
+
+    av_muxer_config muxer_config;
+    muxer_config.tee.push_back({fifo_filename, "mpegts"});
+
+    // without a reader the sink fails, instead of blocking the writer and the recording.
+    const auto stats = record_with_tee("test_tee_fifo.mkv", av_muxer_type::mkv, muxer_config, 50);
+    ::unlink(fifo_filename);
+
+    ASSERT_EQ(stats.size(), 1u);
+    EXPECT_TRUE(stats[0].failed);
+    EXPECT_EQ(stats[0].error, AVERROR(ENXIO));
+    EXPECT_EQ(stats[0].writer.packets_written, 0u);
+    EXPECT_EQ(read_stream_timestamps("test_tee_fifo.mkv").pts.size(), 50u);
+}
+
+TEST(test_tee_sink, test_tee_fifo_reader_goes_away)
+{
+    const auto fifo_filename = "test_tee_fifo_closed";
+    ::unlink(fifo_filename);
+    ASSERT_EQ(::mkfifo(fifo_filename, 0600), 0);
+
+    // the reader takes the first data and goes away, the writes after that fail with EPIPE.
+    const auto reader_fd = ::open(fifo_filename, O_RDONLY | O_NONBLOCK);
+    ASSERT_GE(reader_fd, 0);
+    std::thread reader([reader_fd]() {
+        char buffer[4096];
+        while (::read(reader_fd, buffer, sizeof(buffer)) <= 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ::close(reader_fd);
+    });
+
+    av_muxer_config muxer_config;
+    muxer_config.tee.push_back({fifo_filename, "mpegts"});
+
+    // noise does not compress, so the sink writes long before it is closed.
+    const auto stats = record_with_tee("test_tee_fifo_closed.mkv", av_muxer_type::mkv, muxer_config,
+        100, 256);
+    reader.join();
+    ::unlink(fifo_filename);
+
+    ASSERT_EQ(stats.size(), 1u);
+    EXPECT_TRUE(stats[0].failed);
+    EXPECT_EQ(stats[0].error, AVERROR(EPIPE));
+    EXPECT_EQ(read_stream_timestamps("test_tee_fifo_closed.mkv").pts.size(), 100u);
+
+    // the sink only failed, the signal disposition of the process is left alone.
+    struct sigaction action = {};
+    ASSERT_EQ(sigaction(SIGPIPE, nullptr, &action), 0);
+    EXPECT_EQ(action.sa_handler, SIG_DFL);
+}
+#endif
@@ -1,6 +1,66 @@
 #pragma once
 
 #include <CamEncoder/av_video.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static av_video_meta create_video_config(video::codec codec, const int width,
+                                         const int height, const int fps)
+{
+    av_video_meta meta;
+    meta.codec = codec;
+    meta.quality = 25;
+    meta.bpp = 24;
+    meta.width = width;
+    meta.height = height;
+    meta.fps = {fps, 1};
+    meta.preset = video::preset::ultrafast;  // configure 'almost' realtime video encoding
+    meta.profile = video::profile::baseline; // lets try 264 baseline
+    //meta.profile = video::profile::high; // lets try 264 baseline
+    meta.tune = video::tune::zerolatency;
+    return meta;
+}
+
+static std::unique_ptr<av_video> create_video_codec(const av_video_meta &meta, AVPixelFormat pixel_format)
+{
+    av_video_codec video_codec_config;
+    video_codec_config.pixel_format = pixel_format;
+
+    return std::make_unique<av_video>(video_codec_config, meta);
+}
+
+struct stream_timestamps
+{
+    AVRational time_base{0, 1};
+    std::vector<int64_t> pts;
+};
+
+// read back the packet timestamps of the first stream in a file.
+static stream_timestamps read_stream_timestamps(const std::string &filename)
+{
+    AVFormatContext *format_context = nullptr;
+    if (avformat_open_input(&format_context, filename.c_str(), nullptr, nullptr) < 0)
+        throw std::runtime_error("unable to open the recorded file");
+
+    stream_timestamps result;
+    result.time_base = format_context->streams[0]->time_base;
+
+    AVPacket pkt = {};
+    av_init_packet(&pkt);
+    while (av_read_frame(format_context, &pkt) >= 0)
+    {
+        result.pts.push_back(pkt.pts);
+        av_packet_unref(&pkt);
+    }
+
+    avformat_close_input(&format_context);
+    return result;
+}
+
+// the frame helpers fill a windows DIB.
+#if defined(_WIN32)
 #include <windows.h>
 
 #pragma pack(1)
@@ -26,16 +86,10 @@ struct rgba
 
 static int get_pixel_size(AVPixelFormat pixel_format)
 {
-    switch(pixel_format)
-    {
-    case AV_PIX_FMT_RGB555LE: return 2;
-    case AV_PIX_FMT_BGR24: return 3;
-    case AV_PIX_FMT_BGRA:
-        [[fallthrough]];
-    case AV_PIX_FMT_BGR0: return 4;
-    default:
+    const auto info = pixel_format::get_info(pixel_format);
+    if (info.planar || info.bytes_per_pixel == 0)
         throw std::runtime_error("unable to get pixel size, invalid pixel format");
-    }
+    return info.bytes_per_pixel;
 }
 
 static void fill_bmpinfo(BITMAPINFO *frame, int index, AVPixelFormat pixel_format = AV_PIX_FMT_BGR24)
@@ -100,3 +154,5 @@ static BITMAPINFO *create_bmpinfo(int width, int height, AVPixelFormat pixel_for
     fill_bmpinfo(frame, 0, pixel_format);
     return frame;
 }
+
+#endif
@@ -43,3 +43,59 @@ TEST(test_video_encoder, test_create_h264_encoder)
         frame->bmiHeader.biHeight, frame->bmiHeader.biWidth);
     free(frame);
 }
+
+TEST(test_video_encoder, test_negotiate_passthrough_pixel_format)
+{
+    const auto &cscd = av_codec_registry::get().find(video::codec::camstudio);
+
+    const auto bgr24 = negotiate_pixel_format(cscd, AV_PIX_FMT_BGR24);
+    EXPECT_FALSE(bgr24.conversion_required);
+    EXPECT_EQ(bgr24.output_pixel_format, AV_PIX_FMT_BGR24);
+
+    // bgra and bgr0 only differ in the meaning of the 4th byte.
+    const auto bgra = negotiate_pixel_format(cscd, AV_PIX_FMT_BGRA);
+    EXPECT_FALSE(bgra.conversion_required);
+    EXPECT_EQ(bgra.output_pixel_format, AV_PIX_FMT_BGR0);
+}
+
+TEST(test_video_encoder, test_negotiate_converted_pixel_format)
+{
+    const auto &x264 = av_codec_registry::get().find(video::codec::x264);
+
+    const auto bgra = negotiate_pixel_format(x264, AV_PIX_FMT_BGRA);
+    EXPECT_TRUE(bgra.conversion_required);
+    EXPECT_EQ(bgra.output_pixel_format, AV_PIX_FMT_YUV420P);
+    EXPECT_NE(bgra.loss & FF_LOSS_RESOLUTION, 0);
+}
+
+TEST(test_video_encoder, test_low_latency_keeps_tune_and_keyframes)
+{
+    const auto &x264 = av_codec_registry::get().find(video::codec::x264);
+
+    auto meta = create_video_config(video::codec::x264, 64, 64, 25);
+    meta.tune = video::tune::animation;
+    meta.low_latency = true;
+
+    AVCodecContext *context = avcodec_alloc_context3(nullptr);
+    av_dict av_opts;
+    x264.apply_options(meta, context, av_opts);
+
+    EXPECT_STREQ(av_opts.at("tune")->value, "animation,zerolatency");
+    EXPECT_THROW(av_opts.at("intra-refresh"), std::out_of_range);
+    EXPECT_GT(context->gop_size, 0);
+    EXPECT_EQ(context->max_b_frames, 0);
+    avcodec_free_context(&context);
+}
+
+TEST(test_video_encoder, test_negotiate_opaque_pixel_format)
+{
+    const auto &utvideo = av_codec_registry::get().find(video::codec::utvideo);
+
+    // a captured frame is opaque, encoding its alpha as a plane only costs time and space.
+    const auto bgra = negotiate_pixel_format(utvideo, AV_PIX_FMT_BGRA);
+    EXPECT_TRUE(bgra.conversion_required);
+    EXPECT_EQ(bgra.output_pixel_format, AV_PIX_FMT_GBRP);
+
+    const auto bgr24 = negotiate_pixel_format(utvideo, AV_PIX_FMT_BGR24);
+    EXPECT_EQ(bgr24.output_pixel_format, AV_PIX_FMT_GBRP);
+}
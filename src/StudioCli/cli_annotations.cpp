@@ -0,0 +1,77 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cli_annotations.h"
+#include <algorithm>
+#include <cstdint>
+
+static void fill_rect(cam_capture_buffer &frame, int left, int top, int right, int bottom,
+    uint32_t bgra)
+{
+    left = std::clamp(left, 0, frame.width);
+    right = std::clamp(right, 0, frame.width);
+    top = std::clamp(top, 0, frame.height);
+    bottom = std::clamp(bottom, 0, frame.height);
+
+    for (int y = top; y < bottom; ++y)
+    {
+        auto line = reinterpret_cast<uint32_t *>(frame.data + static_cast<size_t>(y) * frame.stride);
+        std::fill(line + left, line + right, bgra);
+    }
+}
+
+static void blend_halo(cam_capture_buffer &frame, const point<int> &center,
+    const cli_settings &settings)
+{
+    const auto &color = settings.cursor_halo_color;
+    const auto size = settings.cursor_halo_size;
+    const auto radius = size / 2;
+    const auto round = settings.cursor_halo_type == cli_halo_type::circle
+        || settings.cursor_halo_type == cli_halo_type::ellipse;
+
+    const auto left = std::max(center.x() - radius, 0);
+    const auto right = std::min(center.x() - radius + size, frame.width);
+    const auto top = std::max(center.y() - radius, 0);
+    const auto bottom = std::min(center.y() - radius + size, frame.height);
+
+    for (int y = top; y < bottom; ++y)
+    {
+        auto line = frame.data + static_cast<size_t>(y) * frame.stride;
+        for (int x = left; x < right; ++x)
+        {
+            const auto dx = x - center.x();
+            const auto dy = y - center.y();
+            if (round && dx * dx + dy * dy > radius * radius)
+                continue;
+
+            auto pixel = line + x * 4;
+            pixel[0] = static_cast<unsigned char>((color.b_ * color.a_ + pixel[0] * (255 - color.a_)) / 255);
+            pixel[1] = static_cast<unsigned char>((color.g_ * color.a_ + pixel[1] * (255 - color.a_)) / 255);
+            pixel[2] = static_cast<unsigned char>((color.r_ * color.a_ + pixel[2] * (255 - color.a_)) / 255);
+        }
+    }
+}
+
+void draw_cli_annotations(cam_capture_buffer &frame, const point<int> &cursor,
+    const cli_settings &settings)
+{
+    if (settings.cursor_halo_enabled)
+        blend_halo(frame, cursor, settings);
+
+    if (settings.cursor_enabled)
+        fill_rect(frame, cursor.x(), cursor.y(), cursor.x() + 8, cursor.y() + 8, 0xff000000);
+}
@@ -0,0 +1,28 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "cli_settings.h"
+#include <screen_capture/cam_icapture_source.h>
+
+/*!
+ * Draw the cursor annotations of settings into a captured frame. The halo is blended in software,
+ * and without a cursor image the cursor itself is drawn as a small block.
+ */
+void draw_cli_annotations(cam_capture_buffer &frame, const point<int> &cursor,
+    const cli_settings &settings);
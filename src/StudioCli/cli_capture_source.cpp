@@ -0,0 +1,45 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cli_capture_source.h"
+#include <screen_capture/cam_replay_capture.h>
+
+static auto create_screen_capture_source(cam_capture_backend backend, const cli_options &options,
+    const cam::rect<int> &capture_rect) -> std::unique_ptr<cam_icapture_source>
+{
+    if (options.monitor_capture == cli_monitor_capture::parallel)
+        return cam_create_monitor_capture_source(backend, capture_rect);
+
+    return cam_create_capture_source(backend, capture_rect);
+}
+
+auto create_cli_capture_source(const cli_options &options, const cam::rect<int> &capture_rect)
+    -> std::unique_ptr<cam_icapture_source>
+{
+    switch (options.backend)
+    {
+    case cli_capture_backend::pattern:
+        return create_pattern_capture_source(capture_rect);
+    case cli_capture_backend::gdi:
+        return create_screen_capture_source(cam_capture_backend::gdi, options, capture_rect);
+    case cli_capture_backend::x11:
+        return create_screen_capture_source(cam_capture_backend::x11, options, capture_rect);
+    case cli_capture_backend::replay:
+        return std::make_unique<cam_replay_capture_source>(options.input);
+    }
+    return {};
+}
@@ -0,0 +1,33 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "cli_options.h"
+#include <screen_capture/cam_icapture_source.h>
+#include <screen_capture/cam_rect.h>
+#include <memory>
+
+/*!
+ * Create the capture source of the backend in options. An empty capture rect captures the whole
+ * (virtual) screen, or a 1280x720 pattern. A replay always has the size of its input.
+ */
+auto create_cli_capture_source(const cli_options &options, const cam::rect<int> &capture_rect)
+    -> std::unique_ptr<cam_icapture_source>;
+
+auto create_pattern_capture_source(const cam::rect<int> &capture_rect)
+    -> std::unique_ptr<cam_icapture_source>;
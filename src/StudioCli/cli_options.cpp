@@ -0,0 +1,224 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cli_options.h"
+#include <screen_capture/cam_icapture_source.h>
+#include <fmt/format.h>
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <stdexcept>
+#include <string_view>
+
+constexpr std::array<const char *, 5> codec_names = {
+    "x264",
+    "camstudio",
+    "ffv1",
+    "utvideo",
+    "av1"
+};
+
+constexpr std::array<const char *, 4> backend_names = {
+    "pattern",
+    "gdi",
+    "x11",
+    "replay"
+};
+
+constexpr std::array<const char *, 2> monitor_capture_names = {
+    "single",
+    "parallel"
+};
+
+constexpr std::array<const char *, 2> replay_speed_names = {
+    "recorded",
+    "unlimited"
+};
+
+template<typename T, size_t Size>
+static auto parse_name(std::string_view option, std::string_view value,
+    const std::array<const char *, Size> &names) -> T
+{
+    const auto itr = std::find(names.begin(), names.end(), value);
+    if (itr == names.end())
+        throw std::runtime_error(fmt::format("{}: unknown value '{}'", option, value));
+
+    return static_cast<T>(std::distance(names.begin(), itr));
+}
+
+static auto parse_int(std::string_view option, const std::string &value) -> int
+{
+    size_t length = 0;
+    int result = 0;
+    try
+    {
+        result = std::stoi(value, &length);
+    }
+    catch (const std::exception &)
+    {
+        length = 0;
+    }
+
+    if (length != value.size())
+        throw std::runtime_error(fmt::format("{}: '{}' is not a number", option, value));
+
+    return result;
+}
+
+// left,top,right,bottom like the capture_rect of the settings.
+static auto parse_region(std::string_view option, const std::string &value) -> cam::rect<int>
+{
+    std::array<int, 4> values{};
+    size_t begin = 0;
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        const auto end = value.find(',', begin);
+        if ((end == std::string::npos) != (i == values.size() - 1))
+            throw std::runtime_error(fmt::format("{}: expected left,top,right,bottom", option));
+
+        values[i] = parse_int(option, value.substr(begin, end - begin));
+        begin = end + 1;
+    }
+
+    const cam::rect<int> region(values[0], values[1], values[2], values[3]);
+    if (region.width() <= 0 || region.height() <= 0)
+        throw std::runtime_error(fmt::format("{}: the region is empty", option));
+
+    return region;
+}
+
+auto parse_cli_options(int argc, char **argv) -> cli_options
+{
+    cli_options options;
+
+    switch (cam_get_default_capture_backend())
+    {
+    case cam_capture_backend::gdi: options.backend = cli_capture_backend::gdi; break;
+    case cam_capture_backend::x11: options.backend = cli_capture_backend::x11; break;
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view option = argv[i];
+        if (option == "-h" || option == "--help")
+        {
+            options.show_help = true;
+            return options;
+        }
+
+        if (option == "--fragmented")
+        {
+            options.fragmented_mp4 = true;
+            continue;
+        }
+
+        if (i + 1 == argc)
+            throw std::runtime_error(fmt::format("{}: missing value", option));
+
+        const std::string value = argv[++i];
+        if (option == "-o" || option == "--output")
+            options.output = value;
+        else if (option == "--settings")
+            options.settings_file = value;
+        else if (option == "-d" || option == "--duration")
+            options.duration = std::chrono::seconds(parse_int(option, value));
+        else if (option == "--region")
+            options.region = parse_region(option, value);
+        else if (option == "--codec")
+            options.codec = parse_name<video::codec>(option, value, codec_names);
+        else if (option == "--preset")
+            options.preset = parse_name<video::preset>(option, value, video::preset_names);
+        else if (option == "--quality")
+            options.quality = parse_int(option, value);
+        else if (option == "--fps")
+            options.fps = parse_int(option, value);
+        else if (option == "--source")
+            options.backend = parse_name<cli_capture_backend>(option, value, backend_names);
+        else if (option == "--monitors")
+            options.monitor_capture = parse_name<cli_monitor_capture>(option, value, monitor_capture_names);
+        else if (option == "-i" || option == "--input")
+        {
+            options.input = value;
+            options.backend = cli_capture_backend::replay;
+        }
+        else if (option == "--speed")
+            options.replay_speed = parse_name<cli_replay_speed>(option, value, replay_speed_names);
+        else
+            throw std::runtime_error(fmt::format("unknown option '{}'", option));
+    }
+
+    if (options.output.empty())
+        throw std::runtime_error("--output is required");
+
+    if (options.backend == cli_capture_backend::replay && options.input.empty())
+        throw std::runtime_error("--source replay: needs an --input file");
+
+    if (options.duration && *options.duration <= std::chrono::milliseconds(0))
+        throw std::runtime_error("--duration: needs at least a second");
+
+    if (options.fps <= 0)
+        throw std::runtime_error("--fps: needs at least 1 frame per second");
+
+    return options;
+}
+
+auto get_cli_usage() -> std::string
+{
+    return
+        "usage: CamStudioCli --output <file> [options]\n"
+        "\n"
+        "  -o, --output <file>       the recording, the extension selects the container\n"
+        "                            (mp4, mkv, avi, ts or nut), .camraw stores the raw frames\n"
+        "                            to replay them later\n"
+        "      --settings <file>     a settings.toml of the recorder, for the capture rect and\n"
+        "                            the cursor annotations\n"
+        "  -d, --duration <seconds>  the length of the recording (default 10, a replay runs\n"
+        "                            until the end of its input)\n"
+        "      --region <l,t,r,b>    the captured rect, overrides the settings\n"
+        "      --codec <codec>       x264, camstudio, ffv1, utvideo or av1 (default x264)\n"
+        "      --preset <preset>     the x264 preset, ultrafast .. veryslow\n"
+        "      --quality <crf>       the constant quality (default 25)\n"
+        "      --fps <fps>           frames per second (default 30)\n"
+        "      --source <source>     pattern, gdi, x11 or replay (default gdi on windows,\n"
+        "                            otherwise x11)\n"
+        "      --monitors <mode>     grab the monitors at once (single) or every monitor on its\n"
+        "                            own thread (parallel), for gdi and x11 (default single)\n"
+        "  -i, --input <file>        replay the frames of a .camraw file\n"
+        "      --speed <speed>       replay at the recorded speed or unlimited (default recorded)\n"
+        "      --fragmented          write an mp4 as fragments, an interrupted recording stays\n"
+        "                            playable\n"
+        "  -h, --help                show this help\n";
+}
+
+auto is_cli_raw_output(const std::string &filename) -> bool
+{
+    return std::filesystem::path(filename).extension() == ".camraw";
+}
+
+auto get_cli_muxer_type(const std::string &filename) -> av_muxer_type
+{
+    const auto extension = std::filesystem::path(filename).extension().string();
+    if (extension == ".mp4")
+        return av_muxer_type::mp4;
+    if (extension == ".avi")
+        return av_muxer_type::avi;
+    if (extension == ".ts")
+        return av_muxer_type::mpegts;
+    if (extension == ".nut")
+        return av_muxer_type::nut;
+    return av_muxer_type::mkv;
+}
@@ -0,0 +1,86 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <CamEncoder/av_config.h>
+#include <CamEncoder/av_muxer.h>
+#include <screen_capture/cam_rect.h>
+#include <chrono>
+#include <optional>
+#include <string>
+
+enum class cli_capture_backend
+{
+    pattern, // a generated test pattern, available everywhere.
+    gdi,
+    x11,
+    replay // the frames of a raw frame file, see --input.
+};
+
+enum class cli_monitor_capture
+{
+    single,  // grab all monitors at once.
+    parallel // grab every monitor on its own thread.
+};
+
+enum class cli_replay_speed
+{
+    recorded, // wait for the recorded timestamp of every frame.
+    unlimited // as fast as the pipeline goes, to measure its throughput.
+};
+
+struct cli_options
+{
+    // the recording, or a raw frame file when the extension is .camraw.
+    std::string output;
+    std::optional<std::string> settings_file;
+
+    // 10 seconds by default, a replay runs until the end of its file.
+    std::optional<std::chrono::milliseconds> duration;
+    // overrides the capture rect of the settings.
+    std::optional<cam::rect<int>> region;
+
+    video::codec codec{video::codec::x264};
+    std::optional<video::preset> preset;
+    // the constant quality (crf) of the codecs that support it.
+    int quality{25};
+    int fps{30};
+    // the capture backend of the platform by default.
+    cli_capture_backend backend{cli_capture_backend::pattern};
+    cli_monitor_capture monitor_capture{cli_monitor_capture::single};
+    // the raw frame file of the replay backend.
+    std::string input;
+    cli_replay_speed replay_speed{cli_replay_speed::recorded};
+    // write an mp4 as fragments, so an interrupted recording is still playable.
+    bool fragmented_mp4{false};
+
+    bool show_help{false};
+};
+
+/*!
+ * Parse the command line, throws std::runtime_error on an unknown or invalid argument.
+ */
+auto parse_cli_options(int argc, char **argv) -> cli_options;
+
+auto get_cli_usage() -> std::string;
+
+// true when the output is a raw frame file instead of an encoded recording.
+auto is_cli_raw_output(const std::string &filename) -> bool;
+
+// the container that matches the extension of the output filename, mkv when there is none.
+auto get_cli_muxer_type(const std::string &filename) -> av_muxer_type;
@@ -0,0 +1,137 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cli_capture_source.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+/*!
+ * Generates a desktop like test pattern: a static background with a window that moves over it
+ * and a cursor that circles around.
+ */
+class cli_pattern_capture_source : public cam_icapture_source
+{
+public:
+    cli_pattern_capture_source(int width, int height);
+
+    auto get_capture_rect() const noexcept -> cam::rect<int> override;
+    bool capture_frame(cam_capture_buffer &buffer) override;
+    auto get_damage() const -> const std::vector<cam::rect<int>> & override;
+    auto get_cursor_position() const noexcept -> point<int> override;
+
+private:
+    int width_;
+    int height_;
+    std::vector<unsigned char> background_;
+    std::vector<cam::rect<int>> damage_;
+    point<int> cursor_position_;
+    int64_t frame_index_{0};
+};
+
+static void fill_rect(cam_capture_buffer &buffer, const cam::rect<int> &rect, uint32_t bgra)
+{
+    for (int y = std::max(rect.top(), 0); y < std::min(rect.bottom(), buffer.height); ++y)
+    {
+        auto line = reinterpret_cast<uint32_t *>(buffer.data + static_cast<size_t>(y) * buffer.stride);
+        std::fill(line + std::max(rect.left(), 0), line + std::min(rect.right(), buffer.width), bgra);
+    }
+}
+
+cli_pattern_capture_source::cli_pattern_capture_source(int width, int height)
+    : width_(width)
+    , height_(height)
+    , background_(static_cast<size_t>(width) * height * 4)
+{
+    /* a vertical gradient with a grid every 64 pixels, like a busy desktop background. */
+    const auto stride = width * 4;
+    for (int y = 0; y < height; ++y)
+    {
+        auto line = background_.data() + static_cast<size_t>(y) * stride;
+        for (int x = 0; x < width; ++x)
+        {
+            const auto grid = (x % 64 == 0 || y % 64 == 0) ? 0x40 : 0;
+            line[x * 4 + 0] = static_cast<unsigned char>(0x80 + grid);
+            line[x * 4 + 1] = static_cast<unsigned char>(y * 0x80 / height + grid);
+            line[x * 4 + 2] = static_cast<unsigned char>(0x20 + grid);
+            line[x * 4 + 3] = 0xff;
+        }
+    }
+
+    damage_.emplace_back(0, 0, width_, height_);
+}
+
+auto cli_pattern_capture_source::get_capture_rect() const noexcept -> cam::rect<int>
+{
+    return {0, 0, width_, height_};
+}
+
+bool cli_pattern_capture_source::capture_frame(cam_capture_buffer &buffer)
+{
+    if (buffer.width < width_ || buffer.height < height_ || buffer.stride < width_ * 4)
+        throw std::runtime_error("pattern capture source: the buffer is smaller than the pattern");
+
+    const auto line_size = static_cast<size_t>(width_) * 4;
+    for (int y = 0; y < height_; ++y)
+        std::memcpy(buffer.data + static_cast<size_t>(y) * buffer.stride,
+            background_.data() + y * line_size, line_size);
+
+    const auto window_width = std::max(width_ / 3, 1);
+    const auto window_height = std::max(height_ / 3, 1);
+
+    /* the window bounces between the left and right border, its contents scroll. */
+    const auto travel = std::max(width_ - window_width, 1);
+    const auto offset = static_cast<int>((frame_index_ * 4) % (travel * 2));
+    const auto left = offset < travel ? offset : travel * 2 - offset;
+    const auto top = height_ / 3;
+    fill_rect(buffer, {left, top, left + window_width, top + window_height}, 0xffe0e0e0);
+    for (int line = 0; line < window_height; line += 12)
+    {
+        const auto length = static_cast<int>((line * 7 + frame_index_ * 3) % window_width);
+        fill_rect(buffer, {left + 8, top + line + 4, left + 8 + length, top + line + 8}, 0xff202020);
+    }
+
+    constexpr auto pi = 3.14159265358979323846;
+    const auto angle = static_cast<double>(frame_index_) * pi / 90.0;
+    cursor_position_ = point<int>(
+        width_ / 2 + static_cast<int>(std::cos(angle) * width_ / 4),
+        height_ / 2 + static_cast<int>(std::sin(angle) * height_ / 4));
+
+    ++frame_index_;
+    return true;
+}
+
+auto cli_pattern_capture_source::get_damage() const -> const std::vector<cam::rect<int>> &
+{
+    return damage_;
+}
+
+auto cli_pattern_capture_source::get_cursor_position() const noexcept -> point<int>
+{
+    return cursor_position_;
+}
+
+auto create_pattern_capture_source(const cam::rect<int> &capture_rect)
+    -> std::unique_ptr<cam_icapture_source>
+{
+    if (capture_rect.width() <= 0 || capture_rect.height() <= 0)
+        return std::make_unique<cli_pattern_capture_source>(1280, 720);
+
+    return std::make_unique<cli_pattern_capture_source>(capture_rect.width(), capture_rect.height());
+}
@@ -0,0 +1,182 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cli_recorder.h"
+#include "cli_annotations.h"
+#include <algorithm>
+#include <thread>
+
+cli_recorder::cli_recorder(cam_icapture_source &capture_source, const cli_settings &settings,
+    cli_recorder_output output, cli_recorder_config config)
+    : capture_source_(capture_source)
+    , replay_source_(dynamic_cast<cam_replay_capture_source *>(&capture_source))
+    , settings_(settings)
+    , output_(output)
+    , config_(config)
+    , pacer_({config_.fps, config_.missed_frame_policy})
+{
+    stats_[static_cast<size_t>(cli_stage::capture)].name = "capture";
+    stats_[static_cast<size_t>(cli_stage::annotate)].name = "annotate";
+    stats_[static_cast<size_t>(cli_stage::convert)].name = "convert";
+    stats_[static_cast<size_t>(cli_stage::encode)].name = "encode";
+    stats_[static_cast<size_t>(cli_stage::write)].name = "write";
+
+    if (output_.muxer != nullptr)
+        converted_ = output_.muxer->alloc_video_frame(0);
+
+    /* a replay hands out the frames of its mapping, it needs no frame of its own. */
+    if (replay_source_ == nullptr)
+    {
+        const auto capture_rect = capture_source_.get_capture_rect();
+        frame_.width = capture_rect.width();
+        frame_.height = capture_rect.height();
+        frame_.stride = frame_.width * 4;
+        frame_data_.resize(static_cast<size_t>(frame_.stride) * frame_.height);
+        frame_.data = frame_data_.data();
+
+        // annotations draw on the frame before it is converted, raw frames are stored untouched.
+        frame_.keeps_previous_frame = output_.raw_writer != nullptr;
+    }
+}
+
+cli_recorder::~cli_recorder()
+{
+    av_frame_free(&converted_);
+}
+
+void cli_recorder::run(const std::atomic<bool> &run)
+{
+    replay_start_ = std::chrono::steady_clock::now();
+
+    while (run)
+    {
+        const auto frame = _next_frame(run);
+        if (frame == nullptr)
+            break;
+
+        if (output_.raw_writer != nullptr)
+            _write_frame(*frame);
+        else
+            _encode_frame(*frame);
+    }
+}
+
+auto cli_recorder::get_stage_stats() const noexcept -> const std::array<cli_stage_stats, 5> &
+{
+    return stats_;
+}
+
+auto cli_recorder::get_pacing_stats() const noexcept -> const cam::frame_pacer_stats &
+{
+    return pacer_.get_stats();
+}
+
+auto cli_recorder::_next_frame(const std::atomic<bool> &run) -> const cam_capture_buffer *
+{
+    using clock = std::chrono::steady_clock;
+
+    if (replay_source_ != nullptr)
+    {
+        const auto start = clock::now();
+        const auto frame = replay_source_->map_frame();
+        if (frame == nullptr)
+            return nullptr;
+
+        const auto timestamp = std::chrono::microseconds(replay_source_->get_timestamp());
+        if (timestamp >= config_.duration)
+            return nullptr;
+        _add_time(cli_stage::capture, clock::now() - start);
+
+        if (config_.replay_speed == cli_replay_speed::recorded)
+            std::this_thread::sleep_until(replay_start_ + timestamp);
+
+        timestamps_.assign(1, timestamp);
+        return frame;
+    }
+
+    while (run)
+    {
+        auto tick = pacer_.wait();
+        if (tick.timestamps.front() >= config_.duration)
+            return nullptr;
+
+        const auto start = clock::now();
+        if (!capture_source_.capture_frame(frame_))
+            continue;
+        _add_time(cli_stage::capture, clock::now() - start);
+
+        timestamps_ = std::move(tick.timestamps);
+        return &frame_;
+    }
+
+    return nullptr;
+}
+
+void cli_recorder::_encode_frame(cam_capture_buffer frame)
+{
+    using clock = std::chrono::steady_clock;
+
+    const auto cursor = capture_source_.get_cursor_position();
+    const auto unchanged = has_converted_ && capture_source_.get_damage().empty()
+        && cursor.x() == converted_cursor_.x() && cursor.y() == converted_cursor_.y();
+
+    auto start = clock::now();
+    if (!unchanged)
+    {
+        /* drawing on a replayed frame only copies the pages it touches, the file does not change. */
+        draw_cli_annotations(frame, cursor, settings_);
+        auto end = clock::now();
+        _add_time(cli_stage::annotate, end - start);
+
+        start = end;
+        const auto timestamp = static_cast<timestamp_t>(timestamps_.front().count());
+        output_.muxer->convert_frame(0, {frame.data, frame.width, frame.height, frame.stride},
+            timestamp, converted_);
+        end = clock::now();
+        _add_time(cli_stage::convert, end - start);
+
+        start = end;
+        has_converted_ = true;
+        converted_cursor_ = cursor;
+    }
+
+    /* the encoder references the frame, so a duplicate only needs another timestamp. */
+    for (const auto duplicate_timestamp : timestamps_)
+    {
+        converted_->pts = duplicate_timestamp.count();
+        output_.muxer->encode_converted_frames({converted_});
+    }
+    _add_time(cli_stage::encode, clock::now() - start);
+}
+
+void cli_recorder::_write_frame(const cam_capture_buffer &frame)
+{
+    /* a duplicate is not stored, on replay the frame simply lasts until the next one. */
+    const auto start = std::chrono::steady_clock::now();
+    output_.raw_writer->write_frame(frame, static_cast<uint64_t>(timestamps_.front().count()),
+        capture_source_.get_cursor_position());
+    _add_time(cli_stage::write, std::chrono::steady_clock::now() - start);
+}
+
+void cli_recorder::_add_time(cli_stage stage, std::chrono::steady_clock::duration duration)
+{
+    const auto time = std::chrono::duration_cast<std::chrono::microseconds>(duration);
+    auto &stats = stats_[static_cast<size_t>(stage)];
+    ++stats.frame_count;
+    stats.busy_time += time;
+    stats.max_time = std::max(stats.max_time, time);
+}
@@ -0,0 +1,115 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "cli_options.h"
+#include "cli_settings.h"
+#include <screen_capture/cam_frame_pacer.h>
+#include <screen_capture/cam_icapture_source.h>
+#include <screen_capture/cam_raw_frame_file.h>
+#include <screen_capture/cam_replay_capture.h>
+#include <CamEncoder/av_muxer.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+enum class cli_stage
+{
+    capture,
+    annotate,
+    convert,
+    encode,
+    write
+};
+
+struct cli_stage_stats
+{
+    const char *name{""};
+    int64_t frame_count{0};
+    std::chrono::microseconds busy_time{0};
+    std::chrono::microseconds max_time{0};
+};
+
+struct cli_recorder_config
+{
+    int fps{30};
+    std::chrono::milliseconds duration{std::chrono::seconds(10)};
+    cam::missed_frame_policy missed_frame_policy{cam::missed_frame_policy::skip};
+    cli_replay_speed replay_speed{cli_replay_speed::recorded};
+};
+
+// where the recorded frames go, either the muxer or the raw frame writer is set.
+struct cli_recorder_output
+{
+    av_muxer *muxer{nullptr};
+    cam_raw_frame_writer *raw_writer{nullptr};
+};
+
+/*!
+ * Records frames of a capture source into a muxer, one stage after the other on the calling
+ * thread. The stages are timed separately, so the slowest stage at a resolution is easy to spot.
+ *
+ * A replay is paced by its recorded timestamps, or not at all at unlimited speed. Its frames are
+ * annotated and converted straight from the mapped file. Raw frames are written without
+ * annotations, the cursor position is stored with the frame so they are drawn on replay.
+ *
+ * When the capture source reports no damage and the cursor did not move, the previous converted
+ * frame is encoded again, so an idle screen skips the annotate and convert stages.
+ */
+class cli_recorder
+{
+public:
+    cli_recorder(cam_icapture_source &capture_source, const cli_settings &settings,
+        cli_recorder_output output, cli_recorder_config config);
+    ~cli_recorder();
+    cli_recorder(const cli_recorder &) = delete;
+    cli_recorder &operator=(const cli_recorder &) = delete;
+
+    // record until the duration passed or run is false.
+    void run(const std::atomic<bool> &run);
+
+    auto get_stage_stats() const noexcept -> const std::array<cli_stage_stats, 5> &;
+    auto get_pacing_stats() const noexcept -> const cam::frame_pacer_stats &;
+
+private:
+    // the next frame and its timestamps, nullptr when the recording ends.
+    auto _next_frame(const std::atomic<bool> &run) -> const cam_capture_buffer *;
+    void _encode_frame(cam_capture_buffer frame);
+    void _write_frame(const cam_capture_buffer &frame);
+    void _add_time(cli_stage stage, std::chrono::steady_clock::duration duration);
+
+    cam_icapture_source &capture_source_;
+    // the capture source when it is a replay, its frames are mapped instead of captured.
+    cam_replay_capture_source *replay_source_;
+    const cli_settings &settings_;
+    cli_recorder_output output_;
+    cli_recorder_config config_;
+
+    std::vector<unsigned char> frame_data_;
+    cam_capture_buffer frame_;
+
+    cam::frame_pacer pacer_;
+    std::vector<std::chrono::microseconds> timestamps_;
+    std::chrono::steady_clock::time_point replay_start_;
+    AVFrame *converted_{nullptr};
+    // converted_ holds the frame and cursor of the previous capture.
+    bool has_converted_{false};
+    point<int> converted_cursor_;
+    std::array<cli_stage_stats, 5> stats_{};
+};
@@ -0,0 +1,101 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cli_settings.h"
+#include <cpptoml.h>
+#include <fmt/format.h>
+#include <stdexcept>
+
+// the keys of settings_model.
+namespace config
+{
+namespace capture
+{
+    constexpr auto settings = "capture-settings";
+    constexpr auto rect = "capture_rect";
+} // namespace capture
+
+namespace cursor
+{
+    constexpr auto settings = "cursor-settings";
+    constexpr auto enabled = "cursor_enabled";
+    constexpr auto halo_enabled = "cursor_halo_enabled";
+    constexpr auto halo_type = "cursor_halo_type";
+    constexpr auto halo_color = "cursor_halo_color";
+    constexpr auto halo_size = "cursor_halo_size";
+} // namespace cursor
+} // namespace config
+
+template<typename T>
+static auto get_optional(const cpptoml::table &table, const std::string &key, const T &default_value)
+{
+    if constexpr(std::is_enum_v<T>)
+        return static_cast<T>(table.get_as<int64_t>(key).value_or(static_cast<int64_t>(default_value)));
+    else
+        return table.get_as<T>(key).value_or(default_value);
+}
+
+static void load_capture_settings(const cpptoml::table &root, cli_settings &settings)
+{
+    const auto capture = root.get_table(config::capture::settings);
+    if (!capture)
+        return;
+
+    const auto rect = capture->get_array_of<int64_t>(config::capture::rect);
+    if (!rect)
+        return;
+
+    if (rect->size() != 4)
+        throw std::runtime_error(fmt::format("settings: {} needs 4 values", config::capture::rect));
+
+    settings.capture_rect = cam::rect<int>(
+        static_cast<int>(rect->at(0)),
+        static_cast<int>(rect->at(1)),
+        static_cast<int>(rect->at(2)),
+        static_cast<int>(rect->at(3))
+    );
+}
+
+static void load_cursor_settings(const cpptoml::table &root, cli_settings &settings)
+{
+    const auto cursor = root.get_table(config::cursor::settings);
+    if (!cursor)
+        return;
+
+    settings.cursor_enabled = get_optional(*cursor, config::cursor::enabled,
+        settings.cursor_enabled);
+    settings.cursor_halo_enabled = get_optional(*cursor, config::cursor::halo_enabled,
+        settings.cursor_halo_enabled);
+    settings.cursor_halo_type = get_optional(*cursor, config::cursor::halo_type,
+        settings.cursor_halo_type);
+    settings.cursor_halo_color = get_optional<uint32_t>(*cursor, config::cursor::halo_color,
+        settings.cursor_halo_color);
+    settings.cursor_halo_size = get_optional(*cursor, config::cursor::halo_size,
+        settings.cursor_halo_size);
+}
+
+auto load_cli_settings(const std::string &filename) -> cli_settings
+{
+    const auto root = cpptoml::parse_file(filename);
+    if (const auto version = root->get_as<int>("version"); version && *version != 1)
+        throw std::runtime_error(fmt::format("settings: unsupported version {}", *version));
+
+    cli_settings settings;
+    load_capture_settings(*root, settings);
+    load_cursor_settings(*root, settings);
+    return settings;
+}
@@ -0,0 +1,51 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <screen_capture/cam_color.h>
+#include <screen_capture/cam_rect.h>
+#include <string>
+
+// same values as cursor_halo_type of the recorder settings.
+enum class cli_halo_type
+{
+    circle,
+    ellipse,
+    square,
+    rectangle
+};
+
+/*!
+ * The part of the recorder settings the command line recorder uses, loaded from a settings.toml
+ * written by the recorder (see settings_model::load).
+ */
+struct cli_settings
+{
+    /* capture settings */
+    cam::rect<int> capture_rect{0, 0, 0, 0};
+
+    /* cursor settings */
+    bool cursor_enabled{true};
+    bool cursor_halo_enabled{false};
+    cli_halo_type cursor_halo_type{cli_halo_type::circle};
+    cam::color cursor_halo_color{0xa0FFFF80};
+    int cursor_halo_size{100};
+};
+
+// load the settings, missing tables and values keep their defaults.
+auto load_cli_settings(const std::string &filename) -> cli_settings;
@@ -0,0 +1,196 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cli_capture_source.h"
+#include "cli_options.h"
+#include "cli_recorder.h"
+#include "cli_settings.h"
+#include "buildinfo.h"
+#include <CamEncoder/av_muxer.h>
+#include <CamEncoder/av_video.h>
+#include <screen_capture/cam_raw_frame_file.h>
+#include <fmt/format.h>
+#include <atomic>
+#include <csignal>
+#include <exception>
+#include <memory>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <mmsystem.h>
+#endif
+
+static std::atomic<bool> run_recording{true};
+
+static void stop_recording(int /*signal*/)
+{
+    run_recording = false;
+}
+
+static auto create_video_config(const cli_options &options, const cam::rect<int> &capture_rect,
+    av_muxer_type muxer_type) -> av_video_meta
+{
+    av_video_meta meta;
+    meta.bpp = 24;
+    meta.width = capture_rect.width();
+    meta.height = capture_rect.height();
+    meta.fps = {options.fps, 1};
+    meta.codec = options.codec;
+    meta.preset = options.preset;
+    meta.quality = options.quality;
+
+    switch (muxer_type)
+    {
+    case av_muxer_type::avi: meta.container = video::container::avi; break;
+    case av_muxer_type::mp4: meta.container = video::container::mp4; break;
+    // the codecs that fit in mkv also fit in the other streamable containers.
+    default: meta.container = video::container::mkv; break;
+    }
+
+    return meta;
+}
+
+// muxer is nullptr when the raw frames were written.
+static void print_stats(const cli_recorder &recorder, const av_muxer *muxer,
+    const cam::rect<int> &capture_rect)
+{
+    /* the stage with the highest average time limits the frame rate at this resolution. */
+    fmt::print("{}x{}\n", capture_rect.width(), capture_rect.height());
+    for (const auto &stage : recorder.get_stage_stats())
+    {
+        if (stage.frame_count == 0)
+            continue;
+
+        const auto average = stage.frame_count > 0 ? stage.busy_time.count() / stage.frame_count : 0;
+        fmt::print("  {:<9} {:>6} frames, average {:>6}us, slowest {:>6}us\n", stage.name,
+            stage.frame_count, average, stage.max_time.count());
+    }
+
+    /* a replay is not paced by the frame pacer. */
+    const auto &pacing_stats = recorder.get_pacing_stats();
+    if (pacing_stats.frame_count > 0)
+        fmt::print("  pacing    {:>6} frames, missed {} frame deadlines, max jitter {}us\n",
+            pacing_stats.frame_count, pacing_stats.missed_count, pacing_stats.max_jitter.count());
+
+    if (muxer == nullptr)
+        return;
+
+    const auto writer_stats = muxer->get_writer_stats();
+    fmt::print("  writer    max queue depth {}, stalled {} times for {}us, slowest write {}us\n",
+        writer_stats.max_queue_depth, writer_stats.stall_count, writer_stats.stall_time.count(),
+        writer_stats.max_write_time.count());
+}
+
+static int record(const cli_options &options)
+{
+    cli_settings settings;
+    if (options.settings_file)
+        settings = load_cli_settings(*options.settings_file);
+
+    if (options.region)
+        settings.capture_rect = *options.region;
+
+    auto capture_source = create_cli_capture_source(options, settings.capture_rect);
+    const auto capture_rect = capture_source->get_capture_rect();
+
+    std::unique_ptr<av_muxer> muxer;
+    std::unique_ptr<cam_raw_frame_writer> raw_writer;
+    if (is_cli_raw_output(options.output))
+    {
+        raw_writer = std::make_unique<cam_raw_frame_writer>(options.output, capture_rect.width(),
+            capture_rect.height());
+    }
+    else
+    {
+        const auto muxer_type = get_cli_muxer_type(options.output);
+        const av_metadata metadata = {fmt::format("CamStudio {}", buildinfo::full_version)};
+
+        av_video_codec video_codec_config;
+        video_codec_config.pixel_format = AV_PIX_FMT_BGRA;
+
+        av_muxer_config muxer_config;
+        muxer_config.fragmented_mp4 = options.fragmented_mp4;
+
+        muxer = std::make_unique<av_muxer>(options.output, muxer_type, metadata, muxer_config);
+        muxer->add_stream(std::make_unique<av_video>(video_codec_config,
+            create_video_config(options, capture_rect, muxer_type)));
+        muxer->open();
+    }
+
+    cli_recorder_config config;
+    config.fps = options.fps;
+    config.replay_speed = options.replay_speed;
+    if (options.duration)
+        config.duration = *options.duration;
+    else if (options.backend == cli_capture_backend::replay)
+        // until the end of the input, compared against microsecond timestamps.
+        config.duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::microseconds::max());
+
+    std::signal(SIGINT, stop_recording);
+    std::signal(SIGTERM, stop_recording);
+
+#if defined(_WIN32)
+    /* the frame pacer sleeps until just before every frame deadline, which the default windows timer
+     * resolution of 15.6ms is not able to hit. */
+    ::timeBeginPeriod(1);
+#endif
+
+    cli_recorder recorder(*capture_source, settings, {muxer.get(), raw_writer.get()}, config);
+    recorder.run(run_recording);
+
+#if defined(_WIN32)
+    ::timeEndPeriod(1);
+#endif
+
+    /* the writer stats are only final after the writer wrote the last queued packet. */
+    if (muxer)
+        muxer->finish();
+
+    print_stats(recorder, muxer.get(), capture_rect);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    cli_options options;
+    try
+    {
+        options = parse_cli_options(argc, argv);
+    }
+    catch (const std::exception &e)
+    {
+        fmt::print(stderr, "error: {}\n\n{}", e.what(), get_cli_usage());
+        return 1;
+    }
+
+    if (options.show_help)
+    {
+        fmt::print("{}", get_cli_usage());
+        return 0;
+    }
+
+    try
+    {
+        return record(options);
+    }
+    catch (const std::exception &e)
+    {
+        fmt::print(stderr, "error: {}\n", e.what());
+        return 1;
+    }
+}
@@ -6,12 +6,14 @@
 #include "stdafx.h"
 #include "Recorder.h"
 #include "AutopanSpeedDlg.h"
+#include "settings_model.h"
 
 /////////////////////////////////////////////////////////////////////////////
 // CAutopanSpeedDlg dialog
 
-CAutopanSpeedDlg::CAutopanSpeedDlg(CWnd *pParent /*=nullptr*/)
+CAutopanSpeedDlg::CAutopanSpeedDlg(CWnd *pParent, settings_model &settings)
     : CDialog(CAutopanSpeedDlg::IDD, pParent)
+    , settings_(settings)
 {
     //{{AFX_DATA_INIT(CAutopanSpeedDlg)
     // NOTE: the ClassWizard will add member initialization here
@@ -45,13 +47,14 @@ BOOL CAutopanSpeedDlg::OnInitDialog()
     // extra initialization
     // set the slider limits and current position
     const int MAXPANSPEED = 200;
-    //ASSERT(cProgramOpts.m_iMaxPan <= MAXPANSPEED);
+    const auto max_pan = settings_.get_autopan_max_speed();
+    ASSERT(max_pan <= MAXPANSPEED);
     m_ctrlSliderPanSpeed.SetRange(1, MAXPANSPEED, TRUE);
-    //m_ctrlSliderPanSpeed.SetPos(cProgramOpts.m_iMaxPan);
+    m_ctrlSliderPanSpeed.SetPos(max_pan);
 
     // update the test speed display
     CString maxpanspeedstr;
-    //maxpanspeedstr.Format(_T("%d"), cProgramOpts.m_iMaxPan);
+    maxpanspeedstr.Format(_T("%d"), max_pan);
     m_ctrlStaticMaxSpeed.SetWindowText(maxpanspeedstr);
 
     return TRUE; // return TRUE unless you set the focus to a control
@@ -61,7 +64,7 @@ BOOL CAutopanSpeedDlg::OnInitDialog()
 void CAutopanSpeedDlg::OnOK()
 {
     // read the slider position and set the max pan speed
-    //cProgramOpts.m_iMaxPan = m_ctrlSliderPanSpeed.GetPos();
+    settings_.set_autopan_max_speed(m_ctrlSliderPanSpeed.GetPos());
     CDialog::OnOK();
 }
 
@@ -83,5 +86,5 @@ void CAutopanSpeedDlg::OnHScroll(UINT nSBCode, UINT nPos, CScrollBar *pScrollBar
 
 void CAutopanSpeedDlg::OnBnClickedOk()
 {
-    CDialog::OnOK();
+    OnOK();
 }
@@ -1,9 +1,11 @@
 #pragma once
 
+class settings_model;
+
 class CAutopanSpeedDlg : public CDialog
 {
 public:
-    explicit CAutopanSpeedDlg(CWnd *pParent = nullptr);
+    CAutopanSpeedDlg(CWnd *pParent, settings_model &settings);
     CAutopanSpeedDlg(const CAutopanSpeedDlg &) = delete;
     CAutopanSpeedDlg &operator = (const CAutopanSpeedDlg &) = delete;
     CAutopanSpeedDlg(CAutopanSpeedDlg &&) = delete;
@@ -37,6 +39,7 @@ protected:
 private:
     CSliderCtrl m_ctrlSliderPanSpeed;
     CStatic m_ctrlStaticMaxSpeed;
+    settings_model &settings_;
 public:
     afx_msg void OnBnClickedOk();
 };
@@ -34,6 +34,25 @@ END_MESSAGE_MAP()
 
 CRecorderApp theApp;
 
+/*!
+ * Parses /stdout and /fd:<n>, the remaining parameters are handled by mfc.
+ */
+class recorder_command_line_info : public CCommandLineInfo
+{
+public:
+    void ParseParam(const TCHAR *param, BOOL flag, BOOL last) override
+    {
+        if (flag && _tcsicmp(param, _T("stdout")) == 0)
+            stream_output_fd = 1;
+        else if (flag && _tcsnicmp(param, _T("fd:"), 3) == 0)
+            stream_output_fd = _ttoi(param + 3);
+        else
+            CCommandLineInfo::ParseParam(param, flag, last);
+    }
+
+    std::optional<int> stream_output_fd;
+};
+
 CRecorderApp::CRecorderApp()
     : CWinApp()
     , m_hAppMutex(INVALID_HANDLE_VALUE)
@@ -84,9 +103,9 @@ BOOL CRecorderApp::InitInstance()
         RUNTIME_CLASS(CMainFrame), // main SDI frame window
         RUNTIME_CLASS(CRecorderView)));
 
-    // dummy commandline parser.
-    CCommandLineInfo cmd_info;
+    recorder_command_line_info cmd_info;
     ParseCommandLine(cmd_info);
+    stream_output_fd_ = cmd_info.stream_output_fd;
     if (!ProcessShellCommand(cmd_info))
         return FALSE;
 
@@ -111,6 +130,11 @@ int CRecorderApp::ExitInstance()
 /////////////////////////////////////////////////////////////////////////////
 // CRecorderApp commands
 
+auto CRecorderApp::get_stream_output_fd() const noexcept -> std::optional<int>
+{
+    return stream_output_fd_;
+}
+
 // App command to run the dialog
 void CRecorderApp::OnAppAbout()
 {
@@ -6,6 +6,7 @@
 
 #include "resource.h"                   // main symbols
 #include <memory>
+#include <optional>
 
 // Multilanguage
 #define ENT_LANGID _T("LanguageID")
@@ -31,9 +32,14 @@ public:
     // Implementation
 
     afx_msg void OnAppAbout();
+
+    // set with /stdout or /fd:<n>, the recording is streamed to this file descriptor.
+    auto get_stream_output_fd() const noexcept -> std::optional<int>;
+
     DECLARE_MESSAGE_MAP()
 private:
     HANDLE m_hAppMutex;
+    std::optional<int> stream_output_fd_;
 
     std::unique_ptr<gdi_plus> m_gdi;
 
@@ -93,6 +93,9 @@ BEGIN_MESSAGE_MAP(CRecorderView, CView)
     ON_COMMAND(ID_REGION_WINDOW, &CRecorderView::OnRegionWindow)
     ON_UPDATE_COMMAND_UI(ID_REGION_WINDOW, &CRecorderView::OnUpdateRegionWindow)
     ON_COMMAND(ID_OPTIONS_KEYBOARDSHORTCUTS, &CRecorderView::OnOptionsKeyboardshortcuts)
+    ON_COMMAND(ID_OPTIONS_AUTOPAN, &CRecorderView::OnOptionsAutopan)
+    ON_UPDATE_COMMAND_UI(ID_OPTIONS_AUTOPAN, &CRecorderView::OnUpdateOptionsAutopan)
+    ON_COMMAND(ID_OPTIONS_ATUOPANSPEED, &CRecorderView::OnOptionsAutopanSpeed)
     ON_MESSAGE(WM_HOTKEY, &CRecorderView::OnHotKey)
     ON_WM_CAPTURECHANGED()
     ON_COMMAND(ID_OPTIONS_PROGRAMSETTINGS, &CRecorderView::OnOptionsProgramsettings)
@@ -168,6 +171,10 @@ void CRecorderView::set_shortcuts()
     shortcut_controller_->register_action(settings_model_->get_shortcut_data(shortcut_action::record_cancel),
         [this]() {OnCancel(); }
     );
+
+    shortcut_controller_->register_action(settings_model_->get_shortcut_data(shortcut_action::autopan),
+        [this]() {OnOptionsAutopan(); }
+    );
 }
 
 void CRecorderView::set_window_title(const std::string &title)
@@ -413,10 +420,20 @@ LRESULT CRecorderView::OnRecordStart(WPARAM /*wParam*/, LPARAM lParam)
     settings.capture_rect_ = settings_model_->get_capture_rect();
     settings.video_settings = *video_settings_model_;
     settings.settings = *settings_model_;
-    settings.filename = generate_temp_filename();
+    if (const auto stream_output_fd = static_cast<CRecorderApp *>(AfxGetApp())->get_stream_output_fd())
+    {
+        // a streamed recording has no temp file, so there is nothing to move when it is done.
+        settings.output_fd = stream_output_fd;
+        settings.filename = "pipe";
+        temp_video_filepath_.clear();
+    }
+    else
+    {
+        settings.filename = generate_temp_filename();
 
-    // hack, store the filepath to the temp file so we can reuse it later.
-    temp_video_filepath_ = settings.filename;
+        // hack, store the filepath to the temp file so we can reuse it later.
+        temp_video_filepath_ = settings.filename;
+    }
 
     capture_thread_ = std::make_unique<capture_thread>(
         [this](){PostMessage(WM_USER_GENERIC, 0 /* finalize recording */, 0);},
@@ -569,6 +586,10 @@ LRESULT CRecorderView::OnUserGeneric(WPARAM wParam, LPARAM /*lParam*/)
 {
     restore_window();
 
+    // the recording was streamed, there is no temp file to move or remove.
+    if (temp_video_filepath_.empty())
+        return 0;
+
     if (wParam != 0)
     {
         logger->debug("canceled, recording removed");
@@ -810,6 +831,25 @@ void CRecorderView::OnOptionsKeyboardshortcuts()
     set_shortcuts();
 }
 
+void CRecorderView::OnOptionsAutopan()
+{
+    // the change is picked up by the next recording.
+    settings_model_->set_autopan_enabled(!settings_model_->get_autopan_enabled());
+    settings_model_->save();
+}
+
+void CRecorderView::OnUpdateOptionsAutopan(CCmdUI *pCmdUI)
+{
+    pCmdUI->SetCheck(settings_model_->get_autopan_enabled());
+}
+
+void CRecorderView::OnOptionsAutopanSpeed()
+{
+    CAutopanSpeedDlg autopan_speed(this, *settings_model_);
+    if (autopan_speed.DoModal() == IDOK)
+        settings_model_->save();
+}
+
 void CRecorderView::OnSetFocus(CWnd *pOldWnd)
 {
     CView::OnSetFocus(pOldWnd);
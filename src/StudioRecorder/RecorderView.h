@@ -81,6 +81,9 @@ protected:
     afx_msg void OnUpdatePause(CCmdUI *pCmdUI);
     afx_msg void OnUpdateStop(CCmdUI *pCmdUI);
     afx_msg void OnOptionsKeyboardshortcuts();
+    afx_msg void OnOptionsAutopan();
+    afx_msg void OnUpdateOptionsAutopan(CCmdUI *pCmdUI);
+    afx_msg void OnOptionsAutopanSpeed();
     afx_msg void OnSetFocus(CWnd *pOldWnd);
     afx_msg auto OnEraseBkgnd(CDC *pDC) -> BOOL;
     afx_msg void OnRegionWindow();
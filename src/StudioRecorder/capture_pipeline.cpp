@@ -0,0 +1,316 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "stdafx.h"
+#include "capture_pipeline.h"
+#include "logging/logging.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+static auto logger = logging::get_logger("capture pipeline");
+
+capture_pipeline::capture_pipeline(cam_capture_source &capture_source, av_muxer &muxer,
+    capture_pipeline_config config)
+    : capture_source_(capture_source)
+    , muxer_(muxer)
+    , config_(std::move(config))
+    , slots_(config_.pool_size)
+    , free_queue_(config_.pool_size)
+    , annotate_queue_(config_.pool_size)
+    , convert_queue_(config_.pool_size)
+    , encode_queue_(config_.pool_size)
+    , pacer_({config_.fps, config_.missed_frame_policy})
+    , target_fps_(config_.fps)
+{
+    stats_[static_cast<size_t>(capture_stage::capture)].name = "capture";
+    stats_[static_cast<size_t>(capture_stage::annotate)].name = "annotate";
+    stats_[static_cast<size_t>(capture_stage::convert)].name = "convert";
+    stats_[static_cast<size_t>(capture_stage::encode)].name = "encode";
+
+    const auto track_count = std::max<size_t>(config_.track_rects.size(), 1);
+    if (config_.governor)
+    {
+        if (config_.video_metas.size() != track_count)
+            throw std::runtime_error("capture_pipeline: the governor needs the configuration of every track");
+
+        governor_.emplace(*config_.governor, config_.video_metas.front(), config_.fps);
+    }
+
+    if (config_.autopan)
+    {
+        const cam::size<int> frame_size(config_.capture_rect.width(), config_.capture_rect.height());
+        autopan_.emplace(*config_.autopan, frame_size, config_.autopan_view_size);
+    }
+
+    for (auto &slot : slots_)
+    {
+        slot.buffer = capture_source_.create_frame_buffer(config_.capture_rect);
+        for (size_t track = 0; track < track_count; ++track)
+            slot.converted.push_back(muxer_.alloc_video_frame(track));
+
+        free_queue_.try_push(&slot);
+    }
+}
+
+capture_pipeline::~capture_pipeline()
+{
+    for (auto &slot : slots_)
+    {
+        for (auto &frame : slot.converted)
+            av_frame_free(&frame);
+    }
+}
+
+void capture_pipeline::run(const std::atomic<bool> &run, const std::function<bool()> &paused)
+{
+    /* the queues are as large as the pool, so passing a slot on never has to wait. */
+    std::thread annotate_thread([this]() {
+        _run_stage(capture_stage::annotate, annotate_queue_, convert_queue_,
+            &capture_pipeline::_annotate, true);
+    });
+    std::thread convert_thread([this]() {
+        _run_stage(capture_stage::convert, convert_queue_, encode_queue_,
+            &capture_pipeline::_convert, true);
+    });
+    std::thread encode_thread([this]() {
+        _run_stage(capture_stage::encode, encode_queue_, free_queue_,
+            &capture_pipeline::_encode, false);
+    });
+
+    try
+    {
+        _capture(run, paused);
+    }
+    catch (...)
+    {
+        _set_error(std::current_exception());
+    }
+
+    /* closing the first queue drains the whole pipeline, every stage closes the next one. */
+    annotate_queue_.close();
+    annotate_thread.join();
+    convert_thread.join();
+    encode_thread.join();
+
+    if (error_ != nullptr)
+        std::rethrow_exception(error_);
+}
+
+auto capture_pipeline::get_stage_stats() const -> std::vector<capture_stage_stats>
+{
+    return {stats_.begin(), stats_.end()};
+}
+
+auto capture_pipeline::get_pacing_stats() const noexcept -> const cam::frame_pacer_stats &
+{
+    return pacer_.get_stats();
+}
+
+auto capture_pipeline::get_dropped_frame_count() const noexcept -> int
+{
+    return dropped_frame_count_;
+}
+
+auto capture_pipeline::get_governor_events() const -> const std::vector<av_governor_event> &
+{
+    return governor_events_;
+}
+
+void capture_pipeline::_capture(const std::atomic<bool> &run, const std::function<bool()> &paused)
+{
+    /* a slot of which the capture failed is reused for the next frame. */
+    frame_slot *slot = nullptr;
+    bool overrun = false;
+    int fps = config_.fps;
+
+    while (run && !failed_)
+    {
+        if (const auto target_fps = target_fps_.load(); target_fps != fps)
+        {
+            fps = target_fps;
+            pacer_.set_fps(fps);
+        }
+
+        const auto tick = pacer_.wait();
+        overrun |= tick.missed > 0;
+
+        if (slot != nullptr || free_queue_.try_pop(slot))
+        {
+            const auto start = std::chrono::steady_clock::now();
+            if (capture_source_.capture_frame(config_.capture_rect, *slot->buffer,
+                slot->cursor_position))
+            {
+                slot->timestamps.clear();
+                for (const auto timestamp : tick.timestamps)
+                    slot->timestamps.push_back(static_cast<timestamp_t>(timestamp.count()));
+
+                const auto time = std::chrono::steady_clock::now() - start;
+                _add_time(capture_stage::capture, time);
+                slot->stage_time[static_cast<size_t>(capture_stage::capture)] = time;
+                slot->overrun = overrun;
+                overrun = false;
+
+                annotate_queue_.try_push(slot);
+                slot = nullptr;
+            }
+        }
+        else
+        {
+            ++dropped_frame_count_;
+            overrun = true;
+        }
+
+        if (paused())
+        {
+            while (paused() && run)
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+            /* the pause does not count as missed frames. */
+            pacer_.reset();
+        }
+    }
+}
+
+void capture_pipeline::_annotate(frame_slot &slot)
+{
+    capture_source_.draw_annotations(*slot.buffer, config_.capture_rect, slot.cursor_position);
+}
+
+void capture_pipeline::_convert(frame_slot &slot)
+{
+    const auto &frame = slot.buffer->get_frame();
+    av_video_frame view = {frame.bitmap_data, frame.width, frame.height, frame.stride};
+
+    /* the frame is top down bgra, so the autopan view and the tracks are windows into it with the
+     * same stride. Panning only moves the start of the window, the frame is not copied. */
+    if (autopan_)
+    {
+        const point<int> cursor(slot.cursor_position.x - config_.capture_rect.left(),
+            slot.cursor_position.y - config_.capture_rect.top());
+        const auto origin = autopan_->update(cursor);
+        const auto view_size = autopan_->get_view_size();
+        view = {frame.bitmap_data + origin.y() * frame.stride + origin.x() * 4, view_size.width(),
+            view_size.height(), frame.stride};
+    }
+
+    if (config_.track_rects.empty())
+    {
+        muxer_.convert_frame(0, view, slot.timestamps.front(), slot.converted[0]);
+        return;
+    }
+
+    for (size_t i = 0; i < config_.track_rects.size(); ++i)
+    {
+        const auto &track_rect = config_.track_rects[i];
+        const av_video_frame track_frame = {
+            view.data + track_rect.top() * view.stride + track_rect.left() * 4,
+            track_rect.width(), track_rect.height(), view.stride};
+        muxer_.convert_frame(i, track_frame, slot.timestamps.front(), slot.converted[i]);
+    }
+}
+
+void capture_pipeline::_encode(frame_slot &slot)
+{
+    /* the encoder references the frame it was sent, so only the timestamp has to change to send it
+     * again as a duplicate. */
+    for (const auto timestamp : slot.timestamps)
+    {
+        for (auto frame : slot.converted)
+            frame->pts = timestamp;
+
+        muxer_.encode_converted_frames(slot.converted);
+    }
+}
+
+void capture_pipeline::_govern(const frame_slot &slot)
+{
+    const auto busiest_stage_time = std::chrono::duration_cast<std::chrono::microseconds>(
+        *std::max_element(slot.stage_time.begin(), slot.stage_time.end()));
+    const auto frame_time = std::chrono::microseconds(1000000 / governor_->get_fps());
+
+    const auto event = governor_->add_frame(std::chrono::microseconds(slot.timestamps.back()),
+        busiest_stage_time, frame_time, slot.overrun);
+    if (!event)
+        return;
+
+    logger->info("capture_pipeline: {}", event->description);
+    governor_events_.push_back(*event);
+
+    /* the encoder changes at once, the frame rate from the next captured frame on. */
+    if (event->step == av_governor_step::fps)
+    {
+        target_fps_ = governor_->get_fps();
+        return;
+    }
+
+    for (size_t i = 0; i < config_.video_metas.size(); ++i)
+        muxer_.reconfigure_video(i, governor_->get_video_meta(config_.video_metas[i]));
+}
+
+void capture_pipeline::_run_stage(capture_stage stage, slot_queue &input, slot_queue &output,
+    void (capture_pipeline::*work)(frame_slot &), bool close_output)
+{
+    frame_slot *slot = nullptr;
+    while (input.pop(slot))
+    {
+        /* after an error the slots are only passed on, so the pipeline still drains. */
+        if (!failed_)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            try
+            {
+                (this->*work)(*slot);
+
+                const auto time = std::chrono::steady_clock::now() - start;
+                _add_time(stage, time);
+                slot->stage_time[static_cast<size_t>(stage)] = time;
+
+                /* the governor runs on the encode stage, which owns the encoders. */
+                if (stage == capture_stage::encode && governor_)
+                    _govern(*slot);
+            }
+            catch (...)
+            {
+                _set_error(std::current_exception());
+            }
+        }
+
+        output.try_push(slot);
+    }
+
+    if (close_output)
+        output.close();
+}
+
+void capture_pipeline::_set_error(std::exception_ptr error)
+{
+    std::lock_guard<std::mutex> lock(error_lock_);
+    if (error_ == nullptr)
+        error_ = error;
+    failed_ = true;
+}
+
+void capture_pipeline::_add_time(capture_stage stage, std::chrono::steady_clock::duration duration)
+{
+    const auto time = std::chrono::duration_cast<std::chrono::microseconds>(duration);
+
+    auto &stats = stats_[static_cast<size_t>(stage)];
+    ++stats.frame_count;
+    stats.busy_time += time;
+    stats.max_time = std::max(stats.max_time, time);
+}
@@ -0,0 +1,160 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <screen_capture/cam_autopan.h>
+#include <screen_capture/cam_capture.h>
+#include <screen_capture/cam_frame_pacer.h>
+#include <screen_capture/cam_rect.h>
+#include <CamEncoder/av_muxer.h>
+#include <CamEncoder/av_overload_governor.h>
+#include <CamEncoder/av_spsc_queue.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+enum class capture_stage
+{
+    capture,
+    annotate,
+    convert,
+    encode
+};
+
+struct capture_stage_stats
+{
+    const char *name{""};
+    int64_t frame_count{0};
+    // the time spent working on frames, not waiting for them.
+    std::chrono::microseconds busy_time{0};
+    std::chrono::microseconds max_time{0};
+};
+
+struct capture_pipeline_config
+{
+    cam::rect<int> capture_rect{0, 0, 0, 0};
+    // see capture_settings::track_rects, with autopan they are relative to the view.
+    std::vector<cam::rect<int>> track_rects;
+    // let a view of autopan_view_size follow the cursor through the captured frame.
+    std::optional<cam::autopan_config> autopan;
+    cam::size<int> autopan_view_size;
+    int fps{30};
+    cam::missed_frame_policy missed_frame_policy{cam::missed_frame_policy::skip};
+    // the amount of frames that can be in flight between the stages.
+    size_t pool_size{4};
+
+    // adapt the encoder and frame rate to the load, video_metas holds the configuration of every
+    // video track the governor starts from.
+    std::optional<av_governor_config> governor;
+    std::vector<av_video_meta> video_metas;
+};
+
+/*!
+ * Runs the capture as a pipeline: capture -> annotate -> convert -> encode, and the muxer writes
+ * the packets on its own writer thread. Every stage has its own thread, so the frame time is the
+ * time of the slowest stage instead of the sum of all of them. The stages hand frames from a fixed
+ * pool to each other through lock free queues, when the pool is exhausted the capture drops the
+ * frame instead of waiting.
+ */
+class capture_pipeline
+{
+public:
+    capture_pipeline(cam_capture_source &capture_source, av_muxer &muxer,
+        capture_pipeline_config config);
+    ~capture_pipeline();
+    capture_pipeline(const capture_pipeline &) = delete;
+    capture_pipeline &operator=(const capture_pipeline &) = delete;
+
+    /*!
+     * Runs the capture stage on the calling thread (which is bound to the desktop) until run is
+     * false. Rethrows the first error of any of the stages.
+     */
+    void run(const std::atomic<bool> &run, const std::function<bool()> &paused);
+
+    auto get_stage_stats() const -> std::vector<capture_stage_stats>;
+    auto get_pacing_stats() const noexcept -> const cam::frame_pacer_stats &;
+
+    // the amount of frames that were not captured because all frames were in flight.
+    auto get_dropped_frame_count() const noexcept -> int;
+
+    // the changes the overload governor made during the recording.
+    auto get_governor_events() const -> const std::vector<av_governor_event> &;
+
+private:
+    struct frame_slot
+    {
+        std::unique_ptr<cam_frame_buffer> buffer;
+        POINT cursor_position{};
+        // more than one when missed frames are filled up with duplicates of this one.
+        std::vector<timestamp_t> timestamps;
+        // one converted frame for every video track.
+        std::vector<AVFrame *> converted;
+        // the time every stage spent on this frame.
+        std::array<std::chrono::steady_clock::duration, 4> stage_time{};
+        // frames were dropped or deadlines were missed before this frame.
+        bool overrun{false};
+    };
+
+    using slot_queue = av_spsc_queue<frame_slot *>;
+
+    void _capture(const std::atomic<bool> &run, const std::function<bool()> &paused);
+    void _annotate(frame_slot &slot);
+    void _convert(frame_slot &slot);
+    void _encode(frame_slot &slot);
+    void _govern(const frame_slot &slot);
+
+    // pop slots from input until it is closed, and pass them on to output after work.
+    void _run_stage(capture_stage stage, slot_queue &input, slot_queue &output,
+        void (capture_pipeline::*work)(frame_slot &), bool close_output);
+    void _set_error(std::exception_ptr error);
+    void _add_time(capture_stage stage, std::chrono::steady_clock::duration duration);
+
+    cam_capture_source &capture_source_;
+    av_muxer &muxer_;
+    capture_pipeline_config config_;
+
+    std::vector<frame_slot> slots_;
+    slot_queue free_queue_;
+    slot_queue annotate_queue_;
+    slot_queue convert_queue_;
+    slot_queue encode_queue_;
+
+    cam::frame_pacer pacer_;
+    std::array<capture_stage_stats, 4> stats_{};
+    int dropped_frame_count_{0};
+
+    // only used by the convert stage.
+    std::optional<cam::autopan> autopan_;
+
+    std::optional<av_overload_governor> governor_;
+    std::vector<av_governor_event> governor_events_;
+    // the frame rate the governor wants, picked up by the capture stage.
+    std::atomic<int> target_fps_;
+
+    std::atomic<bool> failed_{false};
+    std::mutex error_lock_;
+    std::exception_ptr error_{};
+};
@@ -17,11 +17,12 @@
 
 #include "stdafx.h"
 #include "capture_thread.h"
+#include "capture_pipeline.h"
 #include "buildinfo.h"
 #include "logging/logging.h"
 #include <CamEncoder/av_encoder.h>
-#include <screen_capture/cam_stop_watch.h>
 #include <screen_capture/annotations/cam_annotation_cursor.h>
+#include <mmsystem.h>
 #include <algorithm>
 #include <fmt/format.h>
 
@@ -44,6 +45,9 @@ video::codec cam_create_codec(const video_codec &codec)
     {
         case video_codec::type::x264: return video::codec::x264;
         case video_codec::type::camstudio: return video::codec::camstudio;
+        case video_codec::type::ffv1: return video::codec::ffv1;
+        case video_codec::type::utvideo: return video::codec::utvideo;
+        case video_codec::type::av1: return video::codec::av1;
     }
     return {};
 }
@@ -311,48 +315,132 @@ void capture_thread::run()
     }
 
     /* Setup ffmpeg video encoder */
-    // \todo video encoder framerate is ignored atm.
+    const auto fps = capture_settings_.video_settings.video_source_fps_;
     const auto config = cam_create_video_config(
         pre_frame->width,
         pre_frame->height,
-        30,
+        fps,
         capture_settings_.video_settings);
 
     const av_metadata metadata = {fmt::format("CamStudio {}", buildinfo::full_version)};
 
+    auto muxer_type = cam_get_file_container(capture_settings_.video_settings.video_container_);
+    av_muxer_config muxer_config;
+    if (capture_settings_.output_fd)
+    {
+        // only a streamable container can be written to a pipe.
+        if (muxer_type == av_muxer_type::mp4 || muxer_type == av_muxer_type::avi)
+        {
+            logger->info("capture_thread: streaming as mkv, the selected container is not streamable");
+            muxer_type = av_muxer_type::mkv;
+        }
+        muxer_config.output_fd = capture_settings_.output_fd;
+    }
+
     auto video_encoder = std::make_unique<av_muxer>(
         capture_settings_.filename,
-        cam_get_file_container(capture_settings_.video_settings.video_container_),
-        metadata);
+        muxer_type,
+        metadata,
+        muxer_config);
+
+    const auto &track_rects = capture_settings_.track_rects;
+    for (const auto &track_rect : track_rects)
+    {
+        if (track_rect.left() < 0 || track_rect.top() < 0 || track_rect.right() > pre_frame->width
+            || track_rect.bottom() > pre_frame->height)
+        {
+            logger->error("capture_thread: track rect is outside of the captured frame");
+            return;
+        }
+    }
+
+    std::vector<av_video_meta> video_metas;
+    if (track_rects.empty())
+    {
+        video_metas.push_back(config);
+    }
+    else
+    {
+        for (const auto &track_rect : track_rects)
+        {
+            video_metas.push_back(cam_create_video_config(track_rect.width(), track_rect.height(),
+                fps, capture_settings_.video_settings));
+        }
+    }
 
-    video_encoder->add_stream(cam_create_video_codec(config));
+    for (const auto &video_meta : video_metas)
+        video_encoder->add_stream(cam_create_video_codec(video_meta));
     video_encoder->open();
 
-    cam::stop_watch frame_limiter;
-    frame_limiter.time_start();
+    /* the frame pacer sleeps until just before every frame deadline, which the default windows timer
+     * resolution of 15.6ms is not able to hit. */
+    ::timeBeginPeriod(1);
 
-    const auto max_frame_time = 1.0/capture_settings_.video_settings.video_source_fps_;
-    while (run_)
+    capture_pipeline_config pipeline_config;
+    pipeline_config.capture_rect = capture_settings_.capture_rect_;
+
+    /* autopan captures the whole virtual screen, and records a view of the size of the capture rect
+     * that follows the cursor through it. A window capture can not pan outside of its window. */
+    const auto screen_rect = cam::get_virtual_screen_info().size;
+    const auto &capture_rect = capture_settings_.capture_rect_;
+    if (settings.get_autopan_enabled() && capture_settings_.capture_hwnd_ == nullptr
+        && (capture_rect.width() < screen_rect.width() || capture_rect.height() < screen_rect.height()))
     {
-        const auto timestamp_capture_start = frame_limiter.time_now();
-        const auto frame = capture_screen_frame(capture_settings_.capture_rect_);
+        pipeline_config.capture_rect = screen_rect;
+        pipeline_config.autopan = cam::autopan_config{settings.get_autopan_max_speed()};
+        pipeline_config.autopan_view_size = {pre_frame->width, pre_frame->height};
+    }
 
-        if (frame != nullptr)
-        {
-            const auto timestamp = static_cast<timestamp_t>(timestamp_capture_start * 1000.0);
-            video_encoder->encode_frame(timestamp, frame->bitmap_data, frame->width, frame->height,
-                frame->stride);
-        }
+    pipeline_config.track_rects = track_rects;
+    pipeline_config.fps = fps;
+    pipeline_config.governor = av_governor_config{};
+    pipeline_config.video_metas = video_metas;
+
+    capture_pipeline pipeline(*capture_source_, *video_encoder, std::move(pipeline_config));
+    pipeline.run(run_, [this]() { return capture_state_ == capture_state::paused; });
+
+    ::timeEndPeriod(1);
 
-        const auto timestamp_capture_end = frame_limiter.time_now();
-        
-        if (const auto sleep_for = max_frame_time - (timestamp_capture_end - timestamp_capture_start); sleep_for > 0)
-            std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(std::ceil(sleep_for * 1000.0))));
+    logger->debug("capture_thread: skipped {} colliding frames", video_encoder->get_skipped_frame_count());
+    logger->debug("capture_thread: dropped {} frames, all frames were in flight",
+        pipeline.get_dropped_frame_count());
 
-        while (capture_state_ == capture_state::paused && run_ == true)
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const auto &pacing_stats = pipeline.get_pacing_stats();
+    logger->debug("capture_thread: {} frames, missed {} frame deadlines, max jitter {}us",
+        pacing_stats.frame_count, pacing_stats.missed_count, pacing_stats.max_jitter.count());
+
+    const auto &jitter_limits = cam::frame_pacer_stats::jitter_bucket_limits;
+    for (size_t i = 0; i < pacing_stats.jitter_histogram.size(); ++i)
+    {
+        if (i < jitter_limits.size())
+            logger->debug("capture_thread: jitter < {}us: {}", jitter_limits[i],
+                pacing_stats.jitter_histogram[i]);
+        else
+            logger->debug("capture_thread: jitter >= {}us: {}", jitter_limits.back(),
+                pacing_stats.jitter_histogram[i]);
+    }
+
+    /* the stage with the highest average time limits the frame rate at this resolution. */
+    for (const auto &stage : pipeline.get_stage_stats())
+    {
+        const auto average = stage.frame_count > 0 ? stage.busy_time.count() / stage.frame_count : 0;
+        logger->debug("capture_thread: {}x{} {} stage {} frames, average {}us, slowest {}us",
+            pre_frame->width, pre_frame->height, stage.name, stage.frame_count, average,
+            stage.max_time.count());
+    }
+
+    for (const auto &event : pipeline.get_governor_events())
+    {
+        logger->info("capture_thread: at {}ms the governor changed: {}",
+            event.timestamp.count() / 1000, event.description);
     }
 
+    /* the writer stats are only final after the writer wrote the last queued packet. */
+    video_encoder->finish();
+    const auto writer_stats = video_encoder->get_writer_stats();
+    logger->debug("capture_thread: writer max queue depth {}, stalled {} times for {}us, "
+        "slowest write {}us", writer_stats.max_queue_depth, writer_stats.stall_count,
+        writer_stats.stall_time.count(), writer_stats.max_write_time.count());
     video_encoder.reset();
     logger->debug("capture_thread: completed capturing");
 
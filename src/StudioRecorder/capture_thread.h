@@ -24,7 +24,9 @@
 #include "settings_model.h"
 
 #include <atomic>
+#include <optional>
 #include <thread>
+#include <vector>
 
 struct capture_settings
 {
@@ -33,6 +35,11 @@ struct capture_settings
     capture_type capture_type_{ capture_type::allscreens };
 
     std::string filename;
+    // stream the recording to this file descriptor instead of writing it to filename.
+    std::optional<int> output_fd;
+    // record each of these rects (relative to capture_rect_, a.e. one per monitor) as its own
+    // video track, when empty the whole capture rect is recorded as a single track.
+    std::vector<cam::rect<int>> track_rects;
     video_settings_model video_settings;
     settings_model settings;
 };
@@ -70,13 +70,19 @@ struct video_codec_type
     using enum_type = enum
     {
         x264,
-        camstudio
+        camstudio,
+        ffv1,
+        utvideo,
+        av1
     };
 };
 
 static const wchar_t* video_codec_strings[] = {
     L"H.264 (x264)",
-    L"CamStudio"
+    L"CamStudio",
+    L"FFV1 (lossless)",
+    L"UtVideo (lossless)",
+    L"AV1 (SVT-AV1)"
 };
 
 using video_codec = settings_enum_type<video_codec_type,
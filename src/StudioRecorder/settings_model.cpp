@@ -22,6 +22,7 @@
 #include "utility/filesystem.h"
 
 #include <fmt/format.h>
+#include <algorithm>
 #include <cpptoml.h>
 #include <string_view>
 #include <optional>
@@ -40,6 +41,13 @@ namespace capture
     constexpr auto region_fixed = "capture_region_fixed";
     constexpr auto region_mouse_drag = "capture_region_mouse_drag";
     constexpr auto rect = "capture_rect";
+    constexpr auto autopan_enabled = "capture_autopan_enabled";
+    constexpr auto autopan_max_speed = "capture_autopan_max_speed";
+
+    // the range of the autopan speed dialog.
+    constexpr auto autopan_min_speed = 1;
+    constexpr auto autopan_max_speed_limit = 200;
+    constexpr auto autopan_default_speed = 20;
 }
 
 namespace cursor
@@ -368,6 +376,8 @@ void settings_model::_save_capture_settings(cpptoml::table &root)
     capture.insert(config::capture::region_fixed, capture_fixed_);
     capture.insert(config::capture::region_mouse_drag, capture_mouse_drag_);
     capture.insert(config::capture::rect, capture_rect_);
+    capture.insert(config::capture::autopan_enabled, capture_autopan_enabled_);
+    capture.insert(config::capture::autopan_max_speed, capture_autopan_max_speed_);
 
     root.insert(config::capture::settings, capture.get_table());
 }
@@ -426,13 +436,13 @@ void settings_model::_save_shotcut_settings(cpptoml::table &root)
     if (const auto &cancel = shortcut_settings_.at(shortcut_action::record_cancel); cancel.is_enabled != shortcut_enabled::unsupported)
         shortcuts.insert(setting_keys.at(shortcut_action::record_cancel), cancel.is_enabled == shortcut_enabled::yes ? cancel.shortcut : L""s);
 
+    if (const auto &autopan = shortcut_settings_.at(shortcut_action::autopan); autopan.is_enabled != shortcut_enabled::unsupported)
+        shortcuts.insert(setting_keys.at(shortcut_action::autopan), autopan.is_enabled == shortcut_enabled::yes ? autopan.shortcut : L""s);
+
     // currently not supported.
 #if 0
     if (const auto &zoom = shortcut_settings_.at(shortcut_action::zoom); zoom.is_enabled == shortcut_enabled::yes)
         shortcuts.insert(setting_keys.at(shortcut_action::zoom), zoom.shortcut);
-
-    if (const auto &autopan = shortcut_settings_.at(shortcut_action::autopan); autopan.is_enabled == shortcut_enabled::yes)
-        shortcuts.insert(setting_keys.at(shortcut_action::autopan), autopan.shortcut);
 #endif
     root.insert(config::shortcut::settings, shortcuts.get_table());
 }
@@ -444,6 +454,9 @@ void settings_model::_load_capture_settings(const cpptoml::table &root)
     capture_fixed_ = capture.get_optional<bool>(config::capture::region_fixed, false);
     capture_mouse_drag_ = capture.get_optional<bool>(config::capture::region_mouse_drag, false);
     capture_rect_ = capture.get_optional<cam::rect<int>>(config::capture::rect, {});
+    capture_autopan_enabled_ = capture.get_optional<bool>(config::capture::autopan_enabled, false);
+    set_autopan_max_speed(capture.get_optional<int>(config::capture::autopan_max_speed,
+        config::capture::autopan_default_speed));
 }
 
 void settings_model::_load_cursor_settings(const cpptoml::table &root)
@@ -518,9 +531,13 @@ void settings_model::_load_shortcut_settings(const cpptoml::table &root)
     _load_shortcut(shortcuts, shortcut_action::record_start_or_pause);
     _load_shortcut(shortcuts, shortcut_action::record_stop);
     _load_shortcut(shortcuts, shortcut_action::record_cancel);
+
+    // settings saved before autopan was supported do not have its shortcut, keep it disabled.
+    if (shortcuts.contains(shortcut_action::setting_keys().at(shortcut_action::autopan)))
+        _load_shortcut(shortcuts, shortcut_action::autopan);
+
     // currently not supported
     // _load_shortcut(shortcuts, shortcut_action::zoom);
-    // _load_shortcut(shortcuts, shortcut_action::autopan);
 }
 
 void settings_model::_load_shortcut(const table &shortcuts, shortcut_action::type shortcut)
@@ -599,6 +616,27 @@ bool settings_model::get_region_fixed()
     return capture_fixed_;
 }
 
+void settings_model::set_autopan_enabled(bool enabled) noexcept
+{
+    capture_autopan_enabled_ = enabled;
+}
+
+bool settings_model::get_autopan_enabled() const noexcept
+{
+    return capture_autopan_enabled_;
+}
+
+void settings_model::set_autopan_max_speed(int max_speed)
+{
+    capture_autopan_max_speed_ = std::clamp(max_speed, config::capture::autopan_min_speed,
+        config::capture::autopan_max_speed_limit);
+}
+
+int settings_model::get_autopan_max_speed() const noexcept
+{
+    return capture_autopan_max_speed_;
+}
+
 void settings_model::set_cursor_enabled(bool enabled)
 {
     cursor_enabled_ = enabled;
@@ -65,6 +65,13 @@ public:
     void set_region_fixed(bool capture_fixed);
     auto get_region_fixed() -> bool;
 
+    /* autopan, let the capture region follow the cursor */
+    void set_autopan_enabled(bool enabled) noexcept;
+    auto get_autopan_enabled() const noexcept -> bool;
+    // the most pixels the region moves per frame.
+    void set_autopan_max_speed(int max_speed);
+    auto get_autopan_max_speed() const noexcept -> int;
+
     /* cursor */
     void set_cursor_enabled(bool enabled);
     auto get_cursor_enabled() const -> bool;
@@ -153,6 +160,8 @@ private:
     cam::rect<int> capture_rect_{0, 0, 0, 0};
     bool capture_fixed_{false};
     bool capture_mouse_drag_{false};
+    bool capture_autopan_enabled_{false};
+    int capture_autopan_max_speed_{20};
 
     /* cursor settings */
     bool cursor_enabled_{true};
@@ -188,8 +197,6 @@ private:
     application_output_directory::type application_output_directory_access_{application_output_directory::ask_user};
     // user defined output directory
     std::string application_output_directory_{""};
-    // AutoPan = false; // not implemented
-    // MaxPan = 20; // not implemented
 
     /* shortcuts */
     std::map<shortcut_action::type, shortcut_definition> shortcut_settings_{
@@ -197,6 +204,6 @@ private:
         {shortcut_action::record_stop, {shortcut_action::record_stop, shortcut_enabled::yes, L"F8"}},
         {shortcut_action::record_cancel, {shortcut_action::record_cancel, shortcut_enabled::yes, L"F9"}},
         {shortcut_action::zoom, {shortcut_action::zoom, shortcut_enabled::unsupported, L""}},
-        {shortcut_action::autopan, {shortcut_action::autopan, shortcut_enabled::unsupported, L""}},
+        {shortcut_action::autopan, {shortcut_action::autopan, shortcut_enabled::no, L""}},
     };
 };
@@ -0,0 +1,97 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "stdafx.h"
+#include <gtest/gtest.h>
+#include "capture_pipeline.h"
+#include "gdi_plus_initializer.h"
+#include <screen_capture/cam_annotarion.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+// takes longer than a frame, so the annotate stage can not keep up with the capture.
+class slow_annotation : public cam_iannotation
+{
+public:
+    void draw(Gdiplus::Graphics &, const cam_draw_data &) override
+    {
+        std::this_thread::sleep_for(60ms);
+    }
+};
+
+TEST(test_capture_pipeline, test_slow_consumer_drops_frames)
+{
+    gdi_plus gdiplus;
+
+    const cam::rect<int> capture_rect{0, 0, 64, 64};
+    cam_capture_source capture_source(::GetDesktopWindow(), capture_rect);
+    capture_source.enable_annotations();
+    capture_source.add_annotation(std::make_unique<slow_annotation>());
+
+    av_video_meta meta;
+    meta.bpp = 24;
+    meta.width = capture_rect.width();
+    meta.height = capture_rect.height();
+    meta.fps = {50, 1};
+    meta.quality = 25;
+    meta.preset = video::preset::ultrafast;
+    meta.tune = video::tune::zerolatency;
+
+    av_video_codec codec_config;
+    codec_config.pixel_format = AV_PIX_FMT_BGRA;
+
+    av_metadata metadata{"test"};
+    av_muxer muxer("test_capture_pipeline.mkv", av_muxer_type::mkv, metadata);
+    muxer.add_stream(std::make_unique<av_video>(codec_config, meta));
+    muxer.open();
+
+    capture_pipeline_config config;
+    config.capture_rect = capture_rect;
+    config.fps = 50;
+    config.pool_size = 2;
+
+    capture_pipeline pipeline(capture_source, muxer, config);
+
+    std::atomic<bool> run{true};
+    std::thread stop([&run]() {
+        std::this_thread::sleep_for(1s);
+        run = false;
+    });
+    pipeline.run(run, []() { return false; });
+    stop.join();
+
+    muxer.finish();
+
+    const auto stages = pipeline.get_stage_stats();
+    const auto captured = stages[static_cast<size_t>(capture_stage::capture)].frame_count;
+    const auto encoded = stages[static_cast<size_t>(capture_stage::encode)].frame_count;
+    const auto dropped = pipeline.get_dropped_frame_count();
+
+    // every frame deadline either captured a frame, or dropped it because the pool was in flight.
+    EXPECT_GT(dropped, 0);
+    EXPECT_EQ(captured + dropped, pipeline.get_pacing_stats().frame_count);
+
+    // the slow stage limits the frames that get through, but every captured frame is encoded.
+    EXPECT_GT(encoded, 0);
+    EXPECT_EQ(encoded, captured);
+    EXPECT_LE(encoded, 1000 / 60 + static_cast<int64_t>(config.pool_size) + 1);
+    EXPECT_EQ(muxer.get_writer_stats().packets_written, static_cast<uint64_t>(encoded));
+}
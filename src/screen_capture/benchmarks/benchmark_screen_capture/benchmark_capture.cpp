@@ -0,0 +1,72 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <benchmark/benchmark.h>
+#include <screen_capture/cam_icapture_source.h>
+#include <exception>
+#include <vector>
+
+/*!
+ * Capture a region of the screen with the capture backend of the platform. Reports the capture
+ * rate (items_per_second is frames per second) and the captured bytes per second. On linux run it
+ * on a large enough screen, a.e. under Xvfb:
+ *   Xvfb :99 -screen 0 3840x2160x24 &
+ *   DISPLAY=:99 ./benchmark_screen_capture
+ */
+static void capture_frame(benchmark::State &state)
+{
+    const auto width = static_cast<int>(state.range(0));
+    const auto height = static_cast<int>(state.range(1));
+
+    std::unique_ptr<cam_icapture_source> capture;
+    try
+    {
+        capture = cam_create_capture_source(cam_get_default_capture_backend(),
+            {0, 0, width, height});
+    }
+    catch (const std::exception &e)
+    {
+        state.SkipWithError(e.what());
+        return;
+    }
+
+    std::vector<unsigned char> data(static_cast<size_t>(width) * height * 4);
+    cam_capture_buffer buffer{data.data(), width, height, width * 4};
+
+    for (auto _ : state)
+    {
+        if (!capture->capture_frame(buffer))
+        {
+            state.SkipWithError("unable to capture a frame");
+            break;
+        }
+        benchmark::DoNotOptimize(data.data());
+    }
+
+    const auto frames = static_cast<int64_t>(state.iterations());
+    state.SetItemsProcessed(frames);
+    state.SetBytesProcessed(frames * static_cast<int64_t>(data.size()));
+}
+
+BENCHMARK(capture_frame)
+    ->Args({640, 480})
+    ->Args({1280, 720})
+    ->Args({1920, 1080})
+    ->Args({2560, 1440})
+    ->Args({3840, 2160})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
@@ -0,0 +1,65 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <benchmark/benchmark.h>
+#include <screen_capture/cam_icapture_source.h>
+#include <cstring>
+#include <vector>
+
+/*!
+ * Read a captured region like the convert stage does, out of a buffer of the whole virtual desktop
+ * (three 3840x2160 monitors) or out of a buffer of the size of the region with an aligned stride.
+ * buffer_mb is the memory of a single capture buffer.
+ */
+static void read_region(benchmark::State &state, bool desktop_sized)
+{
+    const auto width = static_cast<int>(state.range(0));
+    const auto height = static_cast<int>(state.range(1));
+
+    const auto buffer_width = desktop_sized ? 3 * 3840 : width;
+    const auto buffer_height = desktop_sized ? 2160 : height;
+    const auto stride = desktop_sized ? buffer_width * 4 : cam_get_capture_stride(width);
+
+    std::vector<unsigned char> buffer(static_cast<size_t>(stride) * buffer_height, 0x80);
+    std::vector<unsigned char> output(static_cast<size_t>(width) * height * 4);
+    const auto line_size = static_cast<size_t>(width) * 4;
+
+    for (auto _ : state)
+    {
+        for (int y = 0; y < height; ++y)
+            std::memcpy(output.data() + y * line_size, buffer.data() + static_cast<size_t>(y) * stride,
+                line_size);
+        benchmark::DoNotOptimize(output.data());
+        benchmark::ClobberMemory();
+    }
+
+    const auto frames = static_cast<int64_t>(state.iterations());
+    state.SetItemsProcessed(frames);
+    state.SetBytesProcessed(frames * static_cast<int64_t>(output.size()));
+    state.counters["buffer_mb"] = static_cast<double>(buffer.size()) / (1024.0 * 1024.0);
+}
+
+static void region_sizes(benchmark::internal::Benchmark *benchmark)
+{
+    benchmark->Args({640, 480});
+    benchmark->Args({1280, 720});
+    benchmark->Args({1920, 1080});
+    benchmark->Unit(benchmark::kMicrosecond);
+}
+
+BENCHMARK_CAPTURE(read_region, desktop_buffer, true)->Apply(region_sizes);
+BENCHMARK_CAPTURE(read_region, region_buffer, false)->Apply(region_sizes);
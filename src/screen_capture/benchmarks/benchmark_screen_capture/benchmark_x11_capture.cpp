@@ -0,0 +1,170 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <benchmark/benchmark.h>
+#include <screen_capture/cam_monitor_capture.h>
+#include <screen_capture/cam_x11_capture.h>
+
+#include <X11/Xlib.h>
+
+#include <exception>
+#include <vector>
+
+/*!
+ * Capture a screen where only a small clock sized window changes every frame, with and without
+ * fetching only the damaged rects. damaged_kb is the average size of the damage per frame.
+ * Run it under Xvfb, see benchmark_capture.cpp.
+ */
+static void capture_x11_clock(benchmark::State &state, bool track_damage)
+{
+    const auto width = static_cast<int>(state.range(0));
+    const auto height = static_cast<int>(state.range(1));
+
+    auto display = XOpenDisplay(nullptr);
+    if (display == nullptr)
+    {
+        state.SkipWithError("no x11 display, run the benchmark under Xvfb");
+        return;
+    }
+
+    std::unique_ptr<cam_x11_capture_source> capture;
+    try
+    {
+        capture = std::make_unique<cam_x11_capture_source>(cam::rect<int>{0, 0, width, height},
+            nullptr, track_damage);
+    }
+    catch (const std::exception &e)
+    {
+        XCloseDisplay(display);
+        state.SkipWithError(e.what());
+        return;
+    }
+
+    XSetWindowAttributes attributes{};
+    attributes.override_redirect = True;
+    const auto clock = XCreateWindow(display, DefaultRootWindow(display), 16, 16, 200, 40, 0,
+        CopyFromParent, InputOutput, CopyFromParent, CWOverrideRedirect, &attributes);
+    XMapRaised(display, clock);
+    XSync(display, False);
+
+    std::vector<unsigned char> data(static_cast<size_t>(width) * height * 4);
+    cam_capture_buffer buffer{data.data(), width, height, width * 4};
+
+    int64_t damaged_size = 0;
+    unsigned long color = 0;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        XSetWindowBackground(display, clock, color++ & 0xffffff);
+        XClearWindow(display, clock);
+        XSync(display, False);
+        state.ResumeTiming();
+
+        if (!capture->capture_frame(buffer))
+        {
+            state.SkipWithError("unable to capture a frame");
+            break;
+        }
+        benchmark::DoNotOptimize(data.data());
+
+        for (const auto &rect : capture->get_damage())
+            damaged_size += static_cast<int64_t>(rect.width()) * rect.height() * 4;
+    }
+
+    XDestroyWindow(display, clock);
+    XCloseDisplay(display);
+
+    const auto frames = static_cast<int64_t>(state.iterations());
+    state.SetItemsProcessed(frames);
+    state.counters["damaged_kb"] = static_cast<double>(damaged_size) / frames / 1024.0;
+    state.counters["damage"] = capture->uses_damage() ? 1 : 0;
+}
+
+static void x11_resolutions(benchmark::internal::Benchmark *benchmark)
+{
+    benchmark->Args({1920, 1080});
+    benchmark->Args({3840, 2160});
+    benchmark->Unit(benchmark::kMillisecond);
+    benchmark->UseRealTime();
+}
+
+BENCHMARK_CAPTURE(capture_x11_clock, full, false)->Apply(x11_resolutions);
+BENCHMARK_CAPTURE(capture_x11_clock, damage, true)->Apply(x11_resolutions);
+
+/*!
+ * Capture all monitors of the display with a single grab, or every monitor on its own thread into
+ * its slice of the frame. Needs a display with more than one Xinerama screen, a.e.:
+ *   Xvfb :99 +xinerama -screen 0 3840x2160x24 -screen 1 3840x2160x24 -screen 2 3840x2160x24 &
+ *   DISPLAY=:99 ./benchmark_screen_capture --benchmark_filter=monitors
+ */
+static void capture_x11_monitors(benchmark::State &state, bool per_monitor)
+{
+    std::vector<cam::rect<int>> monitors;
+    std::unique_ptr<cam_icapture_source> capture;
+    try
+    {
+        monitors = cam_x11_get_monitor_rects();
+        if (monitors.size() < 2)
+        {
+            state.SkipWithError("the display has a single monitor, run Xvfb with +xinerama");
+            return;
+        }
+
+        /* without damage tracking, so every frame grabs the whole screen. */
+        const auto create_source = [](const cam::rect<int> &rect) {
+            return std::make_unique<cam_x11_capture_source>(rect, nullptr, false);
+        };
+
+        if (per_monitor)
+            capture = std::make_unique<cam_monitor_capture_source>(cam::rect<int>{0, 0, 0, 0},
+                monitors, create_source);
+        else
+            capture = create_source({0, 0, 0, 0});
+    }
+    catch (const std::exception &e)
+    {
+        state.SkipWithError(e.what());
+        return;
+    }
+
+    const auto rect = capture->get_capture_rect();
+    const auto stride = cam_get_capture_stride(rect.width());
+    std::vector<unsigned char> data(static_cast<size_t>(stride) * rect.height());
+    cam_capture_buffer buffer{data.data(), rect.width(), rect.height(), stride};
+
+    for (auto _ : state)
+    {
+        if (!capture->capture_frame(buffer))
+        {
+            state.SkipWithError("unable to capture a frame");
+            break;
+        }
+        benchmark::DoNotOptimize(data.data());
+    }
+
+    const auto frames = static_cast<int64_t>(state.iterations());
+    state.SetItemsProcessed(frames);
+    state.SetBytesProcessed(frames * static_cast<int64_t>(rect.width()) * rect.height() * 4);
+    state.counters["monitors"] = static_cast<double>(monitors.size());
+}
+
+BENCHMARK_CAPTURE(capture_x11_monitors, single_grab, false)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(capture_x11_monitors, per_monitor, true)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
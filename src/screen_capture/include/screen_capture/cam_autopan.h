@@ -0,0 +1,69 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "cam_point.h"
+#include "cam_size.h"
+
+namespace cam
+{
+
+struct autopan_config
+{
+    // the most pixels the view moves per frame, the speed of the autopan speed dialog (1..200).
+    int max_speed{20};
+};
+
+/*!
+ * Moves a view over a larger frame so it follows the cursor. The view is a crop window into the
+ * captured frame, so panning only changes where the encoder starts reading, no pixels are copied.
+ * The view moves a part of the distance to the cursor every frame, which smooths out the jitter of
+ * the cursor, a faster pan speed covers a larger part of the distance.
+ */
+class autopan
+{
+public:
+    autopan(const autopan_config &config, size<int> frame_size, size<int> view_size);
+
+    /*!
+     * Move the view towards the cursor (in frame coordinates), and return the left top of the view
+     * in the frame. The first update centers the view on the cursor at once.
+     */
+    auto update(point<int> cursor) -> point<int>;
+
+    // start over, the next update centers the view on the cursor again.
+    void reset() noexcept;
+
+    auto get_position() const noexcept -> point<int>;
+    auto get_view_size() const noexcept -> size<int>;
+
+private:
+    auto _target(point<int> cursor) const noexcept -> point<double>;
+
+    autopan_config config_;
+    size<int> frame_size_;
+    size<int> view_size_;
+    // the part of the distance to the cursor the view covers every frame.
+    double smoothing_{1.0};
+
+    bool started_{false};
+    // kept with sub pixel precision, so slow pans do not get stuck on rounding.
+    point<double> position_{};
+};
+
+} // namespace cam
@@ -0,0 +1,50 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+
+namespace cam
+{
+
+/*!
+ * A reusable barrier for a fixed amount of threads, std::barrier is C++20.
+ */
+class barrier
+{
+public:
+    explicit barrier(int count);
+    barrier(const barrier &) = delete;
+    barrier &operator=(const barrier &) = delete;
+
+    // block until all threads arrived, after which the barrier is ready for the next round.
+    void arrive_and_wait();
+
+    // leave the barrier for good, the following rounds wait for one thread less.
+    void arrive_and_drop();
+
+private:
+    std::mutex lock_;
+    std::condition_variable condition_;
+    int count_;
+    int waiting_{0};
+    unsigned int generation_{0};
+};
+
+} // namespace cam
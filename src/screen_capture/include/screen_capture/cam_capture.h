@@ -19,6 +19,7 @@
 
 #include "cam_rect.h"
 #include "cam_annotarion.h"
+#include "cam_icapture_source.h"
 #include "cam_virtual_screen_info.h"
 
 #include <windows.h>
@@ -39,6 +40,31 @@ struct cam_frame
     int stride{0};
 };
 
+/*!
+ * A DIB section of the size of the captured rect the capture source can capture into, so captured
+ * frames can be handed over to other threads while the next frame is captured. The stride is
+ * aligned to cam_capture_stride_alignment.
+ */
+class cam_frame_buffer
+{
+public:
+    cam_frame_buffer(int width, int height);
+    ~cam_frame_buffer();
+    cam_frame_buffer(const cam_frame_buffer &) = delete;
+    cam_frame_buffer &operator=(const cam_frame_buffer &) = delete;
+
+    // recreate the DIB section for a frame of width x height, only when the size changed.
+    void resize(int width, int height);
+
+    auto get_frame() noexcept -> cam_frame &;
+    auto get_bitmap() const noexcept -> HBITMAP;
+
+private:
+    BITMAPINFO bitmap_info_{};
+    HBITMAP bitmap_{nullptr};
+    cam_frame frame_{};
+};
+
 class cam_capture_source
 {
 public:
@@ -53,26 +79,42 @@ public:
     bool capture_frame(const cam::rect<int> &capture_rect);
     const cam_frame *get_frame();
 
+    /*!
+     * Capture into buffer instead of the frame of the capture source, without drawing the
+     * annotations. The cursor position at the time of the capture is returned in cursor_position.
+     */
+    bool capture_frame(const cam::rect<int> &capture_rect, cam_frame_buffer &buffer,
+        POINT &cursor_position);
+
+    // create a buffer that holds a frame of capture_rect, capture_frame resizes it when needed.
+    auto create_frame_buffer(const cam::rect<int> &capture_rect) const
+        -> std::unique_ptr<cam_frame_buffer>;
+
+    /*!
+     * Draw the annotations onto a frame captured into buffer, this may run on another thread than
+     * the capture.
+     */
+    void draw_annotations(cam_frame_buffer &buffer, const cam::rect<int> &capture_rect,
+        const POINT &cursor_position);
+
     void enable_annotations();
 
     void add_annotation(std::unique_ptr<cam_iannotation> annotation);
 
 protected:
     void _draw_annotations(const cam::rect<int> &capture_rect);
+    void _draw_annotations(Gdiplus::Graphics &canvas, const cam::rect<int> &capture_rect,
+        const POINT &cursor_position);
     auto _translate_from_virtual(const POINT &mouse_position) -> point<int>;
 
 private:
-    BITMAPINFO bitmap_info_;
-    HBITMAP bitmap_frame_;
     HWND hwnd_;
     HDC desktop_dc_;
     HDC memory_dc_;
-    cam::rect<int> src_rect_;
     cam::virtual_screen_info virtual_screen_info_;
 
-    unsigned char *bitmap_data_{nullptr};
-    cam_frame frame_;
-    cam::rect<int> captured_rect_;
+    // the frame of capture_frame without a buffer, it has the size of the last captured rect.
+    std::unique_ptr<cam_frame_buffer> frame_buffer_;
 
     HGDIOBJ old_selected_bitmap_{nullptr};
 
@@ -0,0 +1,116 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace cam
+{
+
+// what to do with the frame deadlines that passed while the previous frame was still busy.
+enum class missed_frame_policy
+{
+    skip,     // continue at the most recent deadline, the recording has a gap.
+    duplicate // repeat the next frame for every missed deadline, the frame rate stays constant.
+};
+
+struct frame_pacer_config
+{
+    int fps{30};
+    missed_frame_policy policy{missed_frame_policy::skip};
+    // spin for the last part of the wait, sleeping is not accurate enough to hit the deadline.
+    std::chrono::microseconds spin_time{500};
+};
+
+struct frame_pacer_tick
+{
+    // the deadline of the frame relative to the first frame. With the duplicate policy this also
+    // holds the missed deadlines before it, the frame is encoded once for every timestamp.
+    std::vector<std::chrono::microseconds> timestamps;
+    // the amount of deadlines that passed before this one without a frame.
+    int missed{0};
+};
+
+struct frame_pacer_stats
+{
+    // the (exclusive) upper bound of every jitter histogram bucket in microseconds, the last bucket
+    // holds everything above.
+    static constexpr std::array<int, 8> jitter_bucket_limits = {50, 100, 250, 500, 1000, 2000, 5000,
+        10000};
+
+    int64_t frame_count{0};
+    int64_t missed_count{0};
+
+    // the difference between the measured and the nominal frame interval, in microseconds.
+    std::array<int64_t, jitter_bucket_limits.size() + 1> jitter_histogram{};
+    std::chrono::microseconds max_jitter{0};
+};
+
+/*!
+ * Paces frames against absolute deadlines (first frame + n * frame time) of a monotonic clock, so
+ * a late frame does not push back all the frames after it.
+ */
+class frame_pacer
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit frame_pacer(const frame_pacer_config &config);
+    virtual ~frame_pacer() = default;
+
+    /*!
+     * Wait for the deadline of the next frame. When the deadline passed already it returns at once,
+     * when more deadlines passed the missed frame policy decides the timestamp.
+     */
+    auto wait() -> frame_pacer_tick;
+
+    // start over with new deadlines from the next frame on, a.e. after a pause.
+    void reset() noexcept;
+
+    // change the frame rate, the deadlines start over from the next frame on.
+    void set_fps(int fps);
+
+    auto get_stats() const noexcept -> const frame_pacer_stats &;
+    auto get_frame_time() const noexcept -> std::chrono::microseconds;
+
+protected:
+    // the clock and the wait, a test can replace them with a fake clock.
+    virtual auto _now() const -> clock::time_point;
+    virtual void _wait_until(clock::time_point deadline) const;
+
+private:
+    auto _deadline(int64_t index) const -> clock::time_point;
+    auto _timestamp(int64_t index) const -> std::chrono::microseconds;
+    void _add_interval(clock::duration interval);
+
+    frame_pacer_config config_;
+
+    bool started_{false};
+    // the time the timestamps are relative to, it survives a reset.
+    clock::time_point origin_{};
+    clock::time_point start_{};
+    int64_t index_{0};
+    clock::time_point last_wakeup_{};
+
+    frame_pacer_stats stats_{};
+};
+
+} // namespace cam
@@ -0,0 +1,48 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "cam_icapture_source.h"
+
+#include <windows.h>
+
+/*!
+ * Captures the desktop with BitBlt into a dib section, and copies it into the buffer of the caller.
+ */
+class cam_gdi_capture_source : public cam_icapture_source
+{
+public:
+    explicit cam_gdi_capture_source(const cam::rect<int> &capture_rect);
+    ~cam_gdi_capture_source() override;
+    cam_gdi_capture_source(const cam_gdi_capture_source &) = delete;
+    cam_gdi_capture_source &operator=(const cam_gdi_capture_source &) = delete;
+
+    auto get_capture_rect() const noexcept -> cam::rect<int> override;
+    bool capture_frame(cam_capture_buffer &buffer) override;
+    auto get_damage() const -> const std::vector<cam::rect<int>> & override;
+    auto get_cursor_position() const noexcept -> point<int> override;
+
+private:
+    cam::rect<int> capture_rect_;
+    HDC desktop_dc_{nullptr};
+    HDC memory_dc_{nullptr};
+    HBITMAP bitmap_{nullptr};
+    unsigned char *bitmap_data_{nullptr};
+    std::vector<cam::rect<int>> damage_;
+    point<int> cursor_position_;
+};
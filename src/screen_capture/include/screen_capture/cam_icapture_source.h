@@ -0,0 +1,101 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "cam_rect.h"
+#include "cam_point.h"
+
+#include <memory>
+#include <vector>
+
+// a caller owned top down bgra (32 bit) frame a capture source captures into.
+struct cam_capture_buffer
+{
+    unsigned char *data{nullptr};
+    int width{0};
+    int height{0};
+    int stride{0};
+    // the caller leaves the buffer as it was captured (no annotations), so when the next frame is
+    // captured into the same buffer a source that tracks damage only copies the changed rects.
+    bool keeps_previous_frame{false};
+};
+
+// the stride alignment of capture buffers, a cache line and the widest (avx-512) simd register.
+constexpr int cam_capture_stride_alignment = 64;
+
+// the stride of a bgra line of width pixels, aligned to cam_capture_stride_alignment.
+constexpr auto cam_get_capture_stride(int width) noexcept -> int
+{
+    return (width * 4 + cam_capture_stride_alignment - 1) / cam_capture_stride_alignment
+        * cam_capture_stride_alignment;
+}
+
+enum class cam_capture_backend
+{
+    gdi,
+    x11
+};
+
+/*!
+ * A platform independent capture source. It captures a fixed rect of the screen into buffers owned
+ * by the caller, so frames can be pooled and handed over to other threads. A capture source is not
+ * thread safe, capture from a single thread.
+ */
+class cam_icapture_source
+{
+public:
+    virtual ~cam_icapture_source() = default;
+
+    // the captured rect in screen coordinates, every frame has the size of this rect.
+    virtual auto get_capture_rect() const noexcept -> cam::rect<int> = 0;
+
+    /*!
+     * Capture a frame into buffer, which has to be at least the size of the capture rect.
+     * \return false when the screen could not be captured, a.e. while the desktop is locked.
+     */
+    virtual bool capture_frame(cam_capture_buffer &buffer) = 0;
+
+    /*!
+     * The rects (in frame coordinates) that changed since the previous capture. A backend that
+     * does not track changes reports the whole frame.
+     */
+    virtual auto get_damage() const -> const std::vector<cam::rect<int>> & = 0;
+
+    // the cursor position at the time of the last capture, in frame coordinates.
+    virtual auto get_cursor_position() const noexcept -> point<int> = 0;
+};
+
+// the capture backend of the platform this is build for.
+auto cam_get_default_capture_backend() noexcept -> cam_capture_backend;
+
+/*!
+ * Create a capture source of backend, an empty capture_rect captures the whole (virtual) screen.
+ * Throws std::runtime_error when the backend is not available.
+ */
+auto cam_create_capture_source(cam_capture_backend backend, const cam::rect<int> &capture_rect)
+    -> std::unique_ptr<cam_icapture_source>;
+
+// the rects of the monitors of backend in screen coordinates, the whole screen when unknown.
+auto cam_get_monitor_rects(cam_capture_backend backend) -> std::vector<cam::rect<int>>;
+
+/*!
+ * Create a capture source of backend that captures every monitor in capture_rect on its own
+ * thread, see cam_monitor_capture_source.
+ */
+auto cam_create_monitor_capture_source(cam_capture_backend backend,
+    const cam::rect<int> &capture_rect) -> std::unique_ptr<cam_icapture_source>;
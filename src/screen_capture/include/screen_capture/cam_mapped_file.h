@@ -0,0 +1,45 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/*!
+ * A read only file mapped copy on write: the mapping is writable, but a write only copies the
+ * touched page and never reaches the file.
+ */
+class cam_mapped_file
+{
+public:
+    explicit cam_mapped_file(const std::string &filename);
+    ~cam_mapped_file();
+    cam_mapped_file(const cam_mapped_file &) = delete;
+    cam_mapped_file &operator=(const cam_mapped_file &) = delete;
+
+    auto data() const noexcept -> unsigned char *;
+    auto size() const noexcept -> size_t;
+
+private:
+    unsigned char *data_{nullptr};
+    size_t size_{0};
+#if defined(_WIN32)
+    void *file_{nullptr};
+    void *mapping_{nullptr};
+#endif
+};
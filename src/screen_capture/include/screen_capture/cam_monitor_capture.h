@@ -0,0 +1,87 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "cam_barrier.h"
+#include "cam_icapture_source.h"
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/*!
+ * Captures every monitor in the capture rect with its own capture source, concurrently, each into
+ * its slice of the caller's buffer. The first monitor is captured on the calling thread, every
+ * other monitor has a worker thread. The threads meet at a barrier at the start and at the end of
+ * every frame, so capture_frame returns a complete frame.
+ */
+class cam_monitor_capture_source : public cam_icapture_source
+{
+public:
+    // create the capture source of a single monitor rect, in screen coordinates.
+    using source_factory =
+        std::function<std::unique_ptr<cam_icapture_source>(const cam::rect<int> &rect)>;
+
+    /*!
+     * \param capture_rect the captured rect in screen coordinates, empty captures all monitors.
+     * \param monitor_rects the rects of the monitors in screen coordinates.
+     */
+    cam_monitor_capture_source(const cam::rect<int> &capture_rect,
+        const std::vector<cam::rect<int>> &monitor_rects, const source_factory &factory);
+    ~cam_monitor_capture_source() override;
+    cam_monitor_capture_source(const cam_monitor_capture_source &) = delete;
+    cam_monitor_capture_source &operator=(const cam_monitor_capture_source &) = delete;
+
+    auto get_capture_rect() const noexcept -> cam::rect<int> override;
+    bool capture_frame(cam_capture_buffer &buffer) override;
+    auto get_damage() const -> const std::vector<cam::rect<int>> & override;
+    auto get_cursor_position() const noexcept -> point<int> override;
+
+    // the amount of monitors in the capture rect, which is the amount of capturing threads.
+    auto get_monitor_count() const noexcept -> int;
+
+private:
+    struct monitor_slice
+    {
+        std::unique_ptr<cam_icapture_source> source;
+        // the rect of the slice in frame coordinates.
+        cam::rect<int> rect{0, 0, 0, 0};
+        bool captured{false};
+        std::exception_ptr error;
+    };
+
+    void _run_worker(monitor_slice &slice);
+    void _capture_slice(monitor_slice &slice);
+
+    cam::rect<int> capture_rect_;
+    std::vector<monitor_slice> slices_;
+    // the monitors do not cover the whole capture rect, the gaps are cleared every frame.
+    bool has_gaps_{false};
+
+    std::vector<std::thread> workers_;
+    cam::barrier barrier_;
+    std::atomic<bool> stop_{false};
+    // the buffer of the current frame, set before the workers are released.
+    cam_capture_buffer buffer_;
+
+    std::vector<cam::rect<int>> damage_;
+    point<int> cursor_position_;
+};
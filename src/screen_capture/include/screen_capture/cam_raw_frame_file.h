@@ -0,0 +1,94 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "cam_icapture_source.h"
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/* A raw frame file holds uncompressed bgra frames with their timestamps, so a recording can be
+ * replayed as a capture source. All frames have the same size, so frame n is found at
+ * header_size + n * frame_size without an index, and a truncated file only loses its last frame.
+ *
+ *   cam_raw_file_header
+ *   frame 0: cam_raw_frame_header, stride * height bytes of pixels
+ *   frame 1: ...
+ *
+ * Everything is little endian and aligned to 64 bytes, so the pixels of a memory mapped file can
+ * be handed to simd code directly.
+ */
+constexpr std::array<char, 8> cam_raw_file_magic = {'C', 'A', 'M', 'R', 'A', 'W', '\0', '\0'};
+constexpr uint32_t cam_raw_file_version = 1;
+constexpr int cam_raw_file_alignment = 64;
+
+enum class cam_raw_pixel_format : uint32_t
+{
+    bgra
+};
+
+struct cam_raw_file_header
+{
+    std::array<char, 8> magic{cam_raw_file_magic};
+    uint32_t version{cam_raw_file_version};
+    uint32_t header_size{0};
+    int32_t width{0};
+    int32_t height{0};
+    int32_t stride{0};
+    cam_raw_pixel_format pixel_format{cam_raw_pixel_format::bgra};
+    // the size of a frame including its header.
+    uint64_t frame_size{0};
+    std::array<uint8_t, 24> reserved{};
+};
+static_assert(sizeof(cam_raw_file_header) == cam_raw_file_alignment);
+
+struct cam_raw_frame_header
+{
+    // microseconds since the first frame.
+    uint64_t timestamp{0};
+    // the cursor position in frame coordinates, so the annotations can be drawn on replay.
+    int32_t cursor_x{0};
+    int32_t cursor_y{0};
+    std::array<uint8_t, 48> reserved{};
+};
+static_assert(sizeof(cam_raw_frame_header) == cam_raw_file_alignment);
+
+/*!
+ * Writes frames to a raw frame file, see cam_replay_capture_source to read them.
+ */
+class cam_raw_frame_writer
+{
+public:
+    cam_raw_frame_writer(const std::string &filename, int width, int height);
+    cam_raw_frame_writer(const cam_raw_frame_writer &) = delete;
+    cam_raw_frame_writer &operator=(const cam_raw_frame_writer &) = delete;
+
+    // append a frame of width x height, its stride may differ from the stride in the file.
+    void write_frame(const cam_capture_buffer &frame, uint64_t timestamp, const point<int> &cursor);
+
+    auto get_frame_count() const noexcept -> int64_t;
+
+private:
+    std::ofstream file_;
+    cam_raw_file_header header_;
+    std::vector<char> padding_;
+    int64_t frame_count_{0};
+};
@@ -0,0 +1,72 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "cam_icapture_source.h"
+#include "cam_mapped_file.h"
+#include "cam_raw_frame_file.h"
+
+#include <cstdint>
+#include <string>
+
+/*!
+ * Replays the frames of a raw frame file (see cam_raw_frame_writer) as a capture source, so
+ * benchmarks and tests get the same frames on every machine. The file is memory mapped, and
+ * map_frame hands out the frames in the mapping without copying them.
+ */
+class cam_replay_capture_source : public cam_icapture_source
+{
+public:
+    // loop starts over at the first frame after the last one, instead of ending the replay.
+    explicit cam_replay_capture_source(const std::string &filename, bool loop = false);
+
+    auto get_capture_rect() const noexcept -> cam::rect<int> override;
+
+    // copy the next frame into buffer, false when there are no frames left.
+    bool capture_frame(cam_capture_buffer &buffer) override;
+    auto get_damage() const -> const std::vector<cam::rect<int>> & override;
+    auto get_cursor_position() const noexcept -> point<int> override;
+
+    /*!
+     * The next frame inside the mapping, nullptr when there are no frames left. The frame is
+     * valid as long as this source lives. It may be drawn on, which copies the touched pages and
+     * does not change the file.
+     */
+    auto map_frame() -> const cam_capture_buffer *;
+
+    // the recorded timestamp of the last frame in microseconds, it keeps increasing when looping.
+    auto get_timestamp() const noexcept -> uint64_t;
+    auto get_frame_count() const noexcept -> int64_t;
+
+private:
+    auto _next_frame() -> const cam_raw_frame_header *;
+
+    cam_mapped_file file_;
+    cam_raw_file_header header_;
+    bool loop_;
+    int64_t frame_count_{0};
+    int64_t frame_index_{0};
+
+    // the timestamp offset of the current loop.
+    uint64_t loop_timestamp_{0};
+    uint64_t timestamp_{0};
+
+    cam_capture_buffer frame_;
+    std::vector<cam::rect<int>> damage_;
+    point<int> cursor_position_;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "screen_capture/cam_rect.h"
+#include <vector>
 
 namespace cam
 {
@@ -12,6 +13,8 @@ struct virtual_screen_info
     int bpp{ 0 };
     // the monitor count
     int monitor_count{ 0 };
+    // the rects of the monitors in virtual screen coordinates
+    std::vector<cam::rect<int>> monitors;
 };
 
 virtual_screen_info get_virtual_screen_info();
@@ -0,0 +1,76 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "cam_icapture_source.h"
+
+#include <memory>
+
+/*!
+ * Captures the root window of an X11 display. The frame is read with XShmGetImage into a shared
+ * memory segment, which avoids sending every frame over the X11 connection. When the display does
+ * not support the MIT-SHM extension (a.e. a remote display) it falls back to XGetImage.
+ *
+ * With the DAMAGE extension only the rects that changed since the previous capture are fetched
+ * into a persistent frame, a.e. only the clock when nothing else moves, and get_damage reports
+ * exactly those rects.
+ */
+class cam_x11_capture_source : public cam_icapture_source
+{
+public:
+    // display_name is the display to capture, nullptr uses $DISPLAY.
+    explicit cam_x11_capture_source(const cam::rect<int> &capture_rect,
+        const char *display_name = nullptr, bool track_damage = true);
+    ~cam_x11_capture_source() override;
+    cam_x11_capture_source(const cam_x11_capture_source &) = delete;
+    cam_x11_capture_source &operator=(const cam_x11_capture_source &) = delete;
+
+    auto get_capture_rect() const noexcept -> cam::rect<int> override;
+    bool capture_frame(cam_capture_buffer &buffer) override;
+    auto get_damage() const -> const std::vector<cam::rect<int>> & override;
+    auto get_cursor_position() const noexcept -> point<int> override;
+
+    // false when the frames are read with XGetImage.
+    auto uses_shared_memory() const noexcept -> bool;
+
+    // false when every capture fetches the whole frame.
+    auto uses_damage() const noexcept -> bool;
+
+private:
+    void _create_shared_memory();
+    void _create_damage();
+
+    // fetch the damaged rects into the frame, false when the whole frame has to be fetched.
+    bool _fetch_damage();
+    // fetch rect (in frame coordinates) of the screen into the frame.
+    bool _fetch_rect(const cam::rect<int> &rect);
+
+    // keeps the xlib headers and their macros out of this header.
+    struct x11_state;
+    std::unique_ptr<x11_state> state_;
+
+    cam::rect<int> capture_rect_;
+    std::vector<cam::rect<int>> damage_;
+    point<int> cursor_position_;
+};
+
+/*!
+ * The rects of the monitors (Xinerama screens) of an X11 display in root window coordinates, the
+ * whole screen without Xinerama. Throws std::runtime_error when the display can not be opened.
+ */
+auto cam_x11_get_monitor_rects(const char *display_name = nullptr) -> std::vector<cam::rect<int>>;
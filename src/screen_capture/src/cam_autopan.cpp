@@ -0,0 +1,102 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "screen_capture/cam_autopan.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace cam
+{
+
+autopan::autopan(const autopan_config &config, size<int> frame_size, size<int> view_size)
+    : config_(config)
+    , frame_size_(frame_size)
+    , view_size_(view_size)
+{
+    if (config_.max_speed <= 0)
+        throw std::runtime_error("autopan: max speed must be larger than 0");
+
+    if (view_size_.width() <= 0 || view_size_.height() <= 0
+        || view_size_.width() > frame_size_.width() || view_size_.height() > frame_size_.height())
+    {
+        throw std::runtime_error(fmt::format("autopan: a view of {}x{} does not fit in a frame of {}x{}",
+            view_size_.width(), view_size_.height(), frame_size_.width(), frame_size_.height()));
+    }
+
+    /* the default speed of 20 covers a third of the distance every frame, the maximum of 200 almost
+     * all of it. */
+    smoothing_ = config_.max_speed / (config_.max_speed + 40.0);
+}
+
+auto autopan::update(point<int> cursor) -> point<int>
+{
+    const auto target = _target(cursor);
+    if (!started_)
+    {
+        started_ = true;
+        position_ = target;
+        return get_position();
+    }
+
+    auto dx = (target.x() - position_.x()) * smoothing_;
+    auto dy = (target.y() - position_.y()) * smoothing_;
+
+    /* limit the step to the max speed, diagonal moves are not faster than straight ones. */
+    const auto distance = std::hypot(dx, dy);
+    if (distance > config_.max_speed)
+    {
+        dx *= config_.max_speed / distance;
+        dy *= config_.max_speed / distance;
+    }
+
+    /* snap to the target when close, instead of creeping towards it forever. */
+    if (std::abs(target.x() - position_.x() - dx) < 0.5 && std::abs(target.y() - position_.y() - dy) < 0.5)
+        position_ = target;
+    else
+        position_ = {position_.x() + dx, position_.y() + dy};
+
+    return get_position();
+}
+
+void autopan::reset() noexcept
+{
+    started_ = false;
+}
+
+auto autopan::get_position() const noexcept -> point<int>
+{
+    return {static_cast<int>(std::lround(position_.x())), static_cast<int>(std::lround(position_.y()))};
+}
+
+auto autopan::get_view_size() const noexcept -> size<int>
+{
+    return view_size_;
+}
+
+auto autopan::_target(point<int> cursor) const noexcept -> point<double>
+{
+    /* center the view on the cursor, but keep it inside the frame. */
+    const auto x = std::clamp(cursor.x() - view_size_.width() / 2, 0,
+        frame_size_.width() - view_size_.width());
+    const auto y = std::clamp(cursor.y() - view_size_.height() / 2, 0,
+        frame_size_.height() - view_size_.height());
+    return {static_cast<double>(x), static_cast<double>(y)};
+}
+
+} // namespace cam
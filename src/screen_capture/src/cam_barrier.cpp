@@ -0,0 +1,54 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "screen_capture/cam_barrier.h"
+
+namespace cam
+{
+
+barrier::barrier(int count)
+    : count_(count)
+{
+}
+
+void barrier::arrive_and_wait()
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    const auto generation = generation_;
+    if (++waiting_ == count_)
+    {
+        waiting_ = 0;
+        ++generation_;
+        condition_.notify_all();
+        return;
+    }
+
+    condition_.wait(lock, [&]() { return generation != generation_; });
+}
+
+void barrier::arrive_and_drop()
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    if (waiting_ == --count_ && count_ > 0)
+    {
+        waiting_ = 0;
+        ++generation_;
+        condition_.notify_all();
+    }
+}
+
+} // namespace cam
@@ -26,52 +26,73 @@
 #include <memory>
 #include <cassert>
 #include <ctime>
+#include <stdexcept>
 
 constexpr auto CAPTURE_BPP = 32;
 
-cam_capture_source::cam_capture_source(HWND hwnd, const cam::rect<int> & /*view*/)
-    : bitmap_info_{}
-    , bitmap_frame_{nullptr}
-    , hwnd_{hwnd}
-    , desktop_dc_{::GetDC(hwnd_)}
-    , memory_dc_{::CreateCompatibleDC(desktop_dc_)}
-    , src_rect_()
-    , annotations_()
-    , stopwatch_(std::make_unique<cam::stop_watch>())
-    , virtual_screen_info_(cam::get_virtual_screen_info())
+cam_frame_buffer::cam_frame_buffer(int width, int height)
 {
-    if (hwnd == nullptr)
-    {
-        src_rect_ = virtual_screen_info_.size;
-    }
-    else
-    {
-        RECT window_rect = {};
-        BOOL ret = ::GetWindowRect(hwnd, &window_rect);
-        assert(ret != 0 && "Failed to get window rect.");
-
-        src_rect_.left_ = window_rect.left;
-        src_rect_.top_ = window_rect.top;
-        src_rect_.right_ = window_rect.right;
-        src_rect_.bottom_ = window_rect.bottom;
-    }
+    resize(width, height);
+}
+
+cam_frame_buffer::~cam_frame_buffer()
+{
+    ::DeleteObject(bitmap_);
+}
+
+void cam_frame_buffer::resize(int width, int height)
+{
+    if (bitmap_ != nullptr && frame_.width == width && frame_.height == height)
+        return;
 
-    bitmap_info_.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-    bitmap_info_.bmiHeader.biWidth = src_rect_.width();
-    bitmap_info_.bmiHeader.biHeight = -src_rect_.height();
-    bitmap_info_.bmiHeader.biPlanes = 1;
-    bitmap_info_.bmiHeader.biBitCount = CAPTURE_BPP;
-    bitmap_info_.bmiHeader.biCompression = BI_RGB;
+    /* a dib line is only aligned to 4 bytes, so the padding of the aligned stride is part of the
+     * bitmap width. The dib memory itself is page aligned. */
+    const auto stride = cam_get_capture_stride(width);
 
-    bitmap_frame_ = ::CreateDIBSection(desktop_dc_, &bitmap_info_, DIB_RGB_COLORS,
-        reinterpret_cast<void **>(&bitmap_data_), nullptr, 0);
+    BITMAPINFO bitmap_info{};
+    bitmap_info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bitmap_info.bmiHeader.biWidth = stride / (CAPTURE_BPP / 8);
+    bitmap_info.bmiHeader.biHeight = -height;
+    bitmap_info.bmiHeader.biPlanes = 1;
+    bitmap_info.bmiHeader.biBitCount = CAPTURE_BPP;
+    bitmap_info.bmiHeader.biCompression = BI_RGB;
 
-    /* \todo handle CreateDIBSection failure */
-    assert(bitmap_frame_);
+    unsigned char *bitmap_data = nullptr;
+    const auto bitmap = ::CreateDIBSection(nullptr, &bitmap_info, DIB_RGB_COLORS,
+        reinterpret_cast<void **>(&bitmap_data), nullptr, 0);
+    if (bitmap == nullptr)
+        throw std::runtime_error("cam_frame_buffer: unable to create frame buffer");
 
+    if (bitmap_ != nullptr)
+        ::DeleteObject(bitmap_);
+
+    bitmap_ = bitmap;
+    bitmap_info_ = bitmap_info;
     frame_.bitmap_info = &bitmap_info_;
-    frame_.bitmap_data = bitmap_data_;
+    frame_.bitmap_data = bitmap_data;
+    frame_.width = width;
+    frame_.height = height;
+    frame_.stride = stride;
+}
+
+auto cam_frame_buffer::get_frame() noexcept -> cam_frame &
+{
+    return frame_;
+}
 
+auto cam_frame_buffer::get_bitmap() const noexcept -> HBITMAP
+{
+    return bitmap_;
+}
+
+cam_capture_source::cam_capture_source(HWND hwnd, const cam::rect<int> & /*view*/)
+    : hwnd_{hwnd}
+    , desktop_dc_{::GetDC(hwnd_)}
+    , memory_dc_{::CreateCompatibleDC(desktop_dc_)}
+    , virtual_screen_info_(cam::get_virtual_screen_info())
+    , annotations_()
+    , stopwatch_(std::make_unique<cam::stop_watch>())
+{
     stopwatch_->time_start();
 }
 
@@ -83,7 +104,12 @@ cam_capture_source::~cam_capture_source()
 
 bool cam_capture_source::capture_frame(const cam::rect<int> &capture_rect)
 {
-    old_selected_bitmap_ = ::SelectObject(memory_dc_, bitmap_frame_);
+    if (frame_buffer_ == nullptr)
+        frame_buffer_ = create_frame_buffer(capture_rect);
+    else
+        frame_buffer_->resize(capture_rect.width(), capture_rect.height());
+
+    old_selected_bitmap_ = ::SelectObject(memory_dc_, frame_buffer_->get_bitmap());
     const auto ret = ::BitBlt(memory_dc_, 0, 0,
         capture_rect.width(), capture_rect.height(),
         desktop_dc_,
@@ -97,8 +123,6 @@ bool cam_capture_source::capture_frame(const cam::rect<int> &capture_rect)
         return false;
     }
 
-    captured_rect_ = capture_rect;
-
     _draw_annotations(capture_rect);
 
     ::SelectObject(memory_dc_, old_selected_bitmap_);
@@ -106,12 +130,54 @@ bool cam_capture_source::capture_frame(const cam::rect<int> &capture_rect)
     return true;
 }
 
+bool cam_capture_source::capture_frame(const cam::rect<int> &capture_rect, cam_frame_buffer &buffer,
+    POINT &cursor_position)
+{
+    buffer.resize(capture_rect.width(), capture_rect.height());
+
+    const auto old_bitmap = ::SelectObject(memory_dc_, buffer.get_bitmap());
+    const auto ret = ::BitBlt(memory_dc_, 0, 0,
+        capture_rect.width(), capture_rect.height(),
+        desktop_dc_,
+        capture_rect.left(), capture_rect.top(),
+        SRCCOPY | CAPTUREBLT);
+    ::SelectObject(memory_dc_, old_bitmap);
+
+    if (!ret)
+        return false;
+
+    /* gdi batches calls, make sure the blit finished before another thread reads the buffer. */
+    ::GdiFlush();
+    ::GetCursorPos(&cursor_position);
+    return true;
+}
+
+auto cam_capture_source::create_frame_buffer(const cam::rect<int> &capture_rect) const
+    -> std::unique_ptr<cam_frame_buffer>
+{
+    return std::make_unique<cam_frame_buffer>(capture_rect.width(), capture_rect.height());
+}
+
+void cam_capture_source::draw_annotations(cam_frame_buffer &buffer,
+    const cam::rect<int> &capture_rect, const POINT &cursor_position)
+{
+    if (!enable_annotations_ || annotations_.empty())
+        return;
+
+    /* draw directly into the dib memory, without selecting the bitmap into a device context. */
+    auto &frame = buffer.get_frame();
+    Gdiplus::Bitmap bitmap(frame.width, frame.height, frame.stride, PixelFormat32bppRGB,
+        frame.bitmap_data);
+    Gdiplus::Graphics canvas(&bitmap);
+    _draw_annotations(canvas, capture_rect, cursor_position);
+}
+
 const cam_frame *cam_capture_source::get_frame()
 {
-    frame_.width = captured_rect_.width();
-    frame_.height = captured_rect_.height();
-    frame_.stride = src_rect_.width() * (CAPTURE_BPP / 8);
-    return &frame_;
+    if (frame_buffer_ == nullptr)
+        return nullptr;
+
+    return &frame_buffer_->get_frame();
 }
 
 void cam_capture_source::enable_annotations()
@@ -131,46 +197,51 @@ void cam_capture_source::_draw_annotations(const cam::rect<int> &capture_rect)
     if (annotations_.empty())
         return;
 
-    {
-        POINT pt;
-        ::GetCursorPos(&pt);
-        const auto mouse_point = _translate_from_virtual(pt);
+    POINT pt;
+    ::GetCursorPos(&pt);
 
-        Gdiplus::Graphics canvas(memory_dc_);
-        canvas.SetSmoothingMode(Gdiplus::SmoothingMode::SmoothingModeAntiAlias);
+    Gdiplus::Graphics canvas(memory_dc_);
+    _draw_annotations(canvas, capture_rect, pt);
+}
 
-        const auto mouse_event_count = mouse_hook::get().get_mouse_events_count();
-        if (mouse_event_count > 0)
-        {
-            mouse_events_.resize(mouse_event_count);
-            mouse_hook::get().get_mouse_events(&mouse_events_[0], mouse_event_count);
-        }
+void cam_capture_source::_draw_annotations(Gdiplus::Graphics &canvas,
+    const cam::rect<int> &capture_rect, const POINT &cursor_position)
+{
+    const auto mouse_point = _translate_from_virtual(cursor_position);
+
+    canvas.SetSmoothingMode(Gdiplus::SmoothingMode::SmoothingModeAntiAlias);
+
+    const auto mouse_event_count = mouse_hook::get().get_mouse_events_count();
+    if (mouse_event_count > 0)
+    {
+        mouse_events_.resize(mouse_event_count);
+        mouse_hook::get().get_mouse_events(&mouse_events_[0], mouse_event_count);
+    }
 
-        unsigned int mouse_status = 0;
-        if (!mouse_events_.empty())
+    unsigned int mouse_status = 0;
+    if (!mouse_events_.empty())
+    {
+        for (const auto &mouse_event : mouse_events_)
         {
-            for (const auto &mouse_event : mouse_events_)
+            switch (mouse_event.dwExtraInfo)
             {
-                switch (mouse_event.dwExtraInfo)
-                {
-                case WM_LBUTTONDOWN: mouse_status |= cam_mouse_button::left_button_down; break;
-                case WM_LBUTTONUP:   mouse_status |= cam_mouse_button::left_button_up; break;
-                case WM_RBUTTONDOWN: mouse_status |= cam_mouse_button::right_button_down; break;
-                case WM_RBUTTONUP:   mouse_status |= cam_mouse_button::right_button_up; break;
-                case WM_MBUTTONDOWN: mouse_status |= cam_mouse_button::middle_button_down; break;
-                case WM_MBUTTONUP:   mouse_status |= cam_mouse_button::middle_button_up; break;
-                }
+            case WM_LBUTTONDOWN: mouse_status |= cam_mouse_button::left_button_down; break;
+            case WM_LBUTTONUP:   mouse_status |= cam_mouse_button::left_button_up; break;
+            case WM_RBUTTONDOWN: mouse_status |= cam_mouse_button::right_button_down; break;
+            case WM_RBUTTONUP:   mouse_status |= cam_mouse_button::right_button_up; break;
+            case WM_MBUTTONDOWN: mouse_status |= cam_mouse_button::middle_button_down; break;
+            case WM_MBUTTONUP:   mouse_status |= cam_mouse_button::middle_button_up; break;
             }
         }
-        mouse_events_.clear();
+    }
+    mouse_events_.clear();
 
-        double dt = stopwatch_->time_since();
-        stopwatch_->time_start();
-        cam_draw_data draw_data(dt, capture_rect, mouse_point, static_cast<cam_mouse_button::type>(mouse_status));
+    double dt = stopwatch_->time_since();
+    stopwatch_->time_start();
+    cam_draw_data draw_data(dt, capture_rect, mouse_point, static_cast<cam_mouse_button::type>(mouse_status));
 
-        for (const auto &annotation : annotations_)
-            annotation->draw(canvas, draw_data);
-    }
+    for (const auto &annotation : annotations_)
+        annotation->draw(canvas, draw_data);
 }
 
 auto cam_capture_source::_translate_from_virtual(const POINT &mouse_position) -> point<int>
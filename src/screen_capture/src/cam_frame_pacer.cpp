@@ -0,0 +1,148 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "screen_capture/cam_frame_pacer.h"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+namespace cam
+{
+
+frame_pacer::frame_pacer(const frame_pacer_config &config)
+    : config_(config)
+{
+    if (config_.fps <= 0)
+        throw std::runtime_error("frame_pacer: fps must be larger than 0");
+}
+
+auto frame_pacer::wait() -> frame_pacer_tick
+{
+    if (!started_)
+    {
+        const auto now = _now();
+        if (origin_ == clock::time_point{})
+            origin_ = now;
+
+        started_ = true;
+        start_ = now;
+        index_ = 0;
+        last_wakeup_ = now;
+        ++stats_.frame_count;
+        return {{_timestamp(0)}, 0};
+    }
+
+    auto index = index_ + 1;
+    const auto now = _now();
+
+    /* when the deadline after the next one passed as well, the frames in between are missed.
+     * continue at the most recent deadline, instead of trying to catch up with frames in a burst. */
+    int missed = 0;
+    if (now >= _deadline(index + 1))
+    {
+        const auto passed = (now - start_) * config_.fps / std::chrono::seconds(1);
+        missed = static_cast<int>(passed - index);
+        index = passed;
+    }
+    else
+    {
+        _wait_until(_deadline(index));
+    }
+
+    index_ = index;
+    stats_.missed_count += missed;
+    ++stats_.frame_count;
+
+    const auto wakeup = _now();
+    _add_interval(wakeup - last_wakeup_);
+    last_wakeup_ = wakeup;
+
+    frame_pacer_tick tick;
+    tick.missed = missed;
+
+    /* a stall of more than a second is not filled up with duplicates, it is a gap either way. */
+    if (config_.policy == missed_frame_policy::duplicate && missed <= config_.fps)
+    {
+        for (auto i = index - missed; i < index; ++i)
+            tick.timestamps.push_back(_timestamp(i));
+    }
+    tick.timestamps.push_back(_timestamp(index));
+    return tick;
+}
+
+void frame_pacer::reset() noexcept
+{
+    started_ = false;
+}
+
+void frame_pacer::set_fps(int fps)
+{
+    if (fps <= 0)
+        throw std::runtime_error("frame_pacer: fps must be larger than 0");
+
+    config_.fps = fps;
+    reset();
+}
+
+auto frame_pacer::get_stats() const noexcept -> const frame_pacer_stats &
+{
+    return stats_;
+}
+
+auto frame_pacer::get_frame_time() const noexcept -> std::chrono::microseconds
+{
+    return std::chrono::microseconds(1000000 / config_.fps);
+}
+
+auto frame_pacer::_deadline(int64_t index) const -> clock::time_point
+{
+    /* computed from the start for every frame, so the rounding of the frame time doesn't add up. */
+    return start_ + std::chrono::duration_cast<clock::duration>(
+        std::chrono::nanoseconds(index * 1000000000 / config_.fps));
+}
+
+auto frame_pacer::_timestamp(int64_t index) const -> std::chrono::microseconds
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(_deadline(index) - origin_);
+}
+
+auto frame_pacer::_now() const -> clock::time_point
+{
+    return clock::now();
+}
+
+void frame_pacer::_wait_until(clock::time_point deadline) const
+{
+    std::this_thread::sleep_until(deadline - config_.spin_time);
+
+    while (clock::now() < deadline)
+        std::this_thread::yield();
+}
+
+void frame_pacer::_add_interval(clock::duration interval)
+{
+    const auto frame_time = std::chrono::nanoseconds(1000000000 / config_.fps);
+    const auto jitter = std::chrono::duration_cast<std::chrono::microseconds>(
+        interval > frame_time ? interval - frame_time : frame_time - interval);
+
+    const auto &limits = frame_pacer_stats::jitter_bucket_limits;
+    const auto bucket = std::upper_bound(limits.begin(), limits.end(), jitter.count()) - limits.begin();
+    ++stats_.jitter_histogram[bucket];
+    stats_.max_jitter = std::max(stats_.max_jitter, jitter);
+}
+
+} // namespace cam
@@ -0,0 +1,109 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "screen_capture/cam_gdi_capture.h"
+#include <cstring>
+#include <stdexcept>
+
+constexpr auto CAPTURE_BPP = 32;
+
+cam_gdi_capture_source::cam_gdi_capture_source(const cam::rect<int> &capture_rect)
+    : capture_rect_(capture_rect)
+{
+    if (capture_rect_.width() <= 0 || capture_rect_.height() <= 0)
+    {
+        const auto left = ::GetSystemMetrics(SM_XVIRTUALSCREEN);
+        const auto top = ::GetSystemMetrics(SM_YVIRTUALSCREEN);
+        capture_rect_ = cam::rect<int>(left, top, left + ::GetSystemMetrics(SM_CXVIRTUALSCREEN),
+            top + ::GetSystemMetrics(SM_CYVIRTUALSCREEN));
+    }
+
+    desktop_dc_ = ::GetDC(nullptr);
+    memory_dc_ = ::CreateCompatibleDC(desktop_dc_);
+
+    BITMAPINFO bitmap_info{};
+    bitmap_info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bitmap_info.bmiHeader.biWidth = capture_rect_.width();
+    bitmap_info.bmiHeader.biHeight = -capture_rect_.height();
+    bitmap_info.bmiHeader.biPlanes = 1;
+    bitmap_info.bmiHeader.biBitCount = CAPTURE_BPP;
+    bitmap_info.bmiHeader.biCompression = BI_RGB;
+
+    bitmap_ = ::CreateDIBSection(desktop_dc_, &bitmap_info, DIB_RGB_COLORS,
+        reinterpret_cast<void **>(&bitmap_data_), nullptr, 0);
+    if (bitmap_ == nullptr)
+    {
+        ::DeleteDC(memory_dc_);
+        ::ReleaseDC(nullptr, desktop_dc_);
+        throw std::runtime_error("cam_gdi_capture_source: unable to create the capture bitmap");
+    }
+
+    damage_.emplace_back(0, 0, capture_rect_.width(), capture_rect_.height());
+}
+
+cam_gdi_capture_source::~cam_gdi_capture_source()
+{
+    ::DeleteObject(bitmap_);
+    ::DeleteDC(memory_dc_);
+    ::ReleaseDC(nullptr, desktop_dc_);
+}
+
+auto cam_gdi_capture_source::get_capture_rect() const noexcept -> cam::rect<int>
+{
+    return capture_rect_;
+}
+
+bool cam_gdi_capture_source::capture_frame(cam_capture_buffer &buffer)
+{
+    const auto width = capture_rect_.width();
+    const auto height = capture_rect_.height();
+    if (buffer.width < width || buffer.height < height || buffer.stride < width * 4)
+        throw std::runtime_error("cam_gdi_capture_source: the buffer is smaller than the capture rect");
+
+    const auto old_bitmap = ::SelectObject(memory_dc_, bitmap_);
+    const auto ret = ::BitBlt(memory_dc_, 0, 0, width, height, desktop_dc_,
+        capture_rect_.left(), capture_rect_.top(), SRCCOPY | CAPTUREBLT);
+    ::SelectObject(memory_dc_, old_bitmap);
+
+    if (!ret)
+        return false;
+
+    /* gdi batches calls, make sure the blit finished before reading the dib. */
+    ::GdiFlush();
+
+    POINT cursor_position{};
+    ::GetCursorPos(&cursor_position);
+    cursor_position_ = point<int>(cursor_position.x - capture_rect_.left(),
+        cursor_position.y - capture_rect_.top());
+
+    const auto line_size = static_cast<size_t>(width) * (CAPTURE_BPP / 8);
+    for (int y = 0; y < height; ++y)
+        std::memcpy(buffer.data + static_cast<size_t>(y) * buffer.stride,
+            bitmap_data_ + y * line_size, line_size);
+
+    return true;
+}
+
+auto cam_gdi_capture_source::get_damage() const -> const std::vector<cam::rect<int>> &
+{
+    return damage_;
+}
+
+auto cam_gdi_capture_source::get_cursor_position() const noexcept -> point<int>
+{
+    return cursor_position_;
+}
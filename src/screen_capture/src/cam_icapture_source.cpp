@@ -0,0 +1,81 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "screen_capture/cam_icapture_source.h"
+#include "screen_capture/cam_monitor_capture.h"
+#if defined(_WIN32)
+#include "screen_capture/cam_gdi_capture.h"
+#include "screen_capture/cam_virtual_screen_info.h"
+#endif
+#if defined(CAM_CAPTURE_X11)
+#include "screen_capture/cam_x11_capture.h"
+#endif
+#include <stdexcept>
+
+auto cam_get_default_capture_backend() noexcept -> cam_capture_backend
+{
+#if defined(_WIN32)
+    return cam_capture_backend::gdi;
+#else
+    return cam_capture_backend::x11;
+#endif
+}
+
+// capture_rect is unused on a platform without a capture backend.
+auto cam_create_capture_source(cam_capture_backend backend,
+    [[maybe_unused]] const cam::rect<int> &capture_rect) -> std::unique_ptr<cam_icapture_source>
+{
+    switch (backend)
+    {
+#if defined(_WIN32)
+    case cam_capture_backend::gdi:
+        return std::make_unique<cam_gdi_capture_source>(capture_rect);
+#endif
+#if defined(CAM_CAPTURE_X11)
+    case cam_capture_backend::x11:
+        return std::make_unique<cam_x11_capture_source>(capture_rect);
+#endif
+    default:
+        break;
+    }
+    throw std::runtime_error("cam_create_capture_source: the capture backend is not available");
+}
+
+auto cam_get_monitor_rects(cam_capture_backend backend) -> std::vector<cam::rect<int>>
+{
+    switch (backend)
+    {
+#if defined(_WIN32)
+    case cam_capture_backend::gdi:
+        return cam::get_virtual_screen_info().monitors;
+#endif
+#if defined(CAM_CAPTURE_X11)
+    case cam_capture_backend::x11:
+        return cam_x11_get_monitor_rects();
+#endif
+    default:
+        break;
+    }
+    throw std::runtime_error("cam_get_monitor_rects: the capture backend is not available");
+}
+
+auto cam_create_monitor_capture_source(cam_capture_backend backend,
+    const cam::rect<int> &capture_rect) -> std::unique_ptr<cam_icapture_source>
+{
+    return std::make_unique<cam_monitor_capture_source>(capture_rect, cam_get_monitor_rects(backend),
+        [backend](const cam::rect<int> &rect) { return cam_create_capture_source(backend, rect); });
+}
@@ -0,0 +1,115 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "screen_capture/cam_mapped_file.h"
+#include <fmt/format.h>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+cam_mapped_file::cam_mapped_file(const std::string &filename)
+{
+    file_ = ::CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE)
+        throw std::runtime_error(fmt::format("cam_mapped_file: unable to open {}", filename));
+
+    LARGE_INTEGER file_size{};
+    ::GetFileSizeEx(file_, &file_size);
+    size_ = static_cast<size_t>(file_size.QuadPart);
+
+    if (size_ > 0)
+    {
+        mapping_ = ::CreateFileMappingA(file_, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+        if (mapping_ != nullptr)
+            data_ = static_cast<unsigned char *>(::MapViewOfFile(mapping_, FILE_MAP_COPY, 0, 0, 0));
+    }
+
+    if (size_ > 0 && data_ == nullptr)
+    {
+        if (mapping_ != nullptr)
+            ::CloseHandle(mapping_);
+        ::CloseHandle(file_);
+        throw std::runtime_error(fmt::format("cam_mapped_file: unable to map {}", filename));
+    }
+}
+
+cam_mapped_file::~cam_mapped_file()
+{
+    if (data_ != nullptr)
+        ::UnmapViewOfFile(data_);
+    if (mapping_ != nullptr)
+        ::CloseHandle(mapping_);
+    ::CloseHandle(file_);
+}
+
+#else
+
+cam_mapped_file::cam_mapped_file(const std::string &filename)
+{
+    const auto fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw std::runtime_error(fmt::format("cam_mapped_file: unable to open {}", filename));
+
+    struct stat file_stat{};
+    ::fstat(fd, &file_stat);
+    size_ = static_cast<size_t>(file_stat.st_size);
+
+    if (size_ > 0)
+    {
+        auto data = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+            data_ = static_cast<unsigned char *>(data);
+            // the frames are read front to back, let the kernel read ahead.
+            ::madvise(data, size_, MADV_SEQUENTIAL);
+        }
+    }
+
+    // the mapping keeps its own reference to the file.
+    ::close(fd);
+
+    if (size_ > 0 && data_ == nullptr)
+        throw std::runtime_error(fmt::format("cam_mapped_file: unable to map {}", filename));
+}
+
+cam_mapped_file::~cam_mapped_file()
+{
+    if (data_ != nullptr)
+        ::munmap(data_, size_);
+}
+
+#endif
+
+auto cam_mapped_file::data() const noexcept -> unsigned char *
+{
+    return data_;
+}
+
+auto cam_mapped_file::size() const noexcept -> size_t
+{
+    return size_;
+}
@@ -0,0 +1,208 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "screen_capture/cam_monitor_capture.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+static auto intersect(const cam::rect<int> &a, const cam::rect<int> &b) -> cam::rect<int>
+{
+    return {std::max(a.left(), b.left()), std::max(a.top(), b.top()),
+        std::min(a.right(), b.right()), std::min(a.bottom(), b.bottom())};
+}
+
+static auto get_slice_count(const cam::rect<int> &capture_rect,
+    const std::vector<cam::rect<int>> &monitor_rects) -> int
+{
+    const auto count = std::count_if(monitor_rects.begin(), monitor_rects.end(),
+        [&](const cam::rect<int> &monitor_rect) {
+            const auto rect = intersect(capture_rect, monitor_rect);
+            return rect.width() > 0 && rect.height() > 0;
+        });
+    return std::max(static_cast<int>(count), 1);
+}
+
+static auto get_bounding_rect(const std::vector<cam::rect<int>> &rects) -> cam::rect<int>
+{
+    if (rects.empty())
+        return {0, 0, 0, 0};
+
+    auto result = rects.front();
+    for (const auto &rect : rects)
+        result = {std::min(result.left(), rect.left()), std::min(result.top(), rect.top()),
+            std::max(result.right(), rect.right()), std::max(result.bottom(), rect.bottom())};
+    return result;
+}
+
+cam_monitor_capture_source::cam_monitor_capture_source(const cam::rect<int> &capture_rect,
+    const std::vector<cam::rect<int>> &monitor_rects, const source_factory &factory)
+    : capture_rect_(capture_rect.width() > 0 && capture_rect.height() > 0
+        ? capture_rect : get_bounding_rect(monitor_rects))
+    , barrier_(get_slice_count(capture_rect_, monitor_rects))
+{
+    int64_t covered_area = 0;
+    for (const auto &monitor_rect : monitor_rects)
+    {
+        const auto rect = intersect(capture_rect_, monitor_rect);
+        if (rect.width() <= 0 || rect.height() <= 0)
+            continue;
+
+        monitor_slice slice;
+        slice.source = factory(rect);
+        slice.rect = cam::rect<int>(rect.left() - capture_rect_.left(),
+            rect.top() - capture_rect_.top(), rect.right() - capture_rect_.left(),
+            rect.bottom() - capture_rect_.top());
+        slices_.emplace_back(std::move(slice));
+        covered_area += static_cast<int64_t>(rect.width()) * rect.height();
+    }
+
+    if (slices_.empty())
+        throw std::runtime_error("cam_monitor_capture_source: the capture rect is outside of the monitors");
+
+    /* monitors do not overlap, so they cover the capture rect when their area adds up to it. */
+    has_gaps_ = covered_area
+        < static_cast<int64_t>(capture_rect_.width()) * capture_rect_.height();
+
+    /* the slices do not move anymore, the workers keep a reference to theirs. */
+    try
+    {
+        for (size_t i = 1; i < slices_.size(); ++i)
+            workers_.emplace_back([this, i]() { _run_worker(slices_[i]); });
+    }
+    catch (...)
+    {
+        /* the destructor does not run, stop the workers that did start before rethrowing. */
+        for (size_t i = workers_.size() + 1; i < slices_.size(); ++i)
+            barrier_.arrive_and_drop();
+
+        stop_ = true;
+        barrier_.arrive_and_wait();
+        for (auto &worker : workers_)
+            worker.join();
+        throw;
+    }
+}
+
+cam_monitor_capture_source::~cam_monitor_capture_source()
+{
+    stop_ = true;
+    barrier_.arrive_and_wait();
+    for (auto &worker : workers_)
+        worker.join();
+}
+
+auto cam_monitor_capture_source::get_capture_rect() const noexcept -> cam::rect<int>
+{
+    return capture_rect_;
+}
+
+bool cam_monitor_capture_source::capture_frame(cam_capture_buffer &buffer)
+{
+    const auto width = capture_rect_.width();
+    const auto height = capture_rect_.height();
+    if (buffer.width < width || buffer.height < height || buffer.stride < width * 4)
+        throw std::runtime_error("cam_monitor_capture_source: the buffer is smaller than the capture rect");
+
+    if (has_gaps_)
+    {
+        for (int y = 0; y < height; ++y)
+            std::memset(buffer.data + static_cast<size_t>(y) * buffer.stride, 0,
+                static_cast<size_t>(width) * 4);
+    }
+
+    /* release the workers, capture the first monitor ourselves, and wait for the others. */
+    buffer_ = buffer;
+    barrier_.arrive_and_wait();
+    _capture_slice(slices_.front());
+    barrier_.arrive_and_wait();
+
+    std::exception_ptr error;
+    for (auto &slice : slices_)
+    {
+        if (slice.error != nullptr && error == nullptr)
+            error = slice.error;
+        slice.error = nullptr;
+    }
+
+    if (error != nullptr)
+        std::rethrow_exception(error);
+
+    bool captured = true;
+    damage_.clear();
+    for (const auto &slice : slices_)
+    {
+        captured &= slice.captured;
+        for (const auto &damage : slice.source->get_damage())
+            damage_.emplace_back(damage.left() + slice.rect.left(), damage.top() + slice.rect.top(),
+                damage.right() + slice.rect.left(), damage.bottom() + slice.rect.top());
+    }
+
+    /* every source reports the same cursor, relative to its own slice. */
+    const auto &first = slices_.front();
+    const auto cursor = first.source->get_cursor_position();
+    cursor_position_ = point<int>(cursor.x() + first.rect.left(), cursor.y() + first.rect.top());
+
+    return captured;
+}
+
+auto cam_monitor_capture_source::get_damage() const -> const std::vector<cam::rect<int>> &
+{
+    return damage_;
+}
+
+auto cam_monitor_capture_source::get_cursor_position() const noexcept -> point<int>
+{
+    return cursor_position_;
+}
+
+auto cam_monitor_capture_source::get_monitor_count() const noexcept -> int
+{
+    return static_cast<int>(slices_.size());
+}
+
+void cam_monitor_capture_source::_run_worker(monitor_slice &slice)
+{
+    while (true)
+    {
+        barrier_.arrive_and_wait();
+        if (stop_)
+            return;
+
+        _capture_slice(slice);
+        barrier_.arrive_and_wait();
+    }
+}
+
+void cam_monitor_capture_source::_capture_slice(monitor_slice &slice)
+{
+    /* the slice is a window into the buffer with the stride of the buffer. */
+    cam_capture_buffer slice_buffer{
+        buffer_.data + static_cast<size_t>(slice.rect.top()) * buffer_.stride
+            + static_cast<size_t>(slice.rect.left()) * 4,
+        slice.rect.width(), slice.rect.height(), buffer_.stride, buffer_.keeps_previous_frame};
+
+    try
+    {
+        slice.captured = slice.source->capture_frame(slice_buffer);
+    }
+    catch (...)
+    {
+        slice.captured = false;
+        slice.error = std::current_exception();
+    }
+}
@@ -0,0 +1,89 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "screen_capture/cam_raw_frame_file.h"
+#include <fmt/format.h>
+#include <stdexcept>
+
+static auto align_up(int64_t value, int64_t alignment) -> int64_t
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+cam_raw_frame_writer::cam_raw_frame_writer(const std::string &filename, int width, int height)
+    : file_(filename, std::ios::binary | std::ios::trunc)
+{
+    if (!file_)
+        throw std::runtime_error(fmt::format("cam_raw_frame_writer: unable to create {}", filename));
+
+    if (width <= 0 || height <= 0)
+        throw std::runtime_error("cam_raw_frame_writer: the frame is empty");
+
+    header_.header_size = sizeof(cam_raw_file_header);
+    header_.width = width;
+    header_.height = height;
+    header_.stride = static_cast<int32_t>(align_up(static_cast<int64_t>(width) * 4,
+        cam_raw_file_alignment));
+    header_.frame_size = sizeof(cam_raw_frame_header)
+        + static_cast<uint64_t>(header_.stride) * static_cast<uint64_t>(height);
+
+    padding_.resize(static_cast<size_t>(header_.stride - width * 4));
+
+    file_.write(reinterpret_cast<const char *>(&header_), sizeof(header_));
+}
+
+void cam_raw_frame_writer::write_frame(const cam_capture_buffer &frame, uint64_t timestamp,
+    const point<int> &cursor)
+{
+    if (frame.width != header_.width || frame.height != header_.height)
+        throw std::runtime_error(fmt::format("cam_raw_frame_writer: expected a {}x{} frame, got {}x{}",
+            header_.width, header_.height, frame.width, frame.height));
+
+    cam_raw_frame_header frame_header;
+    frame_header.timestamp = timestamp;
+    frame_header.cursor_x = cursor.x();
+    frame_header.cursor_y = cursor.y();
+    file_.write(reinterpret_cast<const char *>(&frame_header), sizeof(frame_header));
+
+    const auto line_size = static_cast<std::streamsize>(frame.width) * 4;
+    if (frame.stride == header_.stride)
+    {
+        /* one write, only the padding of the last line may be outside of the frame. */
+        file_.write(reinterpret_cast<const char *>(frame.data),
+            static_cast<std::streamsize>(frame.stride) * (frame.height - 1) + line_size);
+        file_.write(padding_.data(), static_cast<std::streamsize>(padding_.size()));
+    }
+    else
+    {
+        for (int y = 0; y < frame.height; ++y)
+        {
+            file_.write(reinterpret_cast<const char *>(frame.data) + static_cast<size_t>(y) * frame.stride,
+                line_size);
+            file_.write(padding_.data(), static_cast<std::streamsize>(padding_.size()));
+        }
+    }
+
+    if (!file_)
+        throw std::runtime_error("cam_raw_frame_writer: unable to write the frame");
+
+    ++frame_count_;
+}
+
+auto cam_raw_frame_writer::get_frame_count() const noexcept -> int64_t
+{
+    return frame_count_;
+}
@@ -0,0 +1,138 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "screen_capture/cam_replay_capture.h"
+#include <fmt/format.h>
+#include <cstring>
+#include <stdexcept>
+
+cam_replay_capture_source::cam_replay_capture_source(const std::string &filename, bool loop)
+    : file_(filename)
+    , loop_(loop)
+{
+    if (file_.size() < sizeof(header_))
+        throw std::runtime_error(fmt::format("cam_replay_capture_source: {} is not a raw frame file",
+            filename));
+
+    std::memcpy(&header_, file_.data(), sizeof(header_));
+    if (header_.magic != cam_raw_file_magic)
+        throw std::runtime_error(fmt::format("cam_replay_capture_source: {} is not a raw frame file",
+            filename));
+
+    if (header_.version != cam_raw_file_version || header_.pixel_format != cam_raw_pixel_format::bgra)
+        throw std::runtime_error(fmt::format("cam_replay_capture_source: {} has unsupported version {}",
+            filename, header_.version));
+
+    /* the frames start after the header, a corrupt header size would put them outside the file. */
+    if (header_.header_size < sizeof(header_) || header_.header_size > file_.size())
+        throw std::runtime_error(fmt::format("cam_replay_capture_source: {} has an invalid header size",
+            filename));
+
+    if (header_.width <= 0 || header_.height <= 0
+        || header_.stride < static_cast<int64_t>(header_.width) * 4
+        || header_.frame_size < sizeof(cam_raw_frame_header)
+            + static_cast<uint64_t>(header_.stride) * static_cast<uint64_t>(header_.height))
+        throw std::runtime_error(fmt::format("cam_replay_capture_source: {} has an invalid frame size",
+            filename));
+
+    /* a partially written last frame is ignored. */
+    frame_count_ = static_cast<int64_t>((file_.size() - header_.header_size) / header_.frame_size);
+
+    frame_.width = header_.width;
+    frame_.height = header_.height;
+    frame_.stride = header_.stride;
+    damage_.emplace_back(0, 0, header_.width, header_.height);
+}
+
+auto cam_replay_capture_source::get_capture_rect() const noexcept -> cam::rect<int>
+{
+    return {0, 0, header_.width, header_.height};
+}
+
+bool cam_replay_capture_source::capture_frame(cam_capture_buffer &buffer)
+{
+    if (buffer.width < frame_.width || buffer.height < frame_.height || buffer.stride < frame_.width * 4)
+        throw std::runtime_error("cam_replay_capture_source: the buffer is smaller than the frames");
+
+    const auto frame = map_frame();
+    if (frame == nullptr)
+        return false;
+
+    const auto line_size = static_cast<size_t>(frame->width) * 4;
+    for (int y = 0; y < frame->height; ++y)
+        std::memcpy(buffer.data + static_cast<size_t>(y) * buffer.stride,
+            frame->data + static_cast<size_t>(y) * frame->stride, line_size);
+
+    return true;
+}
+
+auto cam_replay_capture_source::get_damage() const -> const std::vector<cam::rect<int>> &
+{
+    return damage_;
+}
+
+auto cam_replay_capture_source::get_cursor_position() const noexcept -> point<int>
+{
+    return cursor_position_;
+}
+
+auto cam_replay_capture_source::map_frame() -> const cam_capture_buffer *
+{
+    const auto frame_header = _next_frame();
+    if (frame_header == nullptr)
+        return nullptr;
+
+    timestamp_ = loop_timestamp_ + frame_header->timestamp;
+    cursor_position_ = point<int>(frame_header->cursor_x, frame_header->cursor_y);
+    frame_.data = const_cast<unsigned char *>(
+        reinterpret_cast<const unsigned char *>(frame_header + 1));
+    return &frame_;
+}
+
+auto cam_replay_capture_source::get_timestamp() const noexcept -> uint64_t
+{
+    return timestamp_;
+}
+
+auto cam_replay_capture_source::get_frame_count() const noexcept -> int64_t
+{
+    return frame_count_;
+}
+
+auto cam_replay_capture_source::_next_frame() -> const cam_raw_frame_header *
+{
+    if (frame_index_ == frame_count_)
+    {
+        if (!loop_ || frame_count_ == 0)
+            return nullptr;
+
+        /* continue one frame interval after the last frame, the interval of the first two. */
+        auto interval = uint64_t{0};
+        if (frame_count_ > 1)
+        {
+            const auto second = reinterpret_cast<const cam_raw_frame_header *>(
+                file_.data() + header_.header_size + header_.frame_size);
+            interval = second->timestamp;
+        }
+        loop_timestamp_ = timestamp_ + interval;
+        frame_index_ = 0;
+    }
+
+    const auto offset = header_.header_size + static_cast<uint64_t>(frame_index_) * header_.frame_size;
+    ++frame_index_;
+    return reinterpret_cast<const cam_raw_frame_header *>(file_.data() + offset);
+}
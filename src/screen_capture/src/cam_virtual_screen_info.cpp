@@ -5,6 +5,13 @@
 namespace cam
 {
 
+static BOOL CALLBACK add_monitor_rect(HMONITOR /*monitor*/, HDC /*dc*/, LPRECT rect, LPARAM data)
+{
+    auto monitors = reinterpret_cast<std::vector<cam::rect<int>> *>(data);
+    monitors->emplace_back(rect->left, rect->top, rect->right, rect->bottom);
+    return TRUE;
+}
+
 virtual_screen_info get_virtual_screen_info()
 {
     virtual_screen_info result{};
@@ -22,6 +29,8 @@ virtual_screen_info get_virtual_screen_info()
     result.bpp = bpp;
     result.size = { min_x, min_y, min_x + max_x, min_y + max_y };
     result.monitor_count = monitor_count;
+    ::EnumDisplayMonitors(nullptr, nullptr, add_monitor_rect,
+        reinterpret_cast<LPARAM>(&result.monitors));
     return result;
 }
 
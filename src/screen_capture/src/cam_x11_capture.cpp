@@ -0,0 +1,478 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "screen_capture/cam_x11_capture.h"
+#include <fmt/format.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#if defined(CAM_CAPTURE_X11_DAMAGE)
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xfixes.h>
+#endif
+#if defined(CAM_CAPTURE_X11_XINERAMA)
+#include <X11/extensions/Xinerama.h>
+#endif
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+struct cam_x11_capture_source::x11_state
+{
+    Display *display{nullptr};
+    Window root{0};
+    XImage *image{nullptr};
+    XShmSegmentInfo shm_info{};
+    bool use_shm{false};
+
+    /* the last frame, the damaged rects are fetched into it. It is the shared memory of image,
+     * or frame_data without shared memory. */
+    unsigned char *frame{nullptr};
+    int frame_stride{0};
+    std::vector<unsigned char> frame_data;
+    bool has_frame{false};
+
+    // the buffer of the previous capture, it already holds everything but the damage.
+    const unsigned char *previous_buffer{nullptr};
+    int previous_buffer_stride{0};
+
+#if defined(CAM_CAPTURE_X11_DAMAGE)
+    Damage damage{0};
+    XserverRegion damage_region{0};
+    int damage_event_base{0};
+    // a pixmap on top of the shared memory, XCopyArea fetches a rect straight into it.
+    Pixmap shm_pixmap{0};
+    GC gc{nullptr};
+#endif
+};
+
+static bool x11_attach_failed = false;
+
+static int x11_attach_error_handler(Display * /*display*/, XErrorEvent * /*event*/)
+{
+    x11_attach_failed = true;
+    return 0;
+}
+
+/* XShmAttach reports an error asynchronously, a.e. when the x server is on another machine and is
+ * not able to access our shared memory. So sync and catch the error, the error handler is process
+ * wide so this is not thread safe. */
+static bool x11_attach_shared_memory(Display *display, XShmSegmentInfo &shm_info)
+{
+    x11_attach_failed = false;
+    const auto old_handler = XSetErrorHandler(x11_attach_error_handler);
+    const auto attached = XShmAttach(display, &shm_info);
+    XSync(display, False);
+    XSetErrorHandler(old_handler);
+    return attached && !x11_attach_failed;
+}
+
+// copy width x height pixels of image to x, y of the frame.
+static void x11_copy_image(const XImage &image, unsigned char *frame, int frame_stride, int x, int y,
+    int width, int height)
+{
+    if (image.bits_per_pixel != 32)
+        throw std::runtime_error(fmt::format("cam_x11_capture_source: unsupported pixel size of {} bits",
+            image.bits_per_pixel));
+
+    const auto line_size = static_cast<size_t>(width) * 4;
+    auto dst = frame + static_cast<size_t>(y) * frame_stride + static_cast<size_t>(x) * 4;
+    for (int line = 0; line < height; ++line)
+        std::memcpy(dst + static_cast<size_t>(line) * frame_stride,
+            image.data + static_cast<size_t>(line) * image.bytes_per_line, line_size);
+}
+
+cam_x11_capture_source::cam_x11_capture_source(const cam::rect<int> &capture_rect,
+    const char *display_name, bool track_damage)
+    : state_(std::make_unique<x11_state>())
+    , capture_rect_(capture_rect)
+{
+    state_->display = XOpenDisplay(display_name);
+    if (state_->display == nullptr)
+        throw std::runtime_error(fmt::format("cam_x11_capture_source: unable to open display {}",
+            display_name ? display_name : "$DISPLAY"));
+
+    const auto screen = DefaultScreen(state_->display);
+    state_->root = RootWindow(state_->display, screen);
+    const auto screen_width = DisplayWidth(state_->display, screen);
+    const auto screen_height = DisplayHeight(state_->display, screen);
+
+    if (capture_rect_.width() <= 0 || capture_rect_.height() <= 0)
+        capture_rect_ = cam::rect<int>(0, 0, screen_width, screen_height);
+
+    if (capture_rect_.left() < 0 || capture_rect_.top() < 0 || capture_rect_.right() > screen_width
+        || capture_rect_.bottom() > screen_height)
+    {
+        XCloseDisplay(state_->display);
+        throw std::runtime_error(fmt::format("cam_x11_capture_source: the capture rect is outside "
+            "of the {}x{} screen", screen_width, screen_height));
+    }
+
+    _create_shared_memory();
+
+    if (state_->use_shm)
+    {
+        state_->frame = reinterpret_cast<unsigned char *>(state_->image->data);
+        state_->frame_stride = state_->image->bytes_per_line;
+    }
+    else
+    {
+        state_->frame_stride = capture_rect_.width() * 4;
+        state_->frame_data.resize(static_cast<size_t>(state_->frame_stride) * capture_rect_.height());
+        state_->frame = state_->frame_data.data();
+    }
+
+    if (track_damage)
+        _create_damage();
+}
+
+cam_x11_capture_source::~cam_x11_capture_source()
+{
+    auto display = state_->display;
+
+#if defined(CAM_CAPTURE_X11_DAMAGE)
+    if (state_->damage != 0)
+    {
+        XDamageDestroy(display, state_->damage);
+        XFixesDestroyRegion(display, state_->damage_region);
+    }
+
+    if (state_->shm_pixmap != 0)
+    {
+        XFreeGC(display, state_->gc);
+        XFreePixmap(display, state_->shm_pixmap);
+    }
+#endif
+
+    if (state_->use_shm)
+    {
+        XShmDetach(display, &state_->shm_info);
+        XSync(display, False);
+        state_->image->data = nullptr;
+        XDestroyImage(state_->image);
+        shmdt(state_->shm_info.shmaddr);
+    }
+
+    XCloseDisplay(display);
+}
+
+auto cam_x11_capture_source::get_capture_rect() const noexcept -> cam::rect<int>
+{
+    return capture_rect_;
+}
+
+bool cam_x11_capture_source::capture_frame(cam_capture_buffer &buffer)
+{
+    const auto width = capture_rect_.width();
+    const auto height = capture_rect_.height();
+    if (buffer.width < width || buffer.height < height || buffer.stride < width * 4)
+        throw std::runtime_error("cam_x11_capture_source: the buffer is smaller than the capture rect");
+
+    if (!_fetch_damage())
+    {
+        if (!_fetch_rect({0, 0, width, height}))
+            return false;
+
+        damage_.assign(1, {0, 0, width, height});
+        state_->has_frame = true;
+    }
+
+    /* a pooled buffer that annotations draw on gets the whole frame. Only the same untouched
+     * buffer as the previous capture gets just the damage, which is nothing on an idle screen. */
+    const bool copy_damage = buffer.keeps_previous_frame && buffer.data == state_->previous_buffer
+        && buffer.stride == state_->previous_buffer_stride;
+    const auto copy_rect = [&](const cam::rect<int> &rect) {
+        const auto offset = static_cast<size_t>(rect.left()) * 4;
+        const auto line_size = static_cast<size_t>(rect.width()) * 4;
+        for (int y = rect.top(); y < rect.bottom(); ++y)
+            std::memcpy(buffer.data + static_cast<size_t>(y) * buffer.stride + offset,
+                state_->frame + static_cast<size_t>(y) * state_->frame_stride + offset, line_size);
+    };
+
+    if (copy_damage)
+    {
+        for (const auto &rect : damage_)
+            copy_rect(rect);
+    }
+    else
+    {
+        copy_rect({0, 0, width, height});
+    }
+    state_->previous_buffer = buffer.keeps_previous_frame ? buffer.data : nullptr;
+    state_->previous_buffer_stride = buffer.stride;
+
+    Window root_return = 0;
+    Window child_return = 0;
+    int root_x = 0;
+    int root_y = 0;
+    int window_x = 0;
+    int window_y = 0;
+    unsigned int mask = 0;
+    if (XQueryPointer(state_->display, state_->root, &root_return, &child_return, &root_x, &root_y,
+        &window_x, &window_y, &mask))
+    {
+        cursor_position_ = point<int>(root_x - capture_rect_.left(), root_y - capture_rect_.top());
+    }
+
+    return true;
+}
+
+auto cam_x11_capture_source::get_damage() const -> const std::vector<cam::rect<int>> &
+{
+    return damage_;
+}
+
+auto cam_x11_capture_source::get_cursor_position() const noexcept -> point<int>
+{
+    return cursor_position_;
+}
+
+auto cam_x11_capture_source::uses_shared_memory() const noexcept -> bool
+{
+    return state_->use_shm;
+}
+
+auto cam_x11_capture_source::uses_damage() const noexcept -> bool
+{
+#if defined(CAM_CAPTURE_X11_DAMAGE)
+    return state_->damage != 0;
+#else
+    return false;
+#endif
+}
+
+void cam_x11_capture_source::_create_shared_memory()
+{
+    auto display = state_->display;
+    const auto screen = DefaultScreen(display);
+    if (!XShmQueryExtension(display))
+        return;
+
+    auto &shm_info = state_->shm_info;
+    state_->image = XShmCreateImage(display, DefaultVisual(display, screen),
+        static_cast<unsigned int>(DefaultDepth(display, screen)), ZPixmap, nullptr,
+        &shm_info, static_cast<unsigned int>(capture_rect_.width()),
+        static_cast<unsigned int>(capture_rect_.height()));
+    if (state_->image == nullptr)
+        return;
+
+    shm_info.shmid = shmget(IPC_PRIVATE,
+        static_cast<size_t>(state_->image->bytes_per_line) * state_->image->height, IPC_CREAT | 0600);
+    if (shm_info.shmid != -1)
+    {
+        shm_info.shmaddr = state_->image->data = static_cast<char *>(shmat(shm_info.shmid, nullptr, 0));
+        shm_info.readOnly = False;
+
+        if (shm_info.shmaddr != reinterpret_cast<char *>(-1))
+            state_->use_shm = x11_attach_shared_memory(display, shm_info);
+
+        /* the segment is released as soon as both sides detached, also when we crash. */
+        shmctl(shm_info.shmid, IPC_RMID, nullptr);
+    }
+
+    if (!state_->use_shm)
+    {
+        if (shm_info.shmaddr != nullptr && shm_info.shmaddr != reinterpret_cast<char *>(-1))
+            shmdt(shm_info.shmaddr);
+
+        state_->image->data = nullptr;
+        XDestroyImage(state_->image);
+        state_->image = nullptr;
+    }
+}
+
+void cam_x11_capture_source::_create_damage()
+{
+#if defined(CAM_CAPTURE_X11_DAMAGE)
+    auto display = state_->display;
+    int damage_error_base = 0;
+    int fixes_event_base = 0;
+    int fixes_error_base = 0;
+    if (!XDamageQueryExtension(display, &state_->damage_event_base, &damage_error_base)
+        || !XFixesQueryExtension(display, &fixes_event_base, &fixes_error_base))
+        return;
+
+    /* report non empty only sends an event when the damage becomes non empty, the rects are
+     * collected by the server until we subtract them. */
+    state_->damage = XDamageCreate(display, state_->root, XDamageReportNonEmpty);
+    state_->damage_region = XFixesCreateRegion(display, nullptr, 0);
+
+    int major = 0;
+    int minor = 0;
+    Bool pixmaps = False;
+    if (!state_->use_shm || !XShmQueryVersion(display, &major, &minor, &pixmaps) || !pixmaps
+        || XShmPixmapFormat(display) != ZPixmap)
+        return;
+
+    const auto screen = DefaultScreen(display);
+    state_->shm_pixmap = XShmCreatePixmap(display, state_->root, state_->shm_info.shmaddr,
+        &state_->shm_info, static_cast<unsigned int>(capture_rect_.width()),
+        static_cast<unsigned int>(capture_rect_.height()),
+        static_cast<unsigned int>(DefaultDepth(display, screen)));
+
+    /* copy the windows on top of the root window as well, like XGetImage does. */
+    XGCValues values{};
+    values.subwindow_mode = IncludeInferiors;
+    state_->gc = XCreateGC(display, state_->shm_pixmap, GCSubwindowMode, &values);
+#endif
+}
+
+bool cam_x11_capture_source::_fetch_damage()
+{
+#if defined(CAM_CAPTURE_X11_DAMAGE)
+    auto display = state_->display;
+    if (state_->damage == 0)
+        return false;
+
+    /* take the damage before fetching, so changes during the fetch are reported next frame. */
+    if (!state_->has_frame)
+    {
+        XDamageSubtract(display, state_->damage, None, None);
+        return false;
+    }
+
+    XDamageSubtract(display, state_->damage, None, state_->damage_region);
+
+    int count = 0;
+    auto rects = XFixesFetchRegion(display, state_->damage_region, &count);
+
+    /* the notify events are not used, drop them so they do not pile up in the queue. */
+    XEvent event;
+    while (XCheckTypedEvent(display, state_->damage_event_base + XDamageNotify, &event))
+    {
+    }
+
+    damage_.clear();
+    for (int i = 0; i < count; ++i)
+    {
+        const auto left = std::max(rects[i].x - capture_rect_.left(), 0);
+        const auto top = std::max(rects[i].y - capture_rect_.top(), 0);
+        const auto right = std::min(rects[i].x + rects[i].width - capture_rect_.left(),
+            capture_rect_.width());
+        const auto bottom = std::min(rects[i].y + rects[i].height - capture_rect_.top(),
+            capture_rect_.height());
+        if (left < right && top < bottom)
+            damage_.emplace_back(left, top, right, bottom);
+    }
+
+    if (rects != nullptr)
+        XFree(rects);
+
+    for (const auto &rect : damage_)
+    {
+        if (!_fetch_rect(rect))
+        {
+            // fetch the whole frame, the damage of this frame is lost.
+            state_->has_frame = false;
+            return false;
+        }
+    }
+
+    /* the copies into the shared memory pixmap are done once the server answered. */
+    if (state_->shm_pixmap != 0 && !damage_.empty())
+        XSync(display, False);
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool cam_x11_capture_source::_fetch_rect(const cam::rect<int> &rect)
+{
+    auto display = state_->display;
+    const auto x = capture_rect_.left() + rect.left();
+    const auto y = capture_rect_.top() + rect.top();
+    const auto width = rect.width();
+    const auto height = rect.height();
+
+    if (state_->use_shm && width == capture_rect_.width() && height == capture_rect_.height())
+    {
+        if (state_->image->bits_per_pixel != 32)
+            throw std::runtime_error(fmt::format(
+                "cam_x11_capture_source: unsupported pixel size of {} bits",
+                state_->image->bits_per_pixel));
+
+        return XShmGetImage(display, state_->root, state_->image, x, y, AllPlanes);
+    }
+
+#if defined(CAM_CAPTURE_X11_DAMAGE)
+    /* a damaged rect is copied into the shared memory by the server, the caller syncs. */
+    if (state_->shm_pixmap != 0)
+    {
+        XCopyArea(display, state_->root, state_->shm_pixmap, state_->gc, x, y,
+            static_cast<unsigned int>(width), static_cast<unsigned int>(height), rect.left(),
+            rect.top());
+        return true;
+    }
+#endif
+
+    auto image = XGetImage(display, state_->root, x, y, static_cast<unsigned int>(width),
+        static_cast<unsigned int>(height), AllPlanes, ZPixmap);
+    if (image == nullptr)
+        return false;
+
+    try
+    {
+        x11_copy_image(*image, state_->frame, state_->frame_stride, rect.left(), rect.top(), width,
+            height);
+    }
+    catch (...)
+    {
+        XDestroyImage(image);
+        throw;
+    }
+    XDestroyImage(image);
+    return true;
+}
+
+auto cam_x11_get_monitor_rects(const char *display_name) -> std::vector<cam::rect<int>>
+{
+    auto display = XOpenDisplay(display_name);
+    if (display == nullptr)
+        throw std::runtime_error(fmt::format("cam_x11_get_monitor_rects: unable to open display {}",
+            display_name ? display_name : "$DISPLAY"));
+
+    std::vector<cam::rect<int>> monitors;
+
+#if defined(CAM_CAPTURE_X11_XINERAMA)
+    int count = 0;
+    if (XineramaIsActive(display))
+    {
+        if (auto screens = XineramaQueryScreens(display, &count))
+        {
+            for (int i = 0; i < count; ++i)
+                monitors.emplace_back(screens[i].x_org, screens[i].y_org,
+                    screens[i].x_org + screens[i].width, screens[i].y_org + screens[i].height);
+            XFree(screens);
+        }
+    }
+#endif
+
+    if (monitors.empty())
+    {
+        const auto screen = DefaultScreen(display);
+        monitors.emplace_back(0, 0, DisplayWidth(display, screen), DisplayHeight(display, screen));
+    }
+
+    XCloseDisplay(display);
+    return monitors;
+}
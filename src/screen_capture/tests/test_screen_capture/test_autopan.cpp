@@ -0,0 +1,108 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <screen_capture/cam_autopan.h>
+
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+TEST(test_autopan, first_update_centers_on_cursor)
+{
+    cam::autopan autopan({20}, {1920, 1080}, {640, 480});
+    EXPECT_EQ(point<int>(680, 300), autopan.update({1000, 540}));
+    EXPECT_EQ(point<int>(680, 300), autopan.get_position());
+}
+
+TEST(test_autopan, view_stays_inside_frame)
+{
+    cam::autopan autopan({200}, {1920, 1080}, {640, 480});
+    EXPECT_EQ(point<int>(0, 0), autopan.update({10, 10}));
+
+    for (int i = 0; i < 100; ++i)
+        autopan.update({1919, 1079});
+
+    EXPECT_EQ(point<int>(1280, 600), autopan.get_position());
+}
+
+TEST(test_autopan, step_is_limited_by_max_speed)
+{
+    cam::autopan autopan({5}, {4000, 1000}, {100, 100});
+    autopan.update({50, 50});
+
+    auto previous = autopan.get_position();
+    for (int i = 0; i < 20; ++i)
+    {
+        const auto position = autopan.update({3950, 50});
+        EXPECT_LE(std::abs(position.x() - previous.x()), 5);
+        EXPECT_EQ(0, position.y());
+        previous = position;
+    }
+
+    EXPECT_GT(previous.x(), 0);
+}
+
+TEST(test_autopan, smooths_towards_cursor_and_settles)
+{
+    cam::autopan autopan({20}, {1920, 1080}, {640, 480});
+    autopan.update({320, 240});
+
+    /* every step covers a part of the remaining distance, so the steps get smaller. */
+    std::vector<int> steps;
+    int x = 0;
+    for (int i = 0; i < 5; ++i)
+    {
+        const auto position = autopan.update({420, 240});
+        steps.push_back(position.x() - x);
+        x = position.x();
+    }
+
+    EXPECT_GT(steps.front(), 0);
+    EXPECT_GT(steps.front(), steps.back());
+    EXPECT_LT(x, 100);
+
+    for (int i = 0; i < 100; ++i)
+        autopan.update({420, 240});
+
+    EXPECT_EQ(point<int>(100, 0), autopan.get_position());
+}
+
+TEST(test_autopan, faster_speed_pans_further)
+{
+    cam::autopan slow({10}, {1920, 1080}, {640, 480});
+    cam::autopan fast({100}, {1920, 1080}, {640, 480});
+    slow.update({320, 240});
+    fast.update({320, 240});
+
+    EXPECT_LT(slow.update({1600, 240}).x(), fast.update({1600, 240}).x());
+}
+
+TEST(test_autopan, reset_centers_on_next_update)
+{
+    cam::autopan autopan({1}, {1920, 1080}, {640, 480});
+    autopan.update({320, 240});
+    autopan.reset();
+    EXPECT_EQ(point<int>(1280, 600), autopan.update({1919, 1079}));
+}
+
+TEST(test_autopan, invalid_config)
+{
+    EXPECT_THROW(cam::autopan({0}, {1920, 1080}, {640, 480}), std::runtime_error);
+    EXPECT_THROW(cam::autopan({20}, {640, 480}, {1920, 1080}), std::runtime_error);
+    EXPECT_THROW(cam::autopan({20}, {640, 480}, {0, 480}), std::runtime_error);
+}
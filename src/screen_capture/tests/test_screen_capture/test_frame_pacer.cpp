@@ -0,0 +1,167 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <screen_capture/cam_frame_pacer.h>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+/*!
+ * A pacer on a clock that only moves when the test does work or the pacer waits, so the results do
+ * not depend on the timer resolution or the load of the machine.
+ */
+class fake_clock_pacer : public cam::frame_pacer
+{
+public:
+    using cam::frame_pacer::frame_pacer;
+
+    // some work that takes time.
+    void work(clock::duration duration)
+    {
+        now_ += duration;
+    }
+
+    auto now() const -> clock::time_point
+    {
+        return now_;
+    }
+
+protected:
+    auto _now() const -> clock::time_point override
+    {
+        return now_;
+    }
+
+    void _wait_until(clock::time_point deadline) const override
+    {
+        now_ = std::max(now_, deadline);
+    }
+
+private:
+    // not the epoch, the pacer uses that as no time.
+    mutable clock::time_point now_{1s};
+};
+
+TEST(test_frame_pacer, test_deadlines_do_not_drift)
+{
+    fake_clock_pacer pacer({100, cam::missed_frame_policy::skip, 500us});
+
+    const auto start = pacer.now();
+    for (int i = 0; i < 50; ++i)
+    {
+        const auto tick = pacer.wait();
+        ASSERT_EQ(tick.missed, 0);
+        ASSERT_EQ(tick.timestamps.size(), 1u);
+        EXPECT_EQ(tick.timestamps.front().count(), i * 10000);
+
+        // some work that takes a part of the frame time.
+        pacer.work(2ms);
+    }
+
+    // 49 intervals of 10ms, plus the work after the last frame. The work does not add up.
+    EXPECT_EQ(pacer.now() - start, 492ms);
+
+    const auto &stats = pacer.get_stats();
+    EXPECT_EQ(stats.frame_count, 50);
+    EXPECT_EQ(stats.missed_count, 0);
+    EXPECT_EQ(stats.max_jitter, 0us);
+
+    // every frame after the first one has an interval.
+    const auto intervals = std::accumulate(stats.jitter_histogram.begin(),
+        stats.jitter_histogram.end(), int64_t{0});
+    EXPECT_EQ(intervals, 49);
+}
+
+TEST(test_frame_pacer, test_skip_missed_frames)
+{
+    fake_clock_pacer pacer({100, cam::missed_frame_policy::skip, 500us});
+
+    pacer.wait();
+    pacer.work(35ms);
+
+    // the deadlines at 10 and 20ms passed, the frame continues at the latest one.
+    const auto tick = pacer.wait();
+    EXPECT_EQ(tick.missed, 2);
+    ASSERT_EQ(tick.timestamps.size(), 1u);
+    EXPECT_EQ(tick.timestamps.front(), 30ms);
+
+    // and the frame after it is on time again.
+    const auto next = pacer.wait();
+    EXPECT_EQ(next.missed, 0);
+    EXPECT_EQ(next.timestamps.front(), 40ms);
+    EXPECT_EQ(pacer.get_stats().missed_count, 2);
+}
+
+TEST(test_frame_pacer, test_duplicate_missed_frames)
+{
+    fake_clock_pacer pacer({100, cam::missed_frame_policy::duplicate, 500us});
+
+    pacer.wait();
+    pacer.work(35ms);
+
+    // a timestamp for every missed deadline, followed by the deadline of the frame itself.
+    const auto tick = pacer.wait();
+    EXPECT_EQ(tick.missed, 2);
+    ASSERT_EQ(tick.timestamps.size(), 3u);
+    for (size_t i = 0; i < tick.timestamps.size(); ++i)
+        EXPECT_EQ(tick.timestamps[i].count(), static_cast<int64_t>(i + 1) * 10000);
+}
+
+TEST(test_frame_pacer, test_duplicate_long_stall_is_a_gap)
+{
+    fake_clock_pacer pacer({100, cam::missed_frame_policy::duplicate, 500us});
+
+    pacer.wait();
+    pacer.work(2s);
+
+    // more than a second of duplicates is not filled up.
+    const auto tick = pacer.wait();
+    EXPECT_EQ(tick.missed, 199);
+    ASSERT_EQ(tick.timestamps.size(), 1u);
+    EXPECT_EQ(tick.timestamps.front(), 2s);
+}
+
+TEST(test_frame_pacer, test_reset_keeps_timestamps_increasing)
+{
+    fake_clock_pacer pacer({100, cam::missed_frame_policy::skip, 500us});
+
+    pacer.wait();
+    const auto before = pacer.wait().timestamps.back();
+
+    // a pause, after it the pacer starts over without counting the pause as missed frames.
+    pacer.work(50ms);
+    pacer.reset();
+
+    const auto after = pacer.wait();
+    EXPECT_EQ(after.missed, 0);
+    EXPECT_EQ(after.timestamps.back(), before + 50ms);
+    EXPECT_EQ(pacer.get_stats().missed_count, 0);
+}
+
+TEST(test_frame_pacer, test_waits_on_the_steady_clock)
+{
+    cam::frame_pacer pacer({100, cam::missed_frame_policy::skip, 500us});
+
+    // a deadline is never early, how late it is depends on the machine.
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 10; ++i)
+        pacer.wait();
+    EXPECT_GE(std::chrono::steady_clock::now() - start, 90ms);
+}
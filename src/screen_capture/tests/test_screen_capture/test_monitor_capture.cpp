@@ -0,0 +1,176 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <screen_capture/cam_monitor_capture.h>
+
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/* A monitor that fills its frame with its own value, and remembers the thread it captured on. */
+class fill_capture_source : public cam_icapture_source
+{
+public:
+    fill_capture_source(const cam::rect<int> &rect, unsigned char value,
+        std::set<std::thread::id> &threads, std::mutex &threads_lock)
+        : rect_(rect)
+        , value_(value)
+        , threads_(threads)
+        , threads_lock_(threads_lock)
+    {
+        damage_.emplace_back(1, 1, 2, 2);
+    }
+
+    auto get_capture_rect() const noexcept -> cam::rect<int> override
+    {
+        return rect_;
+    }
+
+    bool capture_frame(cam_capture_buffer &buffer) override
+    {
+        if (value_ == 0)
+            throw std::runtime_error("unable to capture");
+
+        EXPECT_EQ(rect_.width(), buffer.width);
+        EXPECT_EQ(rect_.height(), buffer.height);
+        for (int y = 0; y < buffer.height; ++y)
+            std::fill_n(buffer.data + y * buffer.stride, buffer.width * 4, value_);
+
+        std::lock_guard<std::mutex> lock(threads_lock_);
+        threads_.insert(std::this_thread::get_id());
+        return true;
+    }
+
+    auto get_damage() const -> const std::vector<cam::rect<int>> & override
+    {
+        return damage_;
+    }
+
+    auto get_cursor_position() const noexcept -> point<int> override
+    {
+        return {5 - rect_.left(), 5 - rect_.top()};
+    }
+
+private:
+    cam::rect<int> rect_;
+    unsigned char value_;
+    std::vector<cam::rect<int>> damage_;
+    std::set<std::thread::id> &threads_;
+    std::mutex &threads_lock_;
+};
+
+class test_monitor_capture : public ::testing::Test
+{
+protected:
+    // the monitor with left == 100 fails to capture.
+    auto create_factory()
+    {
+        return [this](const cam::rect<int> &rect) {
+            const auto value = rect.left() == 100 ? 0 : static_cast<unsigned char>(rect.left() / 10 + 1);
+            return std::make_unique<fill_capture_source>(rect, value, threads_, threads_lock_);
+        };
+    }
+
+    std::set<std::thread::id> threads_;
+    std::mutex threads_lock_;
+};
+
+TEST_F(test_monitor_capture, monitors_are_captured_into_their_slice)
+{
+    // two monitors of a different height side by side, the gap below the second one is cleared.
+    const std::vector<cam::rect<int>> monitors = {{0, 0, 20, 10}, {20, 0, 30, 5}};
+    cam_monitor_capture_source capture({0, 0, 0, 0}, monitors, create_factory());
+    ASSERT_EQ(2, capture.get_monitor_count());
+    ASSERT_EQ(30, capture.get_capture_rect().width());
+    ASSERT_EQ(10, capture.get_capture_rect().height());
+
+    constexpr auto stride = 32 * 4;
+    std::vector<unsigned char> data(stride * 10, 0xcd);
+    cam_capture_buffer buffer{data.data(), 30, 10, stride};
+
+    for (int frame = 0; frame < 3; ++frame)
+    {
+        ASSERT_TRUE(capture.capture_frame(buffer));
+        EXPECT_EQ(1, data[0]);
+        EXPECT_EQ(1, data[9 * stride + 19 * 4]);
+        EXPECT_EQ(3, data[20 * 4]);
+        EXPECT_EQ(3, data[4 * stride + 29 * 4]);
+        EXPECT_EQ(0, data[5 * stride + 20 * 4]);
+        EXPECT_EQ(0xcd, data[30 * 4]);
+    }
+
+    EXPECT_EQ(2u, threads_.size());
+
+    // the damage of every monitor in frame coordinates, the cursor of the first monitor.
+    const auto &damage = capture.get_damage();
+    ASSERT_EQ(2u, damage.size());
+    EXPECT_EQ(1, damage[0].left());
+    EXPECT_EQ(21, damage[1].left());
+    EXPECT_EQ(5, capture.get_cursor_position().x());
+    EXPECT_EQ(5, capture.get_cursor_position().y());
+}
+
+TEST_F(test_monitor_capture, capture_rect_is_clipped_to_the_monitors)
+{
+    const std::vector<cam::rect<int>> monitors = {{0, 0, 20, 10}, {20, 0, 40, 10}, {40, 0, 60, 10}};
+    cam_monitor_capture_source capture({15, 2, 35, 8}, monitors, create_factory());
+    ASSERT_EQ(2, capture.get_monitor_count());
+
+    std::vector<unsigned char> data(20 * 6 * 4);
+    cam_capture_buffer buffer{data.data(), 20, 6, 20 * 4};
+    ASSERT_TRUE(capture.capture_frame(buffer));
+    EXPECT_EQ(2, data[0]);
+    EXPECT_EQ(3, data[5 * 4]);
+    EXPECT_EQ(-10, capture.get_cursor_position().x());
+    EXPECT_EQ(3, capture.get_cursor_position().y());
+}
+
+TEST_F(test_monitor_capture, worker_error_is_rethrown)
+{
+    const std::vector<cam::rect<int>> monitors = {{0, 0, 100, 10}, {100, 0, 200, 10}};
+    cam_monitor_capture_source capture({0, 0, 0, 0}, monitors, create_factory());
+
+    std::vector<unsigned char> data(200 * 10 * 4);
+    cam_capture_buffer buffer{data.data(), 200, 10, 200 * 4};
+    ASSERT_THROW(capture.capture_frame(buffer), std::runtime_error);
+    ASSERT_THROW(capture.capture_frame(buffer), std::runtime_error);
+}
+
+TEST_F(test_monitor_capture, rect_outside_of_monitors_throws)
+{
+    const std::vector<cam::rect<int>> monitors = {{0, 0, 20, 10}};
+    ASSERT_THROW(cam_monitor_capture_source({30, 0, 40, 10}, monitors, create_factory()),
+        std::runtime_error);
+}
+
+TEST(test_barrier, dropped_threads_do_not_block_the_others)
+{
+    // the barrier is created for three threads, but only two of them ever arrive.
+    cam::barrier barrier(3);
+    std::thread worker([&]() { barrier.arrive_and_wait(); });
+    barrier.arrive_and_drop();
+    barrier.arrive_and_wait();
+    worker.join();
+
+    // the next round waits for the two remaining threads only.
+    worker = std::thread([&]() { barrier.arrive_and_wait(); });
+    barrier.arrive_and_wait();
+    worker.join();
+}
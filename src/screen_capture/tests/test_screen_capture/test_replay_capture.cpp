@@ -0,0 +1,200 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <screen_capture/cam_raw_frame_file.h>
+#include <screen_capture/cam_replay_capture.h>
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class test_replay_capture : public ::testing::Test
+{
+protected:
+    void TearDown() override
+    {
+        std::remove(filename_.c_str());
+    }
+
+    // a frame with a padded stride where every pixel holds value.
+    static auto make_frame(int width, int height, unsigned char value) -> std::vector<unsigned char>
+    {
+        std::vector<unsigned char> data(static_cast<size_t>(width + 3) * 4 * height, 0xee);
+        for (int y = 0; y < height; ++y)
+            std::fill_n(data.data() + static_cast<size_t>(y) * (width + 3) * 4, width * 4, value);
+        return data;
+    }
+
+    void write_frames(int width, int height, int count)
+    {
+        cam_raw_frame_writer writer(filename_, width, height);
+        for (int i = 0; i < count; ++i)
+        {
+            auto data = make_frame(width, height, static_cast<unsigned char>(i + 1));
+            const cam_capture_buffer frame{data.data(), width, height, (width + 3) * 4};
+            writer.write_frame(frame, static_cast<uint64_t>(i) * 40000, point<int>(i, i * 2));
+        }
+        ASSERT_EQ(count, writer.get_frame_count());
+    }
+
+    // change the header of the written file.
+    template <typename Function>
+    void patch_header(Function patch)
+    {
+        std::fstream file(filename_, std::ios::binary | std::ios::in | std::ios::out);
+        cam_raw_file_header header;
+        file.read(reinterpret_cast<char *>(&header), sizeof(header));
+        patch(header);
+        file.seekp(0);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+
+    std::string filename_{"test_replay_capture.camraw"};
+};
+
+TEST_F(test_replay_capture, map_frames_round_trip)
+{
+    write_frames(10, 7, 3);
+
+    cam_replay_capture_source replay(filename_);
+    ASSERT_EQ(3, replay.get_frame_count());
+    ASSERT_EQ(10, replay.get_capture_rect().width());
+    ASSERT_EQ(7, replay.get_capture_rect().height());
+
+    for (int i = 0; i < 3; ++i)
+    {
+        const auto frame = replay.map_frame();
+        ASSERT_NE(nullptr, frame);
+        ASSERT_EQ(static_cast<uint64_t>(i) * 40000, replay.get_timestamp());
+        ASSERT_EQ(i, replay.get_cursor_position().x());
+        ASSERT_EQ(i * 2, replay.get_cursor_position().y());
+
+        // the stride in the file is aligned, the pixels are simd aligned inside the mapping.
+        ASSERT_EQ(0, frame->stride % cam_raw_file_alignment);
+        ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(frame->data) % cam_raw_file_alignment);
+        for (int y = 0; y < frame->height; ++y)
+            for (int x = 0; x < frame->width * 4; ++x)
+                ASSERT_EQ(i + 1, frame->data[y * frame->stride + x]);
+    }
+
+    ASSERT_EQ(nullptr, replay.map_frame());
+}
+
+TEST_F(test_replay_capture, capture_frame_copies_into_buffer)
+{
+    write_frames(5, 4, 2);
+
+    cam_replay_capture_source replay(filename_);
+    std::vector<unsigned char> data(5 * 4 * 4);
+    cam_capture_buffer buffer{data.data(), 5, 4, 5 * 4};
+
+    ASSERT_TRUE(replay.capture_frame(buffer));
+    ASSERT_EQ(std::vector<unsigned char>(data.size(), 1), data);
+    ASSERT_TRUE(replay.capture_frame(buffer));
+    ASSERT_EQ(std::vector<unsigned char>(data.size(), 2), data);
+    ASSERT_FALSE(replay.capture_frame(buffer));
+}
+
+TEST_F(test_replay_capture, drawing_on_mapped_frame_keeps_file)
+{
+    write_frames(4, 4, 1);
+
+    {
+        cam_replay_capture_source replay(filename_);
+        const auto frame = replay.map_frame();
+        ASSERT_NE(nullptr, frame);
+        frame->data[0] = 0x42;
+        ASSERT_EQ(0x42, frame->data[0]);
+    }
+
+    cam_replay_capture_source replay(filename_);
+    ASSERT_EQ(1, replay.map_frame()->data[0]);
+}
+
+TEST_F(test_replay_capture, loop_continues_timestamps)
+{
+    write_frames(2, 2, 2);
+
+    cam_replay_capture_source replay(filename_, true);
+    for (int i = 0; i < 5; ++i)
+    {
+        ASSERT_NE(nullptr, replay.map_frame());
+        ASSERT_EQ(static_cast<uint64_t>(i) * 40000, replay.get_timestamp());
+    }
+}
+
+TEST_F(test_replay_capture, truncated_frame_is_ignored)
+{
+    write_frames(4, 4, 2);
+    {
+        std::ofstream file(filename_, std::ios::binary | std::ios::app);
+        file.write("partial", 7);
+    }
+
+    cam_replay_capture_source replay(filename_);
+    ASSERT_EQ(2, replay.get_frame_count());
+}
+
+TEST_F(test_replay_capture, invalid_file_throws)
+{
+    {
+        std::ofstream file(filename_, std::ios::binary);
+        file << "this is not a raw frame file, but it is long enough to hold a header.........";
+    }
+
+    ASSERT_THROW(cam_replay_capture_source{filename_}, std::runtime_error);
+    ASSERT_THROW(cam_replay_capture_source{"does_not_exist.camraw"}, std::runtime_error);
+}
+
+TEST_F(test_replay_capture, truncated_header_throws)
+{
+    write_frames(4, 4, 1);
+
+    std::vector<char> data(sizeof(cam_raw_file_header) / 2);
+    {
+        std::ifstream file(filename_, std::ios::binary);
+        file.read(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+    {
+        std::ofstream file(filename_, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+
+    ASSERT_THROW(cam_replay_capture_source{filename_}, std::runtime_error);
+}
+
+TEST_F(test_replay_capture, invalid_header_throws)
+{
+    const auto expect_invalid = [this](auto patch) {
+        write_frames(4, 4, 1);
+        patch_header(patch);
+        EXPECT_THROW(cam_replay_capture_source{filename_}, std::runtime_error);
+    };
+
+    expect_invalid([](cam_raw_file_header &header) { header.header_size = 0; });
+    expect_invalid([](cam_raw_file_header &header) { header.header_size = sizeof(header) - 1; });
+    expect_invalid([](cam_raw_file_header &header) { header.header_size = 1u << 30; });
+    expect_invalid([](cam_raw_file_header &header) { header.width = 0; });
+    expect_invalid([](cam_raw_file_header &header) { header.height = -1; });
+    expect_invalid([](cam_raw_file_header &header) { header.stride = 0; });
+    expect_invalid([](cam_raw_file_header &header) { header.stride = header.width * 4 - 1; });
+    expect_invalid([](cam_raw_file_header &header) { header.width = 1 << 30; });
+    expect_invalid([](cam_raw_file_header &header) { header.frame_size = 0; });
+}
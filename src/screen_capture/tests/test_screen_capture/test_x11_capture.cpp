@@ -0,0 +1,213 @@
+/**
+ * Copyright(C) 2018  Steven Hoving
+ *
+ * This program is free software : you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gtest/gtest.h>
+#include <screen_capture/cam_x11_capture.h>
+
+#include <X11/Xlib.h>
+
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+/* These tests need an x server, run them under Xvfb:
+ *   Xvfb :99 -screen 0 1920x1080x24 &
+ *   DISPLAY=:99 ./test_screen_capture
+ */
+class test_x11_capture : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        if (std::getenv("DISPLAY") == nullptr)
+            GTEST_SKIP() << "no x11 display, run the tests under Xvfb";
+
+        display_ = XOpenDisplay(nullptr);
+        ASSERT_NE(nullptr, display_);
+    }
+
+    void TearDown() override
+    {
+        if (display_ != nullptr)
+            XCloseDisplay(display_);
+    }
+
+    // fill the screen below the windows with rgb, instead of the stipple pattern of Xvfb.
+    void fill_root_window(unsigned long rgb)
+    {
+        const auto root = DefaultRootWindow(display_);
+        XSetWindowBackground(display_, root, rgb);
+        XClearWindow(display_, root);
+        XSync(display_, False);
+    }
+
+    // show a window filled with rgb, without a window manager moving it.
+    Window create_window(int x, int y, int width, int height, unsigned long rgb)
+    {
+        XSetWindowAttributes attributes{};
+        attributes.override_redirect = True;
+        attributes.background_pixel = rgb;
+
+        const auto window = XCreateWindow(display_, DefaultRootWindow(display_), x, y,
+            static_cast<unsigned int>(width), static_cast<unsigned int>(height), 0, CopyFromParent,
+            InputOutput, CopyFromParent, CWOverrideRedirect | CWBackPixel, &attributes);
+        XMapRaised(display_, window);
+        XSync(display_, False);
+        return window;
+    }
+
+    Display *display_{nullptr};
+};
+
+TEST_F(test_x11_capture, capture_whole_screen)
+{
+    cam_x11_capture_source capture({0, 0, 0, 0});
+    const auto rect = capture.get_capture_rect();
+    ASSERT_EQ(DisplayWidth(display_, DefaultScreen(display_)), rect.width());
+    ASSERT_EQ(DisplayHeight(display_, DefaultScreen(display_)), rect.height());
+
+    std::vector<unsigned char> data(static_cast<size_t>(rect.width()) * rect.height() * 4);
+    cam_capture_buffer buffer{data.data(), rect.width(), rect.height(), rect.width() * 4};
+    ASSERT_TRUE(capture.capture_frame(buffer));
+
+    // without change tracking the damage is the whole frame.
+    const auto &damage = capture.get_damage();
+    ASSERT_EQ(1u, damage.size());
+    ASSERT_EQ(rect.width(), damage.front().width());
+    ASSERT_EQ(rect.height(), damage.front().height());
+}
+
+TEST_F(test_x11_capture, capture_region_into_padded_buffer)
+{
+    fill_root_window(0x0000ff);
+    const auto window = create_window(100, 50, 64, 32, 0xff0000);
+
+    cam_x11_capture_source capture({90, 40, 190, 100});
+    ASSERT_TRUE(capture.uses_shared_memory());
+
+    // a stride that is larger than a line, with a guard value in the padding.
+    constexpr auto width = 100;
+    constexpr auto height = 60;
+    constexpr auto stride = width * 4 + 64;
+    std::vector<unsigned char> data(static_cast<size_t>(stride) * height, 0xcd);
+    cam_capture_buffer buffer{data.data(), width, height, stride};
+    ASSERT_TRUE(capture.capture_frame(buffer));
+
+    // the red window starts at 10,10 in the blue frame, and the frame is bgra.
+    const auto pixel = [&](int x, int y) { return data.data() + y * stride + x * 4; };
+    const auto expect_rgb = [&](int x, int y, unsigned char r, unsigned char g, unsigned char b) {
+        EXPECT_EQ(b, pixel(x, y)[0]) << x << "," << y;
+        EXPECT_EQ(g, pixel(x, y)[1]) << x << "," << y;
+        EXPECT_EQ(r, pixel(x, y)[2]) << x << "," << y;
+    };
+    expect_rgb(9, 9, 0x00, 0x00, 0xff);
+    expect_rgb(10, 10, 0xff, 0x00, 0x00);
+    expect_rgb(73, 41, 0xff, 0x00, 0x00);
+    expect_rgb(74, 42, 0x00, 0x00, 0xff);
+    expect_rgb(width - 1, height - 1, 0x00, 0x00, 0xff);
+    EXPECT_EQ(0xcd, pixel(width, 0)[0]);
+
+    XDestroyWindow(display_, window);
+}
+
+TEST_F(test_x11_capture, rect_outside_of_screen_throws)
+{
+    const auto width = DisplayWidth(display_, DefaultScreen(display_));
+    ASSERT_THROW(cam_x11_capture_source({width - 10, 0, width + 10, 10}), std::runtime_error);
+}
+
+TEST_F(test_x11_capture, buffer_too_small_throws)
+{
+    cam_x11_capture_source capture({0, 0, 64, 64});
+    std::vector<unsigned char> data(32 * 64 * 4);
+    cam_capture_buffer buffer{data.data(), 32, 64, 32 * 4};
+    ASSERT_THROW(capture.capture_frame(buffer), std::runtime_error);
+}
+
+TEST_F(test_x11_capture, damage_reports_changed_rects)
+{
+    cam_x11_capture_source capture({0, 0, 320, 240});
+    if (!capture.uses_damage())
+        GTEST_SKIP() << "the display has no DAMAGE extension";
+
+    std::vector<unsigned char> data(320 * 240 * 4);
+    cam_capture_buffer buffer{data.data(), 320, 240, 320 * 4};
+    const auto pixel = [&](int x, int y) { return data.data() + (y * 320 + x) * 4; };
+
+    // the first frame is fetched completely.
+    ASSERT_TRUE(capture.capture_frame(buffer));
+    ASSERT_EQ(1u, capture.get_damage().size());
+    ASSERT_EQ(320, capture.get_damage().front().width());
+    const auto background = pixel(120, 60)[2];
+
+    ASSERT_TRUE(capture.capture_frame(buffer));
+    ASSERT_TRUE(capture.get_damage().empty());
+
+    // only the window is fetched, the frame still holds the rest of the screen.
+    fill_root_window(0x0000ff);
+    const auto window = create_window(100, 50, 64, 32, 0xff0000);
+    ASSERT_TRUE(capture.capture_frame(buffer));
+    ASSERT_FALSE(capture.get_damage().empty());
+    for (const auto &rect : capture.get_damage())
+    {
+        EXPECT_GE(rect.left(), 0);
+        EXPECT_LE(rect.right(), 320);
+    }
+    EXPECT_EQ(0xff, pixel(120, 60)[2]);
+
+    XDestroyWindow(display_, window);
+    XSync(display_, False);
+    ASSERT_TRUE(capture.capture_frame(buffer));
+    EXPECT_EQ(background, pixel(120, 60)[2]);
+}
+
+TEST_F(test_x11_capture, untouched_buffer_only_gets_the_damage)
+{
+    cam_x11_capture_source capture({0, 0, 320, 240});
+    if (!capture.uses_damage())
+        GTEST_SKIP() << "the display has no DAMAGE extension";
+
+    std::vector<unsigned char> data(320 * 240 * 4);
+    cam_capture_buffer buffer{data.data(), 320, 240, 320 * 4, true};
+    ASSERT_TRUE(capture.capture_frame(buffer));
+
+    // a marker outside of the damage shows whether the unchanged part was copied again.
+    data[(200 * 320 + 300) * 4] = 0xcd;
+    ASSERT_TRUE(capture.capture_frame(buffer));
+    ASSERT_TRUE(capture.get_damage().empty());
+    EXPECT_EQ(0xcd, data[(200 * 320 + 300) * 4]);
+
+    // a buffer the caller draws on gets the whole frame.
+    buffer.keeps_previous_frame = false;
+    ASSERT_TRUE(capture.capture_frame(buffer));
+    EXPECT_NE(0xcd, data[(200 * 320 + 300) * 4]);
+}
+
+TEST_F(test_x11_capture, without_damage_tracking_every_frame_is_damaged)
+{
+    cam_x11_capture_source capture({0, 0, 64, 64}, nullptr, false);
+    ASSERT_FALSE(capture.uses_damage());
+
+    std::vector<unsigned char> data(64 * 64 * 4);
+    cam_capture_buffer buffer{data.data(), 64, 64, 64 * 4};
+    for (int i = 0; i < 2; ++i)
+    {
+        ASSERT_TRUE(capture.capture_frame(buffer));
+        ASSERT_EQ(1u, capture.get_damage().size());
+        ASSERT_EQ(64, capture.get_damage().front().width());
+    }
+}